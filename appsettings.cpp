@@ -19,7 +19,15 @@ AppSettings::AppSettings(QObject *parent) :
     QObject(parent),
     m_logNdefToFile(true),
     m_logNdefDir(DEFAULT_NDEF_LOG_DIR),
+    m_logNdefSegmented(false),
+    m_logNdefDedup(false),
+    m_logNdefDedupRetentionDays(DEFAULT_NDEF_DEDUP_RETENTION_DAYS),
+    m_logNdefAsync(true),
     m_deleteTagBeforeWriting(false),
+    m_persistTagProfiles(false),
+    m_shrinkMessagesToFit(false),
+    m_verifyWrites(false),
+    m_diffWrites(false),
 #if defined(MEEGO_EDITION_HARMATTAN) && !defined(USE_SNEP)
     m_useSnep(false),   // MeeGo: not allowed to use SNEP port
 #else
@@ -136,6 +144,54 @@ QString AppSettings::logNdefDir(const bool collected)
     return m_logNdefDir + (collected ? COLLECTED_LOG_DIR : SAVED_LOG_DIR);
 }
 
+void AppSettings::setLogNdefSegmented(const bool logNdefSegmented)
+{
+    if (logNdefSegmented != m_logNdefSegmented) {
+        m_logNdefSegmented = logNdefSegmented;
+    }
+}
+
+bool AppSettings::logNdefSegmented() const
+{
+    return m_logNdefSegmented;
+}
+
+void AppSettings::setLogNdefDedup(const bool logNdefDedup)
+{
+    if (logNdefDedup != m_logNdefDedup) {
+        m_logNdefDedup = logNdefDedup;
+    }
+}
+
+bool AppSettings::logNdefDedup() const
+{
+    return m_logNdefDedup;
+}
+
+void AppSettings::setLogNdefDedupRetentionDays(const int logNdefDedupRetentionDays)
+{
+    if (logNdefDedupRetentionDays != m_logNdefDedupRetentionDays) {
+        m_logNdefDedupRetentionDays = qMax(0, logNdefDedupRetentionDays);
+    }
+}
+
+int AppSettings::logNdefDedupRetentionDays() const
+{
+    return m_logNdefDedupRetentionDays;
+}
+
+void AppSettings::setLogNdefAsync(const bool logNdefAsync)
+{
+    if (logNdefAsync != m_logNdefAsync) {
+        m_logNdefAsync = logNdefAsync;
+    }
+}
+
+bool AppSettings::logNdefAsync() const
+{
+    return m_logNdefAsync;
+}
+
 void AppSettings::setDeleteTagBeforeWriting(const bool deleteTagBeforeWriting)
 {
     if (deleteTagBeforeWriting != m_deleteTagBeforeWriting) {
@@ -148,6 +204,54 @@ bool AppSettings::deleteTagBeforeWriting() const
     return m_deleteTagBeforeWriting;
 }
 
+void AppSettings::setPersistTagProfiles(const bool persistTagProfiles)
+{
+    if (persistTagProfiles != m_persistTagProfiles) {
+        m_persistTagProfiles = persistTagProfiles;
+    }
+}
+
+bool AppSettings::persistTagProfiles() const
+{
+    return m_persistTagProfiles;
+}
+
+void AppSettings::setShrinkMessagesToFit(const bool shrinkMessagesToFit)
+{
+    if (shrinkMessagesToFit != m_shrinkMessagesToFit) {
+        m_shrinkMessagesToFit = shrinkMessagesToFit;
+    }
+}
+
+bool AppSettings::shrinkMessagesToFit() const
+{
+    return m_shrinkMessagesToFit;
+}
+
+void AppSettings::setVerifyWrites(const bool verifyWrites)
+{
+    if (verifyWrites != m_verifyWrites) {
+        m_verifyWrites = verifyWrites;
+    }
+}
+
+bool AppSettings::verifyWrites() const
+{
+    return m_verifyWrites;
+}
+
+void AppSettings::setDiffWrites(const bool diffWrites)
+{
+    if (diffWrites != m_diffWrites) {
+        m_diffWrites = diffWrites;
+    }
+}
+
+bool AppSettings::diffWrites() const
+{
+    return m_diffWrites;
+}
+
 void AppSettings::setUseSnep(const bool useSnep)
 {
     if (useSnep != m_useSnep) {
@@ -166,7 +270,15 @@ void AppSettings::saveSettings()
     settings.setValue("settingsversion", SETTINGS_VERSION);
     settings.setValue("logNdefToFile", m_logNdefToFile);
     settings.setValue("logNdefDir", m_logNdefDir);
+    settings.setValue("logNdefSegmented", m_logNdefSegmented);
+    settings.setValue("logNdefDedup", m_logNdefDedup);
+    settings.setValue("logNdefDedupRetentionDays", m_logNdefDedupRetentionDays);
+    settings.setValue("logNdefAsync", m_logNdefAsync);
     settings.setValue("deleteTags", m_deleteTagBeforeWriting);
+    settings.setValue("persistTagProfiles", m_persistTagProfiles);
+    settings.setValue("shrinkMessages", m_shrinkMessagesToFit);
+    settings.setValue("verifyWrites", m_verifyWrites);
+    settings.setValue("diffWrites", m_diffWrites);
     settings.setValue("useSnep", m_useSnep);
     settings.setValue("useConnectionLess", m_useConnectionLess);
     settings.setValue("nfcUri", m_nfcUri);
@@ -183,7 +295,15 @@ void AppSettings::loadSettings()
         // Only load settings from version SETTINGS_VERSION with this code
         m_logNdefToFile = settings.value("logNdefToFile", true).toBool();
         m_logNdefDir = settings.value("logNdefDir", DEFAULT_NDEF_LOG_DIR).toString();
+        m_logNdefSegmented = settings.value("logNdefSegmented", false).toBool();
+        m_logNdefDedup = settings.value("logNdefDedup", false).toBool();
+        m_logNdefDedupRetentionDays = qMax(0, settings.value("logNdefDedupRetentionDays", DEFAULT_NDEF_DEDUP_RETENTION_DAYS).toInt());
+        m_logNdefAsync = settings.value("logNdefAsync", true).toBool();
         m_deleteTagBeforeWriting = settings.value("deleteTags", false).toBool();
+        m_persistTagProfiles = settings.value("persistTagProfiles", false).toBool();
+        m_shrinkMessagesToFit = settings.value("shrinkMessages", false).toBool();
+        m_verifyWrites = settings.value("verifyWrites", false).toBool();
+        m_diffWrites = settings.value("diffWrites", false).toBool();
 #if defined(MEEGO_EDITION_HARMATTAN) && !defined(USE_SNEP)
         m_useSnep = settings.value("useSnep", false).toBool();      // MeeGo: not allowed to use SNEP port
 #else
@@ -32,8 +32,13 @@
     #define DEFAULT_NDEF_LOG_DIR "/home/user/MyDocs/nfc/"
 #elif defined(QT_SIMULATOR)
     #define DEFAULT_NDEF_LOG_DIR "C:/nfc/"
+#else
+    // Desktop tools, e.g., the benchmarks
+    #define DEFAULT_NDEF_LOG_DIR "nfc/"
 #endif
 #define COLLECTED_LOG_DIR "collected/"
+/*! Default number of days that reads are kept in the deduplicating store. */
+#define DEFAULT_NDEF_DEDUP_RETENTION_DAYS 90
 #define SAVED_LOG_DIR "saved/"
 
 /*! Default connection URN for the connection-oriented SNEP mode. */
@@ -65,9 +70,25 @@ public slots:
     void setLogNdefDir(const QString& logNdefDir);
     QString logNdefDir() const;
     QString logNdefDir(const bool collected);
+    void setLogNdefSegmented(const bool logNdefSegmented);
+    bool logNdefSegmented() const;
+    void setLogNdefDedup(const bool logNdefDedup);
+    bool logNdefDedup() const;
+    void setLogNdefDedupRetentionDays(const int logNdefDedupRetentionDays);
+    int logNdefDedupRetentionDays() const;
+    void setLogNdefAsync(const bool logNdefAsync);
+    bool logNdefAsync() const;
 
     void setDeleteTagBeforeWriting(const bool deleteTagBeforeWriting);
     bool deleteTagBeforeWriting() const;
+    void setPersistTagProfiles(const bool persistTagProfiles);
+    bool persistTagProfiles() const;
+    void setShrinkMessagesToFit(const bool shrinkMessagesToFit);
+    bool shrinkMessagesToFit() const;
+    void setVerifyWrites(const bool verifyWrites);
+    bool verifyWrites() const;
+    void setDiffWrites(const bool diffWrites);
+    bool diffWrites() const;
 
     // Peer to peer
     void setUseSnep(const bool useSnep);
@@ -95,7 +116,18 @@ private:
     bool m_logNdefToFile;
     /*! If logging tags to files is enabled, in which directory so store them. */
     QString m_logNdefDir;
-
+    /*! Append collected messages to rolling segment files (NdefSegmentLog)
+      instead of creating one file per message. */
+    bool m_logNdefSegmented;
+    /*! Store each distinct collected message only once (NdefDedupStore)
+      and only log the time and tag UID of repeated reads. */
+    bool m_logNdefDedup;
+    /*! Reads older than this number of days are removed from the
+      deduplicating store, together with the messages only they refer
+      to. 0 keeps all reads. */
+    int m_logNdefDedupRetentionDays;
+    /*! Write the log files of read tags on a background thread (NfcLogWriter). */
+    bool m_logNdefAsync;
 
     /*! Write an empty message to the tag before writing the cached message.
       This increases the stability when writing to factory-empty tags, as
@@ -103,6 +135,22 @@ private:
       message writing then usually works fine. */
     bool m_deleteTagBeforeWriting;
 
+    /*! Store the analysis results of known tags (NfcTagProfileCache)
+      in the log directory, so that they are kept after restarting the app. */
+    bool m_persistTagProfiles;
+
+    /*! Reduce the size of messages that are too large for the tag
+      (NdefMessageShrinker) instead of failing to write them. */
+    bool m_shrinkMessagesToFit;
+
+    /*! Read each written message back from the still present tag
+      and compare it (NfcWriteVerifier). */
+    bool m_verifyWrites;
+
+    /*! Only write the changed blocks of Type 2 tags (NfcDiffWriter),
+      instead of the complete message. */
+    bool m_diffWrites;
+
     /*! Use the SNEP (Simple Ndef Exchange Protocol) for peer-to-peer communication. */
     bool m_useSnep;
 
@@ -26,6 +26,9 @@
 #include "nfctypes.h"
 #include "nfcrecordmodel.h"
 #include "nfcrecorditem.h"
+#ifdef USE_NFC_SIMULATOR
+#include "nfcsimulatedmanager.h"
+#endif
 #if defined(USE_IAP) && defined (Q_OS_SYMBIAN)
 #include "iapmanager.h"
 
@@ -224,9 +227,17 @@ int main(int argc, char *argv[])
     nfcInfo->setDeclarativeView(viewer);
     nfcInfo->setAppSettings(settings);
     nfcInfo->setImageCache(tagImageCache);
+#ifdef USE_NFC_SIMULATOR
+    // Simulated tags, touched from the QML UI
+    NfcSimulatedManager* nfcSimulator = new NfcSimulatedManager(nfcInfo.data());
+    nfcInfo->setSimulator(nfcSimulator);
+    viewer.rootContext()->setContextProperty("nfcSimulator", nfcSimulator);
+#endif
     // Pass the record model back to the QML
     // Could be easier to just make the model a property?
     viewer.rootContext()->setContextProperty("recordModel", nfcInfo->recordModel());
+    // Searchable catalog of the collected tags
+    viewer.rootContext()->setContextProperty("tagCatalog", nfcInfo->tagCatalog());
 #ifdef USE_IAP
 #ifdef Q_OS_SYMBIAN
     // Symbian: set unlimited tags according to whether it has been purchased already
@@ -0,0 +1,21 @@
+# Decoding and logging of raw NDEF messages, without any dependencies
+# to the UI. Shared by the app and the command line tools.
+SOURCES += $$PWD/ndefrecordview.cpp \
+    $$PWD/ndefstreamdecoder.cpp \
+    $$PWD/ndefmessagedecoder.cpp \
+    $$PWD/ndefsegmentlog.cpp \
+    $$PWD/ndefmappedfile.cpp \
+    $$PWD/ndefdedupstore.cpp \
+    $$PWD/ndeftlvparser.cpp \
+    $$PWD/ndefmessagetemplate.cpp \
+    $$PWD/nfctrace.cpp
+HEADERS += $$PWD/ndefrecordview.h \
+    $$PWD/ndefstreamdecoder.h \
+    $$PWD/ndefmessagedecoder.h \
+    $$PWD/ndefsegmentlog.h \
+    $$PWD/ndefmappedfile.h \
+    $$PWD/ndefdedupstore.h \
+    $$PWD/ndeftlvparser.h \
+    $$PWD/ndefmessagetemplate.h \
+    $$PWD/nfctrace.h
+INCLUDEPATH += $$PWD
@@ -0,0 +1,434 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "ndefdedupstore.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QtEndian>
+#include <QDebug>
+
+NdefDedupStore::NdefDedupStore() :
+    m_tombstoneCount(0),
+    m_readCount(0),
+    m_savedBytes(0)
+{
+}
+
+NdefDedupStore::~NdefDedupStore()
+{
+    close();
+}
+
+/*!
+  \brief Open the store in the \a directory and load the reference
+  counts from its journal. An incomplete read at the end of the
+  journal (e.g., after a crash) is removed.
+  */
+bool NdefDedupStore::open(const QString &directory)
+{
+    close();
+    m_errorString.clear();
+    if (!QDir().mkpath(directory)) {
+        m_errorString = "Unable to create store directory: " + directory;
+        qDebug() << m_errorString;
+        return false;
+    }
+    m_directory = QDir(directory).absolutePath() + "/";
+    if (!loadJournal() || !openJournal()) {
+        m_directory.clear();
+        return false;
+    }
+    return true;
+}
+
+void NdefDedupStore::close()
+{
+    m_journal.close();
+    m_messages.clear();
+    m_tombstoneCount = 0;
+    m_readCount = 0;
+    m_savedBytes = 0;
+    m_directory.clear();
+}
+
+bool NdefDedupStore::isOpen() const
+{
+    return !m_directory.isEmpty();
+}
+
+QString NdefDedupStore::directory() const
+{
+    return m_directory;
+}
+
+QString NdefDedupStore::errorString() const
+{
+    return m_errorString;
+}
+
+/*!
+  \brief Record a read of the \a rawMessage from the tag with the \a uid.
+
+  The message itself is only written if it isn't stored yet. The read
+  is appended to the journal with a single write.
+
+  \param timestamp time of the read. If invalid, the current time is used.
+  \return the file name of the stored message, which can be loaded
+  like any other logged message, or an empty string in case of an error.
+  */
+QString NdefDedupStore::append(const QByteArray &rawMessage, const QByteArray &uid, const QDateTime &timestamp)
+{
+    if (!isOpen()) {
+        m_errorString = "Store is not open";
+        return QString();
+    }
+
+    // Find the stored message, or the next free hash in case of a collision.
+    // Tombstones don't end the search, but can take the new message.
+    quint64 key = hash(rawMessage);
+    QHash<quint64, StoredMessage>::iterator it = m_messages.find(key);
+    QHash<quint64, StoredMessage>::iterator tombstone = m_messages.end();
+    while (it != m_messages.end() &&
+           (it.value().refCount <= 0 || it.value().size != rawMessage.size() || !isStoredMessage(key, rawMessage))) {
+        if (it.value().refCount <= 0 && tombstone == m_messages.end()) {
+            tombstone = it;
+        }
+        key++;
+        it = m_messages.find(key);
+    }
+    const bool isNewMessage = (it == m_messages.end());
+    const bool reusesTombstone = (isNewMessage && tombstone != m_messages.end());
+    if (reusesTombstone) {
+        key = tombstone.key();
+    }
+    const QString fileName = messageFileName(key);
+    if (isNewMessage) {
+        QFile messageFile(fileName);
+        if (!messageFile.open(QIODevice::WriteOnly) || messageFile.write(rawMessage) != rawMessage.size()) {
+            m_errorString = "Unable to write message to the store: " + fileName;
+            qDebug() << m_errorString;
+            return QString();
+        }
+        messageFile.close();
+    }
+
+    // Assemble the read record, so that it can be written with a single call
+    const QByteArray uidBytes = uid.left(255);
+    const qint64 msecs = (timestamp.isValid() ? timestamp : QDateTime::currentDateTime()).toMSecsSinceEpoch();
+    QByteArray read;
+    read.resize(NDEF_DEDUP_READ_HEADER_LENGTH + uidBytes.size());
+    uchar *data = reinterpret_cast<uchar *>(read.data());
+    qToBigEndian<quint64>((quint64)msecs, data);
+    qToBigEndian<quint64>(key, data + 8);
+    data[16] = (uchar)uidBytes.size();
+    memcpy(data + NDEF_DEDUP_READ_HEADER_LENGTH, uidBytes.constData(), uidBytes.size());
+    if (m_journal.write(read) != read.size()) {
+        // An unreferenced new message will be removed by collectGarbage()
+        m_errorString = "Unable to write to the journal: " + m_journal.fileName();
+        qDebug() << m_errorString;
+        return QString();
+    }
+
+    if (isNewMessage) {
+        StoredMessage message;
+        message.refCount = 1;
+        message.size = rawMessage.size();
+        m_messages.insert(key, message);
+        if (reusesTombstone) {
+            m_tombstoneCount--;
+        }
+    } else {
+        it.value().refCount++;
+        m_savedBytes += rawMessage.size();
+    }
+    m_readCount++;
+    return fileName;
+}
+
+/*!
+  \brief Number of distinct messages in the store.
+  */
+int NdefDedupStore::messageCount() const
+{
+    return m_messages.size() - m_tombstoneCount;
+}
+
+/*!
+  \brief Number of reads recorded in the journal.
+  */
+int NdefDedupStore::readCount() const
+{
+    return m_readCount;
+}
+
+/*!
+  \brief Number of message bytes that didn't have to be written
+  since the store has been opened, because the message was stored
+  already.
+  */
+qint64 NdefDedupStore::savedBytes() const
+{
+    return m_savedBytes;
+}
+
+/*!
+  \brief Remove all reads before the \a time from the journal and
+  delete the messages that aren't referenced by any read anymore.
+
+  The journal is rewritten to a temporary file, which then replaces
+  the original journal. The original is kept as a backup until the new
+  journal is in place, and is restored if replacing it fails.
+
+  \return the number of deleted messages, or -1 in case of an error.
+  */
+int NdefDedupStore::removeReadsBefore(const QDateTime &time)
+{
+    if (!isOpen()) {
+        m_errorString = "Store is not open";
+        return -1;
+    }
+    const qint64 limit = time.toMSecsSinceEpoch();
+    const QString journalName = m_directory + NDEF_DEDUP_JOURNAL_NAME;
+    m_journal.close();
+    QFile journal(journalName);
+    QFile newJournal(journalName + ".new");
+    if (!journal.open(QIODevice::ReadOnly) || !newJournal.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_errorString = "Unable to rewrite the journal: " + journalName;
+        qDebug() << m_errorString;
+        openJournal();
+        return -1;
+    }
+
+    QList<quint64> removed;
+    newJournal.write(journal.read(NDEF_DEDUP_MAGIC_LENGTH));
+    uchar header[NDEF_DEDUP_READ_HEADER_LENGTH];
+    while (journal.read(reinterpret_cast<char *>(header), NDEF_DEDUP_READ_HEADER_LENGTH) == NDEF_DEDUP_READ_HEADER_LENGTH) {
+        const QByteArray uid = journal.read(header[16]);
+        if (uid.size() != header[16]) {
+            break;
+        }
+        if ((qint64)qFromBigEndian<quint64>(header) < limit) {
+            removed.append(qFromBigEndian<quint64>(header + 8));
+        } else {
+            newJournal.write(reinterpret_cast<const char *>(header), NDEF_DEDUP_READ_HEADER_LENGTH);
+            newJournal.write(uid);
+        }
+    }
+    journal.close();
+    if (!newJournal.flush() || newJournal.error() != QFile::NoError) {
+        m_errorString = "Unable to rewrite the journal: " + newJournal.fileName();
+        newJournal.close();
+        newJournal.remove();
+        openJournal();
+        return -1;
+    }
+    newJournal.close();
+    const QString backupName = journalName + NDEF_DEDUP_BACKUP_SUFFIX;
+    QFile::remove(backupName);
+    if (!journal.rename(backupName)) {
+        m_errorString = "Unable to replace the journal: " + journalName;
+        qDebug() << m_errorString;
+        newJournal.remove();
+        openJournal();
+        return -1;
+    }
+    if (!newJournal.rename(journalName)) {
+        m_errorString = "Unable to replace the journal: " + journalName;
+        qDebug() << m_errorString;
+        // Continue with the complete old journal
+        journal.rename(journalName);
+        newJournal.remove();
+        openJournal();
+        return -1;
+    }
+    // Only delete messages once the new journal doesn't reference them anymore
+    journal.remove();
+
+    const int messagesBefore = messageCount();
+    foreach (const quint64 key, removed) {
+        releaseMessage(key);
+    }
+    m_readCount -= removed.size();
+    openJournal();
+    return messagesBefore - messageCount();
+}
+
+/*!
+  \brief Delete all message files of the store that aren't referenced
+  by any read, e.g., because the app was closed after writing the
+  message but before recording the read.
+
+  \return the number of deleted files.
+  */
+int NdefDedupStore::collectGarbage()
+{
+    if (!isOpen()) {
+        return 0;
+    }
+    int deleted = 0;
+    QDirIterator it(m_directory, QStringList() << QString("*") + NDEF_DEDUP_SUFFIX, QDir::Files);
+    while (it.hasNext()) {
+        const QString fileName = it.next();
+        bool ok = false;
+        const quint64 key = it.fileInfo().completeBaseName().toULongLong(&ok, 16);
+        QHash<quint64, StoredMessage>::const_iterator message = m_messages.constFind(key);
+        const bool isReferenced = (message != m_messages.constEnd() && message.value().refCount > 0);
+        if (ok && !isReferenced && QFile::remove(fileName)) {
+            deleted++;
+        }
+    }
+    return deleted;
+}
+
+/*!
+  \brief Full file name of the message with the \a hash.
+  */
+QString NdefDedupStore::messageFileName(const quint64 hash) const
+{
+    return m_directory + QString("%1").arg(hash, 16, 16, QChar('0')) + NDEF_DEDUP_SUFFIX;
+}
+
+/*!
+  \brief Returns true if the message file with the \a hash contains
+  the \a rawMessage. Only called if the hash and the size match, so
+  the file is only read completely for a repeated message.
+  */
+bool NdefDedupStore::isStoredMessage(const quint64 hash, const QByteArray &rawMessage) const
+{
+    QFile messageFile(messageFileName(hash));
+    if (!messageFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return messageFile.readAll() == rawMessage;
+}
+
+/*!
+  \brief 64 bit FNV-1a hash of the raw message.
+  */
+quint64 NdefDedupStore::hash(const QByteArray &rawMessage)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    const uchar *data = reinterpret_cast<const uchar *>(rawMessage.constData());
+    const int size = rawMessage.size();
+    for (int i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+/*!
+  \brief Count the references to each message in the journal.
+  */
+bool NdefDedupStore::loadJournal()
+{
+    QFile journal(m_directory + NDEF_DEDUP_JOURNAL_NAME);
+    const QString backupName = journal.fileName() + NDEF_DEDUP_BACKUP_SUFFIX;
+    if (!journal.exists() && QFile::exists(backupName)) {
+        // Interrupted while replacing the journal in removeReadsBefore()
+        qDebug() << "Restoring the store journal from its backup";
+        QFile::rename(backupName, journal.fileName());
+    }
+    if (!journal.exists()) {
+        return true;
+    }
+    if (!journal.open(QIODevice::ReadWrite)) {
+        m_errorString = "Unable to open the journal: " + journal.fileName();
+        qDebug() << m_errorString;
+        return false;
+    }
+    if (journal.read(NDEF_DEDUP_MAGIC_LENGTH) != NDEF_DEDUP_MAGIC) {
+        m_errorString = "Not a journal of the store: " + journal.fileName();
+        qDebug() << m_errorString;
+        return false;
+    }
+    qint64 validSize = journal.pos();
+    uchar header[NDEF_DEDUP_READ_HEADER_LENGTH];
+    while (journal.read(reinterpret_cast<char *>(header), NDEF_DEDUP_READ_HEADER_LENGTH) == NDEF_DEDUP_READ_HEADER_LENGTH) {
+        if (!journal.seek(journal.pos() + header[16]) || journal.pos() > journal.size()) {
+            break;
+        }
+        const quint64 key = qFromBigEndian<quint64>(header + 8);
+        QHash<quint64, StoredMessage>::iterator it = m_messages.find(key);
+        if (it != m_messages.end()) {
+            it.value().refCount++;
+        } else {
+            StoredMessage message;
+            message.refCount = 1;
+            message.size = (int)QFileInfo(messageFileName(key)).size();
+            m_messages.insert(key, message);
+        }
+        m_readCount++;
+        validSize = journal.pos();
+    }
+    if (validSize < journal.size()) {
+        qDebug() << "Store journal truncated, recovered " << m_readCount << " reads";
+        journal.resize(validSize);
+    }
+    return true;
+}
+
+/*!
+  \brief Open the journal for appending reads, creating it if needed.
+  */
+bool NdefDedupStore::openJournal()
+{
+    m_journal.setFileName(m_directory + NDEF_DEDUP_JOURNAL_NAME);
+    const bool isNew = !m_journal.exists();
+    if (!m_journal.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        m_errorString = "Unable to open the journal: " + m_journal.fileName();
+        qDebug() << m_errorString;
+        return false;
+    }
+    if (isNew) {
+        m_journal.write(NDEF_DEDUP_MAGIC, NDEF_DEDUP_MAGIC_LENGTH);
+    }
+    return true;
+}
+
+/*!
+  \brief Drop a reference to the message, and delete it when the
+  last reference is gone.
+
+  If other messages follow in the probe chain, the entry is kept as
+  a tombstone. Otherwise, the entry and the tombstones directly in
+  front of it are removed, as they don't lead to any message anymore.
+  */
+void NdefDedupStore::releaseMessage(const quint64 hash)
+{
+    QHash<quint64, StoredMessage>::iterator it = m_messages.find(hash);
+    if (it == m_messages.end() || it.value().refCount <= 0) {
+        return;
+    }
+    if (--it.value().refCount > 0) {
+        return;
+    }
+    QFile::remove(messageFileName(hash));
+    if (m_messages.contains(hash + 1)) {
+        m_tombstoneCount++;
+        return;
+    }
+    m_messages.erase(it);
+    quint64 key = hash - 1;
+    it = m_messages.find(key);
+    while (it != m_messages.end() && it.value().refCount <= 0) {
+        m_messages.erase(it);
+        m_tombstoneCount--;
+        key--;
+        it = m_messages.find(key);
+    }
+}
@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NDEFDEDUPSTORE_H
+#define NDEFDEDUPSTORE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+
+/*
+  Layout of the store, inside the directory passed to open():
+
+  <hash>.txt            raw NDEF message, stored once for each distinct
+                        message. The file name is the hash as 16 hex digits.
+  reads.log             journal of all reads (all numbers big endian):
+    "NDEFDUP1"          8 bytes magic
+    Read, repeated:
+      timestamp         qint64, ms since epoch (UTC)
+      hash              quint64, name of the message file
+      UID length        quint8
+      UID               bytes of the tag UID
+  reads.log.old         previous journal, only while removeReadsBefore()
+                        replaces it
+  */
+#define NDEF_DEDUP_SUBDIR "dedup/"
+#define NDEF_DEDUP_JOURNAL_NAME "reads.log"
+#define NDEF_DEDUP_BACKUP_SUFFIX ".old"
+#define NDEF_DEDUP_MAGIC "NDEFDUP1"
+#define NDEF_DEDUP_MAGIC_LENGTH 8
+#define NDEF_DEDUP_READ_HEADER_LENGTH 17
+#define NDEF_DEDUP_SUFFIX ".txt"
+
+/*!
+  \brief Content-addressed store for collected NDEF messages.
+
+  Most tags that are read repeatedly contain the same message. The
+  store only writes each distinct message once, to a file named
+  after its 64 bit FNV-1a hash; every read only appends a small
+  record with the time, the hash and the tag UID to the journal.
+
+  Messages are reference counted by the reads that refer to them.
+  removeReadsBefore() expires old reads and deletes the messages
+  that are no longer referenced; collectGarbage() removes message
+  files that have never been recorded in the journal, e.g., after
+  a crash.
+
+  Two messages are considered identical if they have the same hash
+  and size, and the stored file contains the same bytes. In the
+  unlikely case of a hash collision, the next free hash value is used
+  for the new message. When a message of such a probe chain is deleted,
+  its entry is kept as a tombstone (reference count 0) while messages
+  follow it in the chain, so that these can still be found. Tombstones
+  are reused for new messages and aren't persisted; after reopening
+  the store, a gap in a chain can at most cause a message to be
+  stored a second time.
+  */
+class NdefDedupStore
+{
+public:
+    NdefDedupStore();
+    ~NdefDedupStore();
+
+    bool open(const QString &directory);
+    void close();
+    bool isOpen() const;
+    QString directory() const;
+    QString errorString() const;
+
+    QString append(const QByteArray &rawMessage, const QByteArray &uid, const QDateTime &timestamp = QDateTime());
+
+    int messageCount() const;
+    int readCount() const;
+    qint64 savedBytes() const;
+
+    int removeReadsBefore(const QDateTime &time);
+    int collectGarbage();
+
+    QString messageFileName(const quint64 hash) const;
+    static quint64 hash(const QByteArray &rawMessage);
+
+private:
+    bool loadJournal();
+    bool openJournal();
+    bool isStoredMessage(const quint64 hash, const QByteArray &rawMessage) const;
+    void releaseMessage(const quint64 hash);
+
+private:
+    struct StoredMessage {
+        int refCount;
+        int size;
+    };
+    QString m_directory;
+    QFile m_journal;
+    /*! Reference count and size of all stored messages, by hash. */
+    QHash<quint64, StoredMessage> m_messages;
+    /*! Entries of m_messages that are tombstones of deleted messages. */
+    int m_tombstoneCount;
+    int m_readCount;
+    /*! Bytes that didn't have to be written thanks to deduplication. */
+    qint64 m_savedBytes;
+    QString m_errorString;
+};
+
+#endif // NDEFDEDUPSTORE_H
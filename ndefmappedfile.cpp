@@ -0,0 +1,161 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "ndefmappedfile.h"
+#include <QDebug>
+#include <limits.h>
+
+NdefMappedFile::NdefMappedFile() :
+    m_mappedData(NULL),
+    m_size(0)
+{
+}
+
+NdefMappedFile::~NdefMappedFile()
+{
+    close();
+}
+
+/*!
+  \brief Open and map the file. Any previously mapped file is closed.
+  \return false if the file couldn't be opened or is empty.
+  */
+bool NdefMappedFile::open(const QString &fileName)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = "Unable to open file: " + fileName;
+        return false;
+    }
+    const qint64 fileSize = m_file.size();
+    if (fileSize <= 0 || fileSize > INT_MAX) {
+        m_errorString = "Unable to load file: " + fileName;
+        m_file.close();
+        return false;
+    }
+    m_size = (int)fileSize;
+    m_mappedData = m_file.map(0, fileSize);
+    if (!m_mappedData) {
+        // Not all file systems support mapping
+        qDebug() << "Unable to map file, reading instead: " << fileName;
+        m_fallbackData = m_file.readAll();
+        if (m_fallbackData.size() != m_size) {
+            m_errorString = "Unable to load file: " + fileName;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+  \brief Unmap the file. Messages created by message() must not be
+  used anymore afterwards.
+  */
+void NdefMappedFile::close()
+{
+    if (m_mappedData) {
+        m_file.unmap(m_mappedData);
+        m_mappedData = NULL;
+    }
+    m_fallbackData.clear();
+    m_file.close();
+    m_size = 0;
+}
+
+bool NdefMappedFile::isOpen() const
+{
+    return m_size > 0;
+}
+
+/*!
+  \brief Returns true if the file is memory-mapped, false if it had
+  to be read into memory.
+  */
+bool NdefMappedFile::isMapped() const
+{
+    return m_mappedData != NULL;
+}
+
+QString NdefMappedFile::fileName() const
+{
+    return m_file.fileName();
+}
+
+QString NdefMappedFile::errorString() const
+{
+    return m_errorString;
+}
+
+int NdefMappedFile::size() const
+{
+    return m_size;
+}
+
+/*!
+  \brief Size of the NDEF message in the file, without any trailing
+  data that doesn't belong to the message.
+  */
+int NdefMappedFile::messageSize() const
+{
+    if (!isOpen()) {
+        return 0;
+    }
+    return NdefMessageView(rawMessage()).byteSize();
+}
+
+/*!
+  \brief The raw contents of the file, referencing the mapped region
+  without copying.
+  */
+QByteArray NdefMappedFile::rawMessage() const
+{
+    if (m_mappedData) {
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(m_mappedData), m_size);
+    }
+    return m_fallbackData;
+}
+
+/*!
+  \brief Create the NDEF message contained in the file.
+
+  The record payloads reference the mapped region. Messages with
+  chunked records are merged by QNdefMessage and therefore copied.
+
+  \return an empty message if the file doesn't contain a valid
+  NDEF message.
+  */
+QNdefMessage NdefMappedFile::message() const
+{
+    if (!isOpen()) {
+        return QNdefMessage();
+    }
+    const char *data = m_mappedData ? reinterpret_cast<const char *>(m_mappedData) : m_fallbackData.constData();
+    const NdefMessageView view(data, m_size);
+    if (!view.isValid()) {
+        return QNdefMessage();
+    }
+    if (view.hasChunkedRecords()) {
+        return QNdefMessage::fromByteArray(rawMessage());
+    }
+    QList<QNdefRecord> records;
+    records.reserve(view.size());
+    for (int i = 0; i < view.size(); i++) {
+        records.append(view.at(i).toSharedRecord());
+    }
+    return QNdefMessage(records);
+}
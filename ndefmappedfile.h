@@ -0,0 +1,79 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NDEFMAPPEDFILE_H
+#define NDEFMAPPEDFILE_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QNdefMessage>
+#include "ndefrecordview.h"
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Memory-maps a file containing a raw NDEF message and
+  creates the QNdefMessage directly from the mapped region.
+
+  The payloads of the records of message() are not copied - they
+  reference the mapping, which therefore has to stay alive for as
+  long as the message (or any copy of it) is in use. Large messages,
+  e.g., with images, are thus loaded without reading the file into
+  memory first and without the additional copy of
+  QNdefMessage::fromByteArray().
+
+  The file must not be truncated or overwritten while it is mapped:
+  accessing the truncated pages crashes (SIGBUS on Linux), and on
+  Symbian and Windows, the file can't be written at all. Before
+  writing to the file, copy the message (e.g., through
+  QNdefMessage::fromByteArray(message.toByteArray())) and close().
+
+  If the file can't be mapped, it is read into memory instead.
+  */
+class NdefMappedFile
+{
+public:
+    NdefMappedFile();
+    ~NdefMappedFile();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+    bool isMapped() const;
+
+    QString fileName() const;
+    QString errorString() const;
+
+    int size() const;
+    int messageSize() const;
+    QByteArray rawMessage() const;
+    QNdefMessage message() const;
+
+private:
+    Q_DISABLE_COPY(NdefMappedFile)
+
+    QFile m_file;
+    /*! Start of the mapped region, or NULL if the file has been read
+      into m_fallbackData instead. */
+    uchar *m_mappedData;
+    /*! Contents of the file if mapping is not supported. */
+    QByteArray m_fallbackData;
+    int m_size;
+    QString m_errorString;
+};
+
+#endif // NDEFMAPPEDFILE_H
@@ -0,0 +1,404 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "ndefmessagedecoder.h"
+
+/*!
+  \brief URI identifier codes of the NFC Forum URI RTD, used to
+  abbreviate common URI prefixes in the first payload byte.
+  */
+static const char * const UriPrefixes[] = {
+    "",
+    "http://www.",
+    "https://www.",
+    "http://",
+    "https://",
+    "tel:",
+    "mailto:",
+    "ftp://anonymous:anonymous@",
+    "ftp://ftp.",
+    "ftps://",
+    "sftp://",
+    "smb://",
+    "nfs://",
+    "ftp://",
+    "dav://",
+    "news:",
+    "telnet://",
+    "imap:",
+    "rtsp://",
+    "urn:",
+    "pop:",
+    "sip:",
+    "sips:",
+    "tftp:",
+    "btspp://",
+    "btl2cap://",
+    "btgoep://",
+    "tcpobex://",
+    "irdaobex://",
+    "file://",
+    "urn:epc:id:",
+    "urn:epc:tag:",
+    "urn:epc:pat:",
+    "urn:epc:raw:",
+    "urn:epc:",
+    "urn:nfc:"
+};
+static const int UriPrefixCount = sizeof(UriPrefixes) / sizeof(UriPrefixes[0]);
+
+ParsedNdefMessage::ParsedNdefMessage() :
+    m_byteSize(0),
+    m_valid(false)
+{
+}
+
+/*!
+  \brief Returns true if the complete message could be decoded.
+
+  If false, the records that could be decoded before the first
+  truncated or malformed record are still available.
+  */
+bool ParsedNdefMessage::isValid() const
+{
+    return m_valid;
+}
+
+bool ParsedNdefMessage::isEmpty() const
+{
+    return m_records.isEmpty();
+}
+
+/*!
+  \brief Number of bytes of the raw message that could be decoded.
+  */
+int ParsedNdefMessage::byteSize() const
+{
+    return m_byteSize;
+}
+
+/*!
+  \brief The raw message the spans of the records refer to.
+
+  If the original message contained chunked records, this is the
+  equivalent message with the chunks merged.
+  */
+QByteArray ParsedNdefMessage::rawMessage() const
+{
+    return m_rawMessage;
+}
+
+int ParsedNdefMessage::recordCount() const
+{
+    return m_records.size();
+}
+
+const ParsedNdefRecord &ParsedNdefMessage::record(const int index) const
+{
+    return m_records[index];
+}
+
+/*!
+  \brief Title of a Smart Poster; see ParsedNdefRecord::firstTitle.
+  */
+const ParsedNdefText &ParsedNdefMessage::title(const int index) const
+{
+    return m_titles[index];
+}
+
+const char *ParsedNdefMessage::data(const NdefSpan &span) const
+{
+    return span.isNull() ? NULL : m_rawMessage.constData() + span.offset;
+}
+
+/*!
+  \brief Contents of the \a span. The returned byte array does not own
+  its data, but points directly into the raw message.
+  */
+QByteArray ParsedNdefMessage::bytes(const NdefSpan &span) const
+{
+    return span.isNull() ? QByteArray() : QByteArray::fromRawData(data(span), span.length);
+}
+
+/*!
+  \brief View of the raw record, e.g., to create an owning QNdefRecord
+  through NdefRecordView::toRecord().
+  */
+NdefRecordView ParsedNdefMessage::recordView(const ParsedNdefRecord &record) const
+{
+    NdefRecordView view;
+    if (!record.raw.isNull()) {
+        NdefRecordView::parse(data(record.raw), record.raw.length, view);
+    }
+    return view;
+}
+
+QString ParsedNdefMessage::toAscii(const NdefSpan &span) const
+{
+    return span.isNull() ? QString() : QString::fromAscii(data(span), span.length);
+}
+
+QString ParsedNdefMessage::toUtf8(const NdefSpan &span) const
+{
+    return span.isNull() ? QString() : QString::fromUtf8(data(span), span.length);
+}
+
+/*!
+  \brief Convert the text of a text record or Smart Poster title
+  to a string, using the encoding specified by the record.
+  */
+QString ParsedNdefMessage::text(const ParsedNdefText &text) const
+{
+    if (text.text.isNull()) {
+        return QString();
+    }
+    if (text.utf16) {
+        // The NFC Text RTD specifies big endian if there is no byte
+        // order mark. Don't rely on the codec, which would fall back
+        // to the byte order of the host.
+        const char *textData = data(text.text);
+        int length = text.text.length;
+        const char *codecName = "UTF-16BE";
+        if (length >= 2) {
+            if ((quint8)textData[0] == 0xFF && (quint8)textData[1] == 0xFE) {
+                codecName = "UTF-16LE";
+                textData += 2;
+                length -= 2;
+            } else if ((quint8)textData[0] == 0xFE && (quint8)textData[1] == 0xFF) {
+                textData += 2;
+                length -= 2;
+            }
+        }
+        return QTextCodec::codecForName(codecName)->toUnicode(textData, length);
+    }
+    return toUtf8(text.text);
+}
+
+/*!
+  \brief Full URI of a Uri record or Smart Poster, including the
+  expanded URI prefix.
+  */
+QUrl ParsedNdefMessage::uri(const ParsedNdefRecord &record) const
+{
+    if (record.uri.isNull()) {
+        return QUrl();
+    }
+    return QUrl(NdefMessageDecoder::uriPrefix(record.uriPrefix) + toUtf8(record.uri));
+}
+
+// ----------------------------------------------------------------------------
+
+/*!
+  \brief Decode the raw NDEF message into the structured \a result.
+
+  \return true if the complete message could be decoded.
+  */
+bool NdefMessageDecoder::decode(const QByteArray &rawMessage, ParsedNdefMessage &result)
+{
+    result.m_rawMessage = rawMessage;
+    result.m_records.clear();
+    result.m_titles.clear();
+    result.m_valid = false;
+    result.m_byteSize = 0;
+
+    NdefMessageView messageView(rawMessage);
+    if (messageView.hasChunkedRecords()) {
+        // Let Qt Mobility merge the chunks, then decode the
+        // resulting message instead.
+        result.m_rawMessage = QNdefMessage::fromByteArray(rawMessage).toByteArray();
+        messageView = NdefMessageView(result.m_rawMessage);
+    }
+
+    const char *base = result.m_rawMessage.constData();
+    result.m_records.resize(messageView.size());
+    for (int i = 0; i < messageView.size(); i++) {
+        decodeRecord(messageView.at(i), base, result, result.m_records[i]);
+    }
+    result.m_byteSize = messageView.byteSize();
+    result.m_valid = messageView.isValid();
+    return result.m_valid;
+}
+
+/*!
+  \brief Expand the URI identifier code of a Uri record to the prefix
+  it stands for.
+  */
+QString NdefMessageDecoder::uriPrefix(const quint8 uriCode)
+{
+    return (uriCode < UriPrefixCount) ? QString::fromLatin1(UriPrefixes[uriCode]) : QString();
+}
+
+/*!
+  \brief Determine which kind of record the view contains, based on
+  the type name format and the type.
+
+  Only covers the record types whose payload the decoder splits into
+  the structured fields of ParsedNdefRecord; the kind selects the
+  decoding step in decodeRecord(). This is deliberately separate from
+  the NdefRecordHandlerRegistry of the app: the decoder has no UI
+  dependencies and is used by the command line tools and from other
+  threads. Handlers registered there for other types get the record
+  with its type, id and payload spans and decode the payload themselves.
+  */
+ParsedNdefRecord::RecordKind NdefMessageDecoder::classifyRecord(const NdefRecordView &view)
+{
+    switch (view.typeNameFormat()) {
+    case QNdefRecord::NfcRtd:
+        if (view.isRecordType(QNdefRecord::NfcRtd, "U")) {
+            return ParsedNdefRecord::KindUri;
+        } else if (view.isRecordType(QNdefRecord::NfcRtd, "T")) {
+            return ParsedNdefRecord::KindText;
+        } else if (view.isRecordType(QNdefRecord::NfcRtd, "Sp")) {
+            return ParsedNdefRecord::KindSmartPoster;
+        }
+        break;
+    case QNdefRecord::Mime:
+        if (view.typeStartsWith(QNdefRecord::Mime, "image/")) {
+            return ParsedNdefRecord::KindImage;
+        } else if (view.isRecordType(QNdefRecord::Mime, "text/x-vCard")) {
+            return ParsedNdefRecord::KindVcard;
+        }
+        break;
+    case QNdefRecord::Uri:
+        if (view.isRecordType(QNdefRecord::Uri, "windows.com/LaunchApp")) {
+            return ParsedNdefRecord::KindLaunchApp;
+        }
+        break;
+    case QNdefRecord::ExternalRtd:
+        if (view.isRecordType(QNdefRecord::ExternalRtd, "android.com:pkg")) {
+            return ParsedNdefRecord::KindAndroidApp;
+        }
+        return ParsedNdefRecord::KindExternal;
+    default:
+        break;
+    }
+    return view.isEmpty() ? ParsedNdefRecord::KindEmpty : ParsedNdefRecord::KindUnknown;
+}
+
+void NdefMessageDecoder::decodeRecord(const NdefRecordView &view, const char *base, ParsedNdefMessage &result, ParsedNdefRecord &record)
+{
+    record.kind = classifyRecord(view);
+    record.typeNameFormat = view.typeNameFormat();
+    record.raw = makeSpan(base, view.recordData(), view.recordLength());
+    record.type = makeSpan(base, view.typeData(), view.typeLength());
+    record.id = view.idLength() > 0 ? makeSpan(base, view.idData(), view.idLength()) : nullSpan();
+    record.payload = makeSpan(base, view.payloadData(), view.payloadLength());
+
+    record.uriPrefix = 0;
+    record.uri = nullSpan();
+    record.text.locale = nullSpan();
+    record.text.text = nullSpan();
+    record.text.utf16 = false;
+    record.firstTitle = result.m_titles.size();
+    record.titleCount = 0;
+    record.spAction = -1;
+    record.hasSpSize = false;
+    record.spSize = 0;
+    record.spMimeType = nullSpan();
+    record.imageType = nullSpan();
+    record.image = nullSpan();
+
+    switch (record.kind) {
+    case ParsedNdefRecord::KindUri:
+        if (view.payloadLength() > 0) {
+            record.uriPrefix = (quint8)view.payloadData()[0];
+            record.uri = makeSpan(base, view.payloadData() + 1, view.payloadLength() - 1);
+        }
+        break;
+    case ParsedNdefRecord::KindText:
+        decodeText(view, base, record.text);
+        break;
+    case ParsedNdefRecord::KindSmartPoster:
+        decodeSmartPoster(view, base, result, record);
+        break;
+    case ParsedNdefRecord::KindImage:
+        record.imageType = record.type;
+        record.image = record.payload;
+        break;
+    default:
+        break;
+    }
+}
+
+/*!
+  \brief Find the locale and the text within the payload of a text record
+  and determine the encoding from the status byte.
+  */
+void NdefMessageDecoder::decodeText(const NdefRecordView &view, const char *base, ParsedNdefText &text)
+{
+    text.utf16 = false;
+    text.locale = nullSpan();
+    text.text = nullSpan();
+    if (view.payloadLength() < 1) {
+        return;
+    }
+    const char *payload = view.payloadData();
+    const quint8 status = payload[0];
+    text.utf16 = (status & 0x80) != 0;
+    const int localeLength = qMin((int)(status & 0x3F), view.payloadLength() - 1);
+    text.locale = makeSpan(base, payload + 1, localeLength);
+    text.text = makeSpan(base, payload + 1 + localeLength, view.payloadLength() - 1 - localeLength);
+}
+
+/*!
+  \brief Decode the records nested in the payload of a Smart Poster.
+  */
+void NdefMessageDecoder::decodeSmartPoster(const NdefRecordView &view, const char *base, ParsedNdefMessage &result, ParsedNdefRecord &record)
+{
+    const NdefMessageView spMessage(view.payloadData(), view.payloadLength());
+    for (int i = 0; i < spMessage.size(); i++) {
+        const NdefRecordView &spRecord = spMessage.at(i);
+        if (spRecord.isRecordType(QNdefRecord::NfcRtd, "U")) {
+            if (spRecord.payloadLength() > 0) {
+                record.uriPrefix = (quint8)spRecord.payloadData()[0];
+                record.uri = makeSpan(base, spRecord.payloadData() + 1, spRecord.payloadLength() - 1);
+            }
+        } else if (spRecord.isRecordType(QNdefRecord::NfcRtd, "T")) {
+            ParsedNdefText title;
+            decodeText(spRecord, base, title);
+            result.m_titles.append(title);
+            record.titleCount++;
+        } else if (spRecord.isRecordType(QNdefRecord::NfcRtd, "act")) {
+            record.spAction = (spRecord.payloadLength() == 1) ? (quint8)spRecord.payloadData()[0] : 0xFF;
+        } else if (spRecord.isRecordType(QNdefRecord::NfcRtd, "s")) {
+            record.hasSpSize = true;
+            if (spRecord.payloadLength() == 4) {
+                const uchar *p = (const uchar *)spRecord.payloadData();
+                record.spSize = ((quint32)p[0] << 24) | ((quint32)p[1] << 16) | ((quint32)p[2] << 8) | (quint32)p[3];
+            }
+        } else if (spRecord.isRecordType(QNdefRecord::NfcRtd, "t")) {
+            record.spMimeType = makeSpan(base, spRecord.payloadData(), spRecord.payloadLength());
+        } else if (spRecord.typeStartsWith(QNdefRecord::Mime, "image/")) {
+            record.imageType = makeSpan(base, spRecord.typeData(), spRecord.typeLength());
+            record.image = makeSpan(base, spRecord.payloadData(), spRecord.payloadLength());
+        }
+    }
+}
+
+NdefSpan NdefMessageDecoder::makeSpan(const char *base, const char *start, const int length)
+{
+    NdefSpan span;
+    span.offset = start - base;
+    span.length = length;
+    return span;
+}
+
+NdefSpan NdefMessageDecoder::nullSpan()
+{
+    NdefSpan span;
+    span.offset = -1;
+    span.length = 0;
+    return span;
+}
@@ -0,0 +1,173 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NDEFMESSAGEDECODER_H
+#define NDEFMESSAGEDECODER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+#include <QVector>
+#include <QTextCodec>
+#include <QNdefMessage>
+#include <QNdefRecord>
+#include "ndefrecordview.h"
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Position of a field within the raw message buffer of
+  a ParsedNdefMessage. A negative offset marks a field that is
+  not present.
+  */
+struct NdefSpan
+{
+    int offset;
+    int length;
+
+    bool isNull() const { return offset < 0; }
+};
+
+/*!
+  \brief Decoded contents of a text record, either stand-alone
+  or as the title of a Smart Poster.
+  */
+struct ParsedNdefText
+{
+    NdefSpan locale;
+    NdefSpan text;
+    bool utf16;
+};
+
+/*!
+  \brief Structured result of decoding a single NDEF record.
+
+  Plain data only: all variable-length fields are stored as spans
+  into the raw buffer of the ParsedNdefMessage, which provides the
+  methods to convert them to Qt types when needed.
+  */
+struct ParsedNdefRecord
+{
+    enum RecordKind {
+        KindEmpty,
+        KindUnknown,
+        KindUri,
+        KindText,
+        KindSmartPoster,
+        KindImage,
+        KindVcard,
+        KindLaunchApp,
+        KindAndroidApp,
+        KindExternal
+    };
+
+    RecordKind kind;
+    QNdefRecord::TypeNameFormat typeNameFormat;
+    /*! The complete record, including the header. */
+    NdefSpan raw;
+    NdefSpan type;
+    NdefSpan id;
+    NdefSpan payload;
+
+    // Uri record and Uri of the Smart Poster
+    quint8 uriPrefix;
+    NdefSpan uri;
+
+    // Text record
+    ParsedNdefText text;
+
+    // Smart Poster - the titles are stored in the message
+    int firstTitle;
+    int titleCount;
+    /*! Smart Poster action, or -1 if not present. */
+    int spAction;
+    bool hasSpSize;
+    quint32 spSize;
+    NdefSpan spMimeType;
+
+    // Image record and image of the Smart Poster
+    NdefSpan imageType;
+    NdefSpan image;
+};
+
+/*!
+  \brief Result of decoding a complete raw NDEF message with the
+  NdefMessageDecoder.
+
+  Keeps a (shared, not copied) reference to the raw message, so that
+  the spans of the records stay valid as long as this instance exists.
+  No strings are created during decoding; the conversion methods
+  of this class only allocate when a field is actually needed, e.g.,
+  to render it for the UI.
+  */
+class ParsedNdefMessage
+{
+public:
+    ParsedNdefMessage();
+
+    bool isValid() const;
+    bool isEmpty() const;
+    int byteSize() const;
+    QByteArray rawMessage() const;
+
+    int recordCount() const;
+    const ParsedNdefRecord &record(const int index) const;
+    const ParsedNdefText &title(const int index) const;
+
+    const char *data(const NdefSpan &span) const;
+    QByteArray bytes(const NdefSpan &span) const;
+    NdefRecordView recordView(const ParsedNdefRecord &record) const;
+
+    QString toAscii(const NdefSpan &span) const;
+    QString toUtf8(const NdefSpan &span) const;
+    QString text(const ParsedNdefText &text) const;
+    QUrl uri(const ParsedNdefRecord &record) const;
+
+private:
+    friend class NdefMessageDecoder;
+
+    QByteArray m_rawMessage;
+    QVector<ParsedNdefRecord> m_records;
+    QVector<ParsedNdefText> m_titles;
+    /*! Number of bytes of the raw message that could be decoded. */
+    int m_byteSize;
+    bool m_valid;
+};
+
+/*!
+  \brief Decodes raw NDEF messages into the structured ParsedNdefMessage.
+
+  The decoder only classifies the records and finds the positions of
+  their fields - it doesn't create strings, images or contacts and
+  doesn't have any side effects. Therefore, it can be used for
+  headless validation and batch processing of logged messages, as
+  well as from multiple threads at the same time.
+  */
+class NdefMessageDecoder
+{
+public:
+    static bool decode(const QByteArray &rawMessage, ParsedNdefMessage &result);
+    static QString uriPrefix(const quint8 uriCode);
+
+private:
+    static ParsedNdefRecord::RecordKind classifyRecord(const NdefRecordView &view);
+    static void decodeRecord(const NdefRecordView &view, const char *base, ParsedNdefMessage &result, ParsedNdefRecord &record);
+    static void decodeText(const NdefRecordView &view, const char *base, ParsedNdefText &text);
+    static void decodeSmartPoster(const NdefRecordView &view, const char *base, ParsedNdefMessage &result, ParsedNdefRecord &record);
+    static NdefSpan makeSpan(const char *base, const char *start, const int length);
+    static NdefSpan nullSpan();
+};
+
+#endif // NDEFMESSAGEDECODER_H
@@ -0,0 +1,234 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "ndefmessageshrinker.h"
+
+NdefMessageShrinker::NdefMessageShrinker()
+{
+}
+
+/*!
+  \brief Apply the shrinking steps to the \a message until its size
+  is at most \a maxSize bytes.
+
+  The message is modified even if it doesn't fit in the end.
+
+  \param maxSize maximum size of the raw message in bytes. If it's
+  negative, the size is unknown and the message isn't modified.
+  \return true if the message fits.
+  */
+bool NdefMessageShrinker::shrink(QNdefMessage &message, const int maxSize)
+{
+    m_changes.clear();
+    if (fits(message, maxSize)) {
+        return true;
+    }
+
+    // Lossless: shorter encoding of the same contents
+    compressUris(message);
+    if (fits(message, maxSize)) {
+        return true;
+    }
+    simplifySps(message, SpAllParts, "Shortened Smart Poster");
+    if (fits(message, maxSize)) {
+        return true;
+    }
+
+    // Lossy: remove optional info and reduce the image quality
+    simplifySps(message, SpAllParts & ~(SpSize | SpMimeType), "Removed size and type of Smart Poster");
+    if (fits(message, maxSize)) {
+        return true;
+    }
+    while (scaleImages(message)) {
+        if (fits(message, maxSize)) {
+            return true;
+        }
+    }
+    simplifySps(message, SpImage, "Removed titles and action of Smart Poster");
+    return fits(message, maxSize);
+}
+
+/*!
+  \brief Description of the modifications of the last call to shrink().
+  */
+QStringList NdefMessageShrinker::changes() const
+{
+    return m_changes;
+}
+
+/*!
+  \brief Encode the URI records of the \a message again, using the
+  URI identifier code of the longest matching prefix.
+  \return true if at least one record got smaller.
+  */
+bool NdefMessageShrinker::compressUris(QNdefMessage &message)
+{
+    bool changed = false;
+    for (int i = 0; i < message.size(); i++) {
+        if (!message.at(i).isRecordType<QNdefNfcUriRecord>()) {
+            continue;
+        }
+        const QNdefNfcUriRecord uriRecord(message.at(i));
+        QNdefNfcUriRecord compressedRecord;
+        compressedRecord.setUri(uriRecord.uri());
+        if (compressedRecord.payload().size() < uriRecord.payload().size()) {
+            message[i] = compressedRecord;
+            changed = true;
+        }
+    }
+    if (changed) {
+        m_changes.append("Abbreviated URI prefix");
+    }
+    return changed;
+}
+
+/*!
+  \brief Rebuild the Smart Poster records of the \a message, only
+  keeping the parts specified in \a keepParts.
+
+  Smart Posters that only have a URI left are converted to URI records.
+  \param change description of the step, added to the changes if at
+  least one record got smaller.
+  \return true if at least one record got smaller.
+  */
+bool NdefMessageShrinker::simplifySps(QNdefMessage &message, const int keepParts, const QString &change)
+{
+    bool changed = false;
+    bool convertedToUri = false;
+    for (int i = 0; i < message.size(); i++) {
+        const QNdefRecord &record = message.at(i);
+        if (!record.isRecordType<NdefNfcSpRecord>()) {
+            continue;
+        }
+        const NdefNfcSpRecord spRecord(record);
+        const QNdefRecord simplifiedRecord = rebuildSp(spRecord, keepParts);
+        if (simplifiedRecord.payload().size() + simplifiedRecord.type().size() <
+                record.payload().size() + record.type().size()) {
+            convertedToUri |= (simplifiedRecord.type() != record.type());
+            message[i] = simplifiedRecord;
+            changed = true;
+        }
+    }
+    if (changed) {
+        m_changes.append(convertedToUri ? change + " (now a URI record)" : change);
+    }
+    return changed;
+}
+
+/*!
+  \brief Halve the width and height of all images in the \a message,
+  including the images of Smart Posters.
+  \return true if at least one image got smaller.
+  */
+bool NdefMessageShrinker::scaleImages(QNdefMessage &message)
+{
+    bool changed = false;
+    for (int i = 0; i < message.size(); i++) {
+        const QNdefRecord &record = message.at(i);
+        if (record.typeNameFormat() == QNdefRecord::Mime &&
+                record.type().startsWith("image/")) {
+            const NdefNfcMimeImageRecord imageRecord(record);
+            NdefNfcMimeImageRecord scaledRecord(imageRecord.mimeType());
+            if (scaleImage(imageRecord, scaledRecord)) {
+                message[i] = scaledRecord;
+                changed = true;
+            }
+        } else if (record.isRecordType<NdefNfcSpRecord>()) {
+            const NdefNfcSpRecord spRecord(record);
+            if (!spRecord.imageInUse()) {
+                continue;
+            }
+            const NdefNfcMimeImageRecord imageRecord = spRecord.image();
+            NdefNfcMimeImageRecord scaledRecord(imageRecord.mimeType());
+            if (scaleImage(imageRecord, scaledRecord)) {
+                message[i] = rebuildSp(spRecord, SpAllParts, &scaledRecord);
+                changed = true;
+            }
+        }
+    }
+    if (changed && !m_changes.contains("Scaled down images")) {
+        m_changes.append("Scaled down images");
+    }
+    return changed;
+}
+
+/*!
+  \brief Create a copy of the Smart Poster \a spRecord, only containing
+  the URI and the parts specified in \a keepParts.
+
+  \param image replaces the image of the Smart Poster if not NULL.
+  \return a URI record if no additional info is left, otherwise
+  a Smart Poster record.
+  */
+QNdefRecord NdefMessageShrinker::rebuildSp(const NdefNfcSpRecord &spRecord, const int keepParts, const NdefNfcMimeImageRecord *image) const
+{
+    // Stays a URI record unless Smart Poster info is added
+    NdefNfcSmartUriRecord smartUri;
+    smartUri.setUri(spRecord.uri());
+    if ((keepParts & SpTitles) && spRecord.titleCount() > 0) {
+        smartUri.setTitleList(spRecord.titles());
+    }
+    if ((keepParts & SpAction) && spRecord.actionInUse()) {
+        smartUri.setAction(spRecord.action());
+    }
+    if ((keepParts & SpSize) && spRecord.sizeInUse()) {
+        smartUri.setSize(spRecord.size());
+    }
+    if ((keepParts & SpMimeType) && spRecord.mimeTypeInUse()) {
+        smartUri.setMimeType(spRecord.mimeType());
+    }
+    if (keepParts & SpImage) {
+        if (image) {
+            smartUri.setImage(*image);
+        } else if (spRecord.imageInUse()) {
+            smartUri.setImage(spRecord.image());
+        }
+    }
+    // Copy the type and payload through the non-virtual methods of
+    // the smart URI record, which return the URI record if possible.
+    QNdefRecord record;
+    record.setTypeNameFormat(QNdefRecord::NfcRtd);
+    record.setType(smartUri.type());
+    record.setPayload(smartUri.payload());
+    return record;
+}
+
+/*!
+  \brief Store the image of \a imageRecord in \a scaledRecord, with
+  half the width and height.
+  \return false if the image is already too small, or if the scaled
+  image doesn't need less space.
+  */
+bool NdefMessageShrinker::scaleImage(const NdefNfcMimeImageRecord &imageRecord, NdefNfcMimeImageRecord &scaledRecord) const
+{
+    const QImage image = imageRecord.image();
+    if (image.isNull() ||
+            image.width() / 2 < SHRINK_MIN_IMAGE_SIZE ||
+            image.height() / 2 < SHRINK_MIN_IMAGE_SIZE) {
+        return false;
+    }
+    const QImage scaledImage = image.scaled(image.width() / 2, image.height() / 2,
+                                            Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    if (!scaledRecord.setImage(scaledImage, imageRecord.mimeType())) {
+        qDebug() << "Unable to encode the scaled image as" << imageRecord.mimeType();
+        return false;
+    }
+    return scaledRecord.payload().size() < imageRecord.payload().size();
+}
+
+bool NdefMessageShrinker::fits(const QNdefMessage &message, const int maxSize) const
+{
+    return maxSize < 0 || message.toByteArray().size() <= maxSize;
+}
@@ -0,0 +1,81 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NDEFMESSAGESHRINKER_H
+#define NDEFMESSAGESHRINKER_H
+
+#include <QDebug>
+#include <QStringList>
+#include <QImage>
+#include <QNdefMessage>
+#include <QNdefRecord>
+#include <QNdefNfcUriRecord>
+#include "ndefnfcrecords/ndefnfcsprecord.h"
+#include "ndefnfcrecords/ndefnfcsmarturirecord.h"
+#include "ndefnfcrecords/ndefnfcmimeimagerecord.h"
+
+// Images are not scaled down further once their width or height
+// would drop below this number of pixels.
+#define SHRINK_MIN_IMAGE_SIZE 16
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Reduces the size of an NDEF message so that it fits on a tag.
+
+  The steps get increasingly lossy and are applied in this order, until
+  the message fits:
+  1. Encode URIs with the abbreviation of their prefix (e.g., "http://www.").
+  2. Convert Smart Posters that only contain a URI to URI records.
+  3. Remove the optional size and type info from Smart Posters.
+  4. Scale down images (both stand-alone and in Smart Posters),
+  halving their size in every iteration.
+  5. Remove the titles and the action from Smart Posters, which
+  then become URI records.
+
+  After shrink(), changes() describes what has been modified, so that
+  the user can be informed.
+  */
+class NdefMessageShrinker
+{
+public:
+    NdefMessageShrinker();
+
+    bool shrink(QNdefMessage &message, const int maxSize);
+    QStringList changes() const;
+
+private:
+    /*! Parts of a Smart Poster that are kept by rebuildSp(). */
+    enum SpPart {
+        SpTitles = 0x01,
+        SpAction = 0x02,
+        SpSize = 0x04,
+        SpMimeType = 0x08,
+        SpImage = 0x10,
+        SpAllParts = 0x1F
+    };
+
+    bool compressUris(QNdefMessage &message);
+    bool simplifySps(QNdefMessage &message, const int keepParts, const QString &change);
+    bool scaleImages(QNdefMessage &message);
+    QNdefRecord rebuildSp(const NdefNfcSpRecord &sp, const int keepParts, const NdefNfcMimeImageRecord *image = NULL) const;
+    bool scaleImage(const NdefNfcMimeImageRecord &imageRecord, NdefNfcMimeImageRecord &scaledRecord) const;
+    bool fits(const QNdefMessage &message, const int maxSize) const;
+
+private:
+    QStringList m_changes;
+};
+
+#endif // NDEFMESSAGESHRINKER_H
@@ -0,0 +1,308 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "ndefmessagetemplate.h"
+#include <QVarLengthArray>
+#include <string.h>
+
+NdefMessageTemplate::NdefMessageTemplate() :
+    m_topLevelRecordCount(0),
+    m_fieldCount(0),
+    m_valid(false)
+{
+}
+
+/*!
+  \brief Compile the raw NDEF message \a rawMessage, which contains
+  the placeholders $0 to $9, into a template.
+
+  \return false if the message is malformed or contains chunked
+  records. The template is invalid afterwards.
+  */
+bool NdefMessageTemplate::compile(const QByteArray &rawMessage)
+{
+    m_records.clear();
+    m_parts.clear();
+    m_literals.clear();
+    m_literals.reserve(rawMessage.size());
+    m_fieldCount = 0;
+    m_topLevelRecordCount = 0;
+    m_valid = (compileMessage(rawMessage.constData(), rawMessage.size()) == 0);
+    if (m_valid) {
+        m_topLevelRecordCount = NdefMessageView(rawMessage).size();
+    }
+    return m_valid;
+}
+
+bool NdefMessageTemplate::isValid() const
+{
+    return m_valid;
+}
+
+/*!
+  \brief Number of values generate() needs: the highest placeholder
+  index used in the template + 1.
+  */
+int NdefMessageTemplate::fieldCount() const
+{
+    return m_fieldCount;
+}
+
+/*!
+  \brief Generate the raw NDEF message of the template, with each
+  placeholder replaced by the corresponding entry of \a values.
+
+  The size of the message is calculated first, so that \a output
+  is only resized once. Reusing the same \a output for all messages
+  avoids any further allocation once it has reached the size of the
+  largest message.
+
+  \return false if the template is invalid or if there are less
+  values than fieldCount().
+  */
+bool NdefMessageTemplate::generate(const QList<QByteArray> &values, QByteArray &output) const
+{
+    if (!m_valid || values.size() < m_fieldCount) {
+        return false;
+    }
+    // Nested records always follow their parent - calculate the sizes
+    // from the back, so that the nested sizes are known for the parent.
+    QVarLengthArray<int, 16> payloadSizes(m_records.size());
+    QVarLengthArray<int, 16> recordSizes(m_records.size());
+    for (int i = m_records.size() - 1; i >= 0; i--) {
+        const TemplateRecord &record = m_records.at(i);
+        int payloadSize = 0;
+        if (record.firstNestedRecord >= 0) {
+            for (int r = 0; r < record.nestedRecordCount; r++) {
+                payloadSize += recordSizes[record.firstNestedRecord + r];
+            }
+        } else {
+            for (int p = record.firstPart; p < record.firstPart + record.partCount; p++) {
+                const TemplatePart &part = m_parts.at(p);
+                payloadSize += (part.field < 0) ? part.literalLength : values.at(part.field).size();
+            }
+        }
+        payloadSizes[i] = payloadSize;
+        // Flags, type length, payload length (1 or 4 bytes), id length (optional)
+        recordSizes[i] = 2 + (payloadSize <= 0xFF ? 1 : 4) + ((record.flags & NDEF_FLAG_IL) ? 1 : 0)
+                + record.typeLength + record.idLength + payloadSize;
+    }
+    int messageSize = 0;
+    for (int i = 0; i < m_topLevelRecordCount; i++) {
+        messageSize += recordSizes[i];
+    }
+
+    output.resize(messageSize);
+    char *end = writeMessage(output.data(), 0, m_topLevelRecordCount, values, payloadSizes.constData());
+    Q_ASSERT(end == output.constData() + messageSize);
+    Q_UNUSED(end);
+    return true;
+}
+
+/*!
+  \brief Generate the raw NDEF message of the template for \a values.
+  \return the message, or an empty byte array if the values don't
+  match the template.
+  */
+QByteArray NdefMessageTemplate::generate(const QList<QByteArray> &values) const
+{
+    QByteArray output;
+    if (!generate(values, output)) {
+        return QByteArray();
+    }
+    return output;
+}
+
+/*!
+  \brief Append the records of the message at \a data to m_records.
+  \return index of the first record in m_records, or -1 if the message
+  can't be used as a template.
+  */
+int NdefMessageTemplate::compileMessage(const char *data, const int size)
+{
+    const NdefMessageView messageView(data, size);
+    if (!messageView.isValid() || messageView.isEmpty() || messageView.hasChunkedRecords()) {
+        return -1;
+    }
+    // Reserve the range of this message first, the records of nested
+    // messages are appended behind it.
+    const int firstRecord = m_records.size();
+    m_records.resize(firstRecord + messageView.size());
+    for (int i = 0; i < messageView.size(); i++) {
+        const NdefRecordView &view = messageView.at(i);
+        TemplateRecord record;
+        record.flags = (quint8)view.recordData()[0] & ~NDEF_FLAG_SR;
+        record.typeLength = view.typeLength();
+        record.idLength = view.idLength();
+        record.typeOffset = appendLiteral(view.typeData(), view.typeLength());
+        appendLiteral(view.idData(), view.idLength());
+        record.firstPart = m_parts.size();
+        record.partCount = 0;
+        record.firstNestedRecord = -1;
+        record.nestedRecordCount = 0;
+        m_records[firstRecord + i] = record;
+        compilePayload(view, firstRecord + i);
+    }
+    return firstRecord;
+}
+
+/*!
+  \brief Split the payload of the record \a view into literal parts
+  and fields, or compile it as a nested message for Smart Posters.
+  */
+void NdefMessageTemplate::compilePayload(const NdefRecordView &view, const int recordIndex)
+{
+    const char *payload = view.payloadData();
+    const int payloadLength = view.payloadLength();
+    const bool placeholders = hasPlaceholders(view);
+    const bool smartPoster = view.isRecordType(QNdefRecord::NfcRtd, "Sp");
+    if (placeholders && smartPoster) {
+        const int recordCount = m_records.size();
+        const int partCount = m_parts.size();
+        const int literalsSize = m_literals.size();
+        const int firstNestedRecord = compileMessage(payload, payloadLength);
+        if (firstNestedRecord >= 0) {
+            m_records[recordIndex].firstNestedRecord = firstNestedRecord;
+            m_records[recordIndex].nestedRecordCount = NdefMessageView(payload, payloadLength).size();
+            return;
+        }
+        // Invalid nested message - copy the payload unchanged
+        m_records.resize(recordCount);
+        m_parts.resize(partCount);
+        m_literals.truncate(literalsSize);
+    }
+
+    TemplatePart part;
+    part.field = -1;
+    part.literalOffset = m_literals.size();
+    part.literalLength = 0;
+    if (placeholders && !smartPoster) {
+        int literalStart = 0;
+        int pos = 0;
+        while (pos < payloadLength - 1) {
+            const char next = payload[pos + 1];
+            if (payload[pos] != NDEF_TEMPLATE_PLACEHOLDER || (next != NDEF_TEMPLATE_PLACEHOLDER && (next < '0' || next > '9'))) {
+                pos++;
+                continue;
+            }
+            if (next == NDEF_TEMPLATE_PLACEHOLDER) {
+                // Escaped placeholder character: keep one of both
+                part.literalLength += appendLiteral(payload + literalStart, pos + 1 - literalStart);
+            } else {
+                part.literalLength += appendLiteral(payload + literalStart, pos - literalStart);
+                if (part.literalLength > 0) {
+                    m_parts.append(part);
+                }
+                TemplatePart field;
+                field.literalOffset = 0;
+                field.literalLength = 0;
+                field.field = next - '0';
+                m_parts.append(field);
+                m_fieldCount = qMax(m_fieldCount, field.field + 1);
+                part.literalOffset = m_literals.size();
+                part.literalLength = 0;
+            }
+            pos += 2;
+            literalStart = pos;
+        }
+        part.literalLength += appendLiteral(payload + literalStart, payloadLength - literalStart);
+    } else {
+        part.literalLength = appendLiteral(payload, payloadLength);
+    }
+    if (part.literalLength > 0) {
+        m_parts.append(part);
+    }
+    m_records[recordIndex].partCount = m_parts.size() - m_records[recordIndex].firstPart;
+}
+
+/*!
+  \brief Returns true if the record \a view contains text and its
+  payload contains the placeholder character.
+  */
+bool NdefMessageTemplate::hasPlaceholders(const NdefRecordView &view) const
+{
+    return isTextRecord(view) &&
+            memchr(view.payloadData(), NDEF_TEMPLATE_PLACEHOLDER, view.payloadLength()) != NULL;
+}
+
+bool NdefMessageTemplate::isTextRecord(const NdefRecordView &view) const
+{
+    return view.isRecordType(QNdefRecord::NfcRtd, "U") ||
+            view.isRecordType(QNdefRecord::NfcRtd, "T") ||
+            view.isRecordType(QNdefRecord::NfcRtd, "Sp") ||
+            view.typeStartsWith(QNdefRecord::Mime, "text/");
+}
+
+/*!
+  \brief Append \a size bytes to m_literals.
+  \return the offset of the bytes in m_literals.
+  */
+int NdefMessageTemplate::appendLiteral(const char *data, const int size)
+{
+    const int offset = m_literals.size();
+    if (size > 0) {
+        m_literals.append(data, size);
+    }
+    return offset;
+}
+
+/*!
+  \brief Write the records \a firstRecord to \a firstRecord +
+  \a recordCount - 1 to \a out, using the payload sizes calculated
+  by generate().
+  \return the position behind the last written byte.
+  */
+char *NdefMessageTemplate::writeMessage(char *out, const int firstRecord, const int recordCount, const QList<QByteArray> &values, const int *payloadSizes) const
+{
+    const char *literals = m_literals.constData();
+    for (int i = firstRecord; i < firstRecord + recordCount; i++) {
+        const TemplateRecord &record = m_records.at(i);
+        const quint32 payloadSize = payloadSizes[i];
+        const bool shortRecord = (payloadSize <= 0xFF);
+        *out++ = record.flags | (shortRecord ? NDEF_FLAG_SR : 0);
+        *out++ = record.typeLength;
+        if (shortRecord) {
+            *out++ = (quint8)payloadSize;
+        } else {
+            *out++ = (quint8)(payloadSize >> 24);
+            *out++ = (quint8)(payloadSize >> 16);
+            *out++ = (quint8)(payloadSize >> 8);
+            *out++ = (quint8)payloadSize;
+        }
+        if (record.flags & NDEF_FLAG_IL) {
+            *out++ = record.idLength;
+        }
+        // Type and id are stored next to each other
+        memcpy(out, literals + record.typeOffset, record.typeLength + record.idLength);
+        out += record.typeLength + record.idLength;
+
+        if (record.firstNestedRecord >= 0) {
+            out = writeMessage(out, record.firstNestedRecord, record.nestedRecordCount, values, payloadSizes);
+            continue;
+        }
+        for (int p = record.firstPart; p < record.firstPart + record.partCount; p++) {
+            const TemplatePart &part = m_parts.at(p);
+            if (part.field < 0) {
+                memcpy(out, literals + part.literalOffset, part.literalLength);
+                out += part.literalLength;
+            } else {
+                const QByteArray &value = values.at(part.field);
+                memcpy(out, value.constData(), value.size());
+                out += value.size();
+            }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,103 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NDEFMESSAGETEMPLATE_H
+#define NDEFMESSAGETEMPLATE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+#include "ndefrecordview.h"
+
+// Placeholders in the payloads of a template: $0 to $9. $$ is a literal $.
+#define NDEF_TEMPLATE_PLACEHOLDER   '$'
+#define NDEF_TEMPLATE_MAX_FIELDS    10
+
+/*!
+  \brief Raw NDEF message with placeholders, compiled once and then
+  used to generate many messages that only differ in a few fields.
+
+  compile() splits the payloads of the template message into literal
+  parts and fields, so that generate() only needs to copy the literal
+  bytes and the field values into the output buffer and write the
+  record headers with the new payload lengths. The short record flag
+  is set depending on the new payload length. Smart Poster records
+  that contain placeholders are compiled recursively, so that the
+  lengths of the nested records are updated as well.
+
+  Placeholders are only searched in records that contain text:
+  URI, Text and Smart Poster records, and Mime records of the
+  type text/*, e.g., vCards. All other records are copied unchanged.
+
+  The template is usually a message composed in the editor (with
+  "$0" as part of the URI, the text or a vCard field) and saved
+  through NfcInfo::nfcSaveModelToFile().
+  */
+class NdefMessageTemplate
+{
+public:
+    NdefMessageTemplate();
+
+    bool compile(const QByteArray &rawMessage);
+    bool isValid() const;
+    int fieldCount() const;
+
+    bool generate(const QList<QByteArray> &values, QByteArray &output) const;
+    QByteArray generate(const QList<QByteArray> &values) const;
+
+private:
+    int compileMessage(const char *data, const int size);
+    void compilePayload(const NdefRecordView &view, const int recordIndex);
+    bool hasPlaceholders(const NdefRecordView &view) const;
+    bool isTextRecord(const NdefRecordView &view) const;
+    int appendLiteral(const char *data, const int size);
+    char *writeMessage(char *out, const int firstRecord, const int recordCount, const QList<QByteArray> &values, const int *payloadSizes) const;
+
+private:
+    /*! Part of a record payload: either literal bytes or a field. */
+    struct TemplatePart {
+        /*! Offset of the literal bytes in m_literals. */
+        int literalOffset;
+        int literalLength;
+        /*! Index of the field, or -1 for literal bytes. */
+        int field;
+    };
+    struct TemplateRecord {
+        /*! MB, ME, IL and type name format. SR is set by generate(). */
+        quint8 flags;
+        quint8 typeLength;
+        quint8 idLength;
+        /*! Offset of the type, directly followed by the id, in m_literals. */
+        int typeOffset;
+        /*! Range of the payload parts in m_parts. */
+        int firstPart;
+        int partCount;
+        /*! Range of the nested records in m_records if the payload is an
+          NDEF message with placeholders (Smart Poster), or -1. */
+        int firstNestedRecord;
+        int nestedRecordCount;
+    };
+    /*! Records of all nesting levels. The records of the top level
+      message come first, nested records always follow their parent. */
+    QVector<TemplateRecord> m_records;
+    int m_topLevelRecordCount;
+    QVector<TemplatePart> m_parts;
+    /*! Type, id and literal payload bytes of all records. */
+    QByteArray m_literals;
+    int m_fieldCount;
+    bool m_valid;
+};
+
+#endif // NDEFMESSAGETEMPLATE_H
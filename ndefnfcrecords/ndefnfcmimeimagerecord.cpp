@@ -103,6 +103,21 @@ QByteArray NdefNfcMimeImageRecord::imageRawData() const
     return payload();
 }
 
+/*!
+  \brief File extension for the image contained in this record,
+  based on the mime type (e.g., "png" for "image/png").
+  */
+QString NdefNfcMimeImageRecord::fileExtension() const
+{
+    QByteArray imgExtension = type().toLower();
+    if (imgExtension.startsWith("image/")) {
+        // Remove leading "image/" from the mime type so that only the image
+        // type is left
+        imgExtension = imgExtension.right(imgExtension.size() - 6);
+    }
+    return QString(imgExtension);
+}
+
 /*!
   \brief Save the image contained in this record to a file.
 
@@ -121,13 +136,7 @@ QString NdefNfcMimeImageRecord::saveImageToFile(const QString& fileName) const
     // Do not use QImage::save(), as this would re-encode the image.
     // Instead, only determine the file extension and
     // save the byte array of the payload directly.
-    QByteArray imgExtension = type().toLower();
-    if (imgExtension.startsWith("image/")) {
-        // Remove leading "image/" from the mime type so that only the image
-        // type is left
-        imgExtension = imgExtension.right(imgExtension.size() - 6);
-    }
-    QString fullFileName = fileName + "." + imgExtension;
+    QString fullFileName = fileName + "." + fileExtension();
 
     QFile imgFile(fullFileName);
     if (imgFile.open(QIODevice::WriteOnly)) {
@@ -83,6 +83,7 @@ public:
 
     QImage image() const;
     QByteArray imageRawData() const;
+    QString fileExtension() const;
     QString saveImageToFile(const QString &fileName) const;
 
     bool setImage(QByteArray &imageRawData);
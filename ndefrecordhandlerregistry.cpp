@@ -0,0 +1,173 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "ndefrecordhandlerregistry.h"
+
+NdefRecordHandlerRegistry::NdefRecordHandlerRegistry() :
+    m_lastParseNsecs(0)
+{
+    for (int i = 0; i < NDEF_TNF_COUNT; i++) {
+        m_defaultIndex[i] = -1;
+    }
+}
+
+NdefRecordHandlerRegistry::~NdefRecordHandlerRegistry()
+{
+    // The same handler instance might be registered for multiple types
+    QSet<NdefRecordHandler *> handlers;
+    for (int i = 0; i < m_entries.size(); i++) {
+        handlers.insert(m_entries[i].handler);
+    }
+    qDeleteAll(handlers);
+}
+
+/*!
+  \brief Register the \a handler for records of the type name format
+  \a tnf and the specified \a type.
+
+  If a handler has already been registered for the same type, the new
+  handler replaces it.
+
+  \param type exact type, Mime type with wildcard sub-type ("image/*")
+  or "*" for all types of the type name format.
+  \param handler the handler to use. The registry takes ownership.
+  \param name name of the handler, used for the statistics.
+  */
+void NdefRecordHandlerRegistry::registerHandler(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, NdefRecordHandler *handler, const QString &name)
+{
+    if (!handler || (int)tnf < 0 || (int)tnf >= NDEF_TNF_COUNT) {
+        return;
+    }
+    HandlerEntry entry;
+    entry.handler = handler;
+    entry.name = name;
+    entry.parseCount = 0;
+    entry.totalNsecs = 0;
+    entry.maxNsecs = 0;
+    m_entries.append(entry);
+    const int index = m_entries.size() - 1;
+
+    if (type == "*") {
+        m_defaultIndex[tnf] = index;
+    } else if (type.endsWith("/*")) {
+        // Store the prefix including the slash
+        m_typeIndex[tnf].insert(type.left(type.size() - 1), index);
+    } else {
+        m_typeIndex[tnf].insert(type, index);
+    }
+}
+
+/*!
+  \brief Returns the index of the handler for records of the type name
+  format \a tnf and the \a type in m_entries, or -1 if no handler is
+  registered for it.
+  */
+int NdefRecordHandlerRegistry::findHandlerIndex(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type) const
+{
+    if ((int)tnf < 0 || (int)tnf >= NDEF_TNF_COUNT) {
+        return -1;
+    }
+    const QHash<QByteArray, int> &typeIndex = m_typeIndex[tnf];
+    if (!typeIndex.isEmpty()) {
+        QHash<QByteArray, int>::const_iterator it = typeIndex.constFind(type);
+        if (it != typeIndex.constEnd()) {
+            return it.value();
+        }
+        if (tnf == QNdefRecord::Mime) {
+            // Check for a handler of the major type, e.g., "image/*"
+            const int slashPos = type.indexOf('/');
+            if (slashPos > 0) {
+                it = typeIndex.constFind(QByteArray::fromRawData(type.constData(), slashPos + 1));
+                if (it != typeIndex.constEnd()) {
+                    return it.value();
+                }
+            }
+        }
+    }
+    return m_defaultIndex[tnf];
+}
+
+bool NdefRecordHandlerRegistry::hasHandler(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type) const
+{
+    return findHandlerIndex(tnf, type) >= 0;
+}
+
+/*!
+  \brief Parse the \a record of the decoded \a message with the
+  registered handler and append the textual description to \a contents.
+
+  \return false if no handler is registered for the record type.
+  */
+bool NdefRecordHandlerRegistry::parseRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record, QString &contents)
+{
+    // The type doesn't get copied, it points into the raw message
+    const int index = findHandlerIndex(record.typeNameFormat, message.bytes(record.type));
+    if (index < 0) {
+        return false;
+    }
+
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    contents.append(m_entries[index].handler->parseRecord(message, record));
+#if QT_VERSION >= 0x040800
+    m_lastParseNsecs = parseTimer.nsecsElapsed();
+#else
+    m_lastParseNsecs = parseTimer.elapsed() * 1000000;
+#endif
+
+    HandlerEntry &entry = m_entries[index];
+    entry.parseCount++;
+    entry.totalNsecs += m_lastParseNsecs;
+    entry.maxNsecs = qMax(entry.maxNsecs, m_lastParseNsecs);
+    return true;
+}
+
+/*!
+  \brief Time in nanoseconds the handler needed to parse the most
+  recent record. Only has millisecond resolution before Qt 4.8.
+  */
+qint64 NdefRecordHandlerRegistry::lastParseNsecs() const
+{
+    return m_lastParseNsecs;
+}
+
+/*!
+  \brief Return the number of parsed records, as well as the average
+  and maximum parse time for each handler that has been used so far.
+  */
+QString NdefRecordHandlerRegistry::statisticsToString() const
+{
+    QString stats;
+    for (int i = 0; i < m_entries.size(); i++) {
+        const HandlerEntry &entry = m_entries[i];
+        if (entry.parseCount == 0) {
+            continue;
+        }
+        stats.append(entry.name + ": " + QString::number(entry.parseCount) + " records, avg "
+                     + QString::number(entry.totalNsecs / entry.parseCount / 1000) + " us, max "
+                     + QString::number(entry.maxNsecs / 1000) + " us\n");
+    }
+    return stats;
+}
+
+void NdefRecordHandlerRegistry::resetStatistics()
+{
+    for (int i = 0; i < m_entries.size(); i++) {
+        m_entries[i].parseCount = 0;
+        m_entries[i].totalNsecs = 0;
+        m_entries[i].maxNsecs = 0;
+    }
+    m_lastParseNsecs = 0;
+}
@@ -0,0 +1,135 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NDEFRECORDHANDLERREGISTRY_H
+#define NDEFRECORDHANDLERREGISTRY_H
+
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QNdefRecord>
+#include "ndefmessagedecoder.h"
+
+// Number of possible type name format values (3 bits)
+#define NDEF_TNF_COUNT  8
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Interface for classes that create a textual description
+  of an NDEF record.
+
+  Register instances with the NdefRecordHandlerRegistry to
+  handle additional record types.
+  */
+class NdefRecordHandler
+{
+public:
+    virtual ~NdefRecordHandler() {}
+    /*! \brief Return a textual description of the contents of the
+      \a record, which is part of the decoded \a message. */
+    virtual QString parseRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record) = 0;
+};
+
+/*!
+  \brief Record handler that forwards the record to a member
+  function of an object, e.g., one of the parse methods of
+  the NfcNdefParser.
+  */
+template <class T>
+class NdefRecordMemberHandler : public NdefRecordHandler
+{
+public:
+    typedef QString (T::*ParseMethod)(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
+
+    NdefRecordMemberHandler(T *object, ParseMethod method) :
+        m_object(object),
+        m_method(method)
+    {
+    }
+
+    QString parseRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
+    {
+        return (m_object->*m_method)(message, record);
+    }
+
+private:
+    T *m_object;    // Not owned
+    ParseMethod m_method;
+};
+
+/*!
+  \brief Maps the type name format and the type of NDEF records
+  to the handlers that parse them.
+
+  The handlers are stored in one hash table per type name format,
+  so finding the handler for a record only needs a single hash
+  lookup of the record type, which is directly taken from the raw
+  message buffer of the ParsedNdefMessage without copying.
+
+  The type used when registering a handler can be:
+  - an exact type, e.g., "U" or "text/x-vCard"
+  - a Mime type with a wildcard sub-type, e.g., "image/*"
+  - "*", to handle all records of the type name format that don't
+  have a more specific handler.
+
+  The registry measures the time each handler needs for parsing
+  records, see statisticsToString().
+
+  The registry only decides which handler describes a record. The
+  structured fields of the records are decoded beforehand by the
+  NdefMessageDecoder, which recognizes the built-in record types on
+  its own (see NdefMessageDecoder::classifyRecord()).
+  */
+class NdefRecordHandlerRegistry
+{
+public:
+    NdefRecordHandlerRegistry();
+    ~NdefRecordHandlerRegistry();
+
+    void registerHandler(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, NdefRecordHandler *handler, const QString &name);
+    bool hasHandler(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type) const;
+    bool parseRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record, QString &contents);
+
+    qint64 lastParseNsecs() const;
+    QString statisticsToString() const;
+    void resetStatistics();
+
+private:
+    int findHandlerIndex(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type) const;
+
+private:
+    struct HandlerEntry {
+        NdefRecordHandler *handler;
+        QString name;
+        int parseCount;
+        qint64 totalNsecs;
+        qint64 maxNsecs;
+    };
+    /*! All handlers that have been registered, including their statistics. */
+    QVector<HandlerEntry> m_entries;
+    /*! Per type name format: maps the record type (or the "major/"
+      prefix of a Mime type wildcard) to the index in m_entries. */
+    QHash<QByteArray, int> m_typeIndex[NDEF_TNF_COUNT];
+    /*! Per type name format: index of the handler for all other types, or -1. */
+    int m_defaultIndex[NDEF_TNF_COUNT];
+    /*! Duration of the most recent call to parseRecord(). */
+    qint64 m_lastParseNsecs;
+};
+
+#endif // NDEFRECORDHANDLERREGISTRY_H
@@ -0,0 +1,422 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "ndefrecordview.h"
+
+/*!
+  \brief Create an empty, invalid record view.
+  */
+NdefRecordView::NdefRecordView() :
+    m_data(NULL),
+    m_flags(0),
+    m_typeLength(0),
+    m_idLength(0),
+    m_payloadLength(0),
+    m_typeOffset(0)
+{
+}
+
+/*!
+  \brief Parse the header of the NDEF record that starts at \a data
+  and store the positions of its fields in \a view.
+
+  No data is copied; the view points directly into \a data.
+
+  \param data start of the record header.
+  \param size number of bytes available from \a data onwards.
+  \param recordLength if not NULL, set to the total length of the record
+  as soon as the complete header is available - even if the payload
+  is still incomplete. Set to 0 if the header itself is incomplete.
+  \return ParseOk if the complete record (header + payload) is
+  available, ParseIncomplete if more bytes are needed, or
+  ParseMalformed if the header violates the NDEF specification.
+  */
+NdefRecordView::ParseResult NdefRecordView::parse(const char *data, const int size, NdefRecordView &view, int *recordLength)
+{
+    if (recordLength) {
+        *recordLength = 0;
+    }
+    // Minimum: flags (1b) + type length (1b)
+    if (!data || size < 2) {
+        return ParseIncomplete;
+    }
+    const quint8 flags = data[0];
+    const quint8 typeLength = data[1];
+    int pos = 2;
+
+    // Payload length: 1 byte for short records, 4 bytes otherwise
+    quint32 payloadLength;
+    if (flags & NDEF_FLAG_SR) {
+        if (size < pos + 1) {
+            return ParseIncomplete;
+        }
+        payloadLength = (quint8)data[pos];
+        pos += 1;
+    } else {
+        if (size < pos + 4) {
+            return ParseIncomplete;
+        }
+        payloadLength = ((quint32)(quint8)data[pos] << 24) |
+                ((quint32)(quint8)data[pos + 1] << 16) |
+                ((quint32)(quint8)data[pos + 2] << 8) |
+                (quint32)(quint8)data[pos + 3];
+        pos += 4;
+    }
+
+    // Optional ID length
+    quint8 idLength = 0;
+    if (flags & NDEF_FLAG_IL) {
+        if (size < pos + 1) {
+            return ParseIncomplete;
+        }
+        idLength = data[pos];
+        pos += 1;
+    }
+
+    // Check the header for consistency with the type name format
+    const quint8 tnf = flags & NDEF_TNF_MASK;
+    if (tnf == 0x07) {
+        // Reserved type name format
+        return ParseMalformed;
+    }
+    if (tnf == QNdefRecord::Empty && (typeLength != 0 || idLength != 0 || payloadLength != 0)) {
+        return ParseMalformed;
+    }
+    if ((tnf == QNdefRecord::Unknown || tnf == NDEF_TNF_UNCHANGED) && typeLength != 0) {
+        // Unknown and Unchanged (chunk) records must not have a type
+        return ParseMalformed;
+    }
+
+    const qint64 totalLength = (qint64)pos + typeLength + idLength + payloadLength;
+    if (totalLength > 0x7FFFFFFF) {
+        return ParseMalformed;
+    }
+    if (recordLength) {
+        *recordLength = (int)totalLength;
+    }
+    if (totalLength > size) {
+        return ParseIncomplete;
+    }
+
+    view.m_data = data;
+    view.m_flags = flags;
+    view.m_typeLength = typeLength;
+    view.m_idLength = idLength;
+    view.m_payloadLength = payloadLength;
+    view.m_typeOffset = pos;
+    return ParseOk;
+}
+
+QNdefRecord::TypeNameFormat NdefRecordView::typeNameFormat() const
+{
+    return (QNdefRecord::TypeNameFormat)(m_flags & NDEF_TNF_MASK);
+}
+
+bool NdefRecordView::isMessageBegin() const
+{
+    return (m_flags & NDEF_FLAG_MB) != 0;
+}
+
+bool NdefRecordView::isMessageEnd() const
+{
+    return (m_flags & NDEF_FLAG_ME) != 0;
+}
+
+bool NdefRecordView::isChunked() const
+{
+    return (m_flags & NDEF_FLAG_CF) != 0;
+}
+
+bool NdefRecordView::isShortRecord() const
+{
+    return (m_flags & NDEF_FLAG_SR) != 0;
+}
+
+/*!
+  \brief Returns true if the record is of the Empty type name format
+  or doesn't contain any payload.
+  */
+bool NdefRecordView::isEmpty() const
+{
+    return typeNameFormat() == QNdefRecord::Empty || m_payloadLength == 0;
+}
+
+/*!
+  \brief Check the type name format and the type of the record, without
+  creating a copy of the type.
+
+  Equivalent to QNdefRecord::isRecordType<>(), but working on the raw
+  buffer.
+  */
+bool NdefRecordView::isRecordType(const QNdefRecord::TypeNameFormat tnf, const char *type) const
+{
+    if (typeNameFormat() != tnf) {
+        return false;
+    }
+    const int len = qstrlen(type);
+    return len == m_typeLength && memcmp(typeData(), type, len) == 0;
+}
+
+/*!
+  \brief Check the type name format and if the record type starts with
+  the \a typePrefix (e.g., "image/" for all image types).
+  */
+bool NdefRecordView::typeStartsWith(const QNdefRecord::TypeNameFormat tnf, const char *typePrefix) const
+{
+    if (typeNameFormat() != tnf) {
+        return false;
+    }
+    const int len = qstrlen(typePrefix);
+    return len <= m_typeLength && memcmp(typeData(), typePrefix, len) == 0;
+}
+
+const char *NdefRecordView::typeData() const
+{
+    return m_data ? m_data + m_typeOffset : NULL;
+}
+
+int NdefRecordView::typeLength() const
+{
+    return m_typeLength;
+}
+
+/*!
+  \brief Type of the record. The returned byte array does not own its data,
+  but points directly into the raw message buffer.
+  */
+QByteArray NdefRecordView::type() const
+{
+    return m_data ? QByteArray::fromRawData(typeData(), m_typeLength) : QByteArray();
+}
+
+const char *NdefRecordView::idData() const
+{
+    return m_data ? m_data + m_typeOffset + m_typeLength : NULL;
+}
+
+int NdefRecordView::idLength() const
+{
+    return m_idLength;
+}
+
+/*!
+  \brief ID of the record. The returned byte array does not own its data,
+  but points directly into the raw message buffer.
+  */
+QByteArray NdefRecordView::id() const
+{
+    return m_data ? QByteArray::fromRawData(idData(), m_idLength) : QByteArray();
+}
+
+const char *NdefRecordView::payloadData() const
+{
+    return m_data ? m_data + m_typeOffset + m_typeLength + m_idLength : NULL;
+}
+
+int NdefRecordView::payloadLength() const
+{
+    return m_payloadLength;
+}
+
+/*!
+  \brief Payload of the record. The returned byte array does not own its data,
+  but points directly into the raw message buffer.
+  */
+QByteArray NdefRecordView::payload() const
+{
+    return m_data ? QByteArray::fromRawData(payloadData(), m_payloadLength) : QByteArray();
+}
+
+/*!
+  \brief Start of the record (its header) within the raw buffer.
+  */
+const char *NdefRecordView::recordData() const
+{
+    return m_data;
+}
+
+/*!
+  \brief Number of bytes of the record header, including type and id,
+  but without the payload.
+  */
+int NdefRecordView::headerLength() const
+{
+    return m_typeOffset + m_typeLength + m_idLength;
+}
+
+/*!
+  \brief Total number of bytes of the record, including the header.
+  */
+int NdefRecordView::recordLength() const
+{
+    return headerLength() + m_payloadLength;
+}
+
+/*!
+  \brief Create an owning QNdefRecord containing a deep copy of the
+  type, id and payload of this record.
+
+  Only use this method if a record class derived from QNdefRecord
+  is needed for further processing.
+  */
+QNdefRecord NdefRecordView::toRecord() const
+{
+    QNdefRecord record;
+    if (!m_data) {
+        return record;
+    }
+    record.setTypeNameFormat(typeNameFormat());
+    record.setType(QByteArray(typeData(), m_typeLength));
+    if (m_idLength > 0) {
+        record.setId(QByteArray(idData(), m_idLength));
+    }
+    record.setPayload(QByteArray(payloadData(), m_payloadLength));
+    return record;
+}
+
+/*!
+  \brief Create a QNdefRecord whose payload references the viewed
+  buffer instead of copying it. Type and id are small and copied.
+
+  The buffer has to stay alive and unmodified for as long as the
+  returned record or any copy of it is used. Modifying the payload
+  of the record creates a deep copy first.
+  */
+QNdefRecord NdefRecordView::toSharedRecord() const
+{
+    QNdefRecord record;
+    if (!m_data) {
+        return record;
+    }
+    record.setTypeNameFormat(typeNameFormat());
+    record.setType(QByteArray(typeData(), m_typeLength));
+    if (m_idLength > 0) {
+        record.setId(QByteArray(idData(), m_idLength));
+    }
+    record.setPayload(QByteArray::fromRawData(payloadData(), m_payloadLength));
+    return record;
+}
+
+// ----------------------------------------------------------------------------
+
+/*!
+  \brief Create a view of the NDEF message stored in \a rawMessage.
+
+  The byte array has to stay alive and unmodified while the view is used.
+  */
+NdefMessageView::NdefMessageView(const QByteArray &rawMessage) :
+    m_data(rawMessage.constData()),
+    m_size(rawMessage.size()),
+    m_valid(false),
+    m_hasChunkedRecords(false)
+{
+    parseRecords();
+}
+
+/*!
+  \brief Create a view of the NDEF message stored in the raw memory
+  area starting at \a data, with a length of \a size bytes.
+  */
+NdefMessageView::NdefMessageView(const char *data, const int size) :
+    m_data(data),
+    m_size(size),
+    m_valid(false),
+    m_hasChunkedRecords(false)
+{
+    parseRecords();
+}
+
+/*!
+  \brief Walk all record headers of the message and store a view
+  for each record.
+
+  The message is only valid if all records could be parsed, the
+  first record has the message begin flag set and the last record
+  the message end flag.
+  */
+void NdefMessageView::parseRecords()
+{
+    if (!m_data || m_size <= 0) {
+        return;
+    }
+    int offset = 0;
+    while (offset < m_size) {
+        NdefRecordView view;
+        if (NdefRecordView::parse(m_data + offset, m_size - offset, view) != NdefRecordView::ParseOk) {
+            // Truncated or malformed record
+            return;
+        }
+        if (m_records.isEmpty() && !view.isMessageBegin()) {
+            return;
+        }
+        if (view.isChunked()) {
+            m_hasChunkedRecords = true;
+        }
+        m_records.append(view);
+        offset += view.recordLength();
+        if (view.isMessageEnd()) {
+            break;
+        }
+    }
+    m_valid = !m_records.isEmpty() && m_records[m_records.size() - 1].isMessageEnd();
+    // Trailing data after the message end is ignored and not included in the size.
+    m_size = offset;
+}
+
+/*!
+  \brief Returns true if the whole message could be parsed successfully.
+  */
+bool NdefMessageView::isValid() const
+{
+    return m_valid;
+}
+
+bool NdefMessageView::isEmpty() const
+{
+    return m_records.isEmpty();
+}
+
+/*!
+  \brief Returns true if the message contains chunked records.
+
+  The view lists every chunk as an individual record. To process the
+  payload of chunked records, convert the message to a QNdefMessage,
+  which merges the chunks.
+  */
+bool NdefMessageView::hasChunkedRecords() const
+{
+    return m_hasChunkedRecords;
+}
+
+/*!
+  \brief Number of records in the message.
+  */
+int NdefMessageView::size() const
+{
+    return m_records.size();
+}
+
+/*!
+  \brief Number of bytes of the raw message that belong to the records.
+  */
+int NdefMessageView::byteSize() const
+{
+    return m_size;
+}
+
+const NdefRecordView &NdefMessageView::at(const int index) const
+{
+    return m_records[index];
+}
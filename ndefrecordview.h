@@ -0,0 +1,141 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NDEFRECORDVIEW_H
+#define NDEFRECORDVIEW_H
+
+#include <QByteArray>
+#include <QVarLengthArray>
+#include <QNdefMessage>
+#include <QNdefRecord>
+
+QTM_USE_NAMESPACE
+
+// Flags of the first byte of each NDEF record header
+#define NDEF_FLAG_MB    0x80    // Message begin
+#define NDEF_FLAG_ME    0x40    // Message end
+#define NDEF_FLAG_CF    0x20    // Chunk flag
+#define NDEF_FLAG_SR    0x10    // Short record (1 byte payload length)
+#define NDEF_FLAG_IL    0x08    // ID length field present
+#define NDEF_TNF_MASK   0x07    // Type name format
+
+// Type name format of the middle and terminating chunks of a chunked record
+#define NDEF_TNF_UNCHANGED  0x06
+// Longest possible record header: flags, type length, 4 byte payload length,
+// id length, 255 bytes type and 255 bytes id.
+#define NDEF_MAX_HEADER_LENGTH  517
+
+/*!
+  \brief Non-owning view of a single NDEF record within a raw
+  NDEF message buffer.
+
+  The view only stores the position of the header fields (type, id,
+  payload) within the buffer and doesn't copy any of the record data.
+  Therefore, the buffer the view has been created from needs to stay
+  alive and unmodified for as long as the view is used.
+
+  The QByteArray instances returned by type(), id() and payload() are
+  created through QByteArray::fromRawData() and point directly into the
+  buffer. Use toRecord() to get an owning QNdefRecord, e.g., when
+  the record needs to be passed to one of the NdefNfc*Record classes.
+  */
+class NdefRecordView
+{
+public:
+    NdefRecordView();
+
+    enum ParseResult {
+        ParseOk,
+        ParseIncomplete,
+        ParseMalformed
+    };
+
+    static ParseResult parse(const char *data, const int size, NdefRecordView &view, int *recordLength = NULL);
+
+public:
+    QNdefRecord::TypeNameFormat typeNameFormat() const;
+    bool isMessageBegin() const;
+    bool isMessageEnd() const;
+    bool isChunked() const;
+    bool isShortRecord() const;
+    bool isEmpty() const;
+
+    bool isRecordType(const QNdefRecord::TypeNameFormat tnf, const char *type) const;
+    bool typeStartsWith(const QNdefRecord::TypeNameFormat tnf, const char *typePrefix) const;
+
+    const char *typeData() const;
+    int typeLength() const;
+    QByteArray type() const;
+
+    const char *idData() const;
+    int idLength() const;
+    QByteArray id() const;
+
+    const char *payloadData() const;
+    int payloadLength() const;
+    QByteArray payload() const;
+
+    const char *recordData() const;
+    int headerLength() const;
+    int recordLength() const;
+
+    QNdefRecord toRecord() const;
+    QNdefRecord toSharedRecord() const;
+
+private:
+    /*! Start of the record header within the raw buffer. Not owned. */
+    const char *m_data;
+    quint8 m_flags;
+    quint8 m_typeLength;
+    quint8 m_idLength;
+    quint32 m_payloadLength;
+    /*! Offset of the type field, relative to the start of the record. */
+    int m_typeOffset;
+};
+
+/*!
+  \brief Non-owning view of a complete raw NDEF message.
+
+  Walks the record headers of the buffer once and provides an
+  NdefRecordView for every record found. As with the record view,
+  the buffer is not copied and needs to stay alive for as long as
+  the message view is used.
+  */
+class NdefMessageView
+{
+public:
+    explicit NdefMessageView(const QByteArray &rawMessage);
+    NdefMessageView(const char *data, const int size);
+
+    bool isValid() const;
+    bool isEmpty() const;
+    bool hasChunkedRecords() const;
+    int size() const;
+    int byteSize() const;
+    const NdefRecordView &at(const int index) const;
+
+private:
+    void parseRecords();
+
+private:
+    const char *m_data;
+    int m_size;
+    bool m_valid;
+    bool m_hasChunkedRecords;
+    /*! Most messages only contain a few records - avoid a heap allocation for those. */
+    QVarLengthArray<NdefRecordView, 8> m_records;
+};
+
+#endif // NDEFRECORDVIEW_H
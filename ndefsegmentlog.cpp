@@ -0,0 +1,439 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "ndefsegmentlog.h"
+#include <QDir>
+#include <QtEndian>
+#include <QDebug>
+
+// Segment files are addressed with 32 bit offsets
+#define NDEF_SEGMENT_MAX_SIZE_LIMIT 0x7FFFFFFF
+
+NdefSegmentLog::NdefSegmentLog() :
+    m_segmentSize(0),
+    m_maxSegmentSize(NDEF_SEGMENT_DEFAULT_MAX_SIZE)
+{
+}
+
+NdefSegmentLog::~NdefSegmentLog()
+{
+    close();
+}
+
+/*!
+  \brief Size in bytes after which the current segment is finished and
+  a new segment is started. A single frame that is larger than the limit
+  is still stored, in its own segment.
+  */
+void NdefSegmentLog::setMaxSegmentSize(const qint64 maxSegmentSize)
+{
+    m_maxSegmentSize = qBound((qint64)NDEF_SEGMENT_HEADER_LENGTH, maxSegmentSize, (qint64)NDEF_SEGMENT_MAX_SIZE_LIMIT);
+}
+
+/*!
+  \brief Start logging to segment files in the \a directory, which is
+  created if it doesn't exist yet. The first segment file is only
+  created when the first message is appended.
+
+  \return false if the directory couldn't be created.
+  */
+bool NdefSegmentLog::open(const QString &directory)
+{
+    close();
+    m_errorString.clear();
+    if (!QDir().mkpath(directory)) {
+        m_errorString = "Unable to create log directory: " + directory;
+        qDebug() << m_errorString;
+        return false;
+    }
+    m_directory = directory;
+    return true;
+}
+
+/*!
+  \brief Finish the current segment, which writes its index footer.
+  */
+void NdefSegmentLog::close()
+{
+    finishSegment();
+    m_directory.clear();
+}
+
+bool NdefSegmentLog::isOpen() const
+{
+    return !m_directory.isEmpty();
+}
+
+QString NdefSegmentLog::directory() const
+{
+    return m_directory;
+}
+
+/*!
+  \brief File name of the segment that is currently being written,
+  or an empty string if no message has been appended yet.
+  */
+QString NdefSegmentLog::currentSegmentFileName() const
+{
+    return m_file.isOpen() ? m_file.fileName() : QString();
+}
+
+QString NdefSegmentLog::errorString() const
+{
+    return m_errorString;
+}
+
+/*!
+  \brief Append the \a rawMessage as a new frame to the current segment.
+
+  \param tagType type of the tag the message was read from; may be empty.
+  Only the first 255 bytes of the UTF-8 representation are stored.
+  \param timestamp time the message was read. If invalid, the current
+  time is used.
+  \return index of the frame within the current segment, or -1 if the
+  frame couldn't be written.
+  */
+int NdefSegmentLog::append(const QByteArray &rawMessage, const QString &tagType, const QDateTime &timestamp)
+{
+    if (!isOpen()) {
+        m_errorString = "Log is not open";
+        return -1;
+    }
+    const QByteArray tagTypeUtf8 = tagType.toUtf8().left(255);
+    const int frameLength = NDEF_SEGMENT_FRAME_HEADER_LENGTH + tagTypeUtf8.size() + rawMessage.size();
+    if (frameLength > NDEF_SEGMENT_MAX_SIZE_LIMIT - NDEF_SEGMENT_HEADER_LENGTH - NDEF_SEGMENT_TRAILER_LENGTH - 4) {
+        m_errorString = "NDEF message too large for the log";
+        return -1;
+    }
+
+    // Roll over to a new segment if the frame and its index entry
+    // don't fit into the current one anymore.
+    if (m_file.isOpen() && !m_frameOffsets.isEmpty() &&
+            m_segmentSize + frameLength + (m_frameOffsets.size() + 1) * 4 + NDEF_SEGMENT_TRAILER_LENGTH > m_maxSegmentSize) {
+        finishSegment();
+    }
+    if (!m_file.isOpen() && !startSegment()) {
+        return -1;
+    }
+
+    // Assemble the complete frame, so that it can be written with
+    // a single call.
+    const qint64 msecs = (timestamp.isValid() ? timestamp : QDateTime::currentDateTime()).toMSecsSinceEpoch();
+    QByteArray frame;
+    frame.resize(frameLength);
+    uchar *data = reinterpret_cast<uchar *>(frame.data());
+    qToBigEndian<quint32>(frameLength - 4, data);
+    qToBigEndian<quint64>((quint64)msecs, data + 4);
+    data[12] = (uchar)tagTypeUtf8.size();
+    memcpy(data + NDEF_SEGMENT_FRAME_HEADER_LENGTH, tagTypeUtf8.constData(), tagTypeUtf8.size());
+    memcpy(data + NDEF_SEGMENT_FRAME_HEADER_LENGTH + tagTypeUtf8.size(), rawMessage.constData(), rawMessage.size());
+
+    if (m_file.write(frame) != frame.size()) {
+        m_errorString = "Unable to write to log segment: " + m_file.fileName();
+        qDebug() << m_errorString;
+        // Don't append further frames after the damaged one
+        finishSegment();
+        return -1;
+    }
+    m_frameOffsets.append((quint32)m_segmentSize);
+    m_segmentSize += frame.size();
+    return m_frameOffsets.size() - 1;
+}
+
+/*!
+  \brief All segment files in the \a directory, sorted from oldest to newest.
+  */
+QStringList NdefSegmentLog::segmentFiles(const QString &directory)
+{
+    const QDir dir(directory);
+    QStringList fileNames = dir.entryList(QStringList() << QString("*") + NDEF_SEGMENT_SUFFIX, QDir::Files, QDir::Name);
+    for (int i = 0; i < fileNames.size(); i++) {
+        fileNames[i] = dir.filePath(fileNames[i]);
+    }
+    return fileNames;
+}
+
+/*!
+  \brief Create the reference to a frame, which can be used in place of a
+  file name, e.g., for NfcInfo::loadNdefFromFile().
+  */
+QString NdefSegmentLog::frameReference(const QString &segmentFileName, const int frameIndex)
+{
+    return segmentFileName + "#" + QString::number(frameIndex);
+}
+
+/*!
+  \brief Split a reference created by frameReference() into the file
+  name of the segment and the index of the frame.
+
+  \return false if the \a reference doesn't refer to a frame.
+  */
+bool NdefSegmentLog::parseFrameReference(const QString &reference, QString &segmentFileName, int &frameIndex)
+{
+    const int separatorPos = reference.lastIndexOf('#');
+    if (separatorPos < 0) {
+        return false;
+    }
+    const QString fileName = reference.left(separatorPos);
+    if (!fileName.endsWith(NDEF_SEGMENT_SUFFIX)) {
+        return false;
+    }
+    bool ok = false;
+    const int index = reference.mid(separatorPos + 1).toInt(&ok);
+    if (!ok || index < 0) {
+        return false;
+    }
+    segmentFileName = fileName;
+    frameIndex = index;
+    return true;
+}
+
+/*!
+  \brief Extract the timestamp and the tag type from the name of a
+  file stored by NfcInfo::storeNdefToFile() without the segment log,
+  e.g., "2012.10.05 - 14.02.11 - NFC Forum Type 2".
+
+  \param baseName file name without directory and extension.
+  \return false if the name doesn't follow the pattern.
+  */
+bool NdefSegmentLog::parseLegacyFileName(const QString &baseName, QDateTime &timestamp, QString &tagType)
+{
+    const int dateLength = QString(LEGACY_LOG_DATE_FORMAT).length();
+    timestamp = QDateTime::fromString(baseName.left(dateLength), LEGACY_LOG_DATE_FORMAT);
+    if (!timestamp.isValid()) {
+        return false;
+    }
+    tagType = baseName.mid(dateLength).startsWith(" - ") ? baseName.mid(dateLength + 3) : QString();
+    return true;
+}
+
+/*!
+  \brief Create a new segment file and write its header.
+  */
+bool NdefSegmentLog::startSegment()
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    const QDir dir(m_directory);
+    const QString baseName = "ndef-" + now.toString("yyyyMMdd-hhmmss-zzz");
+    QString fileName = dir.filePath(baseName + NDEF_SEGMENT_SUFFIX);
+    for (int i = 2; QFile::exists(fileName); i++) {
+        fileName = dir.filePath(baseName + "-" + QString::number(i) + NDEF_SEGMENT_SUFFIX);
+    }
+
+    m_file.setFileName(fileName);
+    // Unbuffered: every frame is already assembled in memory and
+    // goes to the file with a single write.
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        m_errorString = "Unable to create log segment: " + fileName;
+        qDebug() << m_errorString;
+        return false;
+    }
+    QByteArray header;
+    header.resize(NDEF_SEGMENT_HEADER_LENGTH);
+    memcpy(header.data(), NDEF_SEGMENT_MAGIC, NDEF_SEGMENT_MAGIC_LENGTH);
+    qToBigEndian<quint64>((quint64)now.toMSecsSinceEpoch(), reinterpret_cast<uchar *>(header.data()) + NDEF_SEGMENT_MAGIC_LENGTH);
+    if (m_file.write(header) != header.size()) {
+        m_errorString = "Unable to write to log segment: " + fileName;
+        qDebug() << m_errorString;
+        m_file.close();
+        return false;
+    }
+    m_frameOffsets.clear();
+    m_segmentSize = NDEF_SEGMENT_HEADER_LENGTH;
+    return true;
+}
+
+/*!
+  \brief Append the index footer to the current segment and close it.
+  */
+bool NdefSegmentLog::finishSegment()
+{
+    if (!m_file.isOpen()) {
+        return true;
+    }
+    const int frameCount = m_frameOffsets.size();
+    QByteArray footer;
+    footer.resize(frameCount * 4 + NDEF_SEGMENT_TRAILER_LENGTH);
+    uchar *data = reinterpret_cast<uchar *>(footer.data());
+    for (int i = 0; i < frameCount; i++) {
+        qToBigEndian<quint32>(m_frameOffsets[i], data + i * 4);
+    }
+    data += frameCount * 4;
+    qToBigEndian<quint32>((quint32)frameCount, data);
+    qToBigEndian<quint32>((quint32)m_segmentSize, data + 4);
+    memcpy(data + 8, NDEF_SEGMENT_INDEX_MAGIC, 4);
+
+    const bool success = (m_file.write(footer) == footer.size());
+    if (!success) {
+        m_errorString = "Unable to write index of log segment: " + m_file.fileName();
+        qDebug() << m_errorString;
+    }
+    m_file.close();
+    m_frameOffsets.clear();
+    m_segmentSize = 0;
+    return success;
+}
+
+// ----------------------------------------------------------------------------
+
+NdefSegmentReader::NdefSegmentReader() :
+    m_hasIndex(false)
+{
+}
+
+/*!
+  \brief Open the segment file and determine the positions of its frames,
+  either from the index footer or by scanning the file.
+  */
+bool NdefSegmentReader::open(const QString &fileName)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = "Unable to open log segment: " + fileName;
+        return false;
+    }
+    const QByteArray header = m_file.read(NDEF_SEGMENT_HEADER_LENGTH);
+    if (header.size() != NDEF_SEGMENT_HEADER_LENGTH || !header.startsWith(NDEF_SEGMENT_MAGIC)) {
+        m_errorString = "Not a log segment: " + fileName;
+        m_file.close();
+        return false;
+    }
+    if (!readIndex()) {
+        // No index, e.g., if the app didn't close the log properly
+        scanFrames();
+    }
+    return true;
+}
+
+void NdefSegmentReader::close()
+{
+    m_file.close();
+    m_frameOffsets.clear();
+    m_hasIndex = false;
+    m_errorString.clear();
+}
+
+/*!
+  \brief Returns true if the frame positions have been read from the
+  index footer of the segment.
+  */
+bool NdefSegmentReader::hasIndex() const
+{
+    return m_hasIndex;
+}
+
+int NdefSegmentReader::frameCount() const
+{
+    return m_frameOffsets.size();
+}
+
+/*!
+  \brief Read the frame with the specified \a index into \a frame.
+  */
+bool NdefSegmentReader::readFrame(const int index, NdefLogFrame &frame)
+{
+    if (index < 0 || index >= m_frameOffsets.size() || !m_file.seek(m_frameOffsets[index])) {
+        m_errorString = "Invalid frame index: " + QString::number(index);
+        return false;
+    }
+    uchar header[NDEF_SEGMENT_FRAME_HEADER_LENGTH];
+    if (m_file.read(reinterpret_cast<char *>(header), NDEF_SEGMENT_FRAME_HEADER_LENGTH) != NDEF_SEGMENT_FRAME_HEADER_LENGTH) {
+        m_errorString = "Truncated frame: " + QString::number(index);
+        return false;
+    }
+    const quint32 frameLength = qFromBigEndian<quint32>(header);
+    const int tagTypeLength = header[12];
+    if (frameLength < (quint32)(NDEF_SEGMENT_FRAME_HEADER_LENGTH - 4 + tagTypeLength)) {
+        m_errorString = "Malformed frame: " + QString::number(index);
+        return false;
+    }
+    const int messageLength = frameLength - (NDEF_SEGMENT_FRAME_HEADER_LENGTH - 4) - tagTypeLength;
+    const QByteArray tagType = m_file.read(tagTypeLength);
+    const QByteArray rawMessage = m_file.read(messageLength);
+    if (tagType.size() != tagTypeLength || rawMessage.size() != messageLength) {
+        m_errorString = "Truncated frame: " + QString::number(index);
+        return false;
+    }
+    frame.timestamp = QDateTime::fromMSecsSinceEpoch((qint64)qFromBigEndian<quint64>(header + 4));
+    frame.tagType = QString::fromUtf8(tagType.constData(), tagType.size());
+    frame.rawMessage = rawMessage;
+    return true;
+}
+
+QString NdefSegmentReader::errorString() const
+{
+    return m_errorString;
+}
+
+/*!
+  \brief Read the frame positions from the index footer.
+  \return false if the segment doesn't have a valid footer.
+  */
+bool NdefSegmentReader::readIndex()
+{
+    const qint64 fileSize = m_file.size();
+    if (fileSize < NDEF_SEGMENT_HEADER_LENGTH + NDEF_SEGMENT_TRAILER_LENGTH ||
+            !m_file.seek(fileSize - NDEF_SEGMENT_TRAILER_LENGTH)) {
+        return false;
+    }
+    const QByteArray trailer = m_file.read(NDEF_SEGMENT_TRAILER_LENGTH);
+    if (trailer.size() != NDEF_SEGMENT_TRAILER_LENGTH || !trailer.endsWith(NDEF_SEGMENT_INDEX_MAGIC)) {
+        return false;
+    }
+    const uchar *data = reinterpret_cast<const uchar *>(trailer.constData());
+    const quint32 frameCount = qFromBigEndian<quint32>(data);
+    const quint32 indexOffset = qFromBigEndian<quint32>(data + 4);
+    if (indexOffset < NDEF_SEGMENT_HEADER_LENGTH ||
+            (qint64)indexOffset + (qint64)frameCount * 4 + NDEF_SEGMENT_TRAILER_LENGTH != fileSize ||
+            !m_file.seek(indexOffset)) {
+        return false;
+    }
+    const QByteArray index = m_file.read(frameCount * 4);
+    if (index.size() != (int)frameCount * 4) {
+        return false;
+    }
+    const uchar *offsets = reinterpret_cast<const uchar *>(index.constData());
+    m_frameOffsets.resize(frameCount);
+    for (quint32 i = 0; i < frameCount; i++) {
+        m_frameOffsets[i] = qFromBigEndian<quint32>(offsets + i * 4);
+    }
+    m_hasIndex = true;
+    return true;
+}
+
+/*!
+  \brief Determine the frame positions by following the length fields,
+  up to the first incomplete frame.
+  */
+void NdefSegmentReader::scanFrames()
+{
+    m_frameOffsets.clear();
+    const qint64 fileSize = m_file.size();
+    qint64 pos = NDEF_SEGMENT_HEADER_LENGTH;
+    uchar lengthField[4];
+    while (pos + NDEF_SEGMENT_FRAME_HEADER_LENGTH <= fileSize && m_file.seek(pos)) {
+        if (m_file.read(reinterpret_cast<char *>(lengthField), 4) != 4) {
+            break;
+        }
+        const quint32 frameLength = qFromBigEndian<quint32>(lengthField);
+        if (frameLength < NDEF_SEGMENT_FRAME_HEADER_LENGTH - 4 || pos + 4 + frameLength > fileSize) {
+            break;
+        }
+        m_frameOffsets.append((quint32)pos);
+        pos += 4 + frameLength;
+    }
+}
@@ -0,0 +1,148 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NDEFSEGMENTLOG_H
+#define NDEFSEGMENTLOG_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QFile>
+#include <QVector>
+
+/*
+  Layout of a segment file (all numbers big endian):
+
+  Segment header:
+    "NDEFSEG1"          8 bytes magic
+    creation time       qint64, ms since epoch (UTC)
+  Frame, repeated:
+    frame length        quint32, number of bytes following this field
+    timestamp           qint64, ms since epoch (UTC)
+    tag type length     quint8
+    tag type            UTF-8
+    raw NDEF message    remaining bytes of the frame
+  Index footer, written when the segment is closed:
+    frame offsets       quint32 for each frame
+    frame count         quint32
+    index offset        quint32
+    "NIDX"              4 bytes magic
+
+  A segment without footer (e.g., after a crash) can still be read
+  by scanning the frames from the beginning.
+  */
+#define NDEF_SEGMENT_MAGIC "NDEFSEG1"
+#define NDEF_SEGMENT_MAGIC_LENGTH 8
+#define NDEF_SEGMENT_HEADER_LENGTH 16
+#define NDEF_SEGMENT_FRAME_HEADER_LENGTH 13
+#define NDEF_SEGMENT_INDEX_MAGIC "NIDX"
+#define NDEF_SEGMENT_TRAILER_LENGTH 12
+#define NDEF_SEGMENT_SUFFIX ".nlog"
+// File name pattern of NfcInfo::storeNdefToFile(), followed
+// by " - <tag type>" if the tag type is known.
+#define LEGACY_LOG_DATE_FORMAT "yyyy.MM.dd - hh.mm.ss"
+#define LEGACY_LOG_SUFFIX ".txt"
+/*! Default size after which a new segment is started. */
+#define NDEF_SEGMENT_DEFAULT_MAX_SIZE (4 * 1024 * 1024)
+
+/*!
+  \brief A single NDEF message stored in a segment of the log.
+  */
+struct NdefLogFrame
+{
+    QDateTime timestamp;
+    QString tagType;
+    QByteArray rawMessage;
+};
+
+/*!
+  \brief Append-only log of NDEF messages, stored in rolling segment
+  files instead of one file per message.
+
+  Each message is written as one length-prefixed frame with a
+  single write to the unbuffered segment file. When the segment
+  reaches the maximum size or the log is closed, an index of
+  all frames is appended, so that the frames can be accessed
+  directly by NdefSegmentReader.
+
+  Frames are referred to as "<segment file name>#<frame index>",
+  see frameReference().
+  */
+class NdefSegmentLog
+{
+public:
+    NdefSegmentLog();
+    ~NdefSegmentLog();
+
+    void setMaxSegmentSize(const qint64 maxSegmentSize);
+
+    bool open(const QString &directory);
+    void close();
+    bool isOpen() const;
+    QString directory() const;
+    QString currentSegmentFileName() const;
+    QString errorString() const;
+
+    int append(const QByteArray &rawMessage, const QString &tagType, const QDateTime &timestamp = QDateTime());
+
+    static QStringList segmentFiles(const QString &directory);
+    static QString frameReference(const QString &segmentFileName, const int frameIndex);
+    static bool parseFrameReference(const QString &reference, QString &segmentFileName, int &frameIndex);
+    static bool parseLegacyFileName(const QString &baseName, QDateTime &timestamp, QString &tagType);
+
+private:
+    bool startSegment();
+    bool finishSegment();
+
+private:
+    QString m_directory;
+    QFile m_file;
+    /*! Offsets of the frames in the current segment, for the index. */
+    QVector<quint32> m_frameOffsets;
+    qint64 m_segmentSize;
+    qint64 m_maxSegmentSize;
+    QString m_errorString;
+};
+
+/*!
+  \brief Reads the frames of a single segment file written by
+  the NdefSegmentLog.
+  */
+class NdefSegmentReader
+{
+public:
+    NdefSegmentReader();
+
+    bool open(const QString &fileName);
+    void close();
+    bool hasIndex() const;
+    int frameCount() const;
+    bool readFrame(const int index, NdefLogFrame &frame);
+    QString errorString() const;
+
+private:
+    bool readIndex();
+    void scanFrames();
+
+private:
+    QFile m_file;
+    QVector<quint32> m_frameOffsets;
+    bool m_hasIndex;
+    QString m_errorString;
+};
+
+#endif // NDEFSEGMENTLOG_H
@@ -0,0 +1,373 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "ndefstreamdecoder.h"
+
+NdefStreamDecoder::NdefStreamDecoder(QObject *parent) :
+    QObject(parent),
+    m_maxRecordSize(NDEF_STREAM_DEFAULT_MAX_RECORD_SIZE),
+    m_maxMessageSize(NDEF_STREAM_DEFAULT_MAX_MESSAGE_SIZE),
+    m_expectedLength(0),
+    m_messageSize(0),
+    m_inChunk(false),
+    m_lastMessageSize(0),
+    m_messageCount(0),
+    m_bytesProcessed(0),
+    m_error(NoError)
+{
+}
+
+/*!
+  \brief Maximum size in bytes of a single record. For chunked records,
+  the limit applies to the merged payload.
+  */
+void NdefStreamDecoder::setMaxRecordSize(const int maxRecordSize)
+{
+    m_maxRecordSize = maxRecordSize;
+}
+
+/*!
+  \brief Maximum size in bytes of a complete NDEF message.
+  */
+void NdefStreamDecoder::setMaxMessageSize(const int maxMessageSize)
+{
+    m_maxMessageSize = maxMessageSize;
+}
+
+/*!
+  \brief Decode the next \a size bytes of the stream, starting at \a data.
+
+  Complete records are decoded directly from \a data without copying
+  the raw bytes first. Only a record that is not yet complete at the
+  end of \a data is buffered until the next call.
+
+  \return false if the data couldn't be decoded. The decoder will then
+  refuse any further data until reset() is called.
+  */
+bool NdefStreamDecoder::feed(const char *data, const int size)
+{
+    if (m_error != NoError) {
+        return false;
+    }
+    if (!data || size <= 0) {
+        return true;
+    }
+
+    int pos = 0;
+    while (pos < size) {
+        NdefRecordView view;
+        int recordLength = 0;
+        if (m_buffer.isEmpty()) {
+            // Decode directly from the incoming data
+            const NdefRecordView::ParseResult result = NdefRecordView::parse(data + pos, size - pos, view, &recordLength);
+            if (result == NdefRecordView::ParseMalformed) {
+                return setError(MalformedRecord);
+            }
+            if (!checkRecordLength(recordLength)) {
+                return false;
+            }
+            if (result == NdefRecordView::ParseOk) {
+                pos += view.recordLength();
+                if (!handleRecord(view)) {
+                    return false;
+                }
+            } else {
+                // Incomplete record - keep the remaining data until the next call.
+                // Allocate the final size right away if the header is known.
+                m_expectedLength = recordLength;
+                m_buffer.reserve(recordLength > 0 ? recordLength : NDEF_MAX_HEADER_LENGTH);
+                m_buffer.append(data + pos, size - pos);
+                pos = size;
+                if (recordLength > 0) {
+                    emit recordProgress(m_buffer.size(), recordLength);
+                }
+            }
+        } else {
+            // Continue the buffered record. Only take as many bytes as are
+            // missing for the record - or for the longest possible header,
+            // if the header isn't complete yet.
+            const int buffered = m_buffer.size();
+            const int missing = (m_expectedLength > 0 ? m_expectedLength : NDEF_MAX_HEADER_LENGTH) - buffered;
+            const int take = qMin(missing, size - pos);
+            m_buffer.append(data + pos, take);
+
+            const NdefRecordView::ParseResult result = NdefRecordView::parse(m_buffer.constData(), m_buffer.size(), view, &recordLength);
+            if (result == NdefRecordView::ParseMalformed) {
+                return setError(MalformedRecord);
+            }
+            if (m_expectedLength == 0 && !checkRecordLength(recordLength)) {
+                return false;
+            }
+            if (result == NdefRecordView::ParseOk) {
+                // The buffer might contain the start of the next record
+                // if the header length was unknown - only consume the bytes
+                // that belong to this record.
+                pos += view.recordLength() - buffered;
+                const bool success = handleRecord(view);
+                m_buffer.clear();
+                m_expectedLength = 0;
+                if (!success) {
+                    return false;
+                }
+            } else {
+                pos += take;
+                if (recordLength > 0) {
+                    if (m_expectedLength == 0) {
+                        m_expectedLength = recordLength;
+                        m_buffer.reserve(recordLength);
+                    }
+                    emit recordProgress(m_buffer.size(), recordLength);
+                }
+            }
+        }
+    }
+    m_bytesProcessed += size;
+    return true;
+}
+
+bool NdefStreamDecoder::feed(const QByteArray &data)
+{
+    return feed(data.constData(), data.size());
+}
+
+/*!
+  \brief Read blocks of \a blockSize bytes from the \a device and decode
+  them, until a complete message has been decoded or the end of the
+  device has been reached.
+
+  \return true if a complete message has been decoded. Retrieve it
+  through lastMessage().
+  */
+bool NdefStreamDecoder::decodeFromDevice(QIODevice *device, const int blockSize)
+{
+    if (!device || !device->isReadable() || blockSize <= 0) {
+        return false;
+    }
+    const int messagesBefore = m_messageCount;
+    QByteArray block(blockSize, char(0));
+    while (m_messageCount == messagesBefore && !device->atEnd()) {
+        const qint64 bytesRead = device->read(block.data(), blockSize);
+        if (bytesRead <= 0) {
+            break;
+        }
+        if (!feed(block.constData(), (int)bytesRead)) {
+            return false;
+        }
+    }
+    return m_messageCount > messagesBefore;
+}
+
+/*!
+  \brief Discard all partially received data and clear the error state.
+
+  The last completely decoded message stays available.
+  */
+void NdefStreamDecoder::reset()
+{
+    m_buffer.clear();
+    m_expectedLength = 0;
+    m_records.clear();
+    m_messageSize = 0;
+    m_inChunk = false;
+    m_chunkRecord = QNdefRecord();
+    m_chunkPayload.clear();
+    m_error = NoError;
+}
+
+/*!
+  \brief Returns true if the decoder is not in the middle of a message,
+  i.e., the data received so far ended at a message boundary.
+  */
+bool NdefStreamDecoder::isIdle() const
+{
+    return m_buffer.isEmpty() && m_messageSize == 0 && !m_inChunk;
+}
+
+bool NdefStreamDecoder::hasError() const
+{
+    return m_error != NoError;
+}
+
+NdefStreamDecoder::DecoderError NdefStreamDecoder::error() const
+{
+    return m_error;
+}
+
+QString NdefStreamDecoder::errorString() const
+{
+    QString errorText;
+    switch (m_error) {
+    case NoError:
+        break;
+    case MalformedRecord:
+        errorText = "Malformed NDEF record";
+        break;
+    case MissingMessageBegin:
+        errorText = "NDEF message begin flag missing";
+        break;
+    case UnexpectedChunk:
+        errorText = "Unexpected chunk of a chunked NDEF record";
+        break;
+    case RecordTooLarge:
+        errorText = "NDEF record exceeds the size limit (" + QString::number(m_maxRecordSize) + " bytes)";
+        break;
+    case MessageTooLarge:
+        errorText = "NDEF message exceeds the size limit (" + QString::number(m_maxMessageSize) + " bytes)";
+        break;
+    }
+    return errorText;
+}
+
+/*!
+  \brief Number of complete messages decoded since the decoder
+  has been created.
+  */
+int NdefStreamDecoder::messageCount() const
+{
+    return m_messageCount;
+}
+
+/*!
+  \brief The most recent completely decoded message.
+  */
+QNdefMessage NdefStreamDecoder::lastMessage() const
+{
+    return m_lastMessage;
+}
+
+/*!
+  \brief Size in bytes of the raw data of the most recent completely
+  decoded message.
+  */
+int NdefStreamDecoder::lastMessageSize() const
+{
+    return m_lastMessageSize;
+}
+
+/*!
+  \brief Total number of bytes successfully passed to the decoder.
+  */
+qint64 NdefStreamDecoder::bytesProcessed() const
+{
+    return m_bytesProcessed;
+}
+
+/*!
+  \brief Add the complete record described by \a view to the current
+  message, merging chunks and emitting the signals as required.
+  */
+bool NdefStreamDecoder::handleRecord(const NdefRecordView &view)
+{
+    // Message begin flag has to be set for the first record only
+    if (m_messageSize == 0 && !view.isMessageBegin()) {
+        return setError(MissingMessageBegin);
+    }
+    if (m_messageSize > 0 && view.isMessageBegin()) {
+        return setError(MalformedRecord);
+    }
+    m_messageSize += view.recordLength();
+
+    const int tnf = view.typeNameFormat();
+    QNdefRecord record;
+    if (m_inChunk) {
+        // Middle or terminating chunk
+        if (tnf != NDEF_TNF_UNCHANGED) {
+            return setError(UnexpectedChunk);
+        }
+        if (m_chunkPayload.size() + view.payloadLength() > m_maxRecordSize) {
+            return setError(RecordTooLarge);
+        }
+        m_chunkPayload.append(view.payloadData(), view.payloadLength());
+        if (view.isChunked()) {
+            // More chunks to follow - the message can't end here
+            return view.isMessageEnd() ? setError(MalformedRecord) : true;
+        }
+        m_chunkRecord.setPayload(m_chunkPayload);
+        record = m_chunkRecord;
+        m_inChunk = false;
+        m_chunkRecord = QNdefRecord();
+        m_chunkPayload.clear();
+    } else {
+        if (tnf == NDEF_TNF_UNCHANGED) {
+            return setError(UnexpectedChunk);
+        }
+        if (view.isChunked()) {
+            // Initial chunk: defines type and id of the merged record
+            if (view.isMessageEnd()) {
+                return setError(MalformedRecord);
+            }
+            m_inChunk = true;
+            m_chunkRecord.setTypeNameFormat(view.typeNameFormat());
+            m_chunkRecord.setType(QByteArray(view.typeData(), view.typeLength()));
+            if (view.idLength() > 0) {
+                m_chunkRecord.setId(QByteArray(view.idData(), view.idLength()));
+            }
+            m_chunkPayload = QByteArray(view.payloadData(), view.payloadLength());
+            return true;
+        }
+        record = view.toRecord();
+    }
+
+    m_records.append(record);
+    emit recordDecoded(record);
+
+    if (view.isMessageEnd()) {
+        m_lastMessage = QNdefMessage(m_records);
+        m_lastMessageSize = m_messageSize;
+        m_messageCount++;
+        m_records.clear();
+        m_messageSize = 0;
+        emit messageDecoded(m_lastMessage);
+    }
+    return true;
+}
+
+/*!
+  \brief Check the total length of a record against the size limits,
+  as soon as its header is known.
+  */
+bool NdefStreamDecoder::checkRecordLength(const int recordLength)
+{
+    if (recordLength <= 0) {
+        // Header not complete yet
+        return true;
+    }
+    if (recordLength - NDEF_MAX_HEADER_LENGTH > m_maxRecordSize) {
+        return setError(RecordTooLarge);
+    }
+    if (m_messageSize + recordLength > m_maxMessageSize) {
+        return setError(MessageTooLarge);
+    }
+    return true;
+}
+
+/*!
+  \brief Switch to the error state and discard all partial data.
+  \return always false, to directly return the result from the
+  calling method.
+  */
+bool NdefStreamDecoder::setError(const DecoderError error)
+{
+    m_buffer.clear();
+    m_expectedLength = 0;
+    m_records.clear();
+    m_messageSize = 0;
+    m_inChunk = false;
+    m_chunkPayload.clear();
+    m_error = error;
+    qDebug() << "NDEF stream decoder error: " << errorString();
+    emit decodeError(errorString());
+    return false;
+}
@@ -0,0 +1,138 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NDEFSTREAMDECODER_H
+#define NDEFSTREAMDECODER_H
+
+#include <QObject>
+#include <QDebug>
+#include <QByteArray>
+#include <QList>
+#include <QIODevice>
+#include <QNdefMessage>
+#include <QNdefRecord>
+#include "ndefrecordview.h"
+
+// Default limits for the size of a single record (payload, including
+// all merged chunks) and of a complete message.
+#define NDEF_STREAM_DEFAULT_MAX_RECORD_SIZE     (1024 * 1024)
+#define NDEF_STREAM_DEFAULT_MAX_MESSAGE_SIZE    (2 * 1024 * 1024)
+// Size of the blocks read from a device by decodeFromDevice()
+#define NDEF_STREAM_BLOCK_SIZE  4096
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Push-style decoder that assembles NDEF messages from
+  data arriving in arbitrary chunks (e.g., LLCP reads or file blocks).
+
+  Feed the data to the decoder through feed(). Each record is emitted
+  through the recordDecoded() signal as soon as its header and payload
+  are complete; the messageDecoded() signal follows once the record
+  with the message end flag has been decoded. Several messages can
+  follow each other in the same stream.
+
+  Only the currently incomplete record is buffered. As soon as its
+  header is available, the buffer is allocated once with the final
+  size of the record, so that the memory consumption doesn't grow
+  with the number of chunks.
+
+  Chunked records (CF flag) are merged into a single record before
+  being emitted. The decoder enforces limits for the size of individual
+  records and of the whole message; exceeding them or receiving
+  malformed data puts the decoder into an error state until reset()
+  is called.
+  */
+class NdefStreamDecoder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NdefStreamDecoder(QObject *parent = 0);
+
+    enum DecoderError {
+        NoError,
+        MalformedRecord,
+        MissingMessageBegin,
+        UnexpectedChunk,
+        RecordTooLarge,
+        MessageTooLarge
+    };
+
+    void setMaxRecordSize(const int maxRecordSize);
+    void setMaxMessageSize(const int maxMessageSize);
+
+    bool feed(const char *data, const int size);
+    bool feed(const QByteArray &data);
+    bool decodeFromDevice(QIODevice *device, const int blockSize = NDEF_STREAM_BLOCK_SIZE);
+    void reset();
+
+    bool isIdle() const;
+    bool hasError() const;
+    DecoderError error() const;
+    QString errorString() const;
+
+    int messageCount() const;
+    QNdefMessage lastMessage() const;
+    int lastMessageSize() const;
+    qint64 bytesProcessed() const;
+
+signals:
+    /*! A record has been completely received. Chunked records are
+      only emitted after the last chunk has been received. */
+    void recordDecoded(const QNdefRecord &record);
+    /*! A complete NDEF message has been received. */
+    void messageDecoded(const QNdefMessage &message);
+    /*! Progress for records that span multiple chunks of data,
+      e.g., to show the progress of receiving a large image. */
+    void recordProgress(const int bytesReceived, const int recordLength);
+    /*! Decoding failed. The decoder needs to be reset before it
+      accepts new data. */
+    void decodeError(const QString &errorText);
+
+private:
+    bool handleRecord(const NdefRecordView &view);
+    bool checkRecordLength(const int recordLength);
+    bool setError(const DecoderError error);
+
+private:
+    int m_maxRecordSize;
+    int m_maxMessageSize;
+
+    /*! Holds the record that is currently being received, if it
+      spans multiple calls to feed(). */
+    QByteArray m_buffer;
+    /*! Total length of the record in m_buffer, once its header is known. */
+    int m_expectedLength;
+
+    /*! Completed records of the message that is currently being received. */
+    QList<QNdefRecord> m_records;
+    /*! Number of bytes of the current message received so far. */
+    int m_messageSize;
+
+    /*! True while receiving the chunks of a chunked record. */
+    bool m_inChunk;
+    /*! First chunk of a chunked record; the payloads of the
+      following chunks are added to this record. */
+    QNdefRecord m_chunkRecord;
+    QByteArray m_chunkPayload;
+
+    QNdefMessage m_lastMessage;
+    int m_lastMessageSize;
+    int m_messageCount;
+    qint64 m_bytesProcessed;
+    DecoderError m_error;
+};
+
+#endif // NDEFSTREAMDECODER_H
@@ -0,0 +1,459 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "ndeftlvparser.h"
+#include <QtAlgorithms>
+
+static bool areaLessThan(const NdefTlvArea &area1, const NdefTlvArea &area2)
+{
+    return area1.address < area2.address;
+}
+
+NdefTlvParser::NdefTlvParser() :
+    m_dataStart(0),
+    m_dataEnd(0),
+    m_tagReservedAreaCount(0),
+    m_memoryAddress(0),
+    m_complete(false),
+    m_ndefTlvAddress(-1),
+    m_ndefMessageLength(0),
+    m_ndefValueAddress(-1),
+    m_freeAddress(-1)
+{
+}
+
+/*!
+  \brief Byte addresses of the data area on the tag, from
+  \a startAddress up to (but not including) \a endAddress.
+  */
+void NdefTlvParser::setDataArea(const int startAddress, const int endAddress)
+{
+    m_dataStart = startAddress;
+    m_dataEnd = endAddress;
+}
+
+/*!
+  \brief Add an area of \a size bytes at \a address that is reserved
+  by the memory layout of the tag type and can't store data.
+
+  Areas announced through Lock Control and Memory Control TLVs are
+  added automatically by parse().
+  */
+void NdefTlvParser::addReservedArea(const int address, const int size)
+{
+    NdefTlvArea area;
+    area.address = address;
+    area.size = size;
+    // Keep the areas of the tag type in front of the areas found by parse()
+    m_reservedAreas.insert(m_tagReservedAreaCount, area);
+    m_tagReservedAreaCount++;
+}
+
+/*!
+  \brief Walk the TLVs in the data area, up to the NDEF message TLV
+  or the Terminator TLV.
+
+  \param memory contents of the tag memory, starting at the byte
+  address \a memoryAddress. Has to contain the data area at least up
+  to the header of the NDEF message TLV.
+  \return true if all TLVs in front of the NDEF message could be
+  parsed. Otherwise, \a memory ended before, and the capacity
+  is unknown.
+  */
+bool NdefTlvParser::parse(const QByteArray &memory, const int memoryAddress)
+{
+    m_memory = memory;
+    m_memoryAddress = memoryAddress;
+    m_complete = false;
+    m_ndefTlvAddress = -1;
+    m_ndefMessageLength = 0;
+    m_ndefValueAddress = -1;
+    m_freeAddress = -1;
+    m_tlvNames.clear();
+    // Remove the areas of control TLVs found by a previous call
+    while (m_reservedAreas.size() > m_tagReservedAreaCount) {
+        m_reservedAreas.removeLast();
+    }
+
+    int address = advance(m_dataStart, 0);
+    while (address < m_dataEnd) {
+        quint8 tlvType;
+        if (!byteAt(address, tlvType)) {
+            return false;
+        }
+        if (tlvType == NDEF_TLV_NULL) {
+            // Padding - doesn't have a length field
+            address = advance(address, 1);
+            continue;
+        }
+        if (tlvType == NDEF_TLV_TERMINATOR) {
+            m_tlvNames.append("Terminator");
+            m_freeAddress = address;
+            m_complete = true;
+            return true;
+        }
+
+        // Length: one byte, or FFh followed by two bytes
+        const int lengthAddress = advance(address, 1);
+        quint8 shortLength;
+        if (lengthAddress >= m_dataEnd || !byteAt(lengthAddress, shortLength)) {
+            return false;
+        }
+        int tlvLength = shortLength;
+        int valueAddress = advance(lengthAddress, 1);
+        if (shortLength == NDEF_TLV_LONG_LENGTH) {
+            quint8 lengthHigh;
+            quint8 lengthLow;
+            const int lengthLowAddress = advance(valueAddress, 1);
+            if (!byteAt(valueAddress, lengthHigh) || !byteAt(lengthLowAddress, lengthLow)) {
+                return false;
+            }
+            tlvLength = (lengthHigh << 8) | lengthLow;
+            valueAddress = advance(lengthLowAddress, 1);
+        }
+
+        switch (tlvType) {
+        case NDEF_TLV_LOCK_CONTROL:
+        case NDEF_TLV_MEMORY_CONTROL: {
+            const bool lockControl = (tlvType == NDEF_TLV_LOCK_CONTROL);
+            quint8 value[NDEF_TLV_CONTROL_VALUE_SIZE];
+            if (tlvLength != NDEF_TLV_CONTROL_VALUE_SIZE) {
+                m_tlvNames.append(lockControl ? "Lock Control (invalid)" : "Memory Control (invalid)");
+                break;
+            }
+            for (int i = 0; i < NDEF_TLV_CONTROL_VALUE_SIZE; i++) {
+                if (!byteAt(advance(valueAddress, i), value[i])) {
+                    return false;
+                }
+            }
+            const NdefTlvArea area = controlArea(value[0], value[1], value[2], lockControl);
+            m_reservedAreas.append(area);
+            m_tlvNames.append(QString(lockControl ? "Lock Control" : "Memory Control")
+                              + " (" + QString::number(area.size) + " bytes at " + QString::number(area.address) + ")");
+            break; }
+        case NDEF_TLV_NDEF_MESSAGE:
+            m_tlvNames.append("NDEF Message (" + QString::number(tlvLength) + " bytes)");
+            m_ndefTlvAddress = address;
+            m_ndefMessageLength = tlvLength;
+            m_ndefValueAddress = valueAddress;
+            m_complete = true;
+            return true;
+        case NDEF_TLV_PROPRIETARY:
+            m_tlvNames.append("Proprietary (" + QString::number(tlvLength) + " bytes)");
+            break;
+        default:
+            // Unknown TLVs are skipped based on their length
+            m_tlvNames.append("Unknown (0x" + QString::number(tlvType, 16) + ")");
+            break;
+        }
+        address = advance(valueAddress, tlvLength);
+    }
+    // No NDEF message and no Terminator TLV - the data area is full
+    m_freeAddress = m_dataEnd;
+    m_complete = true;
+    return true;
+}
+
+/*!
+  \brief Returns true if the last call to parse() found the NDEF
+  message TLV, a Terminator TLV or the end of the data area.
+  */
+bool NdefTlvParser::isComplete() const
+{
+    return m_complete;
+}
+
+bool NdefTlvParser::hasNdefMessage() const
+{
+    return m_ndefTlvAddress >= 0;
+}
+
+/*!
+  \brief Byte address of the type field of the NDEF message TLV,
+  or -1 if the tag doesn't contain one.
+  */
+int NdefTlvParser::ndefTlvAddress() const
+{
+    return m_ndefTlvAddress;
+}
+
+/*!
+  \brief Length of the NDEF message currently stored on the tag.
+  */
+int NdefTlvParser::ndefMessageLength() const
+{
+    return m_ndefMessageLength;
+}
+
+/*!
+  \brief Address behind the last byte of the NDEF message, i.e.,
+  the memory passed to parse() has to extend up to here for
+  ndefMessage(). -1 if the tag doesn't contain an NDEF message.
+  */
+int NdefTlvParser::ndefMessageEndAddress() const
+{
+    if (!hasNdefMessage()) {
+        return -1;
+    }
+    return advance(m_ndefValueAddress, m_ndefMessageLength);
+}
+
+/*!
+  \brief Raw NDEF message stored in the NDEF message TLV, without
+  the bytes of reserved areas in between.
+
+  \return the message, or an empty byte array if the tag doesn't
+  contain a message or the memory passed to parse() ends before the
+  end of the message.
+  */
+QByteArray NdefTlvParser::ndefMessage() const
+{
+    QByteArray message;
+    if (!hasNdefMessage()) {
+        return message;
+    }
+    message.reserve(m_ndefMessageLength);
+    int address = m_ndefValueAddress;
+    for (int i = 0; i < m_ndefMessageLength; i++) {
+        address = advance(address, 0);
+        quint8 value;
+        if (!byteAt(address, value)) {
+            return QByteArray();
+        }
+        message.append((char)value);
+        address++;
+    }
+    return message;
+}
+
+/*!
+  \brief Byte address where a new NDEF message TLV is written: the
+  position of the current one, or the position of the Terminator TLV
+  if the tag doesn't contain a message yet. -1 if parse() didn't
+  complete.
+  */
+int NdefTlvParser::ndefWriteAddress() const
+{
+    if (!m_complete) {
+        return -1;
+    }
+    return hasNdefMessage() ? m_ndefTlvAddress : m_freeAddress;
+}
+
+/*!
+  \brief Address behind the last byte that writeNdefMessage() changes
+  for a message of \a messageLength bytes, including the Terminator TLV.
+  -1 if parse() didn't complete.
+  */
+int NdefTlvParser::ndefTlvEndAddress(const int messageLength) const
+{
+    const int writeAddress = ndefWriteAddress();
+    if (writeAddress < 0) {
+        return -1;
+    }
+    const int headerSize = (messageLength > NDEF_TLV_MAX_SHORT_LENGTH) ? NDEF_TLV_LONG_HEADER_SIZE : NDEF_TLV_SHORT_HEADER_SIZE;
+    const int end = advance(writeAddress, headerSize + messageLength);
+    // The Terminator TLV is only written if there is space left
+    return (end < m_dataEnd) ? advance(end, 1) : end;
+}
+
+/*!
+  \brief Create the contents of the memory passed to parse() after
+  replacing the NDEF message TLV with one containing \a message.
+
+  The TLV is written to ndefWriteAddress(), skipping the reserved
+  areas, and followed by a Terminator TLV if there is space left.
+  All other bytes keep their current value.
+
+  \param lengthAddress if not NULL, set to the address of the first
+  byte of the length field.
+  \return the new memory contents, or an empty byte array if the
+  message doesn't fit or if the memory passed to parse() doesn't
+  extend up to ndefTlvEndAddress().
+  */
+QByteArray NdefTlvParser::writeNdefMessage(const QByteArray &message, int *lengthAddress) const
+{
+    if (!m_complete || message.size() > maxNdefMessageSize()) {
+        return QByteArray();
+    }
+    QByteArray tlv;
+    tlv.reserve(NDEF_TLV_LONG_HEADER_SIZE + message.size() + 1);
+    tlv.append((char)NDEF_TLV_NDEF_MESSAGE);
+    if (message.size() > NDEF_TLV_MAX_SHORT_LENGTH) {
+        tlv.append((char)NDEF_TLV_LONG_LENGTH);
+        tlv.append((char)(message.size() >> 8));
+        tlv.append((char)(message.size() & 0xFF));
+    } else {
+        tlv.append((char)message.size());
+    }
+    tlv.append(message);
+
+    QByteArray image = m_memory;
+    int address = ndefWriteAddress();
+    for (int i = 0; i < tlv.size(); i++) {
+        address = advance(address, 0);
+        const int offset = address - m_memoryAddress;
+        if (offset < 0 || offset >= image.size()) {
+            return QByteArray();
+        }
+        if (i == 1 && lengthAddress) {
+            *lengthAddress = address;
+        }
+        image[offset] = tlv.at(i);
+        address++;
+    }
+    address = advance(address, 0);
+    if (address < m_dataEnd) {
+        const int offset = address - m_memoryAddress;
+        if (offset < 0 || offset >= image.size()) {
+            return QByteArray();
+        }
+        image[offset] = (char)NDEF_TLV_TERMINATOR;
+    }
+    return image;
+}
+
+QList<NdefTlvArea> NdefTlvParser::reservedAreas() const
+{
+    return m_reservedAreas;
+}
+
+/*!
+  \brief Size in bytes of the largest NDEF message that can be written
+  to the tag, replacing the current message.
+
+  The NDEF message TLV starts at the position of the current message,
+  or after the control TLVs if the tag doesn't have a message yet.
+  The TLV header needs two bytes, or four bytes for messages longer
+  than 254 bytes. A Terminator TLV is only written if there is space
+  left, so it isn't subtracted.
+
+  \return the size in bytes, or -1 if the TLVs couldn't be parsed
+  completely.
+  */
+int NdefTlvParser::maxNdefMessageSize() const
+{
+    if (!m_complete) {
+        return -1;
+    }
+    return maxNdefMessageSize(freeBytes(hasNdefMessage() ? m_ndefTlvAddress : m_freeAddress));
+}
+
+/*!
+  \brief Size in bytes of the largest NDEF message that fits into
+  \a availableBytes, including the header of the NDEF message TLV.
+  */
+int NdefTlvParser::maxNdefMessageSize(const int availableBytes)
+{
+    if (availableBytes - NDEF_TLV_LONG_HEADER_SIZE > NDEF_TLV_MAX_SHORT_LENGTH) {
+        return availableBytes - NDEF_TLV_LONG_HEADER_SIZE;
+    }
+    return qMax(0, qMin(availableBytes - NDEF_TLV_SHORT_HEADER_SIZE, NDEF_TLV_MAX_SHORT_LENGTH));
+}
+
+/*!
+  \brief Textual description of the TLVs found by parse().
+  */
+QString NdefTlvParser::toString() const
+{
+    if (m_tlvNames.isEmpty()) {
+        return QString();
+    }
+    return "TLVs: " + m_tlvNames.join(", ");
+}
+
+/*!
+  \brief Get the byte at the tag memory \a address from the memory
+  passed to parse().
+  \return false if the address is outside of the memory.
+  */
+bool NdefTlvParser::byteAt(const int address, quint8 &value) const
+{
+    const int offset = address - m_memoryAddress;
+    if (offset < 0 || offset >= m_memory.size()) {
+        return false;
+    }
+    value = m_memory.at(offset);
+    return true;
+}
+
+/*!
+  \brief Address of the data byte that is \a count data bytes after
+  \a address, skipping all reserved areas.
+  */
+int NdefTlvParser::advance(int address, int count) const
+{
+    bool skipped;
+    do {
+        // Skip reserved areas at the current position
+        skipped = false;
+        for (int i = 0; i < m_reservedAreas.size(); i++) {
+            const NdefTlvArea &area = m_reservedAreas.at(i);
+            if (address >= area.address && address < area.address + area.size) {
+                address = area.address + area.size;
+                skipped = true;
+            }
+        }
+        if (!skipped && count > 0) {
+            address++;
+            count--;
+            skipped = true;
+        }
+    } while (skipped && address < m_dataEnd);
+    return address;
+}
+
+/*!
+  \brief Number of data bytes from \a fromAddress to the end of the
+  data area, not counting the reserved areas.
+  */
+int NdefTlvParser::freeBytes(const int fromAddress) const
+{
+    // Control TLVs might announce areas within the reserved areas
+    // of the tag type - only count overlapping bytes once
+    QList<NdefTlvArea> areas = m_reservedAreas;
+    qSort(areas.begin(), areas.end(), areaLessThan);
+    int count = m_dataEnd - fromAddress;
+    int countedUpTo = fromAddress;
+    for (int i = 0; i < areas.size(); i++) {
+        const int start = qMax(areas.at(i).address, countedUpTo);
+        const int end = qMin(areas.at(i).address + areas.at(i).size, m_dataEnd);
+        if (end > start) {
+            count -= end - start;
+            countedUpTo = end;
+        }
+    }
+    return qMax(0, count);
+}
+
+/*!
+  \brief Decode the value of a Lock Control or Memory Control TLV.
+
+  Position: page address (upper nibble) and byte offset within the page.
+  Size: number of dynamic lock bits, or number of reserved bytes.
+  Page control: number of bytes locked per lock bit (upper nibble, only
+  for lock control) and number of bytes per page (lower nibble), both
+  as exponents of two.
+  */
+NdefTlvArea NdefTlvParser::controlArea(const quint8 position, const quint8 size, const quint8 pageControl, const bool lockControl) const
+{
+    const int bytesPerPage = 1 << (pageControl & 0x0F);
+    NdefTlvArea area;
+    area.address = (position >> 4) * bytesPerPage + (position & 0x0F);
+    // A size of 0 means 256 bits / bytes
+    const int areaSize = (size == 0) ? 256 : size;
+    area.size = lockControl ? (areaSize + 7) / 8 : areaSize;
+    return area;
+}
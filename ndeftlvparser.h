@@ -0,0 +1,118 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NDEFTLVPARSER_H
+#define NDEFTLVPARSER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+// TLV block types in the data area of Type 1 & 2 tags
+#define NDEF_TLV_NULL 0x00
+#define NDEF_TLV_LOCK_CONTROL 0x01
+#define NDEF_TLV_MEMORY_CONTROL 0x02
+#define NDEF_TLV_NDEF_MESSAGE 0x03
+#define NDEF_TLV_PROPRIETARY 0xFD
+#define NDEF_TLV_TERMINATOR 0xFE
+// Value of a one byte length field that announces a three byte length field
+#define NDEF_TLV_LONG_LENGTH 0xFF
+// Lengths up to this value fit into the one byte length field
+#define NDEF_TLV_MAX_SHORT_LENGTH 254
+// Size of the value of Lock Control and Memory Control TLVs
+#define NDEF_TLV_CONTROL_VALUE_SIZE 3
+// Size of the type and length fields of the NDEF message TLV
+#define NDEF_TLV_SHORT_HEADER_SIZE 2
+#define NDEF_TLV_LONG_HEADER_SIZE 4
+
+/*!
+  \brief Bytes within the data area of a tag that can't be used
+  for the NDEF message, e.g., dynamic lock bits.
+  */
+struct NdefTlvArea
+{
+    int address;
+    int size;
+};
+
+/*!
+  \brief Parses the TLV blocks in the data area of NFC Forum Type 1
+  and Type 2 tags, to find the position of the NDEF message and the
+  exact number of bytes available for it.
+
+  Lock Control and Memory Control TLVs announce areas of the memory
+  (dynamic lock bits and reserved bytes) that are skipped when storing
+  data. The parser adds these areas to the reserved areas of the tag
+  layout and skips them as well, both while walking the TLVs and when
+  counting the free bytes.
+
+  Only the memory up to the NDEF message TLV needs to be passed to
+  parse(); the size of the data area is taken from the capability
+  container, so the capacity can be computed from the response of a
+  single read command.
+  */
+class NdefTlvParser
+{
+public:
+    NdefTlvParser();
+
+    void setDataArea(const int startAddress, const int endAddress);
+    void addReservedArea(const int address, const int size);
+    bool parse(const QByteArray &memory, const int memoryAddress);
+
+    bool isComplete() const;
+    bool hasNdefMessage() const;
+    int ndefTlvAddress() const;
+    int ndefMessageLength() const;
+    int ndefMessageEndAddress() const;
+    QByteArray ndefMessage() const;
+    int ndefWriteAddress() const;
+    int ndefTlvEndAddress(const int messageLength) const;
+    QByteArray writeNdefMessage(const QByteArray &message, int *lengthAddress = NULL) const;
+    QList<NdefTlvArea> reservedAreas() const;
+    int maxNdefMessageSize() const;
+    static int maxNdefMessageSize(const int availableBytes);
+    QString toString() const;
+
+private:
+    bool byteAt(const int address, quint8 &value) const;
+    int advance(int address, int count) const;
+    int freeBytes(const int fromAddress) const;
+    NdefTlvArea controlArea(const quint8 position, const quint8 size, const quint8 pageControl, const bool lockControl) const;
+
+private:
+    int m_dataStart;
+    /*! Address after the last byte of the data area. */
+    int m_dataEnd;
+    /*! Reserved areas of the tag type and those announced by control TLVs. */
+    QList<NdefTlvArea> m_reservedAreas;
+    /*! Number of areas at the start of m_reservedAreas that have been
+      added through addReservedArea(). */
+    int m_tagReservedAreaCount;
+    /*! Memory passed to parse() and its start address on the tag. */
+    QByteArray m_memory;
+    int m_memoryAddress;
+    bool m_complete;
+    int m_ndefTlvAddress;
+    int m_ndefMessageLength;
+    /*! Address of the first byte of the NDEF message, behind the TLV header. */
+    int m_ndefValueAddress;
+    /*! Where an NDEF TLV would be written if the tag doesn't contain one yet. */
+    int m_freeAddress;
+    QStringList m_tlvNames;
+};
+
+#endif // NDEFTLVPARSER_H
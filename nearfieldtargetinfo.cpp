@@ -14,6 +14,7 @@
 ****************************************************************************/
 
 #include "nearfieldtargetinfo.h"
+#include "ndeftlvparser.h"
 
 /*!
   \brief New target info, using default values.
@@ -29,10 +30,12 @@ NearFieldTargetInfo::NearFieldTargetInfo()
 void NearFieldTargetInfo::resetInfo()
 {
     tagTypeName = "";
+    tagUid.clear();
     tagMajorVersion = 0;
     tagMinorVersion = 0;
     tagMemorySize = -1;
     tagWritableSize = -1;
+    tagNdefCapacity = -1;
     tagReadAccessCC = NfcAccessUnknown;
     tagWriteAccessCC = NfcAccessUnknown;
     tagReadAccessLockBits = NfcAccessUnknown;
@@ -58,6 +61,26 @@ NearFieldTargetInfo::NfcTagAccessStatus NearFieldTargetInfo::combinedWriteAccess
     return combineAccess(tagWriteAccessCC, tagWriteAccessLockBits);
 }
 
+/*!
+  \brief Size of the largest NDEF message that can be written to the tag.
+
+  Uses the exact capacity based on the TLVs of the tag if it's known.
+  Otherwise, it's estimated from the writable size, minus the header of
+  the NDEF message TLV.
+
+  \return the size in bytes, or -1 if unknown.
+  */
+int NearFieldTargetInfo::maxNdefMessageSize() const
+{
+    if (tagNdefCapacity >= 0) {
+        return tagNdefCapacity;
+    }
+    if (tagWritableSize < 0) {
+        return -1;
+    }
+    return NdefTlvParser::maxNdefMessageSize(tagWritableSize);
+}
+
 /*!
   \brief Internal method used to combine the access status of CC and lock bits.
 
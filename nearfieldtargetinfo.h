@@ -17,6 +17,7 @@
 #define NEARFIELDTARGETINFO_H
 
 #include <QDebug>
+#include <QByteArray>
 
 /*!
   \brief Stores additional information about a QNearFieldTarget.
@@ -42,15 +43,21 @@ public:
 
     NearFieldTargetInfo::NfcTagAccessStatus combinedWriteAccess() const;
 
+    int maxNdefMessageSize() const;
+
 private:
     NearFieldTargetInfo::NfcTagAccessStatus combineAccess(const NfcTagAccessStatus accessCC, const NfcTagAccessStatus accessLockBits) const;
 
 public:
     QString tagTypeName;
+    QByteArray tagUid;
     int tagMajorVersion;
     int tagMinorVersion;
     int tagMemorySize;
     int tagWritableSize;
+    /*! Exact size of the largest NDEF message that fits on the tag,
+      based on its TLVs, or -1 if unknown. */
+    int tagNdefCapacity;
     NfcTagAccessStatus tagReadAccessCC;
     NfcTagAccessStatus tagWriteAccessCC;
     NfcTagAccessStatus tagReadAccessLockBits;
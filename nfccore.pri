@@ -0,0 +1,71 @@
+# NfcInfo and everything it needs for reading and writing tags,
+# without the QML UI. Shared by the app and tools/nfcsimbenchmark.
+SOURCES += $$PWD/nfcinfo.cpp \
+    $$PWD/nearfieldtargetinfo.cpp \
+    $$PWD/nfctargetanalyzer.cpp \
+    $$PWD/nfctagprofilecache.cpp \
+    $$PWD/ndefmessageshrinker.cpp \
+    $$PWD/nfcprovisioningqueue.cpp \
+    $$PWD/nfcwriteverifier.cpp \
+    $$PWD/nfcdiffwriter.cpp \
+    $$PWD/tagimagecache.cpp \
+    $$PWD/nfcrecordmodel.cpp \
+    $$PWD/nfcrecorddefaults.cpp \
+    $$PWD/nfcrecorditem.cpp \
+    $$PWD/nfcmodeltondef.cpp \
+    $$PWD/nfcndefparser.cpp \
+    $$PWD/nfcstats.cpp \
+    $$PWD/appsettings.cpp \
+    $$PWD/nfcpeertopeer.cpp \
+    $$PWD/snepmanager.cpp \
+    $$PWD/nfcllcptransport.cpp \
+    $$PWD/nfclogwriter.cpp \
+    $$PWD/nfctagcatalog.cpp \
+    $$PWD/ndefrecordhandlerregistry.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcsprecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcmimeimagerecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcmimevcardrecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcgeorecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcsmarturirecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcsmsrecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcsocialrecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcstorelinkrecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfcandroidapprecord.cpp \
+    $$PWD/ndefnfcrecords/ndefnfclaunchapprecord.cpp
+HEADERS += $$PWD/nfcinfo.h \
+    $$PWD/nearfieldtargetinfo.h \
+    $$PWD/nfctargetanalyzer.h \
+    $$PWD/nfctagprofilecache.h \
+    $$PWD/ndefmessageshrinker.h \
+    $$PWD/nfcprovisioningqueue.h \
+    $$PWD/nfcwriteverifier.h \
+    $$PWD/nfcdiffwriter.h \
+    $$PWD/tagimagecache.h \
+    $$PWD/nfcrecordmodel.h \
+    $$PWD/nfcrecorddefaults.h \
+    $$PWD/nfcrecorditem.h \
+    $$PWD/nfcmodeltondef.h \
+    $$PWD/nfcndefparser.h \
+    $$PWD/nfcstats.h \
+    $$PWD/nfctypes.h \
+    $$PWD/appsettings.h \
+    $$PWD/nfcpeertopeer.h \
+    $$PWD/snepmanager.h \
+    $$PWD/nfcllcptransport.h \
+    $$PWD/nfclogwriter.h \
+    $$PWD/nfctagcatalog.h \
+    $$PWD/ndefrecordhandlerregistry.h \
+    $$PWD/ndefnfcrecords/ndefnfcsprecord.h \
+    $$PWD/ndefnfcrecords/ndefnfcmimeimagerecord.h \
+    $$PWD/ndefnfcrecords/ndefnfcmimevcardrecord.h \
+    $$PWD/ndefnfcrecords/ndefnfcgeorecord.h \
+    $$PWD/ndefnfcrecords/ndefnfcsmarturirecord.h \
+    $$PWD/ndefnfcrecords/ndefnfcsmsrecord.h \
+    $$PWD/ndefnfcrecords/ndefnfcsocialrecord.h \
+    $$PWD/ndefnfcrecords/ndefnfcstorelinkrecord.h \
+    $$PWD/ndefnfcrecords/ndefnfcandroidapprecord.h \
+    $$PWD/ndefnfcrecords/ndefnfclaunchapprecord.h
+INCLUDEPATH += $$PWD
+
+# Raw NDEF decoding, shared with tools/ndefloganalyzer
+include($$PWD/ndefdecoding.pri)
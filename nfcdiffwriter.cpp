@@ -0,0 +1,312 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "nfcdiffwriter.h"
+#include <string.h>
+
+NfcDiffWriter::NfcDiffWriter(QObject *parent) :
+    QObject(parent),
+    m_state(DiffWriteIdle),
+    m_readAddress(0),
+    m_dataEnd(0),
+    m_commitAddress(0),
+    m_writtenBlocks(0),
+    m_totalBlocks(0)
+{
+}
+
+/*!
+  \brief Returns true if the message can be written to the \a target
+  with write(): a Type 2 tag with tag-type specific access, whose
+  memory size is known from the analysis.
+  */
+bool NfcDiffWriter::isSupported(QNearFieldTarget *target, const NearFieldTargetInfo &tagInfo)
+{
+    return target && target->type() == QNearFieldTarget::NfcTagType2 &&
+            qobject_cast<QNearFieldTagType2 *>(target) && tagInfo.tagMemorySize > 0;
+}
+
+/*!
+  \brief Start writing the \a rawMessage to the \a target.
+
+  Returns immediately; written() or failed() is emitted once the
+  message has been written.
+
+  \return false if the target isn't supported or if the first read
+  request couldn't be sent. The tag hasn't been modified in that case.
+  */
+bool NfcDiffWriter::write(QNearFieldTarget *target, const QByteArray &rawMessage, const NearFieldTargetInfo &tagInfo)
+{
+    abort();
+    if (!isSupported(target, tagInfo)) {
+        return false;
+    }
+    m_target = qobject_cast<QNearFieldTagType2 *>(target);
+    m_message = rawMessage;
+    m_parser = NdefTlvParser();
+    m_dataEnd = TYPE2_DATA_ADDRESS + tagInfo.tagMemorySize;
+    m_parser.setDataArea(TYPE2_DATA_ADDRESS, m_dataEnd);
+    m_readAddress = TYPE2_DATA_ADDRESS;
+    m_writtenBlocks = 0;
+    m_totalBlocks = 0;
+    m_state = DiffWriteReading;
+    connect(target, SIGNAL(requestCompleted(const QNearFieldTarget::RequestId)),
+            this, SLOT(requestCompleted(QNearFieldTarget::RequestId)));
+    connect(target, SIGNAL(error(QNearFieldTarget::Error,QNearFieldTarget::RequestId)),
+            this, SLOT(targetError(QNearFieldTarget::Error,QNearFieldTarget::RequestId)));
+
+    // The NDEF message TLV usually directly follows the control TLVs
+    if (!readUpTo(TYPE2_DATA_ADDRESS + DIFF_WRITE_CONTROL_TLV_SIZE + NDEF_TLV_LONG_HEADER_SIZE + rawMessage.size() + 1)) {
+        abort();
+        return false;
+    }
+    return true;
+}
+
+/*!
+  \brief Stop waiting for the responses of the current target,
+  e.g., when it has been lost. Doesn't emit any signal.
+  */
+void NfcDiffWriter::abort()
+{
+    if (m_target) {
+        disconnect(m_target, 0, this, 0);
+    }
+    m_target = NULL;
+    m_state = DiffWriteIdle;
+    m_pendingRequests.clear();
+    m_diffRequests.clear();
+    m_responses.clear();
+    m_commitImage.clear();
+}
+
+bool NfcDiffWriter::isWriting() const
+{
+    return m_state != DiffWriteIdle && !m_target.isNull();
+}
+
+/*!
+  \brief Returns true if the request \a id has been sent by the
+  writer. Errors of these requests are reported through failed().
+  */
+bool NfcDiffWriter::isDiffWriterRequest(const QNearFieldTarget::RequestId &id) const
+{
+    return m_diffRequests.contains(id);
+}
+
+/*!
+  \brief Send READ commands for the data area until \a endAddress
+  (exclusive), starting at the first byte that hasn't been requested yet.
+
+  \return false if a request couldn't be sent.
+  */
+bool NfcDiffWriter::readUpTo(const int endAddress)
+{
+    const int readEnd = qMin(endAddress, m_dataEnd);
+    while (m_readAddress < readEnd) {
+        if (m_readAddress / TYPE2_BLOCK_SIZE > 0xFF) {
+            // Would need to switch the sector
+            return false;
+        }
+        const QNearFieldTarget::RequestId id = m_target->readBlock(m_readAddress / TYPE2_BLOCK_SIZE);
+        if (!id.isValid()) {
+            return false;
+        }
+        m_pendingRequests.append(qMakePair(id, m_readAddress));
+        m_diffRequests.append(id);
+        m_readAddress += TYPE2_READ_SIZE;
+    }
+    return true;
+}
+
+void NfcDiffWriter::requestCompleted(const QNearFieldTarget::RequestId &id)
+{
+    if (m_state == DiffWriteIdle || !m_target || sender() != m_target.data()) {
+        return;
+    }
+    for (int i = 0; i < m_pendingRequests.size(); i++) {
+        if (m_pendingRequests.at(i).first == id) {
+            if (m_state == DiffWriteReading) {
+                const QByteArray response = m_target->requestResponse(id).toByteArray();
+                if (response.size() < TYPE2_READ_SIZE) {
+                    finishWriting(false, "Unexpected response to READ (" + QString::number(response.size()) + " bytes)");
+                    return;
+                }
+                m_responses.insert(m_pendingRequests.at(i).second, response.left(TYPE2_READ_SIZE));
+            }
+            m_pendingRequests.removeAt(i);
+            break;
+        }
+    }
+    if (!m_pendingRequests.isEmpty()) {
+        return;
+    }
+
+    switch (m_state) {
+    case DiffWriteReading:
+        checkMemory();
+        break;
+    case DiffWriteWriting:
+        // All other blocks are written - commit the new length
+        m_state = DiffWriteCommitting;
+        if (!writeBlock(m_commitImage, m_commitAddress)) {
+            finishWriting(false, "Unable to write the length of the message");
+        }
+        break;
+    case DiffWriteCommitting:
+        finishWriting(true, QString());
+        break;
+    default:
+        break;
+    }
+}
+
+void NfcDiffWriter::targetError(QNearFieldTarget::Error error, const QNearFieldTarget::RequestId &id)
+{
+    if (m_state == DiffWriteIdle || !m_target || sender() != m_target.data() || !m_diffRequests.contains(id)) {
+        return;
+    }
+    finishWriting(false, QString(m_state == DiffWriteReading ? "Reading" : "Writing")
+                  + " the data area failed (error " + QString::number(error) + ")");
+}
+
+/*!
+  \brief Parse the TLVs of the memory read so far. Once the memory
+  up to the end of the new NDEF message TLV is available, write the
+  changed blocks; otherwise, send the reads for the rest of it.
+  */
+void NfcDiffWriter::checkMemory()
+{
+    QByteArray memory(m_readAddress - TYPE2_DATA_ADDRESS, '\0');
+    QMap<int, QByteArray>::const_iterator it;
+    for (it = m_responses.constBegin(); it != m_responses.constEnd(); ++it) {
+        memory.replace(it.key() - TYPE2_DATA_ADDRESS, it.value().size(), it.value());
+    }
+
+    int nextEnd;
+    if (!m_parser.parse(memory, TYPE2_DATA_ADDRESS)) {
+        // The TLVs in front of the message take more space than expected
+        nextEnd = m_readAddress + 1;
+    } else if (m_message.size() > m_parser.maxNdefMessageSize()) {
+        finishWriting(false, "Message (" + QString::number(m_message.size()) + " bytes) is too large for the tag ("
+                      + QString::number(m_parser.maxNdefMessageSize()) + " bytes available)");
+        return;
+    } else {
+        nextEnd = m_parser.ndefTlvEndAddress(m_message.size());
+        if (nextEnd <= m_readAddress) {
+            int lengthAddress = -1;
+            const QByteArray image = m_parser.writeNdefMessage(m_message, &lengthAddress);
+            if (image.isEmpty() || lengthAddress < 0) {
+                finishWriting(false, "Unable to place the message in the data area");
+                return;
+            }
+            m_totalBlocks = (nextEnd - 1) / TYPE2_BLOCK_SIZE - m_parser.ndefWriteAddress() / TYPE2_BLOCK_SIZE + 1;
+            writeChangedBlocks(memory, image, lengthAddress);
+            return;
+        }
+    }
+    if (m_readAddress >= m_dataEnd || !readUpTo(nextEnd) || m_pendingRequests.isEmpty()) {
+        finishWriting(false, "Unable to read the data area");
+    }
+}
+
+/*!
+  \brief Compare the current \a memory with the new contents
+  \a image block by block and send the WRITE commands for the blocks
+  that differ. The block containing the \a lengthAddress is committed
+  last, see the class description.
+  */
+void NfcDiffWriter::writeChangedBlocks(const QByteArray &memory, const QByteArray &image, const int lengthAddress)
+{
+    m_commitAddress = lengthAddress - (lengthAddress % TYPE2_BLOCK_SIZE);
+    m_commitImage = image;
+    const int commitOffset = m_commitAddress - TYPE2_DATA_ADDRESS;
+    const bool commitChanged = (memory.mid(commitOffset, TYPE2_BLOCK_SIZE) != image.mid(commitOffset, TYPE2_BLOCK_SIZE));
+
+    QList<int> changedBlocks;
+    for (int offset = 0; offset + TYPE2_BLOCK_SIZE <= image.size(); offset += TYPE2_BLOCK_SIZE) {
+        if (offset != commitOffset &&
+                memcmp(memory.constData() + offset, image.constData() + offset, TYPE2_BLOCK_SIZE) != 0) {
+            changedBlocks.append(TYPE2_DATA_ADDRESS + offset);
+        }
+    }
+    qDebug() << "Differential write:" << changedBlocks.size() + (commitChanged ? 1 : 0)
+             << "of" << m_totalBlocks << "blocks changed";
+
+    if (changedBlocks.isEmpty()) {
+        if (!commitChanged) {
+            // The tag already contains the message
+            finishWriting(true, QString());
+        } else {
+            m_state = DiffWriteCommitting;
+            if (!writeBlock(image, m_commitAddress)) {
+                finishWriting(false, "Unable to write the length of the message");
+            }
+        }
+        return;
+    }
+
+    m_state = DiffWriteWriting;
+    // Step 1: mark the message as empty while the other blocks change
+    QByteArray emptyImage(image);
+    emptyImage[lengthAddress - TYPE2_DATA_ADDRESS] = 0x00;
+    if (memory.mid(commitOffset, TYPE2_BLOCK_SIZE) != emptyImage.mid(commitOffset, TYPE2_BLOCK_SIZE)) {
+        if (!writeBlock(emptyImage, m_commitAddress)) {
+            finishWriting(false, "Unable to write block " + QString::number(m_commitAddress / TYPE2_BLOCK_SIZE));
+            return;
+        }
+    }
+    // Step 2: all other blocks. Step 3 follows in requestCompleted().
+    for (int i = 0; i < changedBlocks.size(); i++) {
+        if (!writeBlock(image, changedBlocks.at(i))) {
+            finishWriting(false, "Unable to write block " + QString::number(changedBlocks.at(i) / TYPE2_BLOCK_SIZE));
+            return;
+        }
+    }
+}
+
+/*!
+  \brief Send the WRITE command for the block at the byte \a address,
+  with the contents of the block in \a image.
+  */
+bool NfcDiffWriter::writeBlock(const QByteArray &image, const int address)
+{
+    const int block = address / TYPE2_BLOCK_SIZE;
+    if (block > 0xFF) {
+        return false;
+    }
+    const QNearFieldTarget::RequestId id = m_target->writeBlock(block, image.mid(address - TYPE2_DATA_ADDRESS, TYPE2_BLOCK_SIZE));
+    if (!id.isValid()) {
+        return false;
+    }
+    m_pendingRequests.append(qMakePair(id, address));
+    m_diffRequests.append(id);
+    m_writtenBlocks++;
+    return true;
+}
+
+void NfcDiffWriter::finishWriting(const bool success, const QString &detail)
+{
+    const bool tagModified = (m_writtenBlocks > 0);
+    const int writtenBlocks = m_writtenBlocks;
+    const int totalBlocks = m_totalBlocks;
+    abort();
+    if (success) {
+        emit written(writtenBlocks, totalBlocks);
+    } else {
+        qDebug() << "Differential write failed:" << detail;
+        emit failed(detail, tagModified);
+    }
+}
@@ -0,0 +1,125 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NFCDIFFWRITER_H
+#define NFCDIFFWRITER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QPointer>
+#include <QDebug>
+#include <QNearFieldTarget>
+#include <QNearFieldTagType2>
+#include "nearfieldtargetinfo.h"
+#include "nfctargetanalyzer.h"
+#include "ndeftlvparser.h"
+
+// Type 2 WRITE command: one block of 4 bytes
+#define TYPE2_BLOCK_SIZE 4
+// Space for the Lock Control and Memory Control TLVs in front of the
+// NDEF message, read together with the message by the first request.
+#define DIFF_WRITE_CONTROL_TLV_SIZE 16
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Writes an NDEF message to a Type 2 tag by only writing the
+  blocks that differ from the current contents of the tag.
+
+  The writer first reads the data area up to the end of the new NDEF
+  message TLV with 16 byte READ commands and parses its TLVs. It then
+  builds the new memory contents through
+  NdefTlvParser::writeNdefMessage() and compares them block by block.
+
+  To keep the tag consistent if it's removed while writing, the
+  changed blocks are written in three steps:
+  -# the block with the length field of the NDEF message TLV, with
+  the length set to 0 (empty message)
+  -# all other changed blocks
+  -# the block with the length field, with the new length.
+  The last step is only sent once all other blocks have been written
+  successfully. Therefore, the tag either contains the old message
+  (if the first step didn't complete), an empty message or the
+  complete new message.
+
+  If nothing has been written to the tag yet when an error occurs,
+  failed() reports that the tag hasn't been modified, so that the
+  message can still be written through the generic NDEF access.
+  */
+class NfcDiffWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NfcDiffWriter(QObject *parent = 0);
+
+    static bool isSupported(QNearFieldTarget *target, const NearFieldTargetInfo &tagInfo);
+    bool write(QNearFieldTarget *target, const QByteArray &rawMessage, const NearFieldTargetInfo &tagInfo);
+    void abort();
+    bool isWriting() const;
+    bool isDiffWriterRequest(const QNearFieldTarget::RequestId &id) const;
+
+signals:
+    /*! \brief The message has been written. \a writtenBlocks out of
+      the \a totalBlocks blocks of the NDEF message TLV had to be written. */
+    void written(int writtenBlocks, int totalBlocks);
+    /*! \brief Writing failed. If \a tagModified is false, no write
+      command has been sent to the tag yet. */
+    void failed(const QString &detail, bool tagModified);
+
+private slots:
+    void requestCompleted(const QNearFieldTarget::RequestId &id);
+    void targetError(QNearFieldTarget::Error error, const QNearFieldTarget::RequestId &id);
+
+private:
+    enum DiffWriteState {
+        DiffWriteIdle,
+        DiffWriteReading,
+        DiffWriteWriting,
+        DiffWriteCommitting
+    };
+
+    bool readUpTo(const int endAddress);
+    void checkMemory();
+    void writeChangedBlocks(const QByteArray &memory, const QByteArray &image, const int lengthAddress);
+    bool writeBlock(const QByteArray &image, const int address);
+    void finishWriting(const bool success, const QString &detail);
+
+private:
+    /*! Target that the message is written to. Owned by NfcInfo. */
+    QPointer<QNearFieldTagType2> m_target;
+    QByteArray m_message;
+    NdefTlvParser m_parser;
+    DiffWriteState m_state;
+    /*! Address behind the last byte that has been requested so far. */
+    int m_readAddress;
+    int m_dataEnd;
+    /*! Requests that the target hasn't answered yet, with the byte
+      address of the first byte they read or write. */
+    QList<QPair<QNearFieldTarget::RequestId, int> > m_pendingRequests;
+    /*! All requests sent for the current message. */
+    QList<QNearFieldTarget::RequestId> m_diffRequests;
+    /*! Responses of the read requests, by their start address. */
+    QMap<int, QByteArray> m_responses;
+    /*! Final contents of the block with the length field, written last. */
+    QByteArray m_commitImage;
+    int m_commitAddress;
+    int m_writtenBlocks;
+    int m_totalBlocks;
+};
+
+#endif // NFCDIFFWRITER_H
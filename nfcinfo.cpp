@@ -21,16 +21,36 @@ NfcInfo::NfcInfo(QObject *parent) :
     m_cachedTarget(NULL),
     m_reportingLevel(AppSettings::OnlyImportantReporting),
     m_pendingWriteNdef(false),
+    m_writeAfterAnalysis(false),
     m_currentActivity(NfcUninitialized),
     m_writeOneTagOnly(true),
     m_cachedNdefMessage(NULL),
+    m_cachedNdefFile(NULL),
     m_cachedNdefMessageSize(0),
     m_cachedRequestType(NfcIdle),
     m_unlimitedAdvancedMsgs(true),
     m_harmattanPr10(false),
     m_usePeerToPeer(true),
-    m_nfcPeerToPeer(NULL)
+    m_nfcPeerToPeer(NULL),
+    m_peerToPeerFrameId(-1),
+    m_segmentLog(NULL),
+    m_dedupStore(NULL),
+    m_declarativeView(NULL)
 {
+    // Background thread for writing the logs of read tags
+    m_logWriter = new NfcLogWriter(this);
+    connect(m_logWriter, SIGNAL(writeError(QString)), this, SIGNAL(nfcStatusError(QString)));
+    m_tagCatalog = new NfcTagCatalog(this);
+    m_provisioningQueue = new NfcProvisioningQueue(this);
+    connect(m_provisioningQueue, SIGNAL(loaded(int,int)), this, SLOT(provisioningLoaded(int,int)));
+    connect(m_provisioningQueue, SIGNAL(loadError(QString)), this, SLOT(provisioningLoadError(QString)));
+    connect(m_provisioningQueue, SIGNAL(finished()), this, SLOT(provisioningFinished()));
+    m_writeVerifier = new NfcWriteVerifier(this);
+    connect(m_writeVerifier, SIGNAL(verified(bool,QString)), this, SLOT(writeVerified(bool,QString)));
+    m_diffWriter = new NfcDiffWriter(this);
+    connect(m_diffWriter, SIGNAL(written(int,int)), this, SLOT(diffWriteFinished(int,int)));
+    connect(m_diffWriter, SIGNAL(failed(QString,bool)), this, SLOT(diffWriteFailed(QString,bool)));
+
 #if defined(MEEGO_EDITION_HARMATTAN)
     // Determine Harmattan FW version
     // PR 1.0 doesn't support activating read and write NDEF access at the same time,
@@ -50,7 +70,12 @@ NfcInfo::NfcInfo(QObject *parent) :
 
     // Target analyzer and Ndef parser
     m_nfcTargetAnalyzer = new NfcTargetAnalyzer(this);
+    // Tag-type specific analysis results arrive after the generic info
+    connect(m_nfcTargetAnalyzer, SIGNAL(targetAnalyzed(QString)), this, SLOT(targetAnalyzed(QString)));
     m_nfcNdefParser = new NfcNdefParser(m_nfcRecordModel, this);
+    m_nfcNdefParser->setReportingLevel(m_reportingLevel);
+    m_nfcNdefParser->setLogWriter(m_logWriter);
+    m_nfcRecordModel->setLogWriter(m_logWriter);
 
     // Relay the signal when the private ndef parser found an image,
     // so that the QML UI can react to this.
@@ -62,6 +87,13 @@ NfcInfo::NfcInfo(QObject *parent) :
 
 NfcInfo::~NfcInfo() {
     delete m_cachedNdefMessage;
+    // The message might reference the mapped file
+    delete m_cachedNdefFile;
+    // Writes the index of the current log segment
+    delete m_segmentLog;
+    delete m_dedupStore;
+    // Finish writing all queued log files
+    m_logWriter->stop();
 }
 
 void NfcInfo::initAndStartNfcAsync()
@@ -154,6 +186,30 @@ NfcRecordModel * NfcInfo::recordModel() const
     return m_nfcRecordModel;
 }
 
+#ifdef USE_NFC_SIMULATOR
+/*!
+  \brief Additionally handle the targets of the \a simulator, exactly like
+  the targets found by the QNearFieldManager. LLCP targets are passed
+  on to the peer to peer handling.
+  */
+void NfcInfo::setSimulator(NfcSimulatedManager *simulator)
+{
+    connect(simulator, SIGNAL(targetLost(QNearFieldTarget*)),
+            this, SLOT(targetLost(QNearFieldTarget*)));
+    connect(simulator, SIGNAL(targetDetected(QNearFieldTarget*)),
+            this, SLOT(targetDetected(QNearFieldTarget*)));
+}
+#endif
+
+/*!
+  \brief Catalog of the collected messages, for searching the
+  logged tags.
+  */
+NfcTagCatalog * NfcInfo::tagCatalog() const
+{
+    return m_tagCatalog;
+}
+
 void NfcInfo::setUnlimitedAdvancedMsgs(const bool unlimited)
 {
     m_unlimitedAdvancedMsgs = unlimited;
@@ -261,6 +317,7 @@ void NfcInfo::targetDetected(QNearFieldTarget *target)
             this, SLOT(ndefMessageWritten()));
 
     m_currentActivity = NfcTargetAnalysis;
+    m_writeAfterAnalysis = false;
     // Cache the target in any case for future writing
     // (so that we can also write on tags that are empty as of now)
     m_cachedTarget = target;
@@ -274,7 +331,9 @@ void NfcInfo::targetDetected(QNearFieldTarget *target)
         emit nfcStatusUpdate("Target detected");
     }
 
-    // Analyze the target and send the info to the UI
+    // Analyze the target and send the info to the UI.
+    // Only returns the generic info - the tag-type specific analysis
+    // continues in the background, overlapping with reading / writing.
     emit nfcInfoUpdate(m_nfcTargetAnalyzer->analyzeTarget(target));
     m_currentActivity = NfcIdle;
 
@@ -328,7 +387,22 @@ void NfcInfo::targetDetected(QNearFieldTarget *target)
             if (m_harmattanPr10) {
                 m_nfcManager->setTargetAccessModes(QNearFieldManager::NdefWriteTargetAccess);
             }
-            writeCachedNdefMessage();
+            if (m_provisioningQueue->isActive() && !m_provisioningQueue->startTag(target->uid())) {
+                // Don't overwrite a tag that already got its message,
+                // e.g., when it is touched again or stays in the field
+                qDebug() << "Provisioning: tag" << target->uid().toHex() << "already provisioned";
+                emit nfcStatusError("Tag already provisioned - skipped.\nTouch the next tag to write message "
+                                    + QString::number(m_provisioningQueue->currentIndex() + 1));
+                stoppedTagInteraction();
+                return;
+            }
+            if (m_nfcTargetAnalyzer->isAnalyzing()) {
+                // Wait for the exact tag capacity, to avoid writing
+                // a message that doesn't fit
+                m_writeAfterAnalysis = true;
+            } else {
+                writeCachedNdefMessage();
+            }
         }
     } else if (accessMethods.testFlag(QNearFieldTarget::LlcpAccess) && m_usePeerToPeer) {
         // Establish peer to peer connection
@@ -346,6 +420,25 @@ void NfcInfo::targetDetected(QNearFieldTarget *target)
 
 }
 
+/*!
+  \brief Slot for the results of the tag-type specific analysis.
+
+  Shows the additional information and continues a write operation
+  that has been waiting for the analysis.
+  */
+void NfcInfo::targetAnalyzed(const QString &nfcInfo)
+{
+    if (!nfcInfo.isEmpty()) {
+        emit nfcInfoUpdate(nfcInfo);
+    }
+    if (m_writeAfterAnalysis) {
+        m_writeAfterAnalysis = false;
+        if (m_cachedTarget) {
+            writeCachedNdefMessage();
+        }
+    }
+}
+
 /*!
   \brief Slot needed for the registerNdefMessageHandler() method.
 
@@ -388,8 +481,40 @@ void NfcInfo::targetMessageDetected(const QNdefMessage &message, QNearFieldTarge
   */
 void NfcInfo::ndefMessageRead(const QNdefMessage &message)
 {
-    QString fileName = storeNdefToFile(QString(), message, true);
-    emit nfcTagContents(m_nfcNdefParser->parseNdefMessage(message), fileName);
+    // Serialize the message only once - logging and parsing both
+    // work directly on the raw bytes.
+    QElapsedTimer readToUiTimer;
+    readToUiTimer.start();
+    const QByteArray rawMessage = message.toByteArray();
+    QString fileName = storeNdefToFile(QString(), rawMessage, true);
+    if (!fileName.isEmpty()) {
+        if (m_tagCatalog->directory() != m_appSettings->logNdefDir(true)) {
+            m_tagCatalog->open(m_appSettings->logNdefDir(true));
+        }
+        m_tagCatalog->addMessage(fileName, rawMessage, m_nfcTargetAnalyzer->m_tagInfo.tagTypeName,
+                                 m_nfcTargetAnalyzer->m_tagInfo.tagUid);
+    }
+    emit nfcTagContents(message.isEmpty() ? m_nfcNdefParser->parseNdefMessage(message)
+                                          : m_nfcNdefParser->parseNdefMessage(rawMessage), fileName);
+#if QT_VERSION >= 0x040800
+    const qint64 readToUiNsecs = readToUiTimer.nsecsElapsed();
+#else
+    const qint64 readToUiNsecs = readToUiTimer.elapsed() * 1000000;
+#endif
+    // Separate measurements, to compare the latency with and
+    // without the background log writer
+    if (m_appSettings && m_appSettings->logNdefAsync()) {
+        m_readToUiAsyncLog.add(readToUiNsecs);
+    } else {
+        m_readToUiSyncLog.add(readToUiNsecs);
+    }
+    if (m_reportingLevel == AppSettings::DebugReporting) {
+        qDebug() << "Record parse statistics:\n" << m_nfcNdefParser->recordParseStatistics();
+        qDebug() << "Read to UI latency, background log writer: " << m_readToUiAsyncLog.toString();
+        qDebug() << "Read to UI latency, direct log writing: " << m_readToUiSyncLog.toString();
+        qDebug() << "Log writer: " << m_logWriter->writtenCount() << " files written, "
+                 << m_logWriter->syncCount() << " syncs, " << m_logWriter->rejectedCount() << " rejected";
+    }
     stoppedTagInteraction();
 }
 
@@ -404,44 +529,61 @@ void NfcInfo::ndefMessageRead(const QNdefMessage &message)
   extension already. If an empty QString is passed ("QString()"), a default
   file name will be created, based on the current date, time and (if available)
   the tag type.
-  \param message the NDEF message to store as raw byte array in the file.
+  \param rawMessage the raw NDEF message to store in the file.
   \param collected influences the sub directory of the data directory.
   If set to true, it will go to the collected subdirectory for
   auto-collected/saved tags. If set to true, it will go to the subdirectory
   for manually saved messages.
+  \return the file name, or the frame reference if the message has been
+  appended to the segment log.
   */
-QString NfcInfo::storeNdefToFile(const QString& fileName, const QNdefMessage &message, const bool collected)
+QString NfcInfo::storeNdefToFile(const QString& fileName, const QByteArray &rawMessage, const bool collected)
 {
     QString fullFileName = "";
     if (m_appSettings && m_appSettings->logNdefToFile()) {
+        if (collected && fileName.isEmpty() && m_appSettings->logNdefDedup()) {
+            return storeNdefToDedupStore(rawMessage);
+        }
+        if (collected && fileName.isEmpty() && m_appSettings->logNdefSegmented()) {
+            return storeNdefToSegmentLog(rawMessage);
+        }
         // Store tag contents to the log file if enabled
         const QString writeDir = m_appSettings->logNdefDir(collected);
+        QString logFileName;
+        if (fileName.isEmpty()) {
+            // Generate file name
+            QDateTime now = QDateTime::currentDateTime();
+            logFileName = now.toString("yyyy.MM.dd - hh.mm.ss");
+            if (!m_nfcTargetAnalyzer->m_tagInfo.tagTypeName.isEmpty()) {
+                logFileName.append(" - ");
+                logFileName.append(m_nfcTargetAnalyzer->m_tagInfo.tagTypeName);
+            }
+            logFileName.append(".txt");
+        } else {
+            logFileName = fileName;
+            if (logFileName.right(4).toLower() != ".txt") {
+                logFileName.append(".txt");
+            }
+        }
+        // Opening the file for writing truncates it
+        detachCachedNdefFile(writeDir + logFileName);
+        if (collected && m_appSettings->logNdefAsync() &&
+                m_logWriter->enqueue(writeDir + logFileName, rawMessage)) {
+            // Written on the background thread - the read path doesn't
+            // wait for the storage. If the queue is full, write directly.
+            return writeDir + logFileName;
+        }
         QDir dir("/");
         dir.mkpath(writeDir);
         if (QDir::setCurrent(writeDir)) {
-            if (fileName.isEmpty()) {
-                // Generate file name
-                QDateTime now = QDateTime::currentDateTime();
-                fullFileName = now.toString("yyyy.MM.dd - hh.mm.ss");
-                if (!m_nfcTargetAnalyzer->m_tagInfo.tagTypeName.isEmpty()) {
-                    fullFileName.append(" - ");
-                    fullFileName.append(m_nfcTargetAnalyzer->m_tagInfo.tagTypeName);
-                }
-                fullFileName.append(".txt");
-            } else {
-                fullFileName = fileName;
-                if (fullFileName.right(4).toLower() != ".txt") {
-                    fullFileName.append(".txt");
-                }
-            }
-            QFile tagFile(fullFileName);
+            QFile tagFile(logFileName);
             if (tagFile.open(QIODevice::WriteOnly)) {
-                tagFile.write(message.toByteArray());
+                tagFile.write(rawMessage);
                 tagFile.close();
             } else {
                 qDebug() << "Unable to open file for writing: " << tagFile.fileName();
             }
-            fullFileName = writeDir + fullFileName;
+            fullFileName = writeDir + logFileName;
         } else {
             emit nfcStatusError("Unable to open data directory (" + writeDir + ") - please check the application settings");
             qDebug() << "Unable to set current directory to: " << writeDir;
@@ -450,6 +592,115 @@ QString NfcInfo::storeNdefToFile(const QString& fileName, const QNdefMessage &me
     return fullFileName;
 }
 
+/*!
+  \brief Release the mapping of the message cached for writing if it
+  has been loaded from \a fileName, which is about to be overwritten.
+
+  Truncating a mapped file invalidates the mapped pages (SIGBUS when
+  accessing them on Linux), or fails on Symbian and Windows. The
+  payloads of the cached message are copied first.
+  */
+void NfcInfo::detachCachedNdefFile(const QString &fileName)
+{
+    if (!m_cachedNdefFile || QFileInfo(m_cachedNdefFile->fileName()) != QFileInfo(fileName)) {
+        return;
+    }
+    if (m_cachedNdefMessage) {
+        // Serializing copies the payloads out of the mapped region
+        QNdefMessage *detachedMessage = new QNdefMessage(QNdefMessage::fromByteArray(m_cachedNdefMessage->toByteArray()));
+        delete m_cachedNdefMessage;
+        m_cachedNdefMessage = detachedMessage;
+    }
+    delete m_cachedNdefFile;
+    m_cachedNdefFile = NULL;
+}
+
+/*!
+  \brief Append a collected raw NDEF message to the segment log, instead
+  of storing it to a file of its own.
+
+  Avoids creating the directory and a new file for every read tag,
+  the message is written with a single write call.
+
+  \return reference to the frame in the log, which can be passed to
+  loadNdefFromFile().
+  */
+QString NfcInfo::storeNdefToSegmentLog(const QByteArray &rawMessage)
+{
+    const QString writeDir = m_appSettings->logNdefDir(true);
+    if (!m_segmentLog) {
+        m_segmentLog = new NdefSegmentLog();
+    }
+    if (m_segmentLog->directory() != writeDir && !m_segmentLog->open(writeDir)) {
+        emit nfcStatusError("Unable to open data directory (" + writeDir + ") - please check the application settings");
+        return QString();
+    }
+    const int frameIndex = m_segmentLog->append(rawMessage, m_nfcTargetAnalyzer->m_tagInfo.tagTypeName);
+    if (frameIndex < 0) {
+        emit nfcStatusError(m_segmentLog->errorString());
+        return QString();
+    }
+    return NdefSegmentLog::frameReference(m_segmentLog->currentSegmentFileName(), frameIndex);
+}
+
+/*!
+  \brief Store a collected raw NDEF message to the deduplicating store.
+
+  If the same message has been read before, only the time and the
+  UID of the tag are recorded, instead of writing another copy.
+  Reads older than the retention time of the settings are removed
+  when the store is opened and then at most once an hour.
+
+  \return file name of the stored message.
+  */
+QString NfcInfo::storeNdefToDedupStore(const QByteArray &rawMessage)
+{
+    const QString writeDir = m_appSettings->logNdefDir(true) + NDEF_DEDUP_SUBDIR;
+    if (!m_dedupStore) {
+        m_dedupStore = new NdefDedupStore();
+    }
+    if (m_dedupStore->directory() != QDir(writeDir).absolutePath() + "/") {
+        if (!m_dedupStore->open(writeDir)) {
+            emit nfcStatusError("Unable to open data directory (" + writeDir + ") - please check the application settings");
+            return QString();
+        }
+        // Remove messages left over from an interrupted read
+        m_dedupStore->collectGarbage();
+        m_dedupExpiredTime = QDateTime();
+    }
+    if (!m_dedupExpiredTime.isValid() ||
+            m_dedupExpiredTime.secsTo(QDateTime::currentDateTime()) >= NDEF_DEDUP_EXPIRE_INTERVAL_SECS) {
+        expireDedupReads();
+    }
+    const QString fileName = m_dedupStore->append(rawMessage, m_nfcTargetAnalyzer->m_tagInfo.tagUid);
+    if (fileName.isEmpty()) {
+        emit nfcStatusError(m_dedupStore->errorString());
+    } else if (m_reportingLevel == AppSettings::DebugReporting) {
+        qDebug() << "Dedup store: " << m_dedupStore->messageCount() << " messages for "
+                 << m_dedupStore->readCount() << " reads, " << m_dedupStore->savedBytes() << " bytes saved";
+    }
+    return fileName;
+}
+
+/*!
+  \brief Remove the reads that are older than the retention time of the
+  settings from the dedup store, and the messages only they refer to.
+  */
+void NfcInfo::expireDedupReads()
+{
+    m_dedupExpiredTime = QDateTime::currentDateTime();
+    const int retentionDays = m_appSettings->logNdefDedupRetentionDays();
+    if (retentionDays <= 0) {
+        return;
+    }
+    const int deleted = m_dedupStore->removeReadsBefore(m_dedupExpiredTime.addDays(-retentionDays));
+    if (deleted < 0) {
+        qDebug() << "Unable to remove expired reads:" << m_dedupStore->errorString();
+    } else if (deleted > 0) {
+        qDebug() << "Dedup store: removed" << deleted << "expired messages";
+    }
+}
+
 /*!
   \brief Create the message for writing to the tag and attempt
   to write it.
@@ -467,6 +718,8 @@ QString NfcInfo::storeNdefToFile(const QString& fileName, const QNdefMessage &me
   */
 bool NfcInfo::nfcWriteTag(const bool writeOneTagOnly)
 {
+    // The message replaces the messages of the provisioning queue
+    m_provisioningQueue->stop();
     // Convert the model into a NDEF message
     QNdefMessage* message = recordModel()->convertToNdefMessage();
     m_cachedNdefContainsAdvMsg = recordModel()->containsAdvMsg();
@@ -483,7 +736,10 @@ bool NfcInfo::nfcWriteTag(const bool writeOneTagOnly)
     // Write the message (containing either a URL or plain text) to the target.
     if (m_cachedNdefMessage) { delete m_cachedNdefMessage; }
     m_cachedNdefMessage = message;
-    m_cachedNdefMessageSize = m_cachedNdefMessage->toByteArray().size();
+    m_cachedNdefMessageSize = rawMessage.size();
+    // The new message doesn't reference a mapped file
+    delete m_cachedNdefFile;
+    m_cachedNdefFile = NULL;
     m_pendingWriteNdef = true;
     m_writeOneTagOnly = writeOneTagOnly;
     return writeCachedNdefMessage();
@@ -516,12 +772,18 @@ bool NfcInfo::nfcWriteTag(const bool writeOneTagOnly)
   */
 bool NfcInfo::nfcWriteTag(const QString& fileName, const bool writeOneTagOnly)
 {
-    QNdefMessage message = loadNdefFromFile(fileName);
+    // Keep the file mapped while the message is cached for writing.
+    // Use a new mapping, as the currently cached message might still
+    // reference the previous one.
+    NdefMappedFile *mappedFile = new NdefMappedFile();
+    QNdefMessage message = loadNdefFromFile(fileName, *mappedFile);
     if (message.isEmpty()) {
         // Error while loading from the file - don't switch to writing mode.
         // Error info has already been emitted by loading method.
+        delete mappedFile;
         return false;
     }
+    m_provisioningQueue->stop();
 
     // Set to writing mode
     emit nfcModeChanged(NfcTypes::nfcWriting);
@@ -532,7 +794,12 @@ bool NfcInfo::nfcWriteTag(const QString& fileName, const bool writeOneTagOnly)
     // Write the message (containing either a URL or plain text) to the target.
     if (m_cachedNdefMessage) { delete m_cachedNdefMessage; }
     m_cachedNdefMessage = new QNdefMessage(message);
-    m_cachedNdefMessageSize = m_cachedNdefMessage->toByteArray().size();
+    // Only serialize the message again if it hasn't been mapped
+    // from a file (e.g., a frame of the segment log).
+    m_cachedNdefMessageSize = mappedFile->isOpen() ? mappedFile->messageSize()
+                                                   : m_cachedNdefMessage->toByteArray().size();
+    delete m_cachedNdefFile;
+    m_cachedNdefFile = mappedFile;
     m_pendingWriteNdef = true;
     m_writeOneTagOnly = writeOneTagOnly;
 
@@ -548,22 +815,32 @@ bool NfcInfo::nfcWriteTag(const QString& fileName, const bool writeOneTagOnly)
   */
 bool NfcInfo::nfcEditTag(const QString& fileName)
 {
-    QNdefMessage message = loadNdefFromFile(fileName);
+    NdefMappedFile mappedFile;
+    QNdefMessage message = loadNdefFromFile(fileName, mappedFile);
     if (message.isEmpty()) {
         // Error while loading from the file - don't switch to writing mode.
         // Error info has already been emitted by loading method.
         return false;
     }
-    // Parse contents of the message into the record model
+    // Parse contents of the message into the record model.
+    // The record model copies all contents, so the mapping
+    // can be released afterwards.
     m_nfcNdefParser->setParseToModel(true);
-    m_nfcNdefParser->parseNdefMessage(message);
+    if (mappedFile.isOpen()) {
+        // Decode directly from the mapped file
+        m_nfcNdefParser->parseNdefMessage(mappedFile.rawMessage());
+    } else {
+        m_nfcNdefParser->parseNdefMessage(message);
+    }
     m_nfcNdefParser->setParseToModel(false);
     return true;
 }
 
 QString NfcInfo::nfcSaveModelToFile(const QString &fileName)
 {
-    QString savedFileName = storeNdefToFile(fileName, *m_nfcRecordModel->convertToNdefMessage(), false);
+    QNdefMessage* message = m_nfcRecordModel->convertToNdefMessage();
+    QString savedFileName = storeNdefToFile(fileName, message->toByteArray(), false);
+    delete message;
     if (!savedFileName.isEmpty()) {
         emit nfcStatusSuccess("Stored NDEF message to " + savedFileName);
     } else {
@@ -572,41 +849,73 @@ QString NfcInfo::nfcSaveModelToFile(const QString &fileName)
     return savedFileName;
 }
 
-QNdefMessage NfcInfo::loadNdefFromFile(const QString& fileName)
+/*!
+  \brief Load the NDEF message stored in the file, or in the frame of the
+  segment log referenced by \a fileName.
+
+  Files are memory-mapped through \a mappedFile, and the payloads of
+  the records of the returned message reference the mapping. Therefore,
+  \a mappedFile has to stay open for as long as the message is used.
+  Frames of the segment log are copied, \a mappedFile is not opened
+  in this case.
+  */
+QNdefMessage NfcInfo::loadNdefFromFile(const QString& fileName, NdefMappedFile &mappedFile)
 {
     qDebug() << "Load tag: " << fileName;
     if (fileName.isEmpty()) {
         emit nfcTagWriteError("No file name specified");
         return QNdefMessage();
     }
-    // Load the NDEF message from the specified file name
-    QFile tagFile(fileName);
-    if (!tagFile.open(QIODevice::ReadOnly)) {
-        emit nfcTagWriteError("Unable to open file: " + fileName);
-        return QNdefMessage();
+    QString segmentFileName;
+    int frameIndex;
+    if (NdefSegmentLog::parseFrameReference(fileName, segmentFileName, frameIndex)) {
+        return loadNdefFromSegmentLog(segmentFileName, frameIndex);
     }
-    QByteArray rawMessage = tagFile.readAll();
-    tagFile.close();
-    if (rawMessage.isEmpty()) {
-        // Check if reading the file was successful
-        emit nfcTagWriteError("Unable to load file: " + fileName);
+    // A collected message might still be written in the background
+    m_logWriter->waitForPath(fileName);
+    // Map the file and create the records directly from the mapped region
+    if (!mappedFile.open(fileName)) {
+        emit nfcTagWriteError(mappedFile.errorString());
         return QNdefMessage();
     }
-    emit nfcStatusUpdate("Loaded message (size: " + QString::number(rawMessage.size()) + " bytes)");
-    QNdefMessage message = QNdefMessage::fromByteArray(rawMessage);
+    QNdefMessage message = mappedFile.message();
     if (message.isEmpty()) {
         // Unable to create an NDEF message from the file
+        mappedFile.close();
         emit nfcTagWriteError("Unable to create NDEF message from file: " + fileName);
         return QNdefMessage();
     }
+    emit nfcStatusUpdate("Loaded message (size: " + QString::number(mappedFile.size()) + " bytes)");
     return message;
 }
 
+/*!
+  \brief Load the NDEF message stored in the frame \a frameIndex of
+  the segment log file.
+  */
+QNdefMessage NfcInfo::loadNdefFromSegmentLog(const QString &segmentFileName, const int frameIndex)
+{
+    NdefSegmentReader reader;
+    NdefLogFrame frame;
+    if (!reader.open(segmentFileName) || !reader.readFrame(frameIndex, frame)) {
+        emit nfcTagWriteError("Unable to load message from log: " + reader.errorString());
+        return QNdefMessage();
+    }
+    NdefStreamDecoder decoder;
+    if (!decoder.feed(frame.rawMessage) || decoder.messageCount() == 0) {
+        emit nfcTagWriteError("Unable to create NDEF message from log: " + segmentFileName);
+        return QNdefMessage();
+    }
+    emit nfcStatusUpdate("Loaded message (size: " + QString::number(decoder.lastMessageSize()) + " bytes)");
+    return decoder.lastMessage();
+}
+
 /*!
   \brief Stop waiting to write a tag, and switch back to reading mode.
   */
 void NfcInfo::nfcStopWritingTags()
 {
+    m_provisioningQueue->stop();
     m_pendingWriteNdef = false;
     m_writeOneTagOnly = false;
     emit nfcModeChanged(NfcTypes::nfcReading);
@@ -615,6 +924,198 @@ void NfcInfo::nfcStopWritingTags()
     }
 }
 
+/*!
+  \brief Write a different message to each touched tag, taken from the
+  provisioning queue file \a fileName.
+
+  See NfcProvisioningQueue for the file format. The messages are built
+  on a background thread; writing starts once they are available.
+  Each message is read back after writing it, and the results are
+  logged next to the queue file. Loading the same file again resumes
+  with the first message that hasn't been written yet.
+
+  \return false if another queue file is still being loaded.
+  */
+bool NfcInfo::nfcStartProvisioning(const QString &fileName)
+{
+    if (!m_provisioningQueue->load(fileName)) {
+        emit nfcStatusError("Still loading the previous provisioning queue");
+        return false;
+    }
+    emit nfcStatusUpdate("Loading provisioning queue...");
+    return true;
+}
+
+/*!
+  \brief Stop writing the messages of the provisioning queue.
+  */
+void NfcInfo::nfcStopProvisioning()
+{
+    if (m_provisioningQueue->isActive()) {
+        emit nfcStatusUpdate("Provisioning stopped: " + m_provisioningQueue->statisticsToString());
+    }
+    nfcStopWritingTags();
+}
+
+void NfcInfo::provisioningLoaded(const int count, const int remaining)
+{
+    emit nfcStatusSuccess("Loaded provisioning queue: " + QString::number(count) + " messages, "
+                          + QString::number(remaining) + " remaining");
+    if (!m_provisioningQueue->isActive()) {
+        // All messages have already been written in previous sessions
+        return;
+    }
+    cacheProvisioningMessage();
+    m_cachedNdefContainsAdvMsg = false;
+    emit nfcModeChanged(NfcTypes::nfcWriting);
+    if (m_harmattanPr10) {
+        m_nfcManager->setTargetAccessModes(QNearFieldManager::NdefWriteTargetAccess);
+    }
+    m_pendingWriteNdef = true;
+    // The flag is inverted compared to its name: writeCachedNdefMessage()
+    // only leaves writing mode after a tag if m_writeOneTagOnly is false.
+    // Setting it to true keeps writing mode active for all tags of the
+    // provisioning queue.
+    m_writeOneTagOnly = true;
+    emit nfcStatusUpdate("Touch the first tag to write");
+}
+
+void NfcInfo::provisioningLoadError(const QString &errorMessage)
+{
+    emit nfcStatusError("Unable to load provisioning queue:\n" + errorMessage);
+}
+
+/*!
+  \brief All messages of the provisioning queue have been written.
+  */
+void NfcInfo::provisioningFinished()
+{
+    emit nfcStatusSuccess("Provisioning finished: " + m_provisioningQueue->statisticsToString());
+    if (m_pendingWriteNdef) {
+        nfcStopWritingTags();
+    }
+}
+
+/*!
+  \brief Make the current message of the provisioning queue the
+  cached message for writing.
+  */
+void NfcInfo::cacheProvisioningMessage()
+{
+    delete m_cachedNdefMessage;
+    m_cachedNdefMessage = new QNdefMessage(m_provisioningQueue->currentMessage());
+    m_cachedNdefMessageSize = m_provisioningQueue->currentRawMessage().size();
+    delete m_cachedNdefFile;
+    m_cachedNdefFile = NULL;
+}
+
+/*!
+  \brief Read back the message that has just been written to the
+  tag, while the tag is still present. The result is handled by
+  writeVerified().
+  */
+void NfcInfo::verifyWrittenMessage()
+{
+    startedTagInteraction();
+    m_currentActivity = NfcNdefVerifying;
+    m_cachedRequestType = NfcNdefVerifying;
+    emit nfcStatusUpdate("Verifying the written message");
+    if (!m_writeVerifier->verify(m_cachedTarget, m_writtenRawMessage, m_nfcTargetAnalyzer->m_tagInfo)) {
+        writeVerified(false, "Unable to read back the message");
+    }
+}
+
+void NfcInfo::writeVerified(const bool success, const QString &detail)
+{
+    if (m_cachedRequestType != NfcNdefVerifying) {
+        return;
+    }
+    m_cachedRequestType = NfcIdle;
+    m_currentActivity = NfcIdle;
+    if (m_provisioningQueue->isActive()) {
+        finishProvisionedTag(success, detail);
+    } else if (success) {
+        emit nfcStatusSuccess("Message verified (" + QString::number(m_writeVerifier->lastVerifyMsecs()) + " ms)");
+        if (m_reportingLevel == AppSettings::DebugReporting) {
+            qDebug() << m_writeVerifier->statisticsToString();
+        }
+        finishWrittenTag();
+        return;
+    } else {
+        emit nfcTagWriteError("Verification failed: " + detail);
+    }
+    stoppedTagInteraction();
+}
+
+/*!
+  \brief All changed blocks of the message have been written by the
+  NfcDiffWriter. Continues like after writing the complete message.
+  */
+void NfcInfo::diffWriteFinished(const int writtenBlocks, const int totalBlocks)
+{
+    if (m_cachedRequestType != NfcNdefWriting) {
+        return;
+    }
+    m_cachedRequestType = NfcIdle;
+    if (!m_pendingWriteNdef) {
+        m_currentActivity = NfcIdle;
+    }
+    emit nfcStatusSuccess("Wrote " + QString::number(writtenBlocks) + " of "
+                          + QString::number(totalBlocks) + " blocks");
+    ndefMessageWritten();
+}
+
+/*!
+  \brief The NfcDiffWriter couldn't write the message. If the tag
+  hasn't been modified yet, write the complete message instead.
+  */
+void NfcInfo::diffWriteFailed(const QString &detail, const bool tagModified)
+{
+    if (m_cachedRequestType != NfcNdefWriting) {
+        return;
+    }
+    if (!tagModified && m_cachedTarget) {
+        emit nfcStatusUpdate("Writing the complete message (" + detail + ")");
+        m_cachedRequestId = m_cachedTarget->writeNdefMessages(
+                    QList<QNdefMessage>() << QNdefMessage::fromByteArray(m_writtenRawMessage));
+        return;
+    }
+    m_cachedRequestType = NfcIdle;
+    if (!m_pendingWriteNdef) {
+        m_currentActivity = NfcIdle;
+    }
+    // The tag might contain an empty message now
+    m_nfcTargetAnalyzer->profileCache()->invalidate(m_nfcTargetAnalyzer->m_tagInfo.tagUid);
+    if (m_provisioningQueue->isActive()) {
+        m_provisioningQueue->reportResult(m_nfcTargetAnalyzer->m_tagInfo.tagUid, false, detail);
+    }
+    emit nfcTagWriteError("Unable to write message: " + detail);
+    stoppedTagInteraction();
+}
+
+/*!
+  \brief Log the result of the current tag in the provisioning queue
+  and prepare the message for the next tag.
+  */
+void NfcInfo::finishProvisionedTag(const bool success, const QString &detail)
+{
+    const int index = m_provisioningQueue->currentIndex();
+    m_provisioningQueue->reportResult(m_nfcTargetAnalyzer->m_tagInfo.tagUid, success, detail);
+    if (!success) {
+        emit nfcTagWriteError("Provisioning message " + QString::number(index + 1) + " failed: "
+                              + detail + "\n\nTouch a tag to write it again.");
+        return;
+    }
+    emit nfcTagWritten();
+    emit nfcStatusSuccess("Provisioned message " + QString::number(index + 1) + " ("
+                          + QString::number(m_provisioningQueue->tagsPerMinute(), 'f', 1) + " tags/min)");
+    if (m_provisioningQueue->isActive()) {
+        cacheProvisioningMessage();
+        emit nfcStatusUpdate("Touch the next tag to write message " + QString::number(m_provisioningQueue->currentIndex() + 1)
+                             + " (" + QString::number(m_provisioningQueue->remainingCount()) + " remaining)");
+    }
+}
+
 /*!
   \brief Attempt to write the currently cached message to the tag.
 
@@ -650,22 +1151,50 @@ bool NfcInfo::writeCachedNdefMessage()
         } else {
             if (m_cachedTarget)
             {
-                // Check target access mode
-                QNearFieldManager::TargetAccessModes accessModes = m_nfcManager->targetAccessModes();
+                // Check target access mode. Without the NFC manager,
+                // targets only come from the simulator, which allows all access.
+                QNearFieldManager::TargetAccessModes accessModes = m_nfcManager ? m_nfcManager->targetAccessModes()
+                    : QNearFieldManager::NdefReadTargetAccess | QNearFieldManager::NdefWriteTargetAccess | QNearFieldManager::TagTypeSpecificTargetAccess;
+                // Message for this tag - might get shrunk to fit
+                QNdefMessage messageToWrite(*m_cachedNdefMessage);
                 // Writing access is active - we should be able to write
                 if (m_cachedTarget->accessMethods().testFlag(QNearFieldTarget::LlcpAccess) &&
                         m_usePeerToPeer && m_nfcPeerToPeer)
                 {
                     // -----------------------------------------------------
                     // Peer to peer (SNEP)
-                    m_nfcPeerToPeer->sendNdefMessage(m_cachedNdefMessage);
+                    if (!m_nfcPeerToPeer->isFrameQueued(m_peerToPeerFrameId)) {
+                        m_peerToPeerFrameId = m_nfcPeerToPeer->enqueueNdefMessage(m_cachedNdefMessage, NfcPeerToPeer::NormalSendPriority);
+                    }
+                }
+                else if (accessModes.testFlag(QNearFieldManager::NdefWriteTargetAccess) &&
+                         !fitMessageToTag(messageToWrite))
+                {
+                    // -----------------------------------------------------
+                    // Message is known to be too large for the tag -
+                    // don't attempt to write it (error already emitted).
+                    // Writing stays active for the next tag.
+                    if (m_provisioningQueue->isActive()) {
+                        m_provisioningQueue->reportResult(m_nfcTargetAnalyzer->m_tagInfo.tagUid, false, "Message too large for the tag");
+                    }
                 }
                 else if (accessModes.testFlag(QNearFieldManager::NdefWriteTargetAccess))
                 {
                     // -----------------------------------------------------
                     // NDEF Access
                     m_currentActivity = NfcNdefWriting;
-                    if (m_appSettings->deleteTagBeforeWriting() && m_cachedRequestType != NfcNdefDeleting) {
+                    if (m_appSettings->diffWrites() &&
+                            NfcDiffWriter::isSupported(m_cachedTarget, m_nfcTargetAnalyzer->m_tagInfo) &&
+                            m_diffWriter->write(m_cachedTarget, messageToWrite.toByteArray(), m_nfcTargetAnalyzer->m_tagInfo)) {
+                        // Only write the blocks that differ from the current
+                        // contents - no need to delete the message first, the
+                        // length of the message is cleared while writing.
+                        // Finished in diffWriteFinished() / diffWriteFailed().
+                        m_cachedRequestType = NfcNdefWriting;
+                        m_cachedRequestId = QNearFieldTarget::RequestId();
+                        m_writtenRawMessage = messageToWrite.toByteArray();
+                        emit nfcStatusUpdate("Writing changed blocks to the tag");
+                    } else if (m_appSettings->deleteTagBeforeWriting() && m_cachedRequestType != NfcNdefDeleting) {
                         // Write an empty message first
                         m_cachedRequestType = NfcNdefDeleting;
                         emit nfcStatusUpdate("Writing empty message to the tag");
@@ -673,12 +1202,13 @@ bool NfcInfo::writeCachedNdefMessage()
                         // formatting is also done like this.
                         m_cachedRequestId = m_cachedTarget->writeNdefMessages(QList<QNdefMessage>() << (QNdefMessage()));
                     } else {
-                        qDebug() << "Writing message: " << m_cachedNdefMessage->toByteArray();
+                        qDebug() << "Writing message: " << messageToWrite.toByteArray();
                         // Either the empty message was already written, or
                         // configuration is not set to delete the message first.
                         m_cachedRequestType = NfcNdefWriting;
+                        m_writtenRawMessage = messageToWrite.toByteArray();
                         emit nfcStatusUpdate("Writing message to the tag");
-                        m_cachedRequestId = m_cachedTarget->writeNdefMessages(QList<QNdefMessage>() << (*m_cachedNdefMessage));
+                        m_cachedRequestId = m_cachedTarget->writeNdefMessages(QList<QNdefMessage>() << messageToWrite);
                     }
                     success = true;
                     if (!m_writeOneTagOnly && m_cachedRequestType != NfcNdefDeleting) {
@@ -751,6 +1281,51 @@ void NfcInfo::applySettings()
     if (m_nfcPeerToPeer) {
         m_nfcPeerToPeer->applySettings();
     }
+    applyTagProfileSettings();
+}
+
+/*!
+  \brief Store the profiles of analyzed tags in the log directory if
+  enabled in the settings, or only keep them in memory otherwise.
+  */
+void NfcInfo::applyTagProfileSettings()
+{
+    QString profileFileName;
+    if (m_appSettings->persistTagProfiles() && QDir().mkpath(m_appSettings->logNdefDir())) {
+        profileFileName = QDir(m_appSettings->logNdefDir()).filePath(NFC_PROFILE_CACHE_FILE_NAME);
+    }
+    m_nfcTargetAnalyzer->profileCache()->setPersistentFile(profileFileName);
+}
+
+/*!
+  \brief Pre-flight check if the \a message fits on the current tag,
+  based on the results of the NfcTargetAnalyzer.
+
+  If the message is too large and shrinking is enabled in the settings,
+  the \a message is reduced with the NdefMessageShrinker. The cached
+  message isn't modified, so that larger tags still get the complete
+  message.
+
+  \return false if the message is known to be too large for the tag.
+  In this case, the nfcTagWriteError() signal has been emitted.
+  */
+bool NfcInfo::fitMessageToTag(QNdefMessage &message)
+{
+    const int maxMessageSize = m_nfcTargetAnalyzer->m_tagInfo.maxNdefMessageSize();
+    if (maxMessageSize < 0 || m_cachedNdefMessageSize <= maxMessageSize) {
+        return true;
+    }
+    if (m_appSettings->shrinkMessagesToFit()) {
+        NdefMessageShrinker shrinker;
+        if (shrinker.shrink(message, maxMessageSize)) {
+            emit nfcStatusUpdate("Shrunk message to " + QString::number(message.toByteArray().size())
+                                 + " bytes to fit the tag: " + shrinker.changes().join(", "));
+            return true;
+        }
+        qDebug() << "Unable to shrink the message enough:" << shrinker.changes();
+    }
+    emit nfcTagWriteError("Message (" + QString::number(m_cachedNdefMessageSize) + " bytes) is too large for the tag (" + QString::number(maxMessageSize) + " bytes available).");
+    return false;
 }
 
 /*!
@@ -762,7 +1337,17 @@ void NfcInfo::targetLost(QNearFieldTarget *target)
     if (m_nfcPeerToPeer) {
         m_nfcPeerToPeer->targetLost(target);
     }
+    if (m_diffWriter->isWriting()) {
+        m_diffWriter->abort();
+        m_cachedRequestType = NfcIdle;
+    }
+    if (m_cachedRequestType == NfcNdefVerifying) {
+        m_writeVerifier->abort();
+        writeVerified(false, "Target lost before the message was verified");
+    }
     m_cachedTarget = NULL;
+    m_writeAfterAnalysis = false;
+    m_writtenRawMessage.clear();
     target->deleteLater();
     stoppedTagInteraction();
     emit nfcStatusUpdate("Target lost");
@@ -788,6 +1373,8 @@ void NfcInfo::targetError(QNearFieldTarget::Error error, const QNearFieldTarget:
         emit nfcTagWriteError(errorText);
     } else if (id == m_cachedRequestId && m_cachedRequestType == NfcNdefWriting) {
         m_cachedRequestType = NfcIdle;
+        // The failed write might still have modified the tag
+        m_nfcTargetAnalyzer->profileCache()->invalidate(m_nfcTargetAnalyzer->m_tagInfo.tagUid);
         if (!m_pendingWriteNdef) {
             m_currentActivity = NfcIdle;
         }
@@ -836,6 +1423,9 @@ void NfcInfo::targetError(QNearFieldTarget::Error error, const QNearFieldTarget:
                 errorText.append("\n\nMessage (" + QString::number(m_cachedNdefMessageSize) + " bytes) plus control data might be too large for the " + m_nfcTargetAnalyzer->convertTagTypeToString(m_cachedTarget->type()) + " target?");
             }
         }
+        if (m_provisioningQueue->isActive()) {
+            m_provisioningQueue->reportResult(m_nfcTargetAnalyzer->m_tagInfo.tagUid, false, errorText);
+        }
         emit nfcTagWriteError(errorText);
         stoppedTagInteraction();
     } else if (id == m_cachedRequestId && m_cachedRequestType == NfcNdefReading) {
@@ -849,7 +1439,10 @@ void NfcInfo::targetError(QNearFieldTarget::Error error, const QNearFieldTarget:
         // The analysis part will correctly handle those cases, no need to spam the user
         // with error messages.
         if (m_reportingLevel == AppSettings::FullReporting ||
-                (error != QNearFieldTarget::InvalidParametersError &&
+                (!m_nfcTargetAnalyzer->isAnalyzerRequest(id) &&
+                 !m_writeVerifier->isVerifierRequest(id) &&
+                 !m_diffWriter->isDiffWriterRequest(id) &&
+                 error != QNearFieldTarget::InvalidParametersError &&
                  error != QNearFieldTarget::UnsupportedError)) {
             emit nfcTagError(errorText);
         }
@@ -897,6 +1490,13 @@ void NfcInfo::requestCompleted(const QNearFieldTarget::RequestId &id)
             noStatusChange = true;
             break; }
 
+        case NfcNdefVerifying: {
+            // The write request might be completed after
+            // ndefMessageWritten(); the result of the verification
+            // is handled by writeVerified().
+            noStatusChange = true;
+            break; }
+
         case NfcNdefWriting: {
             message = "Write request completed.";
             if (m_pendingWriteNdef) {
@@ -957,12 +1557,7 @@ void NfcInfo::requestCompleted(const QNearFieldTarget::RequestId &id)
                     qDebug() << "Response (" << QString(response.typeName()) << "): " << response.toString();
                 }
                 if (response.type() == QVariant::ByteArray) {
-                    QByteArray p = response.toByteArray();
-                    QString arrayContents = "";
-                    for (int i = 0; i < p.size(); ++i) {
-                        arrayContents.append(QString("0x") + QString::number(p.at(i), 16) + " ");
-                    }
-                    qDebug() << "Raw contents of response:\n" << arrayContents;
+                    NFC_TRACE_BYTES("Tag response", response.toByteArray());
                 }
             }
         }
@@ -988,8 +1583,25 @@ void NfcInfo::ndefMessageWritten()
         QTimer::singleShot(50, this, SLOT(writeCachedNdefMessage()));
         return;
     }
+    // The tag has changed - analyze it again when it's touched the next time
+    m_nfcTargetAnalyzer->profileCache()->invalidate(m_nfcTargetAnalyzer->m_tagInfo.tagUid);
     // Store the composed message type count to the actual written count
     m_nfcStats->commitComposedToWrittenCount();
+    if (m_cachedTarget && !m_writtenRawMessage.isEmpty() &&
+            (m_provisioningQueue->isActive() || (m_appSettings && m_appSettings->verifyWrites()))) {
+        // Read the message back before moving on to the next one
+        verifyWrittenMessage();
+        return;
+    }
+    finishWrittenTag();
+}
+
+/*!
+  \brief The message has been written (and verified, if enabled) -
+  ready for the next tag.
+  */
+void NfcInfo::finishWrittenTag()
+{
     emit nfcTagWritten();
     stoppedTagInteraction();
 
@@ -1064,6 +1676,10 @@ void NfcInfo::setAppSettings(AppSettings *appSettings)
     if (m_nfcPeerToPeer) {
         m_nfcPeerToPeer->setAppSettings(m_appSettings);
     }
+    if (m_appSettings->logNdefToFile()) {
+        m_tagCatalog->open(m_appSettings->logNdefDir(true));
+    }
+    applyTagProfileSettings();
 }
 
 #ifdef Q_OS_SYMBIAN
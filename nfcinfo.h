@@ -45,12 +45,28 @@
 // Analyze and parse targets
 #include "nfctargetanalyzer.h"
 #include "nfcndefparser.h"
+#include "ndefstreamdecoder.h"
+#include "ndefsegmentlog.h"
+#include "ndefdedupstore.h"
+#include "ndefmappedfile.h"
+#include "nfclogwriter.h"
+#include "nfctagcatalog.h"
+#include "ndefmessageshrinker.h"
+#include "nfcprovisioningqueue.h"
+#include "nfcwriteverifier.h"
+#include "nfcdiffwriter.h"
+#include "nfctrace.h"
+#ifdef USE_NFC_SIMULATOR
+#include "nfcsimulatedmanager.h"
+#endif
+#include <QElapsedTimer>
 
 #include "tagimagecache.h"
 
 // Logging tags to files
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QDateTime>
 
 // Record model for writing
@@ -60,6 +76,8 @@
 // Stats
 #include "nfcstats.h"
 #define ADV_MSG_WRITE_COUNT 10
+// Minimum time between removing expired reads from the dedup store
+#define NDEF_DEDUP_EXPIRE_INTERVAL_SECS 3600
 
 // Peer to peer
 #include "nfcpeertopeer.h"
@@ -104,6 +122,7 @@ class NfcInfo : public QObject
         NfcNdefReading,
         NfcNdefDeleting,
         NfcNdefWriting,
+        NfcNdefVerifying,
         NfcTargetAnalysis
     };
 
@@ -158,7 +177,13 @@ public slots:
     bool nfcEditTag(const QString &fileName);
     QString nfcSaveModelToFile(const QString &fileName);
     void nfcStopWritingTags();
+    bool nfcStartProvisioning(const QString &fileName);
+    void nfcStopProvisioning();
     NfcRecordModel* recordModel() const;
+    NfcTagCatalog* tagCatalog() const;
+#ifdef USE_NFC_SIMULATOR
+    void setSimulator(NfcSimulatedManager* simulator);
+#endif
 public:
     Q_INVOKABLE void setUnlimitedAdvancedMsgs(const bool unlimited);
     Q_INVOKABLE void applySettings();
@@ -168,18 +193,36 @@ private slots:
     void nfcRecordModelChanged();
     void targetDetected(QNearFieldTarget *target);
     void targetMessageDetected(const QNdefMessage &message, QNearFieldTarget *target);
+    void targetAnalyzed(const QString &nfcInfo);
     void ndefMessageRead(const QNdefMessage &message);
     bool writeCachedNdefMessage();
     void ndefMessageWritten();
     void requestCompleted(const QNearFieldTarget::RequestId & id);
     void targetError(QNearFieldTarget::Error error, const QNearFieldTarget::RequestId &id);
     void targetLost(QNearFieldTarget *target);
+    void provisioningLoaded(const int count, const int remaining);
+    void provisioningLoadError(const QString &errorMessage);
+    void provisioningFinished();
+    void writeVerified(const bool success, const QString &detail);
+    void diffWriteFinished(const int writtenBlocks, const int totalBlocks);
+    void diffWriteFailed(const QString &detail, const bool tagModified);
 
 private:
-    QString storeNdefToFile(const QString &fileName, const QNdefMessage &message, const bool collected);
-    QNdefMessage loadNdefFromFile(const QString &fileName);
+    QString storeNdefToFile(const QString &fileName, const QByteArray &rawMessage, const bool collected);
+    QString storeNdefToSegmentLog(const QByteArray &rawMessage);
+    QString storeNdefToDedupStore(const QByteArray &rawMessage);
+    void expireDedupReads();
+    void detachCachedNdefFile(const QString &fileName);
+    QNdefMessage loadNdefFromFile(const QString &fileName, NdefMappedFile &mappedFile);
+    QNdefMessage loadNdefFromSegmentLog(const QString &segmentFileName, const int frameIndex);
 
     QString convertTargetErrorToString(QNearFieldTarget::Error error);
+    void applyTagProfileSettings();
+    bool fitMessageToTag(QNdefMessage &message);
+    void cacheProvisioningMessage();
+    void verifyWrittenMessage();
+    void finishWrittenTag();
+    void finishProvisionedTag(const bool success, const QString &detail);
 
     void startedTagInteraction();
     void stoppedTagInteraction();
@@ -214,21 +257,33 @@ private:
     /*! Set to true if the application requested to write an NDEF message
       to the tag on the next opportunity. */
     bool m_pendingWriteNdef;
+    /*! The pending write waits for the tag-type specific analysis,
+      to check the exact capacity of the tag before writing. */
+    bool m_writeAfterAnalysis;
     /*! Set to true if the app is currently interacting with a tag. */
     bool m_nfcTagInteractionActive;
     /*! Current activity / status of the class, e.g., reading or analyzing
       a tag. The activity can consist of multiple individual requests. */
     NfcRequestStatus m_currentActivity;
-    /*! If set to true, the message will only be written to the next tag,
-      then the class will read tags again.
-      If set to false, the message will be written to every future tag
-      touched, until nfcStopWriteTag() is called. */
+    /*! Despite the name, writeCachedNdefMessage() checks
+      !m_writeOneTagOnly: if set to false, the message will only be
+      written to the next tag, then the class will read tags again.
+      If set to true, the message will be written to every future tag
+      touched (e.g., by the provisioning queue), until
+      nfcStopWritingTags() is called. */
     bool m_writeOneTagOnly;
     /*! The cached NDEF message that is to be written to the tag. */
     QNdefMessage* m_cachedNdefMessage;
+    /*! If the cached message has been loaded from a file, the payloads
+      of its records reference this mapping. Has to be deleted after
+      the message. */
+    NdefMappedFile* m_cachedNdefFile;
     /*! Save the size of the message that is queued to write, to make
       it easier to compare it to the tag size if writing fails. */
     int m_cachedNdefMessageSize;
+    /*! Message as it has been written to the current tag, after
+      shrinking it to fit. Compared by the write verification. */
+    QByteArray m_writtenRawMessage;
     /*! Currently active request ID for tracking the requests
       to the NFC interface. Only used for main read & write requests.
       Finishing them will stop NFC interactivity. */
@@ -250,6 +305,32 @@ private:
 
     /*! Persistent storage of application settings. */
     AppSettings* m_appSettings;
+    /*! Log for collected messages if segmented logging is enabled in
+      the settings. Created when the first message is logged. */
+    NdefSegmentLog* m_segmentLog;
+    /*! Stores identical collected messages only once, if enabled in
+      the settings. Created when the first message is logged. */
+    NdefDedupStore* m_dedupStore;
+    /*! When expired reads have last been removed from m_dedupStore. */
+    QDateTime m_dedupExpiredTime;
+    /*! Searchable index of the collected messages. */
+    NfcTagCatalog* m_tagCatalog;
+    /*! Distinct messages for bulk writing, one per tag. */
+    NfcProvisioningQueue* m_provisioningQueue;
+    /*! Reads written messages back, for provisioning or if enabled
+      in the settings. */
+    NfcWriteVerifier* m_writeVerifier;
+    /*! Only writes the changed blocks of Type 2 tags, if enabled
+      in the settings. */
+    NfcDiffWriter* m_diffWriter;
+    /*! Writes the log files of read tags on a background thread. */
+    NfcLogWriter* m_logWriter;
+    /*! Time from receiving a message until its contents have been sent
+      to the UI, when using the background log writer. */
+    NfcLatencyCounter m_readToUiAsyncLog;
+    /*! Time from receiving a message until its contents have been sent
+      to the UI, when writing the log file directly. */
+    NfcLatencyCounter m_readToUiSyncLog;
 
     /*! Needed on MeeGo Harmattan to raise the app to the foreground when
       it's autostarted. */
@@ -261,6 +342,9 @@ private:
 
     bool m_usePeerToPeer;
     NfcPeerToPeer* m_nfcPeerToPeer;
+    /*! Frame of the cached message in the send queue of the peer to
+      peer connection, to avoid queuing it again on the next touch. */
+    int m_peerToPeerFrameId;
 };
 
 #endif // NFCINFO_H
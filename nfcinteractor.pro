@@ -17,6 +17,16 @@ DEFINES += DEPLOY_VERSION
 # Only works for N9 PR 1.2+, library not present on 1.0 & 1.1.
 DEFINES += USE_SNEP
 
+# Simulated NFC tags and devices instead of the NFC hardware,
+# touched through the "nfcSimulator" object in QML.
+# See also tools/nfcsimbenchmark.
+#DEFINES += USE_NFC_SIMULATOR
+
+# Hex dumps of the raw data exchanged with tags and peer devices in
+# the debug output. Also needs to be activated at runtime, e.g., by
+# setting the NFC_TRACE environment variable. See nfctrace.h.
+#DEFINES += NFC_TRACE
+
 # Define for detecting Harmattan in .cpp files.
 # Only needed for experimental / beta Harmattan SDKs.
 # Will be defined by default in the final SDK.
@@ -75,56 +85,14 @@ OTHER_FILES += \
     qml/images/*.png
 
 # The .cpp file which was generated for your project. Feel free to hack it.
-SOURCES += main.cpp \
-    nfcinfo.cpp \
-    nearfieldtargetinfo.cpp \
-    nfctargetanalyzer.cpp \
-    tagimagecache.cpp \
-    nfcrecordmodel.cpp \
-    nfcrecorddefaults.cpp \
-    nfcrecorditem.cpp \
-    nfcmodeltondef.cpp \
-    nfcndefparser.cpp \
-    nfcstats.cpp \
-    appsettings.cpp \
-    nfcpeertopeer.cpp \
-    snepmanager.cpp \
-    ndefnfcrecords/ndefnfcsprecord.cpp \
-    ndefnfcrecords/ndefnfcmimeimagerecord.cpp \
-    ndefnfcrecords/ndefnfcmimevcardrecord.cpp \
-    ndefnfcrecords/ndefnfcgeorecord.cpp \
-    ndefnfcrecords/ndefnfcsmarturirecord.cpp \
-    ndefnfcrecords/ndefnfcsmsrecord.cpp \
-    ndefnfcrecords/ndefnfcsocialrecord.cpp \
-    ndefnfcrecords/ndefnfcstorelinkrecord.cpp \
-    ndefnfcrecords/ndefnfcandroidapprecord.cpp \
-    ndefnfcrecords/ndefnfclaunchapprecord.cpp
-
-HEADERS += \
-    nfcinfo.h \
-    nearfieldtargetinfo.h \
-    nfctargetanalyzer.h \
-    tagimagecache.h \
-    nfcrecordmodel.h \
-    nfcrecorddefaults.h \
-    nfcrecorditem.h \
-    nfcmodeltondef.h \
-    nfcndefparser.h \
-    nfcstats.h \
-    nfctypes.h \
-    appsettings.h \
-    nfcpeertopeer.h \
-    snepmanager.h \
-    ndefnfcrecords/ndefnfcsprecord.h \
-    ndefnfcrecords/ndefnfcmimeimagerecord.h \
-    ndefnfcrecords/ndefnfcmimevcardrecord.h \
-    ndefnfcrecords/ndefnfcgeorecord.h \
-    ndefnfcrecords/ndefnfcsmarturirecord.h \
-    ndefnfcrecords/ndefnfcsmsrecord.h \
-    ndefnfcrecords/ndefnfcsocialrecord.h \
-    ndefnfcrecords/ndefnfcstorelinkrecord.h \
-    ndefnfcrecords/ndefnfcandroidapprecord.h \
-    ndefnfcrecords/ndefnfclaunchapprecord.h
+SOURCES += main.cpp
+
+# Everything but the UI, shared with tools/nfcsimbenchmark
+include(nfccore.pri)
+
+contains(DEFINES,USE_NFC_SIMULATOR) {
+    include(nfcsimulator/nfcsimulator.pri)
+}
 
 simulator {
     # The simulator uses the QML and images from Symbian,
@@ -0,0 +1,79 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "nfcllcptransport.h"
+
+NfcLlcpTransport::NfcLlcpTransport(QObject *parent) :
+    QObject(parent)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+NfcLlcpSocketTransport::NfcLlcpSocketTransport(QLlcpSocket *socket, QObject *parent) :
+    NfcLlcpTransport(parent),
+    m_socket(socket)
+{
+    connect(socket, SIGNAL(readyRead()), this, SIGNAL(readyRead()));
+}
+
+QLlcpSocket *NfcLlcpSocketTransport::socket() const
+{
+    return m_socket;
+}
+
+/*!
+  \brief Connection-oriented sockets need to be connected to the remote
+  service, connection-less sockets only need to exist.
+  */
+bool NfcLlcpSocketTransport::isWritable() const
+{
+    if (!m_socket) {
+        return false;
+    }
+    return m_socket->state() == QLlcpSocket::BoundState ||
+            (m_socket->state() == QLlcpSocket::ConnectedState && m_socket->isWritable());
+}
+
+qint64 NfcLlcpSocketTransport::write(const QByteArray &data)
+{
+    return m_socket ? m_socket->write(data) : -1;
+}
+
+QByteArray NfcLlcpSocketTransport::readAll()
+{
+    return m_socket ? m_socket->readAll() : QByteArray();
+}
+
+bool NfcLlcpSocketTransport::hasPendingDatagrams() const
+{
+    return m_socket && m_socket->hasPendingDatagrams();
+}
+
+QByteArray NfcLlcpSocketTransport::readDatagram()
+{
+    if (!m_socket || !m_socket->hasPendingDatagrams()) {
+        return QByteArray();
+    }
+    const qint64 datagramSize = m_socket->pendingDatagramSize();
+    QByteArray datagram((int)datagramSize, char(0));
+    m_socket->readDatagram(datagram.data(), datagramSize);
+    return datagram;
+}
+
+qint64 NfcLlcpSocketTransport::writeDatagram(const QByteArray &data, QNearFieldTarget *target, const quint8 port)
+{
+    return m_socket ? m_socket->writeDatagram(data.constData(), (qint64)data.size(), target, port) : -1;
+}
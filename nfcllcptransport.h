@@ -0,0 +1,91 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NFCLLCPTRANSPORT_H
+#define NFCLLCPTRANSPORT_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QPointer>
+#include <qnearfieldtarget.h>
+#include <qllcpsocket.h>
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Data path of an LLCP socket, independent of the NFC hardware.
+
+  Connection-oriented sockets transfer a stream of bytes through
+  write() and readAll(), which the receiver has to split into messages
+  (e.g., using SNEP or the NdefStreamDecoder). Connection-less sockets
+  transfer individual datagrams.
+
+  NfcPeerToPeer reads and writes all data through this interface.
+  The NfcLlcpSocketTransport forwards to a QLlcpSocket; the
+  NfcLoopbackTransport of the simulator connects two local
+  transports, which can be set through NfcPeerToPeer::setTransports()
+  for benchmarking the protocol without devices.
+  */
+class NfcLlcpTransport : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NfcLlcpTransport(QObject *parent = 0);
+
+    /*! \brief Returns true if data can be sent through the transport. */
+    virtual bool isWritable() const = 0;
+
+    /*! \brief Send \a data through the connection-oriented link. */
+    virtual qint64 write(const QByteArray &data) = 0;
+    /*! \brief Get all bytes received through the connection-oriented link. */
+    virtual QByteArray readAll() = 0;
+
+    virtual bool hasPendingDatagrams() const = 0;
+    /*! \brief Get the next datagram received through the connection-less link. */
+    virtual QByteArray readDatagram() = 0;
+    /*! \brief Send a datagram to the \a port of the remote \a target. */
+    virtual qint64 writeDatagram(const QByteArray &data, QNearFieldTarget *target, const quint8 port) = 0;
+
+signals:
+    /*! New data or datagrams can be read. */
+    void readyRead();
+};
+
+/*!
+  \brief Transport that sends and receives the data through a QLlcpSocket.
+
+  Doesn't take ownership of the socket. Create the transport as a child
+  of the socket to delete both at the same time.
+  */
+class NfcLlcpSocketTransport : public NfcLlcpTransport
+{
+    Q_OBJECT
+public:
+    explicit NfcLlcpSocketTransport(QLlcpSocket *socket, QObject *parent = 0);
+
+    QLlcpSocket *socket() const;
+
+    bool isWritable() const;
+    qint64 write(const QByteArray &data);
+    QByteArray readAll();
+    bool hasPendingDatagrams() const;
+    QByteArray readDatagram();
+    qint64 writeDatagram(const QByteArray &data, QNearFieldTarget *target, const quint8 port);
+
+private:
+    QPointer<QLlcpSocket> m_socket;
+};
+
+#endif // NFCLLCPTRANSPORT_H
@@ -0,0 +1,281 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "nfclogwriter.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+NfcLatencyCounter::NfcLatencyCounter() :
+    count(0),
+    totalNsecs(0),
+    maxNsecs(0)
+{
+}
+
+void NfcLatencyCounter::add(const qint64 nsecs)
+{
+    count++;
+    totalNsecs += nsecs;
+    maxNsecs = qMax(maxNsecs, nsecs);
+}
+
+QString NfcLatencyCounter::toString() const
+{
+    if (count == 0) {
+        return "no measurements";
+    }
+    return QString::number(count) + " times, avg " + QString::number(totalNsecs / count / 1000)
+            + " us, max " + QString::number(maxNsecs / 1000) + " us";
+}
+
+// ----------------------------------------------------------------------------
+
+NfcLogWriter::NfcLogWriter(QObject *parent) :
+    QThread(parent),
+    m_head(0),
+    m_tail(0),
+    m_stopRequested(0),
+    m_writtenCount(0),
+    m_rejectedCount(0),
+    m_syncCount(0)
+{
+}
+
+NfcLogWriter::~NfcLogWriter()
+{
+    stop();
+}
+
+/*!
+  \brief Queue writing the \a data to the file \a fileName, which is
+  overwritten if it already exists. The directory of the file is
+  created if needed.
+
+  Returns immediately. Starts the writer thread if it isn't running yet.
+
+  \return false if the queue is full or the writer has been stopped.
+  The job is not queued in this case.
+  */
+bool NfcLogWriter::enqueue(const QString &fileName, const QByteArray &data)
+{
+    if (m_stopRequested.fetchAndAddAcquire(0) != 0) {
+        return false;
+    }
+    const int tail = m_tail.fetchAndAddRelaxed(0);
+    const int nextTail = (tail + 1) % LOG_WRITER_QUEUE_SIZE;
+    if (nextTail == m_head.fetchAndAddAcquire(0)) {
+        // Full - the writer thread can't keep up with the storage
+        const int rejected = m_rejectedCount.fetchAndAddRelaxed(1) + 1;
+        emit queueFull(rejected);
+        return false;
+    }
+    // Readers wait for the file until the writer thread has synced it
+    const QString key = pathKey(fileName);
+    m_pathMutex.lock();
+    m_pendingPaths[key]++;
+    m_pathMutex.unlock();
+    // The slot isn't visible to the writer thread until the tail is
+    // published, so it can be filled without locking.
+    m_jobs[tail].fileName = key;
+    m_jobs[tail].data = data;
+    m_tail.fetchAndStoreRelease(nextTail);
+    m_jobsAvailable.release();
+
+    if (!isRunning()) {
+        start(QThread::LowPriority);
+    }
+    return true;
+}
+
+/*!
+  \brief Block until all queued jobs for the file \a fileName have been
+  written and synced, or have failed. Returns immediately if the file
+  isn't queued.
+
+  Call this before opening a file that might still be written in the
+  background, e.g., a log file that is loaded for editing.
+  */
+void NfcLogWriter::waitForPath(const QString &fileName)
+{
+    const QString key = pathKey(fileName);
+    QMutexLocker locker(&m_pathMutex);
+    while (m_pendingPaths.contains(key)) {
+        m_pathFinished.wait(&m_pathMutex);
+    }
+}
+
+/*!
+  \brief Write all queued jobs and stop the writer thread.
+  Blocks until the thread has finished. Further jobs are rejected.
+  */
+void NfcLogWriter::stop()
+{
+    if (m_stopRequested.fetchAndStoreOrdered(1) == 0 && isRunning()) {
+        // Wake up the thread, even if there are no jobs
+        m_jobsAvailable.release();
+    }
+    wait();
+}
+
+/*!
+  \brief Number of jobs that are waiting to be written.
+  */
+int NfcLogWriter::pendingJobs() const
+{
+    const int head = const_cast<QAtomicInt &>(m_head).fetchAndAddAcquire(0);
+    const int tail = const_cast<QAtomicInt &>(m_tail).fetchAndAddAcquire(0);
+    return (tail - head + LOG_WRITER_QUEUE_SIZE) % LOG_WRITER_QUEUE_SIZE;
+}
+
+int NfcLogWriter::writtenCount() const
+{
+    return const_cast<QAtomicInt &>(m_writtenCount).fetchAndAddRelaxed(0);
+}
+
+/*!
+  \brief Number of jobs that have been rejected because the queue was full.
+  */
+int NfcLogWriter::rejectedCount() const
+{
+    return const_cast<QAtomicInt &>(m_rejectedCount).fetchAndAddRelaxed(0);
+}
+
+/*!
+  \brief Number of batches that have been synced to the storage.
+  */
+int NfcLogWriter::syncCount() const
+{
+    return const_cast<QAtomicInt &>(m_syncCount).fetchAndAddRelaxed(0);
+}
+
+void NfcLogWriter::run()
+{
+    QList<QFile *> unsyncedFiles;
+    forever {
+        if (unsyncedFiles.isEmpty()) {
+            m_jobsAvailable.acquire();
+        } else if (!m_jobsAvailable.tryAcquire()) {
+            // Queue ran empty - sync the batch before waiting
+            syncFiles(unsyncedFiles);
+            continue;
+        }
+        WriteJob job;
+        if (!dequeue(job)) {
+            // Woken up by stop() and all jobs have been written
+            break;
+        }
+        writeJob(job, unsyncedFiles);
+        if (unsyncedFiles.size() >= LOG_WRITER_SYNC_BATCH) {
+            syncFiles(unsyncedFiles);
+        }
+    }
+    syncFiles(unsyncedFiles);
+}
+
+/*!
+  \brief Take the oldest job from the queue.
+  \return false if the queue is empty.
+  */
+bool NfcLogWriter::dequeue(WriteJob &job)
+{
+    const int head = m_head.fetchAndAddRelaxed(0);
+    if (head == m_tail.fetchAndAddAcquire(0)) {
+        return false;
+    }
+    job = m_jobs[head];
+    // Release the data of the slot before handing it back to the producer
+    m_jobs[head] = WriteJob();
+    m_head.fetchAndStoreRelease((head + 1) % LOG_WRITER_QUEUE_SIZE);
+    return true;
+}
+
+void NfcLogWriter::writeJob(const WriteJob &job, QList<QFile *> &unsyncedFiles)
+{
+    const QString dirName = QFileInfo(job.fileName).absolutePath();
+    if (!m_createdDirs.contains(dirName)) {
+        if (!QDir().mkpath(dirName)) {
+            emit writeError("Unable to open data directory (" + dirName + ") - please check the application settings");
+            finishPath(job.fileName);
+            return;
+        }
+        m_createdDirs.insert(dirName);
+    }
+
+    QFile *file = new QFile(job.fileName);
+    if (!file->open(QIODevice::WriteOnly) || file->write(job.data) != job.data.size()) {
+        qDebug() << "Unable to write file: " << job.fileName;
+        emit writeError("Unable to write file: " + job.fileName);
+        delete file;
+        finishPath(job.fileName);
+        // The directory might have been removed in the meantime
+        m_createdDirs.remove(dirName);
+        return;
+    }
+    m_writtenCount.fetchAndAddRelaxed(1);
+    unsyncedFiles.append(file);
+}
+
+/*!
+  \brief Flush the written files to the storage and close them.
+  */
+void NfcLogWriter::syncFiles(QList<QFile *> &unsyncedFiles)
+{
+    if (unsyncedFiles.isEmpty()) {
+        return;
+    }
+    foreach (QFile *file, unsyncedFiles) {
+        file->flush();
+#if defined(Q_OS_WIN)
+        _commit(file->handle());
+#else
+        fsync(file->handle());
+#endif
+        file->close();
+        finishPath(file->fileName());
+        delete file;
+    }
+    unsyncedFiles.clear();
+    m_syncCount.fetchAndAddRelaxed(1);
+}
+
+/*!
+  \brief A job for the file \a fileName has been completed; wake up
+  the threads waiting for it in waitForPath().
+  */
+void NfcLogWriter::finishPath(const QString &fileName)
+{
+    QMutexLocker locker(&m_pathMutex);
+    QHash<QString, int>::iterator it = m_pendingPaths.find(fileName);
+    if (it != m_pendingPaths.end() && --it.value() <= 0) {
+        m_pendingPaths.erase(it);
+    }
+    m_pathFinished.wakeAll();
+}
+
+/*!
+  \brief Absolute file name, so that different spellings of the same
+  path refer to the same pending job.
+  */
+QString NfcLogWriter::pathKey(const QString &fileName)
+{
+    return QDir::cleanPath(QFileInfo(fileName).absoluteFilePath());
+}
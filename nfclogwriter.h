@@ -0,0 +1,136 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NFCLOGWRITER_H
+#define NFCLOGWRITER_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+#include <QFile>
+
+/*! Number of slots of the job queue. One slot always stays empty,
+  so that a full queue can be distinguished from an empty one. */
+#define LOG_WRITER_QUEUE_SIZE 64
+/*! Maximum number of written files before they are synced to
+  the storage, even if more jobs are waiting. */
+#define LOG_WRITER_SYNC_BATCH 16
+
+/*!
+  \brief Number, average and maximum of measured durations.
+  */
+struct NfcLatencyCounter
+{
+    NfcLatencyCounter();
+    void add(const qint64 nsecs);
+    QString toString() const;
+
+    int count;
+    qint64 totalNsecs;
+    qint64 maxNsecs;
+};
+
+/*!
+  \brief Writes log files on a background thread, so that reading tags
+  doesn't wait for the storage.
+
+  Jobs are passed from the GUI thread to the writer thread through a
+  bounded single-producer / single-consumer ring buffer that only uses
+  atomic operations. The writer thread syncs the written files in
+  batches - as soon as the queue runs empty or after
+  LOG_WRITER_SYNC_BATCH files.
+
+  If the queue is full, enqueue() fails and queueFull() is emitted;
+  the caller should then write the file itself.
+
+  A queued file is incomplete until it has been synced. Code that
+  opens a file which might have been queued has to call waitForPath()
+  first. Only this bookkeeping of the pending file names uses a mutex;
+  it is never held while writing.
+
+  enqueue() may only be called from a single thread.
+  */
+class NfcLogWriter : public QThread
+{
+    Q_OBJECT
+public:
+    explicit NfcLogWriter(QObject *parent = 0);
+    ~NfcLogWriter();
+
+    bool enqueue(const QString &fileName, const QByteArray &data);
+    void waitForPath(const QString &fileName);
+    void stop();
+
+    int pendingJobs() const;
+    int writtenCount() const;
+    int rejectedCount() const;
+    int syncCount() const;
+
+signals:
+    /*! The queue is full and the job has been rejected. Emitted
+      from the thread that called enqueue(). */
+    void queueFull(int rejectedCount);
+    /*! Writing a file failed. Emitted from the writer thread. */
+    void writeError(const QString &errorMessage);
+
+protected:
+    void run();
+
+private:
+    struct WriteJob {
+        QString fileName;
+        QByteArray data;
+    };
+
+    bool dequeue(WriteJob &job);
+    void writeJob(const WriteJob &job, QList<QFile *> &unsyncedFiles);
+    void syncFiles(QList<QFile *> &unsyncedFiles);
+    void finishPath(const QString &fileName);
+    static QString pathKey(const QString &fileName);
+
+private:
+    WriteJob m_jobs[LOG_WRITER_QUEUE_SIZE];
+    /*! Slot of the next job to write. Only modified by the writer thread. */
+    QAtomicInt m_head;
+    /*! Slot for the next job to enqueue. Only modified by the producer. */
+    QAtomicInt m_tail;
+    /*! Number of queued jobs, for waking up the writer thread. */
+    QSemaphore m_jobsAvailable;
+    QAtomicInt m_stopRequested;
+
+    QAtomicInt m_writtenCount;
+    QAtomicInt m_rejectedCount;
+    QAtomicInt m_syncCount;
+
+    /*! Number of queued jobs for each file that haven't been synced
+      yet, by absolute file name. Protected by m_pathMutex. */
+    QHash<QString, int> m_pendingPaths;
+    QMutex m_pathMutex;
+    /*! Signalled whenever a file has been synced or failed. */
+    QWaitCondition m_pathFinished;
+
+    /*! Directories that already exist. Only used by the writer thread. */
+    QSet<QString> m_createdDirs;
+};
+
+#endif // NFCLOGWRITER_H
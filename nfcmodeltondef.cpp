@@ -21,7 +21,8 @@
   */
 NfcModelToNdef::NfcModelToNdef(QList<NfcRecordItem*> &nfcRecordItems, QObject *parent) :
     QObject(parent),
-    m_recordItems(nfcRecordItems)
+    m_recordItems(nfcRecordItems),
+    m_logWriter(NULL)
 {
 }
 
@@ -30,6 +31,15 @@ void NfcModelToNdef::setNfcStats(NfcStats *nfcStats)
     m_nfcStats = nfcStats;
 }
 
+/*!
+  \brief Writer that saves the images of read tags in the background.
+  Image files are only loaded once it has finished writing them.
+  */
+void NfcModelToNdef::setLogWriter(NfcLogWriter *logWriter)
+{
+    m_logWriter = logWriter;
+}
+
 
 /*!
   \brief Convert the current data in the record model to an NDEF message.
@@ -280,6 +290,10 @@ NdefNfcMimeImageRecord* NfcModelToNdef::convertImageFromModel(const int startInd
     if (curIndex >= m_recordItems.size())
         return newRecord;
     NfcRecordItem* curItem = m_recordItems[curIndex];
+    if (m_logWriter) {
+        // The image of a read tag might still be written in the background
+        m_logWriter->waitForPath(curItem->currentText());
+    }
     if (newRecord->setImage(curItem->currentText())) {
         // Loading the image was successful
     } else {
@@ -508,6 +522,9 @@ template<class T> bool NfcModelToNdef::contactSetDetail(QContact& contact, const
     }
     if (contentType == NfcTypes::RecordImageFilename) {
         // Image-based detail
+        if (m_logWriter) {
+            m_logWriter->waitForPath(value);
+        }
         QImage contactImg(value);
         if (!contactImg.isNull()) {
             // Succeeded in loading the image
@@ -34,6 +34,7 @@
 #include "ndefnfcrecords/ndefnfclaunchapprecord.h"
 #include "ndefnfcrecords/ndefnfcandroidapprecord.h"
 #include "nfcstats.h"
+#include "nfclogwriter.h"
 
 // Contact handling
 #include "ndefnfcrecords/ndefnfcmimevcardrecord.h"
@@ -60,6 +61,7 @@ class NfcModelToNdef : public QObject
 public:
     explicit NfcModelToNdef(QList<NfcRecordItem*> &nfcRecordItems, QObject *parent = 0);
     void setNfcStats(NfcStats* nfcStats);
+    void setLogWriter(NfcLogWriter* logWriter);
     QNdefMessage * convertToNdefMessage();
 
 private:
@@ -82,6 +84,9 @@ private:
     QList<NfcRecordItem*> &m_recordItems;    // Not owned by this class
     /*! Count the number of tags read and messages written. (Not owned by this class) */
     NfcStats* m_nfcStats;
+    /*! Background writer of image files that might still be pending.
+      (Not owned by this class) */
+    NfcLogWriter* m_logWriter;
 
 };
 
@@ -18,8 +18,66 @@
 NfcNdefParser::NfcNdefParser(NfcRecordModel* nfcRecordModel, QObject *parent) :
     QObject(parent),
     m_parseToModel(false),
-    m_nfcRecordModel(nfcRecordModel)
+    m_nfcRecordModel(nfcRecordModel),
+    m_reportingLevel(AppSettings::OnlyImportantReporting),
+    m_logWriter(NULL)
 {
+    registerDefaultRecordHandlers();
+}
+
+/*!
+  \brief Register the handlers for all record types this class
+  can render in detail.
+  */
+void NfcNdefParser::registerDefaultRecordHandlers()
+{
+    typedef NdefRecordMemberHandler<NfcNdefParser> ParserHandler;
+    // URI
+    m_recordHandlers.registerHandler(QNdefRecord::NfcRtd, "U", new ParserHandler(this, &NfcNdefParser::parseUriRecord), "URI");
+    // Text
+    m_recordHandlers.registerHandler(QNdefRecord::NfcRtd, "T", new ParserHandler(this, &NfcNdefParser::parseTextRecord), "Text");
+    // Smart Poster (urn:nfc:wkt:Sp)
+    m_recordHandlers.registerHandler(QNdefRecord::NfcRtd, "Sp", new ParserHandler(this, &NfcNdefParser::parseSpRecord), "Smart Poster");
+    // Image (any supported type). The NdefNfcMimeImageRecord class handles
+    // all image types (image/png, gif, jpg, jpeg, etc.)
+    m_recordHandlers.registerHandler(QNdefRecord::Mime, "image/*", new ParserHandler(this, &NfcNdefParser::parseImageRecord), "Image");
+    // Mime type: vCard
+    m_recordHandlers.registerHandler(QNdefRecord::Mime, "text/x-vCard", new ParserHandler(this, &NfcNdefParser::parseVcardRecord), "vCard");
+    // LaunchApp Record
+    m_recordHandlers.registerHandler(QNdefRecord::Uri, "windows.com/LaunchApp", new ParserHandler(this, &NfcNdefParser::parseLaunchAppRecord), "LaunchApp");
+    // Android Application Record
+    m_recordHandlers.registerHandler(QNdefRecord::ExternalRtd, "android.com:pkg", new ParserHandler(this, &NfcNdefParser::parseAndroidAppRecord), "Android Application Record");
+    // Any other external type according to NFC RTD
+    m_recordHandlers.registerHandler(QNdefRecord::ExternalRtd, "*", new ParserHandler(this, &NfcNdefParser::parseCustomRecord), "External RTD");
+}
+
+/*!
+  \brief Add a \a handler for records of the type name format \a tnf
+  and the \a type, or replace the handler of a record type that is
+  already supported.
+
+  \param type exact record type, Mime type with wildcard sub-type
+  (e.g., "audio/*") or "*" for all types of the type name format.
+  \param handler the handler to use. The parser takes ownership.
+  \param name name of the handler for the parse statistics.
+  */
+void NfcNdefParser::registerRecordHandler(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, NdefRecordHandler *handler, const QString &name)
+{
+    m_recordHandlers.registerHandler(tnf, type, handler, name);
+}
+
+/*!
+  \brief Number of rendered records and render duration for every
+  record handler used so far.
+  */
+QString NfcNdefParser::recordParseStatistics() const
+{
+    return m_recordHandlers.statisticsToString();
+}
+
+void NfcNdefParser::setReportingLevel(AppSettings::ReportingLevel reportingLevel)
+{
+    m_reportingLevel = reportingLevel;
 }
 
 
@@ -40,6 +98,16 @@ void NfcNdefParser::setAppSettings(AppSettings *appSettings)
     m_appSettings = appSettings;
 }
 
+/*!
+  \brief Background writer for saving images found on tags.
+  If not set, the images are written directly.
+  */
+void NfcNdefParser::setLogWriter(NfcLogWriter *logWriter)
+{
+    // Not owned by this class
+    m_logWriter = logWriter;
+}
+
 /*!
   \brief If enabled, additionally parse the contents of the NDEF
   message to the record model.
@@ -52,8 +120,41 @@ void NfcNdefParser::setParseToModel(bool parseToModel)
 /*!
   \brief Parse the NDEF \a message and return its contents in human-readable
   textual format.
+
+  The message is serialized once and then parsed in-place through
+  parseNdefMessage(const QByteArray&).
   */
 QString NfcNdefParser::parseNdefMessage(const QNdefMessage &message)
+{
+    if (message.isEmpty()) {
+        return QString("No records in the Ndef message");
+    }
+    return parseNdefMessage(message.toByteArray());
+}
+
+/*!
+  \brief Parse the raw NDEF message stored in \a rawMessage and return its
+  contents in human-readable textual format.
+
+  Decoding is done by the NdefMessageDecoder, which doesn't create any
+  strings. The text is then created by renderNdefMessage().
+  */
+QString NfcNdefParser::parseNdefMessage(const QByteArray &rawMessage)
+{
+    ParsedNdefMessage parsedMessage;
+    NdefMessageDecoder::decode(rawMessage, parsedMessage);
+    return renderNdefMessage(parsedMessage);
+}
+
+/*!
+  \brief Create the human-readable description of the previously
+  decoded \a message.
+
+  If parsing to the model is enabled, this also adds the records
+  to the record model. Found images are added to the image cache,
+  URIs and texts are copied to the clipboard.
+  */
+QString NfcNdefParser::renderNdefMessage(const ParsedNdefMessage &message)
 {
     if (message.isEmpty()) {
         return QString("No records in the Ndef message");
@@ -64,8 +165,7 @@ QString NfcNdefParser::parseNdefMessage(const QNdefMessage &message)
     m_clipboardContents = ClipboardEmpty;
 
     // Message size
-    QByteArray rawMessage = message.toByteArray();
-    const int msgSize = rawMessage.size();
+    const int msgSize = message.rawMessage().size();
     if (msgSize > 0) {
         tagContents.append("Message size: " + QString::number(msgSize) + " bytes\n");
     }
@@ -76,10 +176,10 @@ QString NfcNdefParser::parseNdefMessage(const QNdefMessage &message)
     }
 
     // Go through all records in the message
-    const int recordCount = message.size();
-    int numRecord = 1;
-    foreach (const QNdefRecord &record, message)
+    const int recordCount = message.recordCount();
+    for (int numRecord = 1; numRecord <= recordCount; numRecord++)
     {
+        const ParsedNdefRecord &record = message.record(numRecord - 1);
         if (recordCount > 1) {
             // More than one record in the message?
             // -> show which one we're parsing now.
@@ -90,66 +190,17 @@ QString NfcNdefParser::parseNdefMessage(const QNdefMessage &message)
         }
 
         // Print generic information about the record
-        tagContents.append("Type name: " + convertRecordTypeNameToString(record.typeNameFormat()) + "\n");
-        tagContents.append("Record type: " + QString(record.type()) + " ");
+        tagContents.append("Type name: " + convertRecordTypeNameToString(record.typeNameFormat) + "\n");
+        tagContents.append("Record type: " + message.toAscii(record.type) + " ");
 
-        // Parse tag contents
-        if (record.isRecordType<QNdefNfcUriRecord>())
+        // Render the contents through the handler registered for the record type
+        if (m_recordHandlers.parseRecord(message, record, tagContents))
         {
-            // ------------------------------------------------
-            // URI
-            tagContents.append(parseUriRecord(QNdefNfcUriRecord(record)));
-        }
-        else if (record.isRecordType<QNdefNfcTextRecord>())
-        {
-            // ------------------------------------------------
-            // Text
-            tagContents.append(parseTextRecord(QNdefNfcTextRecord(record)));
-        }
-        else if (record.isRecordType<NdefNfcSpRecord>())
-        {
-            // ------------------------------------------------
-            // Smart Poster (urn:nfc:wkt:Sp)
-            tagContents.append(parseSpRecord(NdefNfcSpRecord(record)));
-        }
-        else if (record.typeNameFormat() == QNdefRecord::Mime &&
-                   record.type().startsWith("image/"))
-        {
-            // The NdefNfcMimeImageRecord class handles many different
-            // record types. To simplify the use, there is no extra
-            // class for each individual image type (image/png, gif,
-            // jpg, jpeg, etc.)
-            // Therefore, the isRecordType<>() method can't be used
-            // with the generic image handler class.
-            // ------------------------------------------------
-            // Image (any supported type)
-            tagContents.append(parseImageRecord(NdefNfcMimeImageRecord(record)));
-        }
-        else if (record.isRecordType<NdefNfcMimeVcardRecord>())
-        {
-            // ------------------------------------------------
-            // Mime type: vCard
-            NdefNfcMimeVcardRecord vCardRecord(record);
-            tagContents.append(parseVcardRecord(vCardRecord));
-        }
-        else if (record.isRecordType<NdefNfcLaunchAppRecord>())
-        {
-            // ------------------------------------------------
-            // LaunchApp Record
-            tagContents.append(parseLaunchAppRecord(NdefNfcLaunchAppRecord(record)));
-        }
-        else if (record.isRecordType<NdefNfcAndroidAppRecord>())
-        {
-            // ------------------------------------------------
-            // Android Application Record
-            tagContents.append(parseAndroidAppRecord(NdefNfcAndroidAppRecord(record)));
-        }
-        else if (record.typeNameFormat() == QNdefRecord::ExternalRtd) {
-            // ------------------------------------------------
-            // External type according to NFC RTD
-            tagContents.append(parseCustomRecord(record));
+            if (m_reportingLevel == AppSettings::DebugReporting) {
+                qDebug() << "Parsed record " << numRecord << " in " << m_recordHandlers.lastParseNsecs() / 1000 << " us";
+            }
         }
-        else if (record.isEmpty())
+        else if (record.kind == ParsedNdefRecord::KindEmpty)
         {
             // ------------------------------------------------
             // Empty
@@ -160,14 +211,19 @@ QString NfcNdefParser::parseNdefMessage(const QNdefMessage &message)
             // ------------------------------------------------
             // Record type not parsed by this class
             tagContents.append("\nRaw payload: ");
-            if (record.payload().isNull() || record.payload().isEmpty()) {
+            if (record.payload.length == 0) {
                 tagContents.append("[Empty]");
             } else {
-                tagContents.append(record.payload());
+                tagContents.append(message.toAscii(record.payload));
             }
             tagContents.append("\n");
         }
-        numRecord++;
+    }
+
+    if (!message.isValid()) {
+        // Only parts of the message could be parsed
+        tagContents.append("\nWarning: the message is truncated or malformed - only "
+                           + QString::number(message.byteSize()) + " bytes could be parsed\n");
     }
 
     // If we found records that can be stored in a clipboard,
@@ -176,22 +232,40 @@ QString NfcNdefParser::parseNdefMessage(const QNdefMessage &message)
     return tagContents;
 }
 
+/*!
+  \brief Decode the image stored in \a imgData.
+
+  \param imgData raw data of the image, usually the payload of
+  an image record.
+  \param imgFormat returns the format of the image (png, gif, jpg, etc.)
+  \return the decoded image, or a null image if decoding failed.
+  */
+QImage NfcNdefParser::decodeImage(QByteArray imgData, QByteArray &imgFormat)
+{
+    QBuffer buffer(&imgData);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader imgReader(&buffer);
+    imgFormat = imgReader.format();
+    return imgReader.read();
+}
 
 /*!
   \brief Create a textual description of the contents of the
   Uri (U) record.
 
+  \param message the decoded message containing the record
   \param record the record to analyze
   \return plain text description of the record contents.
   */
-QString NfcNdefParser::parseUriRecord(const QNdefNfcUriRecord& record)
+QString NfcNdefParser::parseUriRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
 {
+    const QUrl uri = message.uri(record);
     QString tagContents("[URI]\n");
-    tagContents.append(record.uri().toString());
-    storeClipboard(record.uri());
+    tagContents.append(uri.toString());
+    storeClipboard(uri);
     if (m_parseToModel) {
         m_nfcRecordModel->simpleAppendRecordHeaderItem(NfcTypes::MsgUri, false);
-        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordUri, record.uri().toString(), false);
+        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordUri, uri.toString(), false);
     }
     return tagContents;
 }
@@ -200,19 +274,23 @@ QString NfcNdefParser::parseUriRecord(const QNdefNfcUriRecord& record)
   \brief Create a textual description of the contents of the
   Text (T) record.
 
+  \param message the decoded message containing the record
   \param record the record to analyze
   \return plain text description of the record contents.
   */
-QString NfcNdefParser::parseTextRecord(const QNdefNfcTextRecord& record)
+QString NfcNdefParser::parseTextRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
 {
+    const QString text = message.text(record.text);
+    const QString locale = message.toAscii(record.text.locale);
+
     QString tagContents("[Text]\n");
     // Add the text info to the string, parsed by an extra method
     // as the same content is also present for example in the Smart Poster.
-    tagContents.append(textRecordToString(record));
+    tagContents.append(textRecordToString(text, locale, record.text.utf16));
     if (m_parseToModel) {
         m_nfcRecordModel->simpleAppendRecordHeaderItem(NfcTypes::MsgText, false);
-        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordText, record.text(), false);
-        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordTextLanguage, record.locale(), false);
+        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordText, text, false);
+        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordTextLanguage, locale, false);
     }
     return tagContents;
 }
@@ -223,13 +301,13 @@ QString NfcNdefParser::parseTextRecord(const QNdefNfcTextRecord& record)
   Seperated from parseTextRecord() as this is also used by the
   Smart Poster parser.
   */
-QString NfcNdefParser::textRecordToString(const QNdefNfcTextRecord& textRecord)
+QString NfcNdefParser::textRecordToString(const QString &text, const QString &locale, const bool utf16)
 {
-    QString txt("Title: " + textRecord.text() + "\n");
-    txt.append("Locale: " + textRecord.locale() + "\n");
-    const QString textEncoding = textRecord.encoding() == QNdefNfcTextRecord::Utf8 ? "UTF-8" : "UTF-16";
+    QString txt("Title: " + text + "\n");
+    txt.append("Locale: " + locale + "\n");
+    const QString textEncoding = utf16 ? "UTF-16" : "UTF-8";
     txt.append("Encoding: " + textEncoding + "\n");
-    storeClipboard(textRecord.text(), textRecord.locale());
+    storeClipboard(text, locale);
     return txt;
 }
 
@@ -237,10 +315,11 @@ QString NfcNdefParser::textRecordToString(const QNdefNfcTextRecord& textRecord)
   \brief Create a textual description of the contents of the
   Smart Poster (Sp) record.
 
+  \param message the decoded message containing the record
   \param record the record to analyze
   \return plain text description of the record contents.
   */
-QString NfcNdefParser::parseSpRecord(const NdefNfcSpRecord& record)
+QString NfcNdefParser::parseSpRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
 {
     QString tagContents("[Smart Poster]\n");
     if (m_parseToModel) {
@@ -248,29 +327,31 @@ QString NfcNdefParser::parseSpRecord(const NdefNfcSpRecord& record)
     }
 
     // Uri
-    tagContents.append("Uri: " + record.uri().toString() + "\n");
+    const QString uri = message.uri(record).toString();
+    tagContents.append("Uri: " + uri + "\n");
     if (m_parseToModel) {
-        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordUri, record.uri().toString(), false);
+        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordUri, uri, false);
     }
 
     // Title
-    tagContents.append("Title count: " + QString::number(record.titleCount()) + "\n");
-    if (record.titleCount() > 0)
-    {
-        foreach (QNdefNfcTextRecord curTitle, record.titles()) {
-            tagContents.append(textRecordToString(curTitle));
-            if (m_parseToModel) {
-                m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordText, curTitle.text(), true);
-                m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordTextLanguage, curTitle.locale(), false);
-            }
+    tagContents.append("Title count: " + QString::number(record.titleCount) + "\n");
+    for (int i = record.firstTitle; i < record.firstTitle + record.titleCount; i++) {
+        const ParsedNdefText &title = message.title(i);
+        const QString text = message.text(title);
+        const QString locale = message.toAscii(title.locale);
+        tagContents.append(textRecordToString(text, locale, title.utf16));
+        if (m_parseToModel) {
+            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordText, text, true);
+            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordTextLanguage, locale, false);
         }
     }
 
     // Action
-    if (record.actionInUse())
+    if (record.spAction >= 0)
     {
         QString spActionString = "Unknown";
-        switch (record.action())
+        int spAction = record.spAction;
+        switch (spAction)
         {
         case NdefNfcSpRecord::DoAction:
             spActionString = "Do Action";
@@ -281,43 +362,44 @@ QString NfcNdefParser::parseSpRecord(const NdefNfcSpRecord& record)
         case NdefNfcSpRecord::OpenForEditing:
             spActionString = "Open for editing";
             break;
-        case NdefNfcSpRecord::RFU:
+        default:
+            spAction = NdefNfcSpRecord::RFU;
             spActionString = "RFU";
             break;
         }
         tagContents.append("Action: " + spActionString + "\n");
         if (m_parseToModel) {
-            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordSpAction, QString::number((int)record.action()), true);
+            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordSpAction, QString::number(spAction), true);
         }
     }
 
     // Size
-    if (record.sizeInUse())
+    if (record.hasSpSize)
     {
-        tagContents.append("Size: " + QString::number(record.size()) + "\n");
+        tagContents.append("Size: " + QString::number(record.spSize) + "\n");
         if (m_parseToModel) {
-            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordSpSize, QString::number(record.size()), true);
+            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordSpSize, QString::number(record.spSize), true);
         }
     }
 
     // Type
-    if (record.mimeTypeInUse())
+    if (!record.spMimeType.isNull())
     {
-        tagContents.append("Type: " + record.mimeType() + "\n");
+        const QString spMimeType = message.toUtf8(record.spMimeType);
+        tagContents.append("Type: " + spMimeType + "\n");
         if (m_parseToModel) {
-            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordSpType, record.mimeType(), true);
+            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordSpType, spMimeType, true);
         }
     }
 
     // Image
-    if (record.imageInUse())
+    if (!record.image.isNull())
     {
-        NdefNfcMimeImageRecord spImageRecord = record.image();
-        QByteArray imgFormat = spImageRecord.format();
+        QByteArray imgFormat;
+        QImage spImage = decodeImage(message.bytes(record.image), imgFormat);
         if (!imgFormat.isEmpty()) {
             tagContents.append("Image format: " + imgFormat + "\n");
         }
-        QImage spImage = spImageRecord.image();
         if (!spImage.isNull())
         {
             if (m_imgCache) {
@@ -329,12 +411,12 @@ QString NfcNdefParser::parseSpRecord(const NdefNfcSpRecord& record)
             }
         }
         if (m_parseToModel) {
+            NdefNfcMimeImageRecord spImageRecord(QByteArray(message.data(record.imageType), record.imageType.length));
+            spImageRecord.setPayload(QByteArray(message.data(record.image), record.image.length));
             storeImageToFileForModel(spImageRecord, true);
         }
     }
 
-    // Raw contents
-    //tagContents.append(record.rawContents());
     return tagContents;
 }
 
@@ -345,24 +427,24 @@ QString NfcNdefParser::parseSpRecord(const NdefNfcSpRecord& record)
   The parsing works regardless of the actual image format used and
   supports all image formats available to Qt.
 
+  \param message the decoded message containing the record
   \param record the record to analyze
   \return plain text description of the record contents.
   */
-QString NfcNdefParser::parseImageRecord(const NdefNfcMimeImageRecord& record)
+QString NfcNdefParser::parseImageRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
 {
     QString tagContents("[Image]\n");
     if (m_parseToModel) {
         m_nfcRecordModel->simpleAppendRecordHeaderItem(NfcTypes::MsgImage, true);
     }
 
-    // Read image format (png, gif, jpg, etc.)
-    QByteArray imgFormat = record.format();
+    // Read image format (png, gif, jpg, etc.) and retrieve the image
+    QByteArray imgFormat;
+    QImage img = decodeImage(message.bytes(record.image), imgFormat);
     if (!imgFormat.isEmpty()) {
         tagContents.append("Format: " + imgFormat + "\n");
     }
 
-    // Retrieve the image
-    QImage img = record.image();
     if (!img.isNull()) {
 
         // Image size
@@ -380,7 +462,9 @@ QString NfcNdefParser::parseImageRecord(const NdefNfcMimeImageRecord& record)
     }
 
     if (m_parseToModel) {
-        storeImageToFileForModel(record, false);
+        // Only create an owning copy of the record if it needs to be
+        // saved to a file.
+        storeImageToFileForModel(NdefNfcMimeImageRecord(message.recordView(record).toRecord()), false);
     }
 
     return tagContents;
@@ -390,11 +474,16 @@ QString NfcNdefParser::parseImageRecord(const NdefNfcMimeImageRecord& record)
   \brief Create a textual description of the contents of the
   VCard record.
 
-  \param record the record to analyze
+  The versit parser needs an owning record, so this method
+  creates a copy of the record data.
+
+  \param message the decoded message containing the record
+  \param parsedRecord the record to analyze
   \return plain text description of the record contents.
   */
-QString NfcNdefParser::parseVcardRecord(NdefNfcMimeVcardRecord& record)
+QString NfcNdefParser::parseVcardRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &parsedRecord)
 {
+    NdefNfcMimeVcardRecord record(message.recordView(parsedRecord).toRecord());
     QString tagContents("[vCard]\n");
     if (m_parseToModel) {
         m_nfcRecordModel->simpleAppendRecordHeaderItem(NfcTypes::MsgBusinessCard, true);
@@ -546,11 +635,13 @@ bool NfcNdefParser::addContactDetailToModel(const QString& detailName, const QSt
   \brief Create a textual description of the contents of the
   LaunchApp record.
 
-  \param record the record to analyze
+  \param message the decoded message containing the record
+  \param parsedRecord the record to analyze
   \return plain text description of the record contents.
   */
-QString NfcNdefParser::parseLaunchAppRecord(const NdefNfcLaunchAppRecord& record)
+QString NfcNdefParser::parseLaunchAppRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &parsedRecord)
 {
+    const NdefNfcLaunchAppRecord record(message.recordView(parsedRecord).toRecord());
     QString tagContents("[LaunchApp]\n");
     tagContents.append("Arguments: " + record.arguments() + "\n");
     tagContents.append("Defined platforms: " + QString::number(record.platformAppIdsCount()) + "\n");
@@ -589,21 +680,24 @@ QString NfcNdefParser::parseLaunchAppRecord(const NdefNfcLaunchAppRecord& record
   \brief Create a textual description of the contents of the
   Android Application Record.
 
+  \param message the decoded message containing the record
   \param record the record to analyze
   \return plain text description of the record contents.
   */
-QString NfcNdefParser::parseAndroidAppRecord(const NdefNfcAndroidAppRecord& record)
+QString NfcNdefParser::parseAndroidAppRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
 {
+    const QString packageName = message.toUtf8(record.payload);
+    const QByteArray id = message.bytes(record.id);
     QString tagContents("[Android Application Record]\n");
-    tagContents.append("Package name: " + record.packageName() + "\n");
-    if (!record.id().isNull() && !record.id().isEmpty()) {
-        tagContents.append("Id: " + record.id() + "\n");
+    tagContents.append("Package name: " + packageName + "\n");
+    if (!id.isEmpty()) {
+        tagContents.append("Id: " + id + "\n");
     }
     if (m_parseToModel) {
         m_nfcRecordModel->simpleAppendRecordHeaderItem(NfcTypes::MsgAndroidAppRecord, true);
-        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordAndroidPackageName, record.packageName(), false);
-        if (!record.id().isNull() && !record.id().isEmpty()) {
-            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordId, record.id(), true);
+        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordAndroidPackageName, packageName, false);
+        if (!id.isEmpty()) {
+            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordId, id, true);
         }
     }
     return tagContents;
@@ -614,28 +708,31 @@ QString NfcNdefParser::parseAndroidAppRecord(const NdefNfcAndroidAppRecord& reco
   \brief Create a textual description of the contents of the
   external record type name format.
 
+  \param message the decoded message containing the record
   \param record the record to analyze
   \return plain text description of the record contents.
   */
-QString NfcNdefParser::parseCustomRecord(const QNdefRecord& record)
+QString NfcNdefParser::parseCustomRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
 {
+    const QByteArray payload = message.bytes(record.payload);
+    const QByteArray id = message.bytes(record.id);
     QString tagContents("[External RTD]\n");
     //tagContents.append("Type: " + record.type() + "\n");  // Already parsed for every record
-    tagContents.append("Payload (" + QString::number(record.payload().size()) + ")");
-    if (!record.isEmpty()) {
-        tagContents.append(": " + record.payload());
+    tagContents.append("Payload (" + QString::number(payload.size()) + ")");
+    if (!payload.isEmpty()) {
+        tagContents.append(": " + payload);
     }
     tagContents.append("\n");
-    if (!record.id().isNull() && !record.id().isEmpty()) {
-        tagContents.append("Id: " + record.id() + "\n");
+    if (!id.isEmpty()) {
+        tagContents.append("Id: " + id + "\n");
     }
     if (m_parseToModel) {
         m_nfcRecordModel->simpleAppendRecordHeaderItem(NfcTypes::MsgCustom, true);
         m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordTypeNameFormat, "4", false);
-        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordTypeName, record.type(), false);
-        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordRawPayload, record.payload(), false);
-        if (!record.id().isNull() && !record.id().isEmpty()) {
-            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordId, record.id(), true);
+        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordTypeName, message.bytes(record.type), false);
+        m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordRawPayload, payload, false);
+        if (!id.isEmpty()) {
+            m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordId, id, true);
         }
     }
     return tagContents;
@@ -705,6 +802,9 @@ void NfcNdefParser::setStoredClipboard()
 {
     if (m_clipboardContents == ClipboardEmpty)
         return;
+    // No clipboard in console tools (e.g., the benchmark)
+    if (QApplication::type() == QApplication::Tty)
+        return;
 
     QClipboard *clipboard = QApplication::clipboard();
     if (clipboard) {
@@ -727,18 +827,25 @@ void NfcNdefParser::setStoredClipboard()
 void NfcNdefParser::storeImageToFileForModel(const NdefNfcMimeImageRecord& imgRecord, const bool removeVisible)
 {
     if (m_appSettings && m_appSettings->logNdefToFile()) {
-        // Save image to file
-        QDir dir("/");
-        QString fileName = "";
-        dir.mkpath(m_appSettings->logNdefDir());
-        if (QDir::setCurrent(m_appSettings->logNdefDir())) {
-            // Create image name based on current system time
-            QDateTime now = QDateTime::currentDateTime();
-            fileName = now.toString("yyyy.MM.dd - hh.mm.ss");
-            fileName.append(" - image");
-            QString imgFullFileName = imgRecord.saveImageToFile(fileName);
-            qDebug() << "Saved image to file: " << m_appSettings->logNdefDir() + imgFullFileName;
-
+        // Create image name based on current system time
+        QDateTime now = QDateTime::currentDateTime();
+        QString fileName = now.toString("yyyy.MM.dd - hh.mm.ss");
+        fileName.append(" - image");
+        QString imgFullFileName;
+        if (m_logWriter && m_appSettings->logNdefAsync() &&
+                m_logWriter->enqueue(m_appSettings->logNdefDir() + fileName + "." + imgRecord.fileExtension(), imgRecord.payload())) {
+            // Saved in the background
+            imgFullFileName = fileName + "." + imgRecord.fileExtension();
+        } else {
+            // Save image to file
+            QDir dir("/");
+            dir.mkpath(m_appSettings->logNdefDir());
+            if (QDir::setCurrent(m_appSettings->logNdefDir())) {
+                imgFullFileName = imgRecord.saveImageToFile(fileName);
+                qDebug() << "Saved image to file: " << m_appSettings->logNdefDir() + imgFullFileName;
+            }
+        }
+        if (!imgFullFileName.isEmpty()) {
             // Put image name to model
             m_nfcRecordModel->addContentToLastRecord(NfcTypes::RecordImageFilename, m_appSettings->logNdefDir() + imgFullFileName, removeVisible);
         }
@@ -33,9 +33,14 @@
 #include "ndefnfcrecords/ndefnfcsprecord.h"
 #include "ndefnfcrecords/ndefnfcmimevcardrecord.h"
 #include "ndefnfcrecords/ndefnfcandroidapprecord.h"
+#include "ndefmessagedecoder.h"
+#include "ndefrecordhandlerregistry.h"
+#include "nfclogwriter.h"
 
 // Image handling
 #include <QImage>
+#include <QImageReader>
+#include <QBuffer>
 #include "tagimagecache.h"
 
 // VCard reading
@@ -70,6 +75,7 @@ public:
     explicit NfcNdefParser(NfcRecordModel *nfcRecordModel, QObject *parent = 0);
     void setImageCache(TagImageCache* tagImageCache);
     void setAppSettings(AppSettings* appSettings);
+    void setLogWriter(NfcLogWriter* logWriter);
 
 signals:
     /*! \brief The tag contained an image.
@@ -81,21 +87,35 @@ public:
     /*! \brief Parse the NDEF message and return its contents
       as human-readable text. */
     QString parseNdefMessage(const QNdefMessage &message);
+    /*! \brief Decode the raw NDEF message and return its
+      contents as human-readable text. */
+    QString parseNdefMessage(const QByteArray &rawMessage);
+    /*! \brief Render the previously decoded NDEF message
+      as human-readable text. */
+    QString renderNdefMessage(const ParsedNdefMessage &message);
 
     void setParseToModel(bool parseToModel);
+    void setReportingLevel(AppSettings::ReportingLevel reportingLevel);
+
+    void registerRecordHandler(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, NdefRecordHandler *handler, const QString &name);
+    QString recordParseStatistics() const;
+
     private:
-    QString parseUriRecord(const QNdefNfcUriRecord &record);
-    QString parseTextRecord(const QNdefNfcTextRecord &record);
-    QString textRecordToString(const QNdefNfcTextRecord &textRecord);
-    QString parseSpRecord(const NdefNfcSpRecord &record);
-    QString parseImageRecord(const NdefNfcMimeImageRecord &record);
-    QString parseVcardRecord(NdefNfcMimeVcardRecord &record);
-    QString parseLaunchAppRecord(const NdefNfcLaunchAppRecord &record);
-    QString parseAndroidAppRecord(const NdefNfcAndroidAppRecord &record);
+    void registerDefaultRecordHandlers();
+    QString parseUriRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
+    QString parseTextRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
+    QString textRecordToString(const QString &text, const QString &locale, const bool utf16);
+    QString parseSpRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
+    QString parseImageRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
+    QString parseVcardRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &parsedRecord);
+    QString parseLaunchAppRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &parsedRecord);
+    QString parseAndroidAppRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
 
     bool addContactDetailToModel(const QString &detailName, const QString &detailValue);
 
-    QString parseCustomRecord(const QNdefRecord &record);
+    QString parseCustomRecord(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
+
+    static QImage decodeImage(QByteArray imgData, QByteArray &imgFormat);
 
     QString convertRecordTypeNameToString(const QNdefRecord::TypeNameFormat typeName);
 
@@ -128,6 +148,13 @@ private:
 
     /*! Persistent storageof application settings. Not owned by this class. */
     AppSettings* m_appSettings;
+    /*! Outputs the parse duration of each record to qDebug() if set to debug. */
+    AppSettings::ReportingLevel m_reportingLevel;
+    /*! Writes the extracted images in the background. Not owned by this class. */
+    NfcLogWriter* m_logWriter;
+
+    /*! Maps the record types to the methods that parse them. */
+    NdefRecordHandlerRegistry m_recordHandlers;
 
 };
 
@@ -15,6 +15,33 @@
 
 #include "nfcpeertopeer.h"
 
+/*!
+  \brief Returns true if \a data can be the start of a raw NDEF message:
+  the first record has the message begin flag and a consistent header.
+
+  Plain text usually fails this check, as ASCII characters don't have
+  the most significant bit (MB) set. Only checks the header fields that
+  are already available; the record itself may continue in later reads.
+  */
+static bool isNdefMessageStart(const QByteArray &data)
+{
+    if (data.size() < 3) {
+        return false;
+    }
+    const quint8 flags = data.at(0);
+    const quint8 tnf = flags & NDEF_TNF_MASK;
+    const quint8 typeLength = data.at(1);
+    if (!(flags & NDEF_FLAG_MB) || tnf == NDEF_TNF_UNCHANGED) {
+        return false;
+    }
+    if (tnf >= QNdefRecord::NfcRtd && tnf <= QNdefRecord::ExternalRtd && typeLength == 0) {
+        // Well known, MIME, URI and external records need a type
+        return false;
+    }
+    NdefRecordView view;
+    return NdefRecordView::parse(data.constData(), data.size(), view) != NdefRecordView::ParseMalformed;
+}
+
 NfcPeerToPeer::NfcPeerToPeer(QObject *parent) :
     QObject(parent),
     m_appSettings(NULL),
@@ -25,11 +52,22 @@ NfcPeerToPeer::NfcPeerToPeer(QObject *parent) :
     m_nfcServer(NULL),
     m_nfcClientSocket(NULL),
     m_nfcServerSocket(NULL),
+    m_transportsInjected(false),
+    m_nextFrameId(0),
+    m_snepRequestFrameId(-1),
     m_isResetting(false),
     m_isBusy(false)
 {
     m_snepManager = new SnepManager(this);
     connect(m_snepManager, SIGNAL(nfcSnepSuccess()), this, SIGNAL(nfcSendNdefSuccess()));
+    // Queued, as the next request is sent from the slot - don't do that
+    // while the SNEP manager is still processing the response.
+    connect(m_snepManager, SIGNAL(requestFinished(bool)), this, SLOT(snepRequestFinished(bool)), Qt::QueuedConnection);
+
+    // Decodes raw NDEF messages that arrive in multiple reads
+    m_ndefDecoder = new NdefStreamDecoder(this);
+    connect(m_ndefDecoder, SIGNAL(messageDecoded(QNdefMessage)), this, SLOT(streamNdefMessageDecoded(QNdefMessage)));
+    connect(m_ndefDecoder, SIGNAL(recordProgress(int,int)), this, SLOT(streamNdefRecordProgress(int,int)));
 
 #if defined(MEEGO_EDITION_HARMATTAN) && defined(USE_SNEP)
     m_snepManagerMeego = new SnepManagerMeego(this);
@@ -64,6 +102,33 @@ void NfcPeerToPeer::setNfcManager(QNearFieldManager *nfcManager)
     m_nfcManager = nfcManager;
 }
 
+/*!
+  \brief Exchange the data through the given transports instead of the
+  LLCP sockets of the NFC hardware, e.g., loopback transports of the
+  simulator or a benchmark.
+
+  No sockets are created afterwards. The transports are not owned.
+  The \a clientTransport is used like the client socket (in case of
+  connection-less the only one), the \a serverTransport like the
+  connection accepted by the server. Either one can be NULL.
+  */
+void NfcPeerToPeer::setTransports(NfcLlcpTransport *clientTransport, NfcLlcpTransport *serverTransport)
+{
+    m_transportsInjected = true;
+    setClientTransport(clientTransport);
+    setServerTransport(serverTransport);
+    sendCachedText();
+}
+
+/*!
+  \brief Size of the first fragment of SNEP requests and responses,
+  i.e., the MIU of the LLCP connection. See SnepManager::setFragmentSize().
+  */
+void NfcPeerToPeer::setSnepFragmentSize(const int fragmentSize)
+{
+    m_snepManager->setFragmentSize(fragmentSize);
+}
+
 void NfcPeerToPeer::applySettings()
 {
     m_isResetting = true;
@@ -158,24 +223,29 @@ void NfcPeerToPeer::resetAll()
         m_nfcClientSocket->close();
         m_nfcClientSocket->deleteLater();
         m_nfcClientSocket = NULL;
+        setClientTransport(NULL);
     }
     if (m_nfcServerSocket) {
         m_nfcServerSocket->close();
         m_nfcServerSocket->deleteLater();
         m_nfcServerSocket = NULL;
+        setServerTransport(NULL);
     }
     if (m_nfcServer) {
         m_nfcServer->close();
         m_nfcServer->deleteLater();
         m_nfcServer = NULL;
     }
+    m_ndefDecoder->reset();
+    m_snepManager->reset();
+    abortSnepRequest();
     qDebug() << "NfcPeerToPeer::resetAll() finished";
 }
 
 void NfcPeerToPeer::initAndStartNfc()
 {
     qDebug(__PRETTY_FUNCTION__);
-    if (!m_appSettings) {
+    if (!m_appSettings || m_transportsInjected) {
         return;
     }
 
@@ -197,6 +267,9 @@ void NfcPeerToPeer::initAndStartNfc()
 
 void NfcPeerToPeer::initClientSocket()
 {
+    if (m_transportsInjected) {
+        return;
+    }
     if (!m_useConnectionLess && !m_connectClientSocket) {
         // If using only one socket for connection-oriented, do not initialize
         // a client (second) socket here. The server will already wait for incoming
@@ -205,13 +278,14 @@ void NfcPeerToPeer::initClientSocket()
     }
 
     if (m_nfcClientSocket) {
+        setClientTransport(NULL);
         delete m_nfcClientSocket;
     }
 
     qDebug() << "Creating new client socket";
     // The NFC client socket (in case of connectionless the only one)
     m_nfcClientSocket = new QLlcpSocket(this);
-    connect(m_nfcClientSocket, SIGNAL(readyRead()), this, SLOT(readTextClient()));
+    setClientTransport(new NfcLlcpSocketTransport(m_nfcClientSocket, m_nfcClientSocket));
     connect(m_nfcClientSocket, SIGNAL(disconnected()), this, SLOT(clientSocketDisconnected()));
     connect(m_nfcClientSocket, SIGNAL(error(QLlcpSocket::SocketError)), this, SLOT(clientSocketError(QLlcpSocket::SocketError)));
     connect(m_nfcClientSocket, SIGNAL(stateChanged(QLlcpSocket::SocketState)), this, SLOT(clientSocketStateChanged(QLlcpSocket::SocketState)));
@@ -256,6 +330,10 @@ void NfcPeerToPeer::targetDetected(QNearFieldTarget *target)
 
 void NfcPeerToPeer::targetLost(QNearFieldTarget */*target*/)
 {
+    // Discard partially received messages
+    m_ndefDecoder->reset();
+    m_snepManager->reset();
+    abortSnepRequest();
     if (!m_useConnectionLess && m_nfcClientSocket) {
         // Connection-oriented
         m_nfcClientSocket->disconnectFromService();
@@ -282,8 +360,8 @@ void NfcPeerToPeer::handleNewConnection()
 
     // The socket is a child of the server and will therefore be deleted automatically
     m_nfcServerSocket = m_nfcServer->nextPendingConnection();
+    setServerTransport(new NfcLlcpSocketTransport(m_nfcServerSocket, m_nfcServerSocket));
 
-    connect(m_nfcServerSocket, SIGNAL(readyRead()), this, SLOT(readTextServer()));
     connect(m_nfcServerSocket, SIGNAL(error(QLlcpSocket::SocketError)), this, SLOT(serverSocketError(QLlcpSocket::SocketError)));
     connect(m_nfcServerSocket, SIGNAL(stateChanged(QLlcpSocket::SocketState)), this, SLOT(serverSocketStateChanged(QLlcpSocket::SocketState)));
     connect(m_nfcServerSocket, SIGNAL(disconnected()), this, SLOT(serverSocketDisconnected()));
@@ -294,89 +372,129 @@ void NfcPeerToPeer::handleNewConnection()
     sendCachedText();
 }
 
+/*!
+  \brief Read and write the data of the client socket through the
+  \a transport. The SNEP session of the previous transport is discarded.
+  */
+void NfcPeerToPeer::setClientTransport(NfcLlcpTransport *transport)
+{
+    if (m_clientTransport == transport) {
+        return;
+    }
+    if (m_clientTransport) {
+        disconnect(m_clientTransport, SIGNAL(readyRead()), this, SLOT(readTextClient()));
+        m_snepManager->removeSession(m_clientTransport);
+    }
+    m_clientTransport = transport;
+    if (transport) {
+        connect(transport, SIGNAL(readyRead()), this, SLOT(readTextClient()));
+    }
+}
+
+/*!
+  \brief Read and write the data of the connection accepted by the
+  server through the \a transport.
+  */
+void NfcPeerToPeer::setServerTransport(NfcLlcpTransport *transport)
+{
+    if (m_serverTransport == transport) {
+        return;
+    }
+    if (m_serverTransport) {
+        disconnect(m_serverTransport, SIGNAL(readyRead()), this, SLOT(readTextServer()));
+        m_snepManager->removeSession(m_serverTransport);
+    }
+    m_serverTransport = transport;
+    if (transport) {
+        connect(transport, SIGNAL(readyRead()), this, SLOT(readTextServer()));
+    }
+}
+
 void NfcPeerToPeer::readTextClient()
 {
-    readText(m_nfcClientSocket, false);
+    readText(m_clientTransport, false);
 }
 
 void NfcPeerToPeer::readTextServer()
 {
-    readText(m_nfcServerSocket, true);
+    readText(m_serverTransport, true);
 }
 
-void NfcPeerToPeer::readText(QLlcpSocket* socket, const bool isServerSocket)
+void NfcPeerToPeer::readText(NfcLlcpTransport* transport, const bool isServerSocket)
 {
-    if (!socket)
+    if (!transport)
         return;
 
-    bool hasDatagramWaiting = socket->hasPendingDatagrams();
+    bool hasDatagramWaiting = transport->hasPendingDatagrams();
     if (hasDatagramWaiting)
     {
         // Connection-less
-        qint64 datagramSize = socket->pendingDatagramSize();
-        char* rawData = new char[datagramSize];
-        socket->readDatagram ( rawData, datagramSize );
+        QByteArray rawData = transport->readDatagram();
+        const int datagramSize = rawData.size();
 
-        // Check if data is NDEF formatted
-        QNdefMessage containedNdef = QNdefMessage::fromByteArray(rawData);
-        if (containedNdef.count() > 0) {
+        // Check if data is NDEF formatted. Every datagram has to
+        // contain a complete message.
+        NdefStreamDecoder datagramDecoder;
+        if (datagramDecoder.feed(rawData) && datagramDecoder.messageCount() > 0) {
             // NDEF message found
+            QNdefMessage containedNdef = datagramDecoder.lastMessage();
             qDebug() << "Raw NDEF message received (" << containedNdef.count() << " records)";
             emit ndefMessage(containedNdef);
         }
         else
         {
             // No NDEF message found - output raw data
-            QString data = QString::fromUtf8(rawData, datagramSize);
+            QString data = QString::fromUtf8(rawData.constData(), rawData.size());
             QString dataLength;
             dataLength.setNum(datagramSize);
             QString message = (isServerSocket ? "Server" : "Client");
             message.append(" (" + dataLength + "): " + data);
             emit rawMessage(message);
         }
-        delete rawData;
     }
     else
     {
         // Connection-oriented
         // Parse SNEP
         qDebug() << "Received peer-to-peer data";
-        QByteArray rawData = socket->readAll();
-        if (m_appSettings->useSnep()) {
+        QByteArray rawData = transport->readAll();
+        if (m_appSettings && m_appSettings->useSnep()) {
             QString snepAnalysis;
-            QNdefMessage containedNdef = m_snepManager->analyzeSnepMessage(rawData, snepAnalysis);
-            emit rawMessage(snepAnalysis);
-            if (containedNdef.count() > 0) {
-                // NDEF message
-                qDebug() << "SNEP NDEF message received (" << containedNdef.count() << " records)";
-                emit ndefMessage(containedNdef);
-
-                // Send back success response
-                emit sendData(m_snepManager->createSnepSuccessResponse());
-            } else {
-                qDebug() << "No / empty NDEF message contained";
+            QByteArray snepReply;
+            const QList<QNdefMessage> containedNdefs = m_snepManager->analyzeSnepMessage(transport, rawData, snepAnalysis, snepReply);
+            if (!snepAnalysis.isEmpty()) {
+                emit rawMessage(snepAnalysis);
             }
-        } else {
-            // Check if data is NDEF formatted
-            QNdefMessage containedNdef = QNdefMessage::fromByteArray(rawData);
-
-
-            // TODO: Debug
-            QString arrayContents = "";
-            for (int i = 0; i < rawData.size(); ++i) {
-                arrayContents.append(QString("0x") + QString::number(rawData.at(i), 16) + " ");
+            if (!snepReply.isEmpty()) {
+                // Continue / Success / error response, or the remaining
+                // fragments of our request. Always goes back through
+                // the socket the data arrived on.
+                NFC_TRACE_BYTES("SNEP reply", snepReply);
+                transport->write(snepReply);
             }
-            qDebug() << "Raw contents of message:\n" << arrayContents;
-
-
-            if (containedNdef.count() > 0) {
-                // NDEF message found
-                qDebug() << "Raw NDEF message received (" << containedNdef.count() << " records)";
-                emit ndefMessage(containedNdef);
+            foreach (const QNdefMessage &containedNdef, containedNdefs) {
+                if (containedNdef.count() > 0) {
+                    // NDEF message
+                    qDebug() << "SNEP NDEF message received (" << containedNdef.count() << " records)";
+                    emit ndefMessage(containedNdef);
+                }
+            }
+            if (containedNdefs.isEmpty() && !m_snepManager->isReceiving(transport)) {
+                qDebug() << "No / empty NDEF message contained";
             }
-            else
+        } else {
+            NFC_TRACE_BYTES("P2P received", rawData);
+
+            // Check if data is NDEF formatted. The message can be split
+            // over multiple reads - the decoder emits it once complete.
+            // Only start decoding for data that looks like the begin of
+            // a message; other data would often parse as an incomplete
+            // record and be buffered forever instead of being shown.
+            const bool isNdef = !m_ndefDecoder->isIdle() || isNdefMessageStart(rawData);
+            if (!isNdef || !m_ndefDecoder->feed(rawData))
             {
                 // No NDEF message found - output raw data
+                m_ndefDecoder->reset();
                 QString data = QString::fromUtf8(rawData.constData(), rawData.size());
                 QString message = (isServerSocket ? "Server" : "Client");
                 message.append(": " + data);
@@ -386,6 +504,26 @@ void NfcPeerToPeer::readText(QLlcpSocket* socket, const bool isServerSocket)
     }
 }
 
+/*!
+  \brief Complete NDEF message received through a connection-oriented
+  socket without SNEP.
+  */
+void NfcPeerToPeer::streamNdefMessageDecoded(const QNdefMessage &message)
+{
+    qDebug() << "Raw NDEF message received (" << message.count() << " records)";
+    emit ndefMessage(message);
+}
+
+/*!
+  \brief Report the progress of receiving a large record.
+  */
+void NfcPeerToPeer::streamNdefRecordProgress(const int bytesReceived, const int recordLength)
+{
+    if (m_reportingLevel != AppSettings::OnlyImportantReporting) {
+        emit statusMessage("Receiving record: " + QString::number(bytesReceived) + " / " + QString::number(recordLength) + " bytes");
+    }
+}
+
 void NfcPeerToPeer::sendText(const QString& text)
 {
     sendData(text.toUtf8());
@@ -393,81 +531,259 @@ void NfcPeerToPeer::sendText(const QString& text)
 
 void NfcPeerToPeer::sendData(const QByteArray data)
 {
-    bool textQueuedBefore = m_sendDataQueue.isEmpty() ? false : true;
-    m_sendDataQueue = data;
-    if (!sendCachedText()) {
-        if (textQueuedBefore) {
-            emit statusMessage("Enqueued message replaced");
-        } else {
-            emit statusMessage("Message enqueued");
-        }
-    }
+    enqueueFrame(data, NormalSendPriority, false);
 }
 
 void NfcPeerToPeer::sendNdefMessage(const QNdefMessage *message)
+{
+    enqueueNdefMessage(message, NormalSendPriority);
+}
+
+/*!
+  \brief Add the NDEF \a message to the queue of outgoing frames.
+
+  With SNEP, the message is wrapped in a Put request. The next request
+  is only sent once the remote server has responded to the previous
+  one, so multiple messages can be exchanged while the devices are
+  connected.
+
+  \return the id of the frame, which is reported through
+  frameCompleted(), or -1 if the message couldn't be queued.
+  */
+int NfcPeerToPeer::enqueueNdefMessage(const QNdefMessage *message, const int priority)
 {
 #if defined(MEEGO_EDITION_HARMATTAN) && defined(USE_SNEP)
+    Q_UNUSED(priority);
     if (m_snepManagerMeego) {
         m_snepManagerMeego->pushNdef(message);
     }
+    return -1;
 #else
     if (m_appSettings && m_appSettings->useSnep()) {
-        // Wrap in SNEP protocol
-        m_sendDataQueue = m_snepManager->wrapNdefInSnepPut(message);
-    } else {
-        // Directly write NDEF to stream
-        m_sendDataQueue = message->toByteArray();
+        // Wrap in SNEP protocol. Large messages are fragmented when
+        // the request is sent.
+        return enqueueFrame(m_snepManager->wrapNdefInSnepPut(message), priority, true);
+    }
+    // Directly write NDEF to stream
+    return enqueueFrame(message->toByteArray(), priority, false);
+#endif
+}
+
+/*!
+  \brief Returns true if the frame with the \a frameId is waiting
+  to be sent or waiting for the SNEP response.
+  */
+bool NfcPeerToPeer::isFrameQueued(const int frameId) const
+{
+    if (frameId < 0) {
+        return false;
     }
+    if (frameId == m_snepRequestFrameId) {
+        return true;
+    }
+    for (int i = 0; i < m_sendQueue.size(); i++) {
+        if (m_sendQueue.at(i).id == frameId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+  \brief Insert the \a data behind all frames of the same or a higher
+  \a priority and try to send it right away.
+
+  \param snepRequest the data is a complete SNEP request, which has
+  to be answered by the remote server before the next frame is sent.
+  \return the id of the frame, or -1 if the queue is full.
+  */
+int NfcPeerToPeer::enqueueFrame(const QByteArray &data, const int priority, const bool snepRequest)
+{
+    if (m_sendQueue.size() >= MAX_SEND_QUEUE_LENGTH) {
+        emit statusMessage("Send queue full - message dropped");
+        return -1;
+    }
+    OutgoingFrame frame;
+    frame.id = m_nextFrameId++;
+    frame.priority = priority;
+    frame.snepRequest = snepRequest;
+    frame.data = data;
+    int index = m_sendQueue.size();
+    while (index > 0 && m_sendQueue.at(index - 1).priority < priority) {
+        index--;
+    }
+    m_sendQueue.insert(index, frame);
+
     if (!sendCachedText()) {
-        emit statusMessage("Message enqueued");
+        emit statusMessage("Message enqueued (" + QString::number(m_sendQueue.size()) + " waiting)");
+    }
+    return frame.id;
+}
+
+/*!
+  \brief Send a SNEP Get request to the remote device. The server
+  returns the NDEF message that matches the type of the first record
+  of \a requestMessage, which is then emitted through ndefMessage().
+
+  \return the id of the frame, which is reported through
+  frameCompleted(), or -1 if the request couldn't be queued.
+  */
+int NfcPeerToPeer::requestNdefMessage(const QNdefMessage *requestMessage)
+{
+#if defined(MEEGO_EDITION_HARMATTAN) && defined(USE_SNEP)
+    // The SNEP implementation of the platform only supports Put
+    Q_UNUSED(requestMessage);
+    emit statusMessage("SNEP Get is not supported");
+    return -1;
+#else
+    if (!m_appSettings || !m_appSettings->useSnep() || m_useConnectionLess) {
+        emit statusMessage("SNEP Get requires a connection-oriented SNEP connection");
+        return -1;
     }
+    return enqueueFrame(m_snepManager->wrapNdefInSnepGet(requestMessage, SNEP_MAX_MESSAGE_SIZE), HighSendPriority, true);
 #endif
 }
 
+/*!
+  \brief Request the NDEF message of the type name format \a tnf and
+  the \a type from the remote device. The request contains a single
+  empty record of that type.
+  */
+int NfcPeerToPeer::requestNdef(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type)
+{
+    QNdefRecord requestRecord;
+    requestRecord.setTypeNameFormat(tnf);
+    requestRecord.setType(type);
+    QNdefMessage requestMessage(requestRecord);
+    return requestNdefMessage(&requestMessage);
+}
+
+/*!
+  \brief Serve the \a message to remote devices that send a SNEP Get
+  request for the type name format \a tnf and the \a type.
+  */
+void NfcPeerToPeer::setSnepGetResponse(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, const QNdefMessage &message)
+{
+    m_snepManager->setGetResponse(tnf, type, message);
+}
+
+void NfcPeerToPeer::clearSnepGetResponses()
+{
+    m_snepManager->clearGetResponses();
+}
+
+/*!
+  \brief Send the frames of the queue, as long as the connection is
+  ready and no SNEP request is waiting for its response.
+  \return true if at least one frame has been sent.
+  */
 bool NfcPeerToPeer::sendCachedText()
 {
     qDebug(__PRETTY_FUNCTION__);
-    if (!m_sendDataQueue.isEmpty()) {
-
-        if (m_useConnectionLess) {
-            // Connection-less
-            if (m_nfcClientSocket) {
-                // Connection-less doesn't have a server, only uses the client socket
-                m_nfcClientSocket->writeDatagram(m_sendDataQueue.data(), (qint64)m_sendDataQueue.size(), m_nfcTarget, m_nfcPort);
-                m_sendDataQueue.clear();
-                emit statusMessage("Datagram sent");
-                emit nfcSendNdefSuccess();
-                return true;
-            }
+    if (m_sendQueue.isEmpty()) {
+        qDebug() << "NfcPeerToPeer::sendCachedText(): No text cached";
+        return false;
+    }
+    bool frameSent = false;
+    while (!m_sendQueue.isEmpty() && m_snepRequestFrameId < 0) {
+        NfcLlcpTransport *transport = sendTransport();
+        if (!transport || !transport->isWritable()) {
+            // Check before starting the SNEP request, which would
+            // otherwise wait for the response to data that hasn't
+            // been sent.
+            qDebug() << "Connection not ready for sending message";
+            break;
         }
-        else {
-            // Connection-oriented
-            bool messageSent = false;
-            if (m_sendThroughServerSocket && m_nfcServerSocket && m_nfcServerSocket->isOpen() && m_nfcServerSocket->isWritable()) {
-                m_nfcServerSocket->write(m_sendDataQueue);
-                messageSent = true;
-            } else if (!m_sendThroughServerSocket && m_nfcClientSocket && m_nfcClientSocket->isOpen() && m_nfcClientSocket->state() == QLlcpSocket::ConnectedState){
-                m_nfcClientSocket->write(m_sendDataQueue);
-                messageSent = true;
+        const OutgoingFrame &frame = m_sendQueue.first();
+        // Large SNEP requests are fragmented: only the first fragment
+        // is sent before the server responds with Continue.
+        if (!writeFrame(transport, frame.snepRequest ? m_snepManager->startRequest(transport, frame.data) : frame.data)) {
+            if (frame.snepRequest) {
+                m_snepManager->cancelRequest(transport);
             }
-            if (messageSent) {
-                m_sendDataQueue.clear();
-                QString messageText = (m_appSettings && m_appSettings->useSnep() ? "SNEP message sent" : "NDEF message sent");
-                emit statusMessage(messageText);
-                if (m_appSettings && !m_appSettings->useSnep())
-                {
-                    // SNEP: success response from other phone will trigger written signal
-                    // Without SNEP (= here), send success when we managed to send the data through the socket.
-                    emit nfcSendNdefSuccess();
-                }
-                return true;
+            qDebug() << "Writing the message failed";
+            break;
+        }
+        const OutgoingFrame sentFrame = m_sendQueue.takeFirst();
+        frameSent = true;
+        if (m_useConnectionLess) {
+            emit statusMessage("Datagram sent");
+            emit nfcSendNdefSuccess();
+            emit frameCompleted(sentFrame.id, true);
+        } else if (sentFrame.snepRequest) {
+            // SNEP: success response from other phone will trigger
+            // the written signal and sending the next frame.
+            m_snepRequestFrameId = sentFrame.id;
+            emit statusMessage("SNEP message sent");
+        } else {
+            emit statusMessage("NDEF message sent");
+            if (m_appSettings && !m_appSettings->useSnep())
+            {
+                // Without SNEP (= here), send success when we managed to send the data through the socket.
+                emit nfcSendNdefSuccess();
             }
-            qDebug() << "Connection not ready for sending message";
+            emit frameCompleted(sentFrame.id, true);
         }
-    } else {
-        qDebug() << "NfcPeerToPeer::sendCachedText(): No text cached";
     }
-    return false;
+    return frameSent;
+}
+
+/*!
+  \brief Transport of the socket that is configured for sending, or
+  NULL if it doesn't exist.
+  */
+NfcLlcpTransport *NfcPeerToPeer::sendTransport() const
+{
+    if (m_useConnectionLess || !m_sendThroughServerSocket) {
+        // Connection-less doesn't have a server, only uses the client socket
+        return m_clientTransport;
+    }
+    return m_serverTransport;
+}
+
+/*!
+  \brief Write the \a data to the \a transport that is configured for
+  sending, which has to be writable.
+  \return false if the transport failed to send the data.
+  */
+bool NfcPeerToPeer::writeFrame(NfcLlcpTransport *transport, const QByteArray &data)
+{
+    NFC_TRACE_BYTES("P2P send", data);
+    if (m_useConnectionLess) {
+        return transport->writeDatagram(data, m_nfcTarget, m_nfcPort) >= 0;
+    }
+    return transport->write(data) >= 0;
+}
+
+/*!
+  \brief The remote SNEP server responded to the request that has been
+  sent - continue with the next frame of the queue.
+  */
+void NfcPeerToPeer::snepRequestFinished(const bool success)
+{
+    if (m_snepRequestFrameId < 0) {
+        return;
+    }
+    const int frameId = m_snepRequestFrameId;
+    m_snepRequestFrameId = -1;
+    emit frameCompleted(frameId, success);
+    if (!m_sendQueue.isEmpty()) {
+        sendCachedText();
+    }
+}
+
+/*!
+  \brief The connection has been closed while waiting for the response
+  to a SNEP request. The frames that haven't been sent yet stay queued
+  for the next connection.
+  */
+void NfcPeerToPeer::abortSnepRequest()
+{
+    if (m_snepRequestFrameId >= 0) {
+        const int frameId = m_snepRequestFrameId;
+        m_snepRequestFrameId = -1;
+        emit frameCompleted(frameId, false);
+    }
 }
 
 void NfcPeerToPeer::clientSocketDisconnected()
@@ -491,6 +807,7 @@ void NfcPeerToPeer::serverSocketDisconnected()
     if (!m_isResetting && m_nfcServerSocket) {
         m_nfcServerSocket->deleteLater();
         m_nfcServerSocket = NULL;
+        setServerTransport(NULL);
     }
 #endif
 }
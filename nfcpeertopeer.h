@@ -17,19 +17,24 @@
 #define NFCPEERTOPEER_H
 
 #include <QObject>
-#include <QDeclarativeView>
 #include <QTimer>
+#include <QPointer>
 #include <qnearfieldmanager.h>
 #include <qllcpserver.h>
 #include <qllcpsocket.h>
 #include "appsettings.h"
 #include "snepmanager.h"
+#include "nfcllcptransport.h"
+#include "ndefstreamdecoder.h"
 #if defined(MEEGO_EDITION_HARMATTAN) && defined(USE_SNEP)
 #include "snepmanagermeego.h"
 #endif
 
 QTM_USE_NAMESPACE   // Use Qt Mobility namespace
 
+// Maximum number of outgoing frames waiting to be sent
+#define MAX_SEND_QUEUE_LENGTH 32
+
 
 class NfcPeerToPeer : public QObject
 {
@@ -42,13 +47,33 @@ public:
 
     void setAppSettings(AppSettings* appSettings);
     void setNfcManager(QNearFieldManager* nfcManager);
+    void setTransports(NfcLlcpTransport *clientTransport, NfcLlcpTransport *serverTransport);
+    void setSnepFragmentSize(const int fragmentSize);
 
     bool isBusy() const;
+
+    /*! Frames of a higher priority are sent before all frames of
+      a lower priority. Frames of the same priority are sent in
+      the order they have been queued. */
+    enum SendPriority {
+        LowSendPriority = 0,
+        NormalSendPriority = 1,
+        HighSendPriority = 2
+    };
+    int enqueueNdefMessage(const QNdefMessage* message, const int priority);
+    bool isFrameQueued(const int frameId) const;
+
+    void setSnepGetResponse(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, const QNdefMessage &message);
+    void clearSnepGetResponses();
+    int requestNdef(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type);
 signals:
     void rawMessage(const QString& nfcClientMessage);
     void ndefMessage(const QNdefMessage& nfcNdefMessage);
     void statusMessage(const QString& statusMessage);
     void nfcSendNdefSuccess();
+    /*! The frame has been written to the socket or, for SNEP requests,
+      the remote server has responded. */
+    void frameCompleted(const int frameId, const bool success);
     void settingsApplied();
     void busyChanged();
 
@@ -58,6 +83,7 @@ public slots:
     void sendText(const QString& text);
     void sendData(const QByteArray data);
     void sendNdefMessage(const QNdefMessage* message);
+    int requestNdefMessage(const QNdefMessage* requestMessage);
     void targetDetected(QNearFieldTarget *target);
     void targetLost(QNearFieldTarget *target);
 
@@ -77,12 +103,22 @@ private slots:
     void clientSocketError(QLlcpSocket::SocketError socketError);
     void clientSocketStateChanged ( QLlcpSocket::SocketState socketState );
 
+    void streamNdefMessageDecoded(const QNdefMessage &message);
+    void streamNdefRecordProgress(const int bytesReceived, const int recordLength);
+    void snepRequestFinished(const bool success);
+
 private:
     void resetAll();
     void copyNfcUriFromAppSettings();
     void initClientSocket();
-    void readText(QLlcpSocket *socket, const bool isServerSocket);
+    void setClientTransport(NfcLlcpTransport *transport);
+    void setServerTransport(NfcLlcpTransport *transport);
+    NfcLlcpTransport *sendTransport() const;
+    void readText(NfcLlcpTransport *transport, const bool isServerSocket);
+    int enqueueFrame(const QByteArray &data, const int priority, const bool snepRequest);
     bool sendCachedText();
+    bool writeFrame(NfcLlcpTransport *transport, const QByteArray &data);
+    void abortSnepRequest();
     QString convertTargetErrorToString(QNearFieldTarget::Error error);
     QString convertSocketStateToString(QLlcpSocket::SocketState socketState);
     QString convertSocketErrorToString(QLlcpSocket::SocketError socketError);
@@ -100,11 +136,32 @@ private:
     int m_nfcPort;
     QNearFieldManager *m_nfcManager;
     SnepManager* m_snepManager;
+    /*! Incrementally decodes NDEF messages received without SNEP. */
+    NdefStreamDecoder* m_ndefDecoder;
     QNearFieldTarget *m_nfcTarget;
     QLlcpServer *m_nfcServer;
     QLlcpSocket *m_nfcClientSocket;
     QLlcpSocket *m_nfcServerSocket;
-    QByteArray m_sendDataQueue;
+    /*! Data path of the client socket (in case of connection-less the
+      only one). Deleted together with the socket. */
+    QPointer<NfcLlcpTransport> m_clientTransport;
+    /*! Data path of the connection accepted by the server. */
+    QPointer<NfcLlcpTransport> m_serverTransport;
+    /*! The transports have been set through setTransports() - don't
+      create sockets for the NFC hardware. */
+    bool m_transportsInjected;
+    struct OutgoingFrame {
+        int id;
+        int priority;
+        /*! Complete SNEP request, to be answered by the remote server. */
+        bool snepRequest;
+        QByteArray data;
+    };
+    /*! Frames waiting to be sent, ordered by priority. */
+    QList<OutgoingFrame> m_sendQueue;
+    int m_nextFrameId;
+    /*! Id of the sent SNEP request that waits for its response, or -1. */
+    int m_snepRequestFrameId;
     bool m_isResetting;
     // Use connection-less or connection-oriented LLCP.
     // In case of connection-less, will connect to: m_nfcPort
@@ -0,0 +1,439 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "nfcprovisioningqueue.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+
+NfcProvisioningLoader::NfcProvisioningLoader(QObject *parent) :
+    QThread(parent)
+{
+}
+
+/*!
+  \brief Queue file to load the next time the thread is started.
+  */
+void NfcProvisioningLoader::setFileName(const QString &fileName)
+{
+    m_fileName = fileName;
+}
+
+/*!
+  \brief Raw messages built by the last run. Only valid after the
+  thread has finished.
+  */
+QList<QByteArray> NfcProvisioningLoader::messages() const
+{
+    return m_messages;
+}
+
+/*!
+  \brief Errors of the last run, one entry per invalid line. Only valid
+  after the thread has finished.
+  */
+QStringList NfcProvisioningLoader::errors() const
+{
+    return m_errors;
+}
+
+void NfcProvisioningLoader::run()
+{
+    m_messages.clear();
+    m_errors.clear();
+    m_template = NdefMessageTemplate();
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        m_errors.append("Unable to open " + m_fileName + ": " + file.errorString());
+        return;
+    }
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    int lineNumber = 0;
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine();
+        lineNumber++;
+        if (line.trimmed().isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        QString error;
+        if (line.startsWith("template,", Qt::CaseInsensitive)) {
+            if (!loadTemplate(line.mid(9).trimmed(), error)) {
+                m_errors.append("Line " + QString::number(lineNumber) + ": " + error);
+            }
+            continue;
+        }
+        const QByteArray rawMessage = buildMessage(line, error);
+        if (rawMessage.isEmpty()) {
+            m_errors.append("Line " + QString::number(lineNumber) + ": " + error);
+        } else {
+            m_messages.append(rawMessage);
+        }
+    }
+}
+
+/*!
+  \brief Create the raw NDEF message described by one \a line of the
+  queue file.
+  \return the message, or an empty byte array if the line is invalid.
+  */
+QByteArray NfcProvisioningLoader::buildMessage(const QString &line, QString &error) const
+{
+    const int separator = line.indexOf(',');
+    if (separator <= 0) {
+        error = "Missing message type";
+        return QByteArray();
+    }
+    const QString type = line.left(separator).trimmed().toLower();
+    QString value = line.mid(separator + 1);
+    QNdefMessage message;
+    if (type == "uri") {
+        QNdefNfcUriRecord uriRecord;
+        uriRecord.setUri(QUrl(value.trimmed()));
+        message.append(uriRecord);
+    } else if (type == "text" || type.startsWith("text:")) {
+        QNdefNfcTextRecord textRecord;
+        textRecord.setLocale(type == "text" ? "en" : type.mid(5));
+        textRecord.setText(value.replace("\\n", "\n"));
+        message.append(textRecord);
+    } else if (type == "vcard") {
+        QNdefRecord vcardRecord;
+        vcardRecord.setTypeNameFormat(QNdefRecord::Mime);
+        vcardRecord.setType("text/x-vCard");
+        vcardRecord.setPayload(value.replace("\\n", "\r\n").toUtf8());
+        message.append(vcardRecord);
+    } else if (type == "ndef") {
+        const QByteArray rawMessage = QByteArray::fromHex(value.trimmed().toLatin1());
+        ParsedNdefMessage parsedMessage;
+        if (!NdefMessageDecoder::decode(rawMessage, parsedMessage)) {
+            error = "Invalid NDEF message";
+            return QByteArray();
+        }
+        return rawMessage;
+    } else if (type == "fields") {
+        if (!m_template.isValid()) {
+            error = "No valid template for the fields";
+            return QByteArray();
+        }
+        const QStringList fields = value.split(',');
+        if (fields.size() < m_template.fieldCount()) {
+            error = "Template needs " + QString::number(m_template.fieldCount()) + " fields";
+            return QByteArray();
+        }
+        QList<QByteArray> values;
+        for (int i = 0; i < fields.size(); i++) {
+            values.append(fields.at(i).toUtf8());
+        }
+        return m_template.generate(values);
+    } else {
+        error = "Unknown message type: " + type;
+        return QByteArray();
+    }
+    return message.toByteArray();
+}
+
+/*!
+  \brief Compile the raw NDEF message stored in \a templateFileName
+  as the template for the following "fields" lines.
+  */
+bool NfcProvisioningLoader::loadTemplate(const QString &templateFileName, QString &error)
+{
+    m_template = NdefMessageTemplate();
+    const QString path = QFileInfo(m_fileName).dir().absoluteFilePath(templateFileName);
+    QFile templateFile(path);
+    if (!templateFile.open(QIODevice::ReadOnly)) {
+        error = "Unable to open template " + path + ": " + templateFile.errorString();
+        return false;
+    }
+    if (!m_template.compile(templateFile.readAll())) {
+        error = "Invalid NDEF message in template " + path;
+        return false;
+    }
+    qDebug() << "Provisioning template" << path << "with" << m_template.fieldCount() << "fields";
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+NfcProvisioningQueue::NfcProvisioningQueue(QObject *parent) :
+    QObject(parent),
+    m_currentIndex(-1),
+    m_active(false),
+    m_writtenCount(0),
+    m_failedCount(0)
+{
+    m_loader = new NfcProvisioningLoader(this);
+    connect(m_loader, SIGNAL(finished()), this, SLOT(loaderFinished()));
+}
+
+NfcProvisioningQueue::~NfcProvisioningQueue()
+{
+    m_loader->wait();
+}
+
+/*!
+  \brief Start building the messages of the queue file \a fileName
+  on the background thread.
+
+  Returns immediately; loaded() or loadError() is emitted once the
+  messages are available.
+
+  \return false if a queue file is still being loaded.
+  */
+bool NfcProvisioningQueue::load(const QString &fileName)
+{
+    if (m_loader->isRunning()) {
+        return false;
+    }
+    stop();
+    m_fileName = fileName;
+    m_loader->setFileName(fileName);
+    m_loader->start(QThread::LowPriority);
+    return true;
+}
+
+/*!
+  \brief Stop provisioning and close the result log.
+  The progress is kept in the result log.
+  */
+void NfcProvisioningQueue::stop()
+{
+    m_active = false;
+    m_currentIndex = -1;
+    m_resultsFile.close();
+}
+
+/*!
+  \brief Returns true if the queue has been loaded and still contains
+  messages that need to be written.
+  */
+bool NfcProvisioningQueue::isActive() const
+{
+    return m_active;
+}
+
+int NfcProvisioningQueue::count() const
+{
+    return m_messages.size();
+}
+
+int NfcProvisioningQueue::remainingCount() const
+{
+    return m_messages.size() - m_doneIndexes.size();
+}
+
+/*!
+  \brief Index of the message for the next tag, which is the line
+  number within the valid lines of the queue file (0-based).
+  */
+int NfcProvisioningQueue::currentIndex() const
+{
+    return m_currentIndex;
+}
+
+QNdefMessage NfcProvisioningQueue::currentMessage() const
+{
+    return QNdefMessage::fromByteArray(currentRawMessage());
+}
+
+QByteArray NfcProvisioningQueue::currentRawMessage() const
+{
+    if (m_currentIndex < 0 || m_currentIndex >= m_messages.size()) {
+        return QByteArray();
+    }
+    return m_messages.at(m_currentIndex);
+}
+
+/*!
+  \brief Returns true if a message of the queue has already been
+  written successfully to the tag \a tagUid.
+  */
+bool NfcProvisioningQueue::isProvisioned(const QByteArray &tagUid) const
+{
+    return !tagUid.isEmpty() && m_doneUids.contains(tagUid);
+}
+
+/*!
+  \brief The tag \a tagUid has been touched - start measuring the time
+  until its result is reported.
+
+  \return false if the tag has already been provisioned and must not
+  be written again.
+  */
+bool NfcProvisioningQueue::startTag(const QByteArray &tagUid)
+{
+    if (isProvisioned(tagUid)) {
+        return false;
+    }
+    m_tagTimer.start();
+    if (!m_sessionTimer.isValid()) {
+        m_sessionTimer.start();
+    }
+    return true;
+}
+
+/*!
+  \brief Log the result of writing the current message to the tag
+  \a tagUid. If successful, the queue advances to the next message.
+
+  \param detail additional info for the log, e.g., the error message.
+  */
+void NfcProvisioningQueue::reportResult(const QByteArray &tagUid, const bool success, const QString &detail)
+{
+    if (!m_active) {
+        return;
+    }
+    const qint64 msecs = m_tagTimer.isValid() ? m_tagTimer.elapsed() : 0;
+    appendResult(tagUid, success, msecs, detail);
+    if (success) {
+        m_writtenCount++;
+        m_tagLatency.add(msecs * 1000000);
+        m_doneIndexes.insert(m_currentIndex);
+        if (!tagUid.isEmpty()) {
+            m_doneUids.insert(tagUid);
+        }
+        advance();
+    } else {
+        m_failedCount++;
+    }
+}
+
+/*!
+  \brief Number of tags written successfully in the current session.
+  */
+int NfcProvisioningQueue::writtenCount() const
+{
+    return m_writtenCount;
+}
+
+int NfcProvisioningQueue::failedCount() const
+{
+    return m_failedCount;
+}
+
+/*!
+  \brief Throughput of the current session, from the first touched tag
+  until now.
+  */
+double NfcProvisioningQueue::tagsPerMinute() const
+{
+    if (!m_sessionTimer.isValid() || m_writtenCount == 0) {
+        return 0.0;
+    }
+    const qint64 msecs = qMax(Q_INT64_C(1), m_sessionTimer.elapsed());
+    return m_writtenCount * 60000.0 / msecs;
+}
+
+QString NfcProvisioningQueue::statisticsToString() const
+{
+    return QString::number(m_writtenCount) + " written, " + QString::number(m_failedCount) + " failed, "
+            + QString::number(remainingCount()) + " remaining, "
+            + QString::number(tagsPerMinute(), 'f', 1) + " tags/min\nPer tag: " + m_tagLatency.toString();
+}
+
+void NfcProvisioningQueue::loaderFinished()
+{
+    m_messages = m_loader->messages();
+    const QStringList errors = m_loader->errors();
+    if (!errors.isEmpty()) {
+        // Don't provision a partial queue - the indexes of the
+        // result log would no longer match the queue file.
+        m_messages.clear();
+        emit loadError(errors.join("\n"));
+        return;
+    }
+    if (m_messages.isEmpty()) {
+        emit loadError("No messages in " + m_fileName);
+        return;
+    }
+
+    readResults();
+    m_resultsFile.setFileName(m_fileName + PROVISIONING_RESULTS_SUFFIX);
+    if (!m_resultsFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        m_messages.clear();
+        emit loadError("Unable to open the result log: " + m_resultsFile.errorString());
+        return;
+    }
+    m_writtenCount = 0;
+    m_failedCount = 0;
+    m_sessionTimer.invalidate();
+    m_tagLatency = NfcLatencyCounter();
+    m_active = true;
+    m_currentIndex = -1;
+    advance();
+    emit loaded(m_messages.size(), remainingCount());
+}
+
+/*!
+  \brief Collect the indexes of the messages and the UIDs of the tags
+  that have been written successfully according to an existing result log.
+  */
+void NfcProvisioningQueue::readResults()
+{
+    m_doneIndexes.clear();
+    m_doneUids.clear();
+    QFile file(m_fileName + PROVISIONING_RESULTS_SUFFIX);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    while (!file.atEnd()) {
+        const QList<QByteArray> fields = file.readLine().split(',');
+        if (fields.size() < 3 || fields.at(2) != "ok") {
+            continue;
+        }
+        bool ok;
+        const int index = fields.at(0).toInt(&ok);
+        if (ok && index >= 0 && index < m_messages.size()) {
+            m_doneIndexes.insert(index);
+        }
+        const QByteArray tagUid = QByteArray::fromHex(fields.at(1));
+        if (!tagUid.isEmpty()) {
+            m_doneUids.insert(tagUid);
+        }
+    }
+    qDebug() << "Resuming provisioning:" << m_doneIndexes.size() << "of" << m_messages.size() << "already written to" << m_doneUids.size() << "tags";
+}
+
+/*!
+  \brief Move to the next message that hasn't been written yet.
+  Emits finished() if there is none.
+  */
+void NfcProvisioningQueue::advance()
+{
+    do {
+        m_currentIndex++;
+    } while (m_currentIndex < m_messages.size() && m_doneIndexes.contains(m_currentIndex));
+    if (m_currentIndex >= m_messages.size()) {
+        stop();
+        emit finished();
+    }
+}
+
+void NfcProvisioningQueue::appendResult(const QByteArray &tagUid, const bool success, const qint64 msecs, const QString &detail)
+{
+    if (!m_resultsFile.isOpen()) {
+        return;
+    }
+    // Keep one line per tag
+    QString cleanDetail = detail;
+    cleanDetail.replace('\n', ' ').replace(',', ';');
+    const QString line = QString::number(m_currentIndex) + "," + tagUid.toHex() + ","
+            + (success ? "ok" : "failed") + "," + QString::number(msecs) + ","
+            + QDateTime::currentDateTime().toString(Qt::ISODate) + "," + cleanDetail + "\n";
+    m_resultsFile.write(line.toUtf8());
+    // Make sure the progress survives a crash of the app
+    m_resultsFile.flush();
+}
@@ -0,0 +1,176 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NFCPROVISIONINGQUEUE_H
+#define NFCPROVISIONINGQUEUE_H
+
+#include <QObject>
+#include <QThread>
+#include <QDebug>
+#include <QFile>
+#include <QSet>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QNdefMessage>
+#include <QNdefRecord>
+#include <QNdefNfcUriRecord>
+#include <QNdefNfcTextRecord>
+#include "ndefmessagedecoder.h"
+#include "ndefmessagetemplate.h"
+#include "nfclogwriter.h"
+
+/*! Suffix appended to the file name of the queue for the result log. */
+#define PROVISIONING_RESULTS_SUFFIX ".results.csv"
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Builds the NDEF messages of a provisioning queue file on a
+  background thread.
+
+  Each line of the file describes the message for one tag, as the type
+  of the message and its contents, separated by the first comma:
+  - uri,http://www.nokia.com/
+  - text,Hello world  (or text:de,Hallo Welt for a specific language)
+  - vcard,BEGIN:VCARD\nVERSION:3.0\nFN:Jane Doe\nEND:VCARD
+  - ndef,d1010f5402656e48656c6c6f  (complete raw message as hex)
+  - fields,0001,Jane Doe  (message generated from the current template)
+
+  "\n" in text and vCard contents is converted to a line break. Empty
+  lines and lines starting with # are ignored.
+
+  A line "template,<file>" loads a raw NDEF message with the
+  placeholders $0 to $9 (see NdefMessageTemplate), e.g., a message
+  saved from the editor. Relative file names are resolved from the
+  directory of the queue file. Each following "fields" line generates
+  a message from the template, with the comma separated values
+  replacing the placeholders - without building and serializing
+  a QNdefMessage for every tag.
+
+  The results are only accessed after the thread has finished.
+  */
+class NfcProvisioningLoader : public QThread
+{
+    Q_OBJECT
+public:
+    explicit NfcProvisioningLoader(QObject *parent = 0);
+
+    void setFileName(const QString &fileName);
+    QList<QByteArray> messages() const;
+    QStringList errors() const;
+
+protected:
+    void run();
+
+private:
+    QByteArray buildMessage(const QString &line, QString &error) const;
+    bool loadTemplate(const QString &templateFileName, QString &error);
+
+private:
+    QString m_fileName;
+    /*! Template for the "fields" lines, set by the last "template" line. */
+    NdefMessageTemplate m_template;
+    /*! Raw messages, in the order of the lines of the file. */
+    QList<QByteArray> m_messages;
+    QStringList m_errors;
+};
+
+/*!
+  \brief Queue of distinct NDEF messages, to write a different message
+  to each touched tag, e.g., on a production line.
+
+  load() prebuilds all messages of the queue file on a background
+  thread (NfcProvisioningLoader) and emits loaded() afterwards.
+  currentMessage() is the message for the next tag. Once it has been
+  written and verified, reportResult() advances the queue. Failed tags
+  get the same message again on the next touch.
+
+  Each result is appended to the result log next to the queue file
+  (PROVISIONING_RESULTS_SUFFIX), as a line of
+  "index,uid,result,milliseconds,timestamp,detail". The log is flushed
+  after every tag. When the same queue file is loaded again, messages
+  that have already been written successfully according to the log
+  are skipped, so that provisioning resumes after a crash.
+
+  The UIDs of all tags that have been written successfully are kept
+  as well (also from the log), so that a tag touched again or staying
+  in the field isn't overwritten with the next message.
+  */
+class NfcProvisioningQueue : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NfcProvisioningQueue(QObject *parent = 0);
+    ~NfcProvisioningQueue();
+
+    bool load(const QString &fileName);
+    void stop();
+    bool isActive() const;
+
+    int count() const;
+    int remainingCount() const;
+    int currentIndex() const;
+    QNdefMessage currentMessage() const;
+    QByteArray currentRawMessage() const;
+
+    bool isProvisioned(const QByteArray &tagUid) const;
+    bool startTag(const QByteArray &tagUid);
+    void reportResult(const QByteArray &tagUid, const bool success, const QString &detail);
+
+    int writtenCount() const;
+    int failedCount() const;
+    double tagsPerMinute() const;
+    QString statisticsToString() const;
+
+signals:
+    /*! All messages of the queue file have been built.
+      \a remaining messages haven't been written yet. */
+    void loaded(int count, int remaining);
+    void loadError(const QString &errorMessage);
+    /*! The last message of the queue has been written. */
+    void finished();
+
+private slots:
+    void loaderFinished();
+
+private:
+    void readResults();
+    void advance();
+    void appendResult(const QByteArray &tagUid, const bool success, const qint64 msecs, const QString &detail);
+
+private:
+    NfcProvisioningLoader *m_loader;
+    QString m_fileName;
+    QList<QByteArray> m_messages;
+    /*! Indexes of the messages that have been written successfully,
+      including the previous sessions of the same queue file. */
+    QSet<int> m_doneIndexes;
+    /*! UIDs of the tags that have been written successfully, including
+      the previous sessions of the same queue file. */
+    QSet<QByteArray> m_doneUids;
+    /*! Index of the message for the next tag, or -1. */
+    int m_currentIndex;
+    bool m_active;
+    QFile m_resultsFile;
+
+    // Statistics of the current session
+    int m_writtenCount;
+    int m_failedCount;
+    QElapsedTimer m_sessionTimer;
+    QElapsedTimer m_tagTimer;
+    NfcLatencyCounter m_tagLatency;
+};
+
+#endif // NFCPROVISIONINGQUEUE_H
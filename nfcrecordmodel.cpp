@@ -49,6 +49,11 @@ void NfcRecordModel::setNfcStats(NfcStats *nfcStats)
     m_nfcModelToNdef->setNfcStats(nfcStats);
 }
 
+void NfcRecordModel::setLogWriter(NfcLogWriter *logWriter)
+{
+    m_nfcModelToNdef->setLogWriter(logWriter);
+}
+
 /*!
   \brief Convert all the record items currently stored in the model
   to a QNdefMessage.
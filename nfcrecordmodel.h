@@ -60,6 +60,7 @@ public:
     ~NfcRecordModel();
 
     void setNfcStats(NfcStats* nfcStats);
+    void setLogWriter(NfcLogWriter* logWriter);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
     QVariant data(const QModelIndex &index, int role) const;
@@ -0,0 +1,152 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "nfcloopbacktransport.h"
+#include <QTimer>
+
+NfcLoopbackTransport::NfcLoopbackTransport(QObject *parent) :
+    NfcLlcpTransport(parent),
+    m_segmentSize(0),
+    m_readyReadPending(false),
+    m_bytesWritten(0)
+{
+}
+
+/*!
+  \brief Create two transports that are connected to each other.
+  */
+void NfcLoopbackTransport::createPair(NfcLoopbackTransport *&first, NfcLoopbackTransport *&second, QObject *parent)
+{
+    first = new NfcLoopbackTransport(parent);
+    second = new NfcLoopbackTransport(parent);
+    first->connectTo(second);
+    second->connectTo(first);
+}
+
+/*!
+  \brief Deliver all data written to this transport to the \a peer.
+  Only connects one direction.
+  */
+void NfcLoopbackTransport::connectTo(NfcLoopbackTransport *peer)
+{
+    m_peer = peer;
+}
+
+/*!
+  \brief Maximum number of bytes returned by a single call to
+  readAll(), e.g., the MIU of the simulated link. 0 for no limit.
+  */
+void NfcLoopbackTransport::setSegmentSize(const int segmentSize)
+{
+    m_segmentSize = qMax(0, segmentSize);
+}
+
+bool NfcLoopbackTransport::isWritable() const
+{
+    return !m_peer.isNull();
+}
+
+qint64 NfcLoopbackTransport::write(const QByteArray &data)
+{
+    if (!m_peer) {
+        return -1;
+    }
+    m_peer->receive(data);
+    m_bytesWritten += data.size();
+    return data.size();
+}
+
+QByteArray NfcLoopbackTransport::readAll()
+{
+    if (m_segmentSize <= 0 || m_readBuffer.size() <= m_segmentSize) {
+        QByteArray data = m_readBuffer;
+        m_readBuffer.clear();
+        return data;
+    }
+    // Deliver the next segment with another readyRead()
+    const QByteArray segment = m_readBuffer.left(m_segmentSize);
+    m_readBuffer.remove(0, m_segmentSize);
+    scheduleReadyRead();
+    return segment;
+}
+
+bool NfcLoopbackTransport::hasPendingDatagrams() const
+{
+    return !m_datagrams.isEmpty();
+}
+
+QByteArray NfcLoopbackTransport::readDatagram()
+{
+    if (m_datagrams.isEmpty()) {
+        return QByteArray();
+    }
+    return m_datagrams.takeFirst();
+}
+
+/*!
+  \brief Send the datagram to the peer; the \a target and the \a port
+  are ignored.
+  */
+qint64 NfcLoopbackTransport::writeDatagram(const QByteArray &data, QNearFieldTarget *target, const quint8 port)
+{
+    Q_UNUSED(target);
+    Q_UNUSED(port);
+    if (!m_peer) {
+        return -1;
+    }
+    m_peer->receiveDatagram(data);
+    m_bytesWritten += data.size();
+    return data.size();
+}
+
+/*!
+  \brief Total number of bytes written through this transport.
+  */
+qint64 NfcLoopbackTransport::bytesWritten() const
+{
+    return m_bytesWritten;
+}
+
+void NfcLoopbackTransport::receive(const QByteArray &data)
+{
+    m_readBuffer.append(data);
+    scheduleReadyRead();
+}
+
+void NfcLoopbackTransport::receiveDatagram(const QByteArray &datagram)
+{
+    m_datagrams.append(datagram);
+    scheduleReadyRead();
+}
+
+/*!
+  \brief Emit readyRead() from the event loop. Multiple writes before
+  the receiver gets to read the data result in a single signal.
+  */
+void NfcLoopbackTransport::scheduleReadyRead()
+{
+    if (!m_readyReadPending) {
+        m_readyReadPending = true;
+        QTimer::singleShot(0, this, SLOT(deliver()));
+    }
+}
+
+void NfcLoopbackTransport::deliver()
+{
+    m_readyReadPending = false;
+    if (!m_readBuffer.isEmpty() || !m_datagrams.isEmpty()) {
+        emit readyRead();
+    }
+}
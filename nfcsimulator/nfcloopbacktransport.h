@@ -0,0 +1,78 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NFCLOOPBACKTRANSPORT_H
+#define NFCLOOPBACKTRANSPORT_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QPointer>
+#include "nfcllcptransport.h"
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Local LLCP transport, connected to a second loopback transport
+  that receives all data written to this one and vice versa.
+
+  Like with a real LLCP link, written data is delivered asynchronously:
+  the peer emits readyRead() from the event loop. With a segment size
+  set, readAll() returns at most that many bytes at once and the rest
+  is announced with another readyRead(), like the information fields
+  of separate LLCP I PDUs. This way, the reassembly of the receiver
+  gets exercised as well.
+
+  Use createPair() to create two connected transports.
+  */
+class NfcLoopbackTransport : public NfcLlcpTransport
+{
+    Q_OBJECT
+public:
+    explicit NfcLoopbackTransport(QObject *parent = 0);
+
+    static void createPair(NfcLoopbackTransport *&first, NfcLoopbackTransport *&second, QObject *parent = 0);
+    void connectTo(NfcLoopbackTransport *peer);
+    void setSegmentSize(const int segmentSize);
+
+    bool isWritable() const;
+    qint64 write(const QByteArray &data);
+    QByteArray readAll();
+    bool hasPendingDatagrams() const;
+    QByteArray readDatagram();
+    qint64 writeDatagram(const QByteArray &data, QNearFieldTarget *target, const quint8 port);
+
+    qint64 bytesWritten() const;
+
+private slots:
+    void deliver();
+
+private:
+    void receive(const QByteArray &data);
+    void receiveDatagram(const QByteArray &datagram);
+    void scheduleReadyRead();
+
+private:
+    QPointer<NfcLoopbackTransport> m_peer;
+    /*! Maximum number of bytes returned by readAll(), 0 for no limit. */
+    int m_segmentSize;
+    /*! Stream data received from the peer, not read yet. */
+    QByteArray m_readBuffer;
+    QList<QByteArray> m_datagrams;
+    bool m_readyReadPending;
+    qint64 m_bytesWritten;
+};
+
+#endif // NFCLOOPBACKTRANSPORT_H
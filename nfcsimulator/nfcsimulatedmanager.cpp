@@ -0,0 +1,165 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "nfcsimulatedmanager.h"
+
+NfcSimulatedManager::NfcSimulatedManager(QObject *parent) :
+    QObject(parent)
+{
+}
+
+/*!
+  \brief Timing and failure behavior of the targets created
+  from now on.
+  */
+void NfcSimulatedManager::setConfig(const NfcSimulatorConfig &config)
+{
+    m_config = config;
+}
+
+NfcSimulatorConfig NfcSimulatedManager::config() const
+{
+    return m_config;
+}
+
+/*!
+  \brief Restart the random numbers for UIDs, latency jitter and
+  failures, to reproduce a simulation run.
+  */
+void NfcSimulatedManager::setSeed(const quint32 seed)
+{
+    m_random = NfcSimulatorRandom(seed);
+}
+
+/*!
+  \brief Create a new, empty NDEF formatted tag.
+  \param size size of the data area (Type 2) or NDEF file (Type 4).
+  0 for the default size. Type 1 tags always have static memory.
+  */
+QSharedPointer<NfcSimulatedTagMemory> NfcSimulatedManager::createTag(const SimulatedTagType tagType, const int size)
+{
+    switch (tagType) {
+    case SimulatedType1:
+        return QSharedPointer<NfcSimulatedTagMemory>(new NfcSimulatedType1Memory(createUid(7)));
+    case SimulatedType2:
+        return QSharedPointer<NfcSimulatedTagMemory>(new NfcSimulatedType2Memory(createUid(7), size > 0 ? size : SIM_TYPE2_DEFAULT_DATA_SIZE));
+    case SimulatedType4:
+        return QSharedPointer<NfcSimulatedTagMemory>(new NfcSimulatedType4Memory(createUid(7), size > 0 ? size : SIM_TYPE4_DEFAULT_NDEF_FILE_SIZE));
+    default:
+        return QSharedPointer<NfcSimulatedTagMemory>();
+    }
+}
+
+/*!
+  \brief Bring the \a tag into range. The target that was in range
+  before is removed first.
+  \return the new target, which is also passed to targetDetected().
+  */
+QNearFieldTarget *NfcSimulatedManager::touch(const QSharedPointer<NfcSimulatedTagMemory> &tag)
+{
+    if (!tag) {
+        return NULL;
+    }
+    QNearFieldTarget *target = NULL;
+    const quint32 seed = m_random.next();
+    switch (tag->type()) {
+    case QNearFieldTarget::NfcTagType1:
+        target = new NfcSimulatedTagType1(tag, QByteArray(), m_config, seed);
+        break;
+    case QNearFieldTarget::NfcTagType2:
+        target = new NfcSimulatedTagType2(tag, QByteArray(), m_config, seed);
+        break;
+    default:
+        target = new NfcSimulatedTagType4(tag, QByteArray(), m_config, seed);
+        break;
+    }
+    activateTarget(target);
+    return target;
+}
+
+/*!
+  \brief Bring an NFC Forum device with LLCP access into range.
+  */
+QNearFieldTarget *NfcSimulatedManager::touchPeer()
+{
+    QNearFieldTarget *target = new NfcSimulatedPeer(QSharedPointer<NfcSimulatedTagMemory>(), createUid(10), m_config, m_random.next());
+    activateTarget(target);
+    return target;
+}
+
+QNearFieldTarget *NfcSimulatedManager::currentTarget() const
+{
+    return m_currentTarget;
+}
+
+/*!
+  \brief Touch the simulated tag of the type (SimulatedTagType), e.g.,
+  from the QML UI. Each type has a single tag, which keeps its
+  contents between the touches.
+  */
+void NfcSimulatedManager::touchTag(const int tagType)
+{
+    if (tagType < 0 || tagType >= SimulatedPeer) {
+        touchPeer();
+        return;
+    }
+    if (!m_tags[tagType]) {
+        m_tags[tagType] = createTag((SimulatedTagType)tagType);
+    }
+    touch(m_tags[tagType]);
+}
+
+/*!
+  \brief Take the current target out of range.
+  */
+void NfcSimulatedManager::removeTarget()
+{
+    if (m_currentTarget) {
+        QNearFieldTarget *target = m_currentTarget;
+        m_currentTarget = NULL;
+        disconnect(target, SIGNAL(disconnected()), this, SLOT(targetDisconnected()));
+        emit targetLost(target);
+    }
+}
+
+/*!
+  \brief The target simulated that it went out of range.
+  */
+void NfcSimulatedManager::targetDisconnected()
+{
+    if (sender() == m_currentTarget) {
+        removeTarget();
+    }
+}
+
+QByteArray NfcSimulatedManager::createUid(const int length)
+{
+    QByteArray uid;
+    // NXP manufacturer code
+    uid.append(char(0x04));
+    while (uid.size() < length) {
+        uid.append(char(m_random.next() & 0xFF));
+    }
+    return uid;
+}
+
+void NfcSimulatedManager::activateTarget(QNearFieldTarget *target)
+{
+    removeTarget();
+    m_currentTarget = target;
+    connect(target, SIGNAL(disconnected()), this, SLOT(targetDisconnected()));
+    emit targetDetected(target);
+}
@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NFCSIMULATEDMANAGER_H
+#define NFCSIMULATEDMANAGER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QNearFieldTarget>
+#include "nfcsimulatedtagmemory.h"
+#include "nfcsimulatedtarget.h"
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Simulates touching tags and devices, as a replacement
+  for the QNearFieldManager during development and benchmarks.
+
+  Connect the targetDetected() and targetLost() signals to the
+  same slots as the signals of the QNearFieldManager. Like with
+  the QNearFieldManager, the receiver of targetLost() is
+  responsible for deleting the target.
+
+  The physical tags are represented by their tag memory, which can
+  be touched again and again - every touch creates a new target.
+  */
+class NfcSimulatedManager : public QObject
+{
+    Q_OBJECT
+    Q_ENUMS(SimulatedTagType)
+public:
+    enum SimulatedTagType {
+        SimulatedType1,
+        SimulatedType2,
+        SimulatedType4,
+        SimulatedPeer
+    };
+
+    explicit NfcSimulatedManager(QObject *parent = 0);
+
+    void setConfig(const NfcSimulatorConfig &config);
+    NfcSimulatorConfig config() const;
+    void setSeed(const quint32 seed);
+
+    QSharedPointer<NfcSimulatedTagMemory> createTag(const SimulatedTagType tagType, const int size = 0);
+    QNearFieldTarget *touch(const QSharedPointer<NfcSimulatedTagMemory> &tag);
+    QNearFieldTarget *touchPeer();
+    QNearFieldTarget *currentTarget() const;
+
+public slots:
+    void touchTag(const int tagType);
+    void removeTarget();
+
+signals:
+    void targetDetected(QNearFieldTarget *target);
+    void targetLost(QNearFieldTarget *target);
+
+private slots:
+    void targetDisconnected();
+
+private:
+    QByteArray createUid(const int length);
+    void activateTarget(QNearFieldTarget *target);
+
+private:
+    NfcSimulatorConfig m_config;
+    NfcSimulatorRandom m_random;
+    QPointer<QNearFieldTarget> m_currentTarget;
+    /*! Tags touched through touchTag(), so that they keep their contents. */
+    QSharedPointer<NfcSimulatedTagMemory> m_tags[SimulatedPeer];
+};
+
+#endif // NFCSIMULATEDMANAGER_H
@@ -0,0 +1,586 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "nfcsimulatedtagmemory.h"
+
+NfcSimulatedTagMemory::NfcSimulatedTagMemory(const QNearFieldTarget::Type type, const QByteArray &uid, const int size) :
+    m_type(type),
+    m_uid(uid),
+    m_image(size, char(0)),
+    m_locked(size, false),
+    m_tlvAreaStart(0),
+    m_tlvAreaEnd(0),
+    m_bytesWritten(0)
+{
+}
+
+NfcSimulatedTagMemory::~NfcSimulatedTagMemory()
+{
+}
+
+QNearFieldTarget::Type NfcSimulatedTagMemory::type() const
+{
+    return m_type;
+}
+
+QByteArray NfcSimulatedTagMemory::uid() const
+{
+    return m_uid;
+}
+
+/*!
+  \brief The complete memory contents of the tag.
+  */
+const QByteArray &NfcSimulatedTagMemory::image() const
+{
+    return m_image;
+}
+
+/*!
+  \brief Find the NDEF TLV in the TLV area of the tag memory and
+  return its value.
+  \return false if the tag doesn't contain an NDEF TLV.
+  */
+bool NfcSimulatedTagMemory::readNdefMessage(QByteArray &rawMessage) const
+{
+    int pos = m_tlvAreaStart;
+    while (pos < m_tlvAreaEnd) {
+        const quint8 tlvType = (quint8)m_image.at(pos);
+        if (tlvType == SIM_TLV_NULL) {
+            pos++;
+            continue;
+        }
+        if (tlvType == SIM_TLV_TERMINATOR || pos + 1 >= m_tlvAreaEnd) {
+            break;
+        }
+        int length = (quint8)m_image.at(pos + 1);
+        int valuePos = pos + 2;
+        if (length == 0xFF) {
+            // Three byte length format
+            if (pos + 3 >= m_tlvAreaEnd) {
+                break;
+            }
+            length = ((quint8)m_image.at(pos + 2) << 8) | (quint8)m_image.at(pos + 3);
+            valuePos = pos + 4;
+        }
+        if (valuePos + length > m_tlvAreaEnd) {
+            break;
+        }
+        if (tlvType == SIM_TLV_NDEF) {
+            rawMessage = m_image.mid(valuePos, length);
+            return true;
+        }
+        pos = valuePos + length;
+    }
+    return false;
+}
+
+/*!
+  \brief Store the message in an NDEF TLV at the start of the TLV area,
+  followed by a terminator TLV if there is enough space.
+
+  \param tearAfterBytes simulate removing the tag while writing: only
+  the specified number of bytes is written. -1 to write all bytes.
+  \return false if the message doesn't fit, the memory is locked or
+  the write has been torn.
+  */
+bool NfcSimulatedTagMemory::writeNdefMessage(const QByteArray &rawMessage, const int tearAfterBytes)
+{
+    if (isReadOnly() || rawMessage.size() > ndefCapacity()) {
+        return false;
+    }
+    QByteArray tlv;
+    tlv.append(char(SIM_TLV_NDEF));
+    if (rawMessage.size() < 0xFF) {
+        tlv.append(char(rawMessage.size()));
+    } else {
+        tlv.append(char(0xFF));
+        tlv.append(char(rawMessage.size() >> 8));
+        tlv.append(char(rawMessage.size() & 0xFF));
+    }
+    tlv.append(rawMessage);
+    if (m_tlvAreaStart + tlv.size() < m_tlvAreaEnd) {
+        tlv.append(char(SIM_TLV_TERMINATOR));
+    }
+    const int writeCount = (tearAfterBytes >= 0 && tearAfterBytes < tlv.size()) ? tearAfterBytes : tlv.size();
+    for (int i = 0; i < writeCount; i++) {
+        if (!writeByte(m_tlvAreaStart + i, (quint8)tlv.at(i))) {
+            return false;
+        }
+    }
+    return writeCount == tlv.size();
+}
+
+/*!
+  \brief Maximum size of an NDEF message that fits into the tag.
+  */
+int NfcSimulatedTagMemory::ndefCapacity() const
+{
+    const int areaSize = m_tlvAreaEnd - m_tlvAreaStart;
+    int capacity = areaSize - 2;
+    if (capacity >= 0xFF) {
+        capacity = areaSize - 4;
+    }
+    return qMax(0, capacity);
+}
+
+/*!
+  \brief Make the tag read-only by setting the write access condition
+  of the capability container, which directly precedes the TLV area
+  on Type 1 and 2 tags. Subclasses additionally set the lock bits.
+  */
+void NfcSimulatedTagMemory::setReadOnly()
+{
+    if (m_tlvAreaStart > 0) {
+        m_image[m_tlvAreaStart - 1] = char(0x0F);
+        lockRange(m_tlvAreaStart - 4, m_tlvAreaEnd - m_tlvAreaStart + 4);
+    }
+}
+
+bool NfcSimulatedTagMemory::isReadOnly() const
+{
+    return m_tlvAreaStart > 0 && (m_image.at(m_tlvAreaStart - 1) & 0x0F) == 0x0F;
+}
+
+/*!
+  \brief Reset the state that only lasts while the tag is in range.
+  */
+void NfcSimulatedTagMemory::resetSession()
+{
+}
+
+qint64 NfcSimulatedTagMemory::bytesWritten() const
+{
+    return m_bytesWritten;
+}
+
+void NfcSimulatedTagMemory::resetBytesWritten()
+{
+    m_bytesWritten = 0;
+}
+
+/*!
+  \brief Write a single byte, unless it has been locked.
+  */
+bool NfcSimulatedTagMemory::writeByte(const int address, const quint8 value)
+{
+    if (address < 0 || address >= m_image.size() || m_locked.testBit(address)) {
+        return false;
+    }
+    m_image[address] = char(value);
+    m_bytesWritten++;
+    return true;
+}
+
+void NfcSimulatedTagMemory::lockRange(const int address, const int length)
+{
+    const int end = qMin(address + length, m_locked.size());
+    for (int i = qMax(0, address); i < end; i++) {
+        m_locked.setBit(i);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+  Type 1 static memory layout (8 byte blocks):
+  Block 0:      UID (7 bytes) + reserved
+  Block 1:      Capability container (bytes 8 - 11), data
+  Block 2 - C:  Data
+  Block D:      Reserved
+  Block E:      Lock bytes 0 / 1, OTP
+  */
+NfcSimulatedType1Memory::NfcSimulatedType1Memory(const QByteArray &uid) :
+    NfcSimulatedTagMemory(QNearFieldTarget::NfcTagType1, uid.left(7), SIM_TYPE1_MEMORY_SIZE)
+{
+    m_image.replace(0, m_uid.size(), m_uid);
+    m_image[8] = char(SIM_NDEF_MAGIC_NUMBER);
+    m_image[9] = char(0x10);    // Version 1.0
+    m_image[10] = char(0x0E);   // (14 + 1) * 8 = 120 bytes
+    m_image[11] = char(0x00);   // Read / write access
+    m_tlvAreaStart = 12;
+    m_tlvAreaEnd = 0x0D * 8;
+    // Empty NDEF message
+    m_image[12] = char(SIM_TLV_NDEF);
+    m_image[13] = char(0x00);
+    m_image[14] = char(SIM_TLV_TERMINATOR);
+    applyLockBits();
+}
+
+/*!
+  \brief Emulate the Type 1 commands, in the format sent by
+  QNearFieldTagType1: command, address, data, UID (4 bytes).
+  */
+bool NfcSimulatedType1Memory::processCommand(const QByteArray &command, QVariant &response)
+{
+    if (command.size() < 3) {
+        return false;
+    }
+    const quint8 address = (quint8)command.at(1);
+    const quint8 data = (quint8)command.at(2);
+    switch ((quint8)command.at(0)) {
+    case 0x78: {
+        // RID - header ROM and UID
+        QByteArray identification;
+        identification.append(char(SIM_TYPE1_HR0));
+        identification.append(char(SIM_TYPE1_HR1));
+        identification.append(m_image.left(4));
+        response = identification;
+        return true;
+    }
+    case 0x00: {
+        // RALL - header ROM and all memory
+        QByteArray all;
+        all.append(char(SIM_TYPE1_HR0));
+        all.append(char(SIM_TYPE1_HR1));
+        all.append(m_image);
+        response = all;
+        return true;
+    }
+    case 0x01:
+        // READ
+        if (address >= m_image.size()) {
+            return false;
+        }
+        response = QVariant::fromValue((quint8)m_image.at(address));
+        return true;
+    case 0x53:
+    case 0x1A: {
+        // WRITE-E (erase) and WRITE-NE (no erase: bits can only be set)
+        if (address >= m_image.size()) {
+            return false;
+        }
+        const bool isLockByte = (address == 0x0E * 8 || address == 0x0E * 8 + 1);
+        const bool erase = ((quint8)command.at(0) == 0x53) && !isLockByte;
+        const quint8 value = erase ? data : ((quint8)m_image.at(address) | data);
+        const bool written = writeByte(address, value);
+        if (written && isLockByte) {
+            applyLockBits();
+        }
+        response = written;
+        return true;
+    }
+    }
+    return false;
+}
+
+void NfcSimulatedType1Memory::setReadOnly()
+{
+    m_image[0x0E * 8] = char(0xFF);
+    m_image[0x0E * 8 + 1] = char(0xFF);
+    NfcSimulatedTagMemory::setReadOnly();
+    applyLockBits();
+}
+
+/*!
+  \brief Lock the blocks according to the lock bytes in block E.
+  Block 0 (UID) is always locked.
+  */
+void NfcSimulatedType1Memory::applyLockBits()
+{
+    const quint16 lockBits = (quint8)m_image.at(0x0E * 8) | ((quint8)m_image.at(0x0E * 8 + 1) << 8);
+    lockRange(0, 8);
+    for (int block = 1; block < 0x0D; block++) {
+        if (lockBits & (1 << block)) {
+            lockRange(block * 8, 8);
+        }
+    }
+    if (lockBits & 0x6000) {
+        // Lock area itself (blocks D and E)
+        lockRange(0x0D * 8, 16);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+  Type 2 memory layout (4 byte pages):
+  Page 0 - 1:   UID and check bytes
+  Page 2:       Check byte, internal, static lock bytes 0 / 1
+  Page 3:       Capability container
+  Page 4 - n:   Data
+  */
+NfcSimulatedType2Memory::NfcSimulatedType2Memory(const QByteArray &uid, const int dataSize) :
+    NfcSimulatedTagMemory(QNearFieldTarget::NfcTagType2, uid.left(7), 16 + (qMax(dataSize, 16) + 7) / 8 * 8)
+{
+    QByteArray uidBytes = m_uid;
+    uidBytes.append(QByteArray(7 - uidBytes.size(), char(0)));
+    m_image.replace(0, 3, uidBytes.left(3));
+    m_image[3] = char(0x88 ^ uidBytes.at(0) ^ uidBytes.at(1) ^ uidBytes.at(2));
+    m_image.replace(4, 4, uidBytes.mid(3, 4));
+    m_image[8] = char(uidBytes.at(3) ^ uidBytes.at(4) ^ uidBytes.at(5) ^ uidBytes.at(6));
+    m_image[9] = char(0x48);
+    m_image[12] = char(SIM_NDEF_MAGIC_NUMBER);
+    m_image[13] = char(0x10);   // Version 1.0
+    m_image[14] = char((m_image.size() - 16) / 8);
+    m_image[15] = char(0x00);   // Read / write access
+    m_tlvAreaStart = 16;
+    m_tlvAreaEnd = m_image.size();
+    m_image[16] = char(SIM_TLV_NDEF);
+    m_image[17] = char(0x00);
+    m_image[18] = char(SIM_TLV_TERMINATOR);
+    applyLockBits();
+}
+
+/*!
+  \brief Emulate the Type 2 commands: READ (4 pages), WRITE (1 page)
+  and SECTOR SELECT. Only sector 0 is supported.
+  */
+bool NfcSimulatedType2Memory::processCommand(const QByteArray &command, QVariant &response)
+{
+    if (command.isEmpty()) {
+        return false;
+    }
+    switch ((quint8)command.at(0)) {
+    case 0x30: {
+        // READ - 16 bytes, wrapping around at the end of the memory
+        if (command.size() < 2) {
+            return false;
+        }
+        const int start = (quint8)command.at(1) * 4;
+        if (start >= m_image.size()) {
+            return false;
+        }
+        QByteArray data;
+        for (int i = 0; i < 16; i++) {
+            data.append(m_image.at((start + i) % m_image.size()));
+        }
+        response = data;
+        return true;
+    }
+    case 0xA2: {
+        // WRITE - one page
+        if (command.size() < 6) {
+            return false;
+        }
+        const int start = (quint8)command.at(1) * 4;
+        if (start >= m_image.size()) {
+            return false;
+        }
+        bool written = true;
+        for (int i = 0; i < 4 && written; i++) {
+            quint8 value = (quint8)command.at(2 + i);
+            if (start < 16) {
+                // Lock bytes and CC are one time programmable
+                value |= (quint8)m_image.at(start + i);
+            }
+            if ((quint8)m_image.at(start + i) != value || start >= 16) {
+                written = writeByte(start + i, value);
+            }
+        }
+        if (start == 8) {
+            applyLockBits();
+        }
+        response = written;
+        return true;
+    }
+    case 0xC2:
+        // SECTOR SELECT
+        response = true;
+        return true;
+    }
+    return false;
+}
+
+void NfcSimulatedType2Memory::setReadOnly()
+{
+    m_image[10] = char(0xFF);
+    m_image[11] = char(0xFF);
+    NfcSimulatedTagMemory::setReadOnly();
+    applyLockBits();
+}
+
+/*!
+  \brief Lock the pages according to the static lock bytes. The
+  dynamic lock bits of larger tags aren't emulated; setReadOnly()
+  locks their complete data area.
+  */
+void NfcSimulatedType2Memory::applyLockBits()
+{
+    const quint16 lockBits = (quint8)m_image.at(10) | ((quint8)m_image.at(11) << 8);
+    lockRange(0, 10);
+    for (int page = 3; page < 16; page++) {
+        if (lockBits & (1 << page)) {
+            lockRange(page * 4, 4);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+  Type 4 memory layout:
+  Offset 0:     Capability container file (E103h, 15 bytes)
+  Offset 15:    NDEF file (E104h): NLEN (2 bytes) + NDEF message
+  */
+static const char type4Application[] = { char(0xD2), char(0x76), char(0x00), char(0x00), char(0x85), char(0x01), char(0x01) };
+#define SIM_TYPE4_CC_SIZE 15
+
+NfcSimulatedType4Memory::NfcSimulatedType4Memory(const QByteArray &uid, const int ndefFileSize) :
+    NfcSimulatedTagMemory(QNearFieldTarget::NfcTagType4, uid, SIM_TYPE4_CC_SIZE + qBound(3, ndefFileSize, 0x7FFF)),
+    m_selectedFile(NoFile),
+    m_ndefFileSize(qBound(3, ndefFileSize, 0x7FFF))
+{
+    const char cc[] = {
+        char(0x00), char(0x0F),     // CC length
+        char(0x20),                 // Mapping version 2.0
+        char(0x00), char(0x3B),     // Maximum R-APDU data size
+        char(0x00), char(0x34),     // Maximum C-APDU data size
+        char(0x04), char(0x06),     // NDEF file control TLV
+        char(0xE1), char(0x04),     // NDEF file identifier
+        char(m_ndefFileSize >> 8), char(m_ndefFileSize & 0xFF),
+        char(0x00),                 // Read access
+        char(0x00)                  // Write access
+    };
+    m_image.replace(0, SIM_TYPE4_CC_SIZE, QByteArray(cc, SIM_TYPE4_CC_SIZE));
+    lockRange(0, SIM_TYPE4_CC_SIZE);
+}
+
+/*!
+  \brief Emulate the APDUs of the NDEF tag application: SELECT,
+  READ BINARY and UPDATE BINARY.
+  */
+bool NfcSimulatedType4Memory::processCommand(const QByteArray &command, QVariant &response)
+{
+    if (command.size() < 5 || command.at(0) != char(0x00)) {
+        return false;
+    }
+    const quint8 p1 = (quint8)command.at(2);
+    const int offset = (p1 << 8) | (quint8)command.at(3);
+    const int lc = (quint8)command.at(4);
+    switch ((quint8)command.at(1)) {
+    case 0xA4: {
+        // SELECT
+        const QByteArray name = command.mid(5, lc);
+        if (p1 == 0x04) {
+            const bool found = (name == QByteArray::fromRawData(type4Application, sizeof(type4Application)));
+            m_selectedFile = found ? ApplicationSelected : NoFile;
+            response = found;
+        } else if (m_selectedFile != NoFile && name == QByteArray::fromHex("E103")) {
+            m_selectedFile = CcFile;
+            response = true;
+        } else if (m_selectedFile != NoFile && name == QByteArray::fromHex("E104")) {
+            m_selectedFile = NdefFile;
+            response = true;
+        } else {
+            response = false;
+        }
+        return true;
+    }
+    case 0xB0: {
+        // READ BINARY, Le = 0 means 256 bytes
+        int fileOffset;
+        int fileSize;
+        if (!selectedFile(fileOffset, fileSize) || offset >= fileSize) {
+            response = QByteArray();
+            return true;
+        }
+        const int length = (lc == 0) ? 256 : lc;
+        response = m_image.mid(fileOffset + offset, qMin(length, fileSize - offset));
+        return true;
+    }
+    case 0xD6: {
+        // UPDATE BINARY
+        int fileOffset;
+        int fileSize;
+        if (m_selectedFile != NdefFile || isReadOnly() || !selectedFile(fileOffset, fileSize)
+                || offset + lc > fileSize || command.size() < 5 + lc) {
+            response = false;
+            return true;
+        }
+        bool written = true;
+        for (int i = 0; i < lc && written; i++) {
+            written = writeByte(fileOffset + offset + i, (quint8)command.at(5 + i));
+        }
+        response = written;
+        return true;
+    }
+    }
+    return false;
+}
+
+bool NfcSimulatedType4Memory::readNdefMessage(QByteArray &rawMessage) const
+{
+    const int length = ((quint8)m_image.at(SIM_TYPE4_CC_SIZE) << 8) | (quint8)m_image.at(SIM_TYPE4_CC_SIZE + 1);
+    if (length > m_ndefFileSize - 2) {
+        return false;
+    }
+    rawMessage = m_image.mid(SIM_TYPE4_CC_SIZE + 2, length);
+    return true;
+}
+
+/*!
+  \brief Write the message like the NDEF mapping specifies: first clear
+  NLEN, then write the message and finally set NLEN to its length.
+  */
+bool NfcSimulatedType4Memory::writeNdefMessage(const QByteArray &rawMessage, const int tearAfterBytes)
+{
+    if (isReadOnly() || rawMessage.size() > ndefCapacity()) {
+        return false;
+    }
+    QByteArray sequence;
+    sequence.append(char(0));
+    sequence.append(char(0));
+    sequence.append(rawMessage);
+    sequence.append(char(rawMessage.size() >> 8));
+    sequence.append(char(rawMessage.size() & 0xFF));
+    const int writeCount = (tearAfterBytes >= 0 && tearAfterBytes < sequence.size()) ? tearAfterBytes : sequence.size();
+    for (int i = 0; i < writeCount; i++) {
+        // The last two bytes of the sequence are the final NLEN
+        const int address = (i < sequence.size() - 2) ? SIM_TYPE4_CC_SIZE + i : SIM_TYPE4_CC_SIZE + i - (sequence.size() - 2);
+        if (!writeByte(address, (quint8)sequence.at(i))) {
+            return false;
+        }
+    }
+    return writeCount == sequence.size();
+}
+
+int NfcSimulatedType4Memory::ndefCapacity() const
+{
+    return m_ndefFileSize - 2;
+}
+
+void NfcSimulatedType4Memory::setReadOnly()
+{
+    m_image[SIM_TYPE4_CC_SIZE - 1] = char(0xFF);
+    lockRange(SIM_TYPE4_CC_SIZE, m_ndefFileSize);
+}
+
+bool NfcSimulatedType4Memory::isReadOnly() const
+{
+    return (quint8)m_image.at(SIM_TYPE4_CC_SIZE - 1) == 0xFF;
+}
+
+void NfcSimulatedType4Memory::resetSession()
+{
+    m_selectedFile = NoFile;
+}
+
+bool NfcSimulatedType4Memory::selectedFile(int &offset, int &size) const
+{
+    switch (m_selectedFile) {
+    case CcFile:
+        offset = 0;
+        size = SIM_TYPE4_CC_SIZE;
+        return true;
+    case NdefFile:
+        offset = SIM_TYPE4_CC_SIZE;
+        size = m_ndefFileSize;
+        return true;
+    default:
+        return false;
+    }
+}
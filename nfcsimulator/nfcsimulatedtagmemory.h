@@ -0,0 +1,156 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NFCSIMULATEDTAGMEMORY_H
+#define NFCSIMULATEDTAGMEMORY_H
+
+#include <QByteArray>
+#include <QBitArray>
+#include <QVariant>
+#include <QNearFieldTarget>
+
+QTM_USE_NAMESPACE
+
+#define SIM_NDEF_MAGIC_NUMBER 0xE1
+#define SIM_TLV_NULL 0x00
+#define SIM_TLV_NDEF 0x03
+#define SIM_TLV_TERMINATOR 0xFE
+
+#define SIM_TYPE1_MEMORY_SIZE 120
+#define SIM_TYPE1_HR0 0x11
+#define SIM_TYPE1_HR1 0x48
+#define SIM_TYPE2_DEFAULT_DATA_SIZE 144
+#define SIM_TYPE4_DEFAULT_NDEF_FILE_SIZE 2048
+
+/*!
+  \brief Memory image of a simulated NFC Forum tag.
+
+  Represents the physical tag: it keeps its contents while the
+  simulated targets that access it are created and deleted every
+  time the tag is touched.
+
+  The subclasses emulate the tag type specific commands that are
+  sent through QNearFieldTarget::sendCommand(), including the
+  lock bits of the tags. NDEF messages are stored in an NDEF TLV
+  (Type 1 and 2) or in the NDEF file (Type 4), just like on a real
+  tag, so that the data written by the app can be examined.
+  */
+class NfcSimulatedTagMemory
+{
+public:
+    NfcSimulatedTagMemory(const QNearFieldTarget::Type type, const QByteArray &uid, const int size);
+    virtual ~NfcSimulatedTagMemory();
+
+    QNearFieldTarget::Type type() const;
+    QByteArray uid() const;
+    const QByteArray &image() const;
+
+    /*! \brief Execute the tag type specific \a command and set the decoded
+      \a response, as returned by QNearFieldTarget::requestResponse().
+      \return false if the tag doesn't respond to the command. */
+    virtual bool processCommand(const QByteArray &command, QVariant &response) = 0;
+    virtual bool readNdefMessage(QByteArray &rawMessage) const;
+    virtual bool writeNdefMessage(const QByteArray &rawMessage, const int tearAfterBytes = -1);
+    virtual int ndefCapacity() const;
+    virtual void setReadOnly();
+    virtual bool isReadOnly() const;
+    virtual void resetSession();
+
+    qint64 bytesWritten() const;
+    void resetBytesWritten();
+
+protected:
+    bool writeByte(const int address, const quint8 value);
+    void lockRange(const int address, const int length);
+
+protected:
+    QNearFieldTarget::Type m_type;
+    QByteArray m_uid;
+    QByteArray m_image;
+    /*! Bytes of the image that can't be written anymore. */
+    QBitArray m_locked;
+    /*! Start and end of the TLV area of Type 1 and 2 tags. */
+    int m_tlvAreaStart;
+    int m_tlvAreaEnd;
+    /*! Number of bytes written to the tag memory, e.g., to compare
+      the efficiency of write strategies. */
+    qint64 m_bytesWritten;
+};
+
+/*!
+  \brief NFC Forum Type 1 tag with static memory (e.g., Topaz 96).
+  */
+class NfcSimulatedType1Memory : public NfcSimulatedTagMemory
+{
+public:
+    explicit NfcSimulatedType1Memory(const QByteArray &uid);
+
+    bool processCommand(const QByteArray &command, QVariant &response);
+    void setReadOnly();
+
+private:
+    void applyLockBits();
+};
+
+/*!
+  \brief NFC Forum Type 2 tag (e.g., MIFARE Ultralight or NTAG203),
+  with the specified size of the data area.
+  */
+class NfcSimulatedType2Memory : public NfcSimulatedTagMemory
+{
+public:
+    NfcSimulatedType2Memory(const QByteArray &uid, const int dataSize = SIM_TYPE2_DEFAULT_DATA_SIZE);
+
+    bool processCommand(const QByteArray &command, QVariant &response);
+    void setReadOnly();
+
+private:
+    void applyLockBits();
+};
+
+/*!
+  \brief NFC Forum Type 4 tag (e.g., MIFARE DESFire) with the NDEF
+  tag application, a capability container file and an NDEF file.
+  */
+class NfcSimulatedType4Memory : public NfcSimulatedTagMemory
+{
+public:
+    NfcSimulatedType4Memory(const QByteArray &uid, const int ndefFileSize = SIM_TYPE4_DEFAULT_NDEF_FILE_SIZE);
+
+    bool processCommand(const QByteArray &command, QVariant &response);
+    bool readNdefMessage(QByteArray &rawMessage) const;
+    bool writeNdefMessage(const QByteArray &rawMessage, const int tearAfterBytes = -1);
+    int ndefCapacity() const;
+    void setReadOnly();
+    bool isReadOnly() const;
+    void resetSession();
+
+private:
+    enum SelectedFile {
+        NoFile,
+        ApplicationSelected,
+        CcFile,
+        NdefFile
+    };
+    /*! Offset and size of the currently selected file in the image. */
+    bool selectedFile(int &offset, int &size) const;
+
+private:
+    SelectedFile m_selectedFile;
+    int m_ndefFileSize;
+};
+
+#endif // NFCSIMULATEDTAGMEMORY_H
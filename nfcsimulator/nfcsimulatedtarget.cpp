@@ -0,0 +1,156 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "nfcsimulatedtarget.h"
+
+QTM_BEGIN_NAMESPACE
+// Private class of QtMobility, which only contains the shared data
+// reference count. Needed to create valid request IDs outside of
+// the QtMobility backends.
+class QNearFieldTarget::RequestIdPrivate : public QSharedData
+{
+};
+QTM_END_NAMESPACE
+
+/*!
+  \brief Create a new, unique request ID.
+  */
+QNearFieldTarget::RequestId nfcSimulatorCreateRequestId()
+{
+    return QNearFieldTarget::RequestId(new QNearFieldTarget::RequestIdPrivate);
+}
+
+NfcSimulatorConfig::NfcSimulatorConfig() :
+    requestLatencyUsecs(5000),
+    byteLatencyUsecs(100),
+    jitterUsecs(0),
+    failureRate(0.0),
+    removeAfterRequests(-1)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+NfcSimulatorRandom::NfcSimulatorRandom(const quint32 seed) :
+    m_state(seed != 0 ? seed : 1)
+{
+}
+
+quint32 NfcSimulatorRandom::next()
+{
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state;
+}
+
+/*!
+  \brief Random number between 0 and \a max - 1.
+  */
+int NfcSimulatorRandom::bounded(const int max)
+{
+    return max > 0 ? (int)(next() % (quint32)max) : 0;
+}
+
+bool NfcSimulatorRandom::chance(const double probability)
+{
+    if (probability <= 0.0) {
+        return false;
+    }
+    return next() < probability * 4294967295.0;
+}
+
+// ----------------------------------------------------------------------------
+
+NfcSimulatorScheduler::NfcSimulatorScheduler(NfcSimulatedRequestHandler *handler, QObject *parent) :
+    QObject(parent),
+    m_handler(handler),
+    m_lastDueUsecs(0)
+{
+    m_clock.start();
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(processDueRequests()));
+}
+
+/*!
+  \brief Complete the \a request once the previous requests have been
+  completed and the latency has passed.
+  */
+void NfcSimulatorScheduler::schedule(NfcSimulatedRequest request, const int latencyUsecs)
+{
+    request.dueUsecs = qMax(m_lastDueUsecs, elapsedUsecs()) + latencyUsecs;
+    m_lastDueUsecs = request.dueUsecs;
+    m_pending.append(request);
+    if (!m_timer.isActive()) {
+        startTimer();
+    }
+}
+
+bool NfcSimulatorScheduler::isPending(const QNearFieldTarget::RequestId &id) const
+{
+    for (int i = 0; i < m_pending.size(); i++) {
+        if (m_pending.at(i).id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+  \brief The target went out of range: the requests that are still
+  pending fail with an out of range error once they are due, instead
+  of being completed.
+  */
+void NfcSimulatorScheduler::setAllOutOfRange()
+{
+    for (int i = 0; i < m_pending.size(); i++) {
+        m_pending[i].outOfRange = true;
+    }
+}
+
+void NfcSimulatorScheduler::cancelAll()
+{
+    m_pending.clear();
+    m_timer.stop();
+}
+
+void NfcSimulatorScheduler::processDueRequests()
+{
+    while (!m_pending.isEmpty() && m_pending.first().dueUsecs <= elapsedUsecs()) {
+        // The handler might schedule new requests
+        const NfcSimulatedRequest request = m_pending.takeFirst();
+        m_handler->completeRequest(request);
+        emit requestProcessed();
+    }
+    if (!m_pending.isEmpty()) {
+        startTimer();
+    }
+}
+
+qint64 NfcSimulatorScheduler::elapsedUsecs() const
+{
+#if QT_VERSION >= 0x040800
+    return m_clock.nsecsElapsed() / 1000;
+#else
+    return m_clock.elapsed() * 1000;
+#endif
+}
+
+void NfcSimulatorScheduler::startTimer()
+{
+    const qint64 remainingUsecs = m_pending.first().dueUsecs - elapsedUsecs();
+    m_timer.start(remainingUsecs > 0 ? (int)((remainingUsecs + 999) / 1000) : 0);
+}
@@ -0,0 +1,343 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NFCSIMULATEDTARGET_H
+#define NFCSIMULATEDTARGET_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QList>
+#include <QSharedPointer>
+#include <QNearFieldTarget>
+#include <QNearFieldTagType1>
+#include <QNearFieldTagType2>
+#include <QNearFieldTagType4>
+#include <QNdefMessage>
+#include "nfcsimulatedtagmemory.h"
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Timing and failure behavior of the simulated targets.
+  */
+struct NfcSimulatorConfig
+{
+    NfcSimulatorConfig();
+
+    /*! Fixed duration of every request to the target. */
+    int requestLatencyUsecs;
+    /*! Additional duration for every byte transferred by a request. */
+    int byteLatencyUsecs;
+    /*! Maximum random delay added to every request. */
+    int jitterUsecs;
+    /*! Probability (0 - 1) that a request fails. Failed NDEF writes
+      are torn: only half of the data is written to the tag. */
+    double failureRate;
+    /*! The target goes out of range after this number of requests,
+      or never if -1. */
+    int removeAfterRequests;
+};
+
+/*!
+  \brief Deterministic pseudo random numbers (xorshift), so that
+  simulation runs with the same seed are reproducible.
+  */
+class NfcSimulatorRandom
+{
+public:
+    explicit NfcSimulatorRandom(const quint32 seed = 1);
+    quint32 next();
+    int bounded(const int max);
+    bool chance(const double probability);
+
+private:
+    quint32 m_state;
+};
+
+/*!
+  \brief A request to a simulated target that completes after the
+  simulated latency.
+  */
+struct NfcSimulatedRequest
+{
+    enum Kind {
+        CommandRequest,
+        NdefReadRequest,
+        NdefWriteRequest
+    };
+
+    QNearFieldTarget::RequestId id;
+    Kind kind;
+    /*! Decoded response of a command. */
+    QVariant response;
+    /*! Message to write, for NDEF write requests. */
+    QByteArray rawMessage;
+    bool fail;
+    bool outOfRange;
+    /*! Completion time, relative to the clock of the scheduler. */
+    qint64 dueUsecs;
+};
+
+/*!
+  \brief Completes the requests of a simulated target.
+  */
+class NfcSimulatedRequestHandler
+{
+public:
+    virtual ~NfcSimulatedRequestHandler() {}
+    virtual void completeRequest(const NfcSimulatedRequest &request) = 0;
+};
+
+/*!
+  \brief Delays the completion of the requests of a simulated target.
+
+  Like a real tag, the target processes one request after another:
+  each request completes after its latency, counted from the
+  completion of the previous request.
+  */
+class NfcSimulatorScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    NfcSimulatorScheduler(NfcSimulatedRequestHandler *handler, QObject *parent = 0);
+
+    void schedule(NfcSimulatedRequest request, const int latencyUsecs);
+    bool isPending(const QNearFieldTarget::RequestId &id) const;
+    void setAllOutOfRange();
+    void cancelAll();
+
+signals:
+    /*! A request has been completed. */
+    void requestProcessed();
+
+private slots:
+    void processDueRequests();
+
+private:
+    qint64 elapsedUsecs() const;
+    void startTimer();
+
+private:
+    NfcSimulatedRequestHandler *m_handler;    // Not owned
+    QList<NfcSimulatedRequest> m_pending;
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    qint64 m_lastDueUsecs;
+};
+
+QNearFieldTarget::RequestId nfcSimulatorCreateRequestId();
+
+/*!
+  \brief Simulated target, based on one of the QtMobility target
+  classes, so that qobject_cast to the tag type specific classes
+  works just like with the real targets.
+
+  The tag type specific methods of QtMobility send their commands
+  through sendCommand(), which the tag memory executes. NDEF messages
+  are directly read from and written to the tag memory. Without tag
+  memory, the target is an LLCP capable NFC Forum device.
+  */
+template <class TargetBase>
+class NfcSimulatedTarget : public TargetBase, public NfcSimulatedRequestHandler
+{
+public:
+    NfcSimulatedTarget(const QSharedPointer<NfcSimulatedTagMemory> &memory, const QByteArray &uid,
+                       const NfcSimulatorConfig &config, const quint32 seed, QObject *parent = 0) :
+        TargetBase(parent),
+        m_memory(memory),
+        m_uid(memory ? memory->uid() : uid),
+        m_config(config),
+        m_random(seed),
+        m_requestCount(0),
+        m_outOfRange(false)
+    {
+        m_scheduler = new NfcSimulatorScheduler(this, this);
+        if (m_memory) {
+            m_memory->resetSession();
+        }
+    }
+
+    QByteArray uid() const
+    {
+        return m_uid;
+    }
+
+    QNearFieldTarget::Type type() const
+    {
+        return m_memory ? m_memory->type() : QNearFieldTarget::NfcForumDevice;
+    }
+
+    QNearFieldTarget::AccessMethods accessMethods() const
+    {
+        if (!m_memory) {
+            return QNearFieldTarget::LlcpAccess;
+        }
+        return QNearFieldTarget::NdefAccess | QNearFieldTarget::TagTypeSpecificAccess;
+    }
+
+    bool hasNdefMessage()
+    {
+        QByteArray rawMessage;
+        return m_memory && !m_outOfRange && m_memory->readNdefMessage(rawMessage) && !rawMessage.isEmpty();
+    }
+
+    QNearFieldTarget::RequestId readNdefMessages()
+    {
+        NfcSimulatedRequest request = createRequest(NfcSimulatedRequest::NdefReadRequest);
+        // A real tag reads the whole NDEF area
+        const int bytes = m_memory ? m_memory->ndefCapacity() : 0;
+        m_scheduler->schedule(request, latencyUsecs(bytes));
+        return request.id;
+    }
+
+    QNearFieldTarget::RequestId writeNdefMessages(const QList<QNdefMessage> &messages)
+    {
+        NfcSimulatedRequest request = createRequest(NfcSimulatedRequest::NdefWriteRequest);
+        if (!messages.isEmpty()) {
+            request.rawMessage = messages.first().toByteArray();
+        }
+        m_scheduler->schedule(request, latencyUsecs(request.rawMessage.size()));
+        return request.id;
+    }
+
+    QNearFieldTarget::RequestId sendCommand(const QByteArray &command)
+    {
+        NfcSimulatedRequest request = createRequest(NfcSimulatedRequest::CommandRequest);
+        if (!m_memory || !m_memory->processCommand(command, request.response)) {
+            // No response from the tag
+            request.fail = true;
+        }
+        const int responseSize = request.response.type() == QVariant::ByteArray ? request.response.toByteArray().size() : 1;
+        m_scheduler->schedule(request, latencyUsecs(command.size() + responseSize));
+        return request.id;
+    }
+
+    bool waitForRequestCompleted(const QNearFieldTarget::RequestId &id, int msecs = 5000)
+    {
+        if (m_scheduler->isPending(id)) {
+            QEventLoop loop;
+            QTimer timeout;
+            timeout.setSingleShot(true);
+            QObject::connect(&timeout, SIGNAL(timeout()), &loop, SLOT(quit()));
+            QObject::connect(m_scheduler, SIGNAL(requestProcessed()), &loop, SLOT(quit()));
+            timeout.start(msecs);
+            while (m_scheduler->isPending(id) && timeout.isActive()) {
+                loop.exec();
+            }
+        }
+        return !m_scheduler->isPending(id) && !m_failedRequests.contains(id);
+    }
+
+    void completeRequest(const NfcSimulatedRequest &request)
+    {
+        if (request.outOfRange) {
+            m_failedRequests.append(request.id);
+            emit this->error(QNearFieldTarget::TargetOutOfRangeError, request.id);
+            return;
+        }
+        switch (request.kind) {
+        case NfcSimulatedRequest::CommandRequest:
+            if (request.fail) {
+                m_failedRequests.append(request.id);
+                emit this->error(QNearFieldTarget::NoResponseError, request.id);
+            } else {
+                this->setResponseForRequest(request.id, request.response);
+            }
+            break;
+        case NfcSimulatedRequest::NdefReadRequest: {
+            QByteArray rawMessage;
+            if (request.fail || !m_memory || !m_memory->readNdefMessage(rawMessage)) {
+                m_failedRequests.append(request.id);
+                emit this->error(QNearFieldTarget::NdefReadError, request.id);
+            } else {
+                emit this->ndefMessageRead(QNdefMessage::fromByteArray(rawMessage));
+                this->setResponseForRequest(request.id, QVariant());
+            }
+            break;
+        }
+        case NfcSimulatedRequest::NdefWriteRequest: {
+            const int tearAfterBytes = request.fail ? request.rawMessage.size() / 2 : -1;
+            if (!m_memory || !m_memory->writeNdefMessage(request.rawMessage, tearAfterBytes)) {
+                m_failedRequests.append(request.id);
+                emit this->error(QNearFieldTarget::NdefWriteError, request.id);
+            } else {
+                emit this->ndefMessagesWritten();
+                this->setResponseForRequest(request.id, QVariant());
+            }
+            break;
+        }
+        }
+    }
+
+    /*! \brief Number of requests sent to the target so far. */
+    int requestCount() const
+    {
+        return m_requestCount;
+    }
+
+    /*! \brief Simulate that the target went out of range: all pending
+      and future requests fail. */
+    void setOutOfRange()
+    {
+        if (!m_outOfRange) {
+            m_outOfRange = true;
+            m_scheduler->setAllOutOfRange();
+            emit this->disconnected();
+        }
+    }
+
+private:
+    NfcSimulatedRequest createRequest(const NfcSimulatedRequest::Kind kind)
+    {
+        m_requestCount++;
+        if (m_config.removeAfterRequests >= 0 && m_requestCount > m_config.removeAfterRequests) {
+            setOutOfRange();
+        }
+        NfcSimulatedRequest request;
+        request.id = nfcSimulatorCreateRequestId();
+        request.kind = kind;
+        request.fail = m_random.chance(m_config.failureRate);
+        request.outOfRange = m_outOfRange;
+        request.dueUsecs = 0;
+        return request;
+    }
+
+    int latencyUsecs(const int bytes)
+    {
+        return m_config.requestLatencyUsecs + bytes * m_config.byteLatencyUsecs
+                + (m_config.jitterUsecs > 0 ? m_random.bounded(m_config.jitterUsecs + 1) : 0);
+    }
+
+private:
+    QSharedPointer<NfcSimulatedTagMemory> m_memory;
+    QByteArray m_uid;
+    NfcSimulatorConfig m_config;
+    NfcSimulatorRandom m_random;
+    NfcSimulatorScheduler *m_scheduler;
+    /*! Failed requests, as RequestId doesn't provide a hash function. */
+    QList<QNearFieldTarget::RequestId> m_failedRequests;
+    int m_requestCount;
+    bool m_outOfRange;
+};
+
+typedef NfcSimulatedTarget<QNearFieldTagType1> NfcSimulatedTagType1;
+typedef NfcSimulatedTarget<QNearFieldTagType2> NfcSimulatedTagType2;
+typedef NfcSimulatedTarget<QNearFieldTagType4> NfcSimulatedTagType4;
+typedef NfcSimulatedTarget<QNearFieldTarget> NfcSimulatedPeer;
+
+#endif // NFCSIMULATEDTARGET_H
@@ -0,0 +1,14 @@
+# Simulated NFC targets, for developing and benchmarking the tag
+# interaction without NFC hardware.
+# The loopback transport simulates the LLCP link to another device.
+# It implements the interface of nfcllcptransport.h, which has to be
+# built by the including project.
+SOURCES += $$PWD/nfcsimulatedtagmemory.cpp \
+    $$PWD/nfcsimulatedtarget.cpp \
+    $$PWD/nfcsimulatedmanager.cpp \
+    $$PWD/nfcloopbacktransport.cpp
+HEADERS += $$PWD/nfcsimulatedtagmemory.h \
+    $$PWD/nfcsimulatedtarget.h \
+    $$PWD/nfcsimulatedmanager.h \
+    $$PWD/nfcloopbacktransport.h
+INCLUDEPATH += $$PWD
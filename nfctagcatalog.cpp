@@ -0,0 +1,555 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "nfctagcatalog.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QtConcurrentMap>
+#include <QDebug>
+
+static QDataStream &operator<<(QDataStream &stream, const NfcCatalogEntry &entry)
+{
+    stream << entry.timestamp << entry.fileName << entry.tagType << entry.uid
+           << (qint32)entry.messageSize << entry.keys;
+    return stream;
+}
+
+static QDataStream &operator>>(QDataStream &stream, NfcCatalogEntry &entry)
+{
+    qint32 messageSize;
+    stream >> entry.timestamp >> entry.fileName >> entry.tagType >> entry.uid
+           >> messageSize >> entry.keys;
+    entry.messageSize = messageSize;
+    return stream;
+}
+
+static bool entryLessThan(const NfcCatalogEntry &entry1, const NfcCatalogEntry &entry2)
+{
+    return entry1.timestamp < entry2.timestamp;
+}
+
+NfcCatalogEntry::NfcCatalogEntry() :
+    timestamp(0),
+    messageSize(0)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+NfcTagCatalog::NfcTagCatalog(QObject *parent) :
+    QObject(parent),
+    m_rebuildWatcher(NULL)
+{
+}
+
+NfcTagCatalog::~NfcTagCatalog()
+{
+    if (m_rebuildWatcher) {
+        m_rebuildWatcher->waitForFinished();
+    }
+    close();
+}
+
+/*!
+  \brief Load the catalog of the logged messages in the \a directory.
+  Entries of a truncated index file (e.g., after a crash) are
+  recovered up to the last complete entry. If there is no index
+  file yet, the catalog is rebuilt from the directory.
+  */
+bool NfcTagCatalog::open(const QString &directory)
+{
+    close();
+    if (!QDir().mkpath(directory)) {
+        qDebug() << "Unable to create catalog directory: " << directory;
+        return false;
+    }
+    m_directory = directory;
+    if (!loadIndex()) {
+        // Not existing or unusable - start with an empty index
+        // and add the messages that have been logged already
+        m_entries.clear();
+        m_keyIndex.clear();
+        if (!writeIndex()) {
+            return false;
+        }
+        rebuild();
+        return true;
+    }
+    m_indexFile.setFileName(QDir(m_directory).filePath(NFC_CATALOG_FILE_NAME));
+    return m_indexFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered);
+}
+
+void NfcTagCatalog::close()
+{
+    m_indexFile.close();
+    m_entries.clear();
+    m_keyIndex.clear();
+    m_directory.clear();
+}
+
+QString NfcTagCatalog::directory() const
+{
+    return m_directory;
+}
+
+/*!
+  \brief Add a logged message to the catalog and append it to the
+  index file.
+
+  \param fileName file name or frame reference of the logged message.
+  \param timestamp time the message was read. If invalid, the current
+  time is used.
+  */
+bool NfcTagCatalog::addMessage(const QString &fileName, const QByteArray &rawMessage, const QString &tagType, const QByteArray &uid, const QDateTime &timestamp)
+{
+    if (m_directory.isEmpty()) {
+        return false;
+    }
+    const qint64 msecs = (timestamp.isValid() ? timestamp : QDateTime::currentDateTime()).toMSecsSinceEpoch();
+    const NfcCatalogEntry entry = createEntry(fileName, rawMessage, tagType, uid, msecs);
+    if (m_rebuildWatcher) {
+        // The index will be rewritten once rebuilding has finished
+        m_pendingEntries.append(entry);
+        return true;
+    }
+
+    if (m_entries.isEmpty() || m_entries.last().timestamp <= entry.timestamp) {
+        m_entries.append(entry);
+        const int entryIndex = m_entries.size() - 1;
+        foreach (const QString &key, entry.keys) {
+            m_keyIndex[key].append(entryIndex);
+        }
+    } else {
+        // The clock has been changed - keep the entries sorted
+        m_entries.append(entry);
+        qStableSort(m_entries.begin(), m_entries.end(), entryLessThan);
+        buildKeyIndex();
+    }
+    return appendToIndex(entry);
+}
+
+int NfcTagCatalog::size() const
+{
+    return m_entries.size();
+}
+
+bool NfcTagCatalog::isRebuilding() const
+{
+    return m_rebuildWatcher != NULL;
+}
+
+/*!
+  \brief Recreate the catalog from all logged messages in the directory,
+  on all cores in the background. Emits rebuilt() when done.
+
+  \return false if the catalog isn't open or is already being rebuilt.
+  */
+bool NfcTagCatalog::rebuild()
+{
+    if (m_directory.isEmpty() || m_rebuildWatcher) {
+        return false;
+    }
+    QStringList fileNames;
+    QDirIterator it(m_directory, QStringList() << QString("*") + LEGACY_LOG_SUFFIX << QString("*") + NDEF_SEGMENT_SUFFIX, QDir::Files);
+    while (it.hasNext()) {
+        fileNames.append(it.next());
+    }
+    m_pendingEntries.clear();
+    m_rebuildWatcher = new QFutureWatcher<QList<NfcCatalogEntry> >(this);
+    connect(m_rebuildWatcher, SIGNAL(finished()), this, SLOT(rebuildFinished()));
+    m_rebuildWatcher->setFuture(QtConcurrent::mappedReduced(fileNames,
+                                                            &NfcTagCatalog::catalogFile,
+                                                            &NfcTagCatalog::mergeEntries,
+                                                            QtConcurrent::UnorderedReduce));
+    return true;
+}
+
+/*!
+  \brief Find the logged messages that match all terms of the \a queryText,
+  newest first.
+
+  Terms are separated by spaces. Plain terms match words of the tag type,
+  URIs and texts (case insensitive). Qualified terms match a UID
+  ("uid:04a1b2c3d4e5f6") or a record type ("type:sp", "type:image/png").
+
+  \return a map for every result, containing the fileName, timestamp,
+  tagType, uid and messageSize.
+  */
+QVariantList NfcTagCatalog::query(const QString &queryText, const int maxResults) const
+{
+    const QStringList terms = queryText.toLower().split(' ', QString::SkipEmptyParts);
+    return toVariantList(findEntries(terms, 0, m_entries.size() - 1), maxResults);
+}
+
+/*!
+  \brief Same as query(), but only returns messages read between \a from
+  and \a to. Invalid times don't limit the range.
+  */
+QVariantList NfcTagCatalog::queryTimeRange(const QString &queryText, const QDateTime &from, const QDateTime &to, const int maxResults) const
+{
+    // Entries are sorted by time - find the first and last entry in range
+    int first = 0;
+    int last = m_entries.size() - 1;
+    if (from.isValid()) {
+        const qint64 fromMsecs = from.toMSecsSinceEpoch();
+        int low = 0;
+        int high = m_entries.size();
+        while (low < high) {
+            const int mid = (low + high) / 2;
+            if (m_entries[mid].timestamp < fromMsecs) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        first = low;
+    }
+    if (to.isValid()) {
+        const qint64 toMsecs = to.toMSecsSinceEpoch();
+        int low = 0;
+        int high = m_entries.size();
+        while (low < high) {
+            const int mid = (low + high) / 2;
+            if (m_entries[mid].timestamp <= toMsecs) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        last = low - 1;
+    }
+    const QStringList terms = queryText.toLower().split(' ', QString::SkipEmptyParts);
+    return toVariantList(findEntries(terms, first, last), maxResults);
+}
+
+/*!
+  \brief File names of all logged messages read from the tag with the
+  UID (hex string), newest first.
+  */
+QStringList NfcTagCatalog::findByUid(const QString &uidHex) const
+{
+    QStringList fileNames;
+    const QVector<int> entries = findEntries(QStringList() << "uid:" + uidHex.toLower(), 0, m_entries.size() - 1);
+    for (int i = entries.size() - 1; i >= 0; i--) {
+        fileNames.append(m_entries[entries[i]].fileName);
+    }
+    return fileNames;
+}
+
+/*!
+  \brief File names of all logged messages containing a record of the
+  type (e.g., "U", "Sp" or "image/png"), newest first.
+  */
+QStringList NfcTagCatalog::findByRecordType(const QString &recordType) const
+{
+    QStringList fileNames;
+    const QVector<int> entries = findEntries(QStringList() << "type:" + recordType.toLower(), 0, m_entries.size() - 1);
+    for (int i = entries.size() - 1; i >= 0; i--) {
+        fileNames.append(m_entries[entries[i]].fileName);
+    }
+    return fileNames;
+}
+
+void NfcTagCatalog::rebuildFinished()
+{
+    QList<NfcCatalogEntry> entries = m_rebuildWatcher->result();
+    m_rebuildWatcher->deleteLater();
+    m_rebuildWatcher = NULL;
+
+    // Messages logged while rebuilding might have been found
+    // in the directory already
+    QSet<QString> fileNames;
+    foreach (const NfcCatalogEntry &entry, entries) {
+        fileNames.insert(entry.fileName);
+    }
+    foreach (const NfcCatalogEntry &entry, m_pendingEntries) {
+        if (!fileNames.contains(entry.fileName)) {
+            entries.append(entry);
+        }
+    }
+    m_pendingEntries.clear();
+
+    m_entries = entries.toVector();
+    qStableSort(m_entries.begin(), m_entries.end(), entryLessThan);
+    buildKeyIndex();
+    writeIndex();
+    qDebug() << "Rebuilt tag catalog: " << m_entries.size() << " entries";
+    emit rebuilt(m_entries.size());
+}
+
+/*!
+  \brief Create the catalog entries for a logged message, or for all
+  messages of a segment of the log. Called from the worker threads
+  while rebuilding.
+  */
+QList<NfcCatalogEntry> NfcTagCatalog::catalogFile(const QString &fileName)
+{
+    QList<NfcCatalogEntry> entries;
+    if (fileName.endsWith(NDEF_SEGMENT_SUFFIX)) {
+        NdefSegmentReader reader;
+        if (!reader.open(fileName)) {
+            return entries;
+        }
+        NdefLogFrame frame;
+        for (int i = 0; i < reader.frameCount(); i++) {
+            if (reader.readFrame(i, frame)) {
+                // The segment log doesn't store the UID
+                entries.append(createEntry(NdefSegmentLog::frameReference(fileName, i), frame.rawMessage,
+                                           frame.tagType, QByteArray(), frame.timestamp.toMSecsSinceEpoch()));
+            }
+        }
+        return entries;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return entries;
+    }
+    const QByteArray rawMessage = file.readAll();
+    file.close();
+    const QFileInfo fileInfo(fileName);
+    QDateTime timestamp;
+    QString tagType;
+    if (!NdefSegmentLog::parseLegacyFileName(fileInfo.completeBaseName(), timestamp, tagType)) {
+        timestamp = fileInfo.lastModified();
+    }
+    entries.append(createEntry(fileName, rawMessage, tagType, QByteArray(), timestamp.toMSecsSinceEpoch()));
+    return entries;
+}
+
+void NfcTagCatalog::mergeEntries(QList<NfcCatalogEntry> &result, const QList<NfcCatalogEntry> &fileEntries)
+{
+    result.append(fileEntries);
+}
+
+/*!
+  \brief Decode the message and create its catalog entry, including
+  all index keys.
+  */
+NfcCatalogEntry NfcTagCatalog::createEntry(const QString &fileName, const QByteArray &rawMessage, const QString &tagType, const QByteArray &uid, const qint64 timestamp)
+{
+    NfcCatalogEntry entry;
+    entry.timestamp = timestamp;
+    entry.fileName = fileName;
+    entry.tagType = tagType;
+    entry.uid = uid;
+    entry.messageSize = rawMessage.size();
+
+    QSet<QString> keys;
+    if (!uid.isEmpty()) {
+        keys.insert("uid:" + QString(uid.toHex()));
+    }
+    addTokens(tagType, keys);
+
+    ParsedNdefMessage message;
+    if (!NdefMessageDecoder::decode(rawMessage, message)) {
+        keys.insert("status:malformed");
+    }
+    for (int i = 0; i < message.recordCount(); i++) {
+        const ParsedNdefRecord &record = message.record(i);
+        if (record.type.length > 0) {
+            keys.insert("type:" + message.toAscii(record.type).toLower());
+        }
+        if (!record.uri.isNull()) {
+            addTokens(message.uri(record).toString(), keys);
+        }
+        if (record.kind == ParsedNdefRecord::KindText) {
+            addTokens(message.text(record.text), keys);
+        }
+        for (int t = record.firstTitle; t < record.firstTitle + record.titleCount; t++) {
+            addTokens(message.text(message.title(t)), keys);
+        }
+    }
+    entry.keys = keys.toList();
+    return entry;
+}
+
+/*!
+  \brief Split the \a text into lower case words and add them to
+  the \a keys, up to NFC_CATALOG_MAX_TOKENS keys per message.
+  */
+void NfcTagCatalog::addTokens(const QString &text, QSet<QString> &keys)
+{
+    QString token;
+    for (int i = 0; i <= text.size() && keys.size() < NFC_CATALOG_MAX_TOKENS; i++) {
+        if (i < text.size() && text.at(i).isLetterOrNumber()) {
+            token.append(text.at(i).toLower());
+            continue;
+        }
+        if (token.size() >= NFC_CATALOG_MIN_TOKEN_LENGTH && token.size() <= NFC_CATALOG_MAX_TOKEN_LENGTH) {
+            keys.insert(token);
+        }
+        token.clear();
+    }
+}
+
+/*!
+  \brief Indices of the entries between \a first and \a last (inclusive)
+  that contain all \a terms, in ascending order.
+  */
+QVector<int> NfcTagCatalog::findEntries(const QStringList &terms, const int first, const int last) const
+{
+    QVector<int> result;
+    if (first > last) {
+        return result;
+    }
+    if (terms.isEmpty()) {
+        result.reserve(last - first + 1);
+        for (int i = first; i <= last; i++) {
+            result.append(i);
+        }
+        return result;
+    }
+
+    // Start with the shortest list and check the others for each of its entries
+    QList<const QVector<int> *> lists;
+    const QVector<int> *shortest = NULL;
+    foreach (const QString &term, terms) {
+        QHash<QString, QVector<int> >::const_iterator it = m_keyIndex.constFind(term);
+        if (it == m_keyIndex.constEnd()) {
+            return result;
+        }
+        lists.append(&it.value());
+        if (!shortest || it.value().size() < shortest->size()) {
+            shortest = &it.value();
+        }
+    }
+    QVector<int>::const_iterator begin = qLowerBound(shortest->constBegin(), shortest->constEnd(), first);
+    for (QVector<int>::const_iterator entry = begin; entry != shortest->constEnd() && *entry <= last; ++entry) {
+        bool matchesAll = true;
+        foreach (const QVector<int> *list, lists) {
+            if (list != shortest && qBinaryFind(list->constBegin(), list->constEnd(), *entry) == list->constEnd()) {
+                matchesAll = false;
+                break;
+            }
+        }
+        if (matchesAll) {
+            result.append(*entry);
+        }
+    }
+    return result;
+}
+
+/*!
+  \brief Convert the entries to a list of maps for QML, newest first.
+  */
+QVariantList NfcTagCatalog::toVariantList(const QVector<int> &entries, const int maxResults) const
+{
+    QVariantList results;
+    for (int i = entries.size() - 1; i >= 0 && results.size() < maxResults; i--) {
+        const NfcCatalogEntry &entry = m_entries[entries[i]];
+        QVariantMap result;
+        result.insert("fileName", entry.fileName);
+        result.insert("timestamp", QDateTime::fromMSecsSinceEpoch(entry.timestamp));
+        result.insert("tagType", entry.tagType);
+        result.insert("uid", QString(entry.uid.toHex()));
+        result.insert("messageSize", entry.messageSize);
+        results.append(result);
+    }
+    return results;
+}
+
+void NfcTagCatalog::buildKeyIndex()
+{
+    m_keyIndex.clear();
+    for (int i = 0; i < m_entries.size(); i++) {
+        foreach (const QString &key, m_entries[i].keys) {
+            m_keyIndex[key].append(i);
+        }
+    }
+}
+
+/*!
+  \brief Append the entry to the index file with a single write.
+  */
+bool NfcTagCatalog::appendToIndex(const NfcCatalogEntry &entry)
+{
+    if (!m_indexFile.isOpen()) {
+        return false;
+    }
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_7);
+    stream << entry;
+    return m_indexFile.write(data) == data.size();
+}
+
+/*!
+  \brief Read all entries from the index file and create the key index.
+  \return false if the index file doesn't exist or is invalid.
+  */
+bool NfcTagCatalog::loadIndex()
+{
+    m_entries.clear();
+    QFile file(QDir(m_directory).filePath(NFC_CATALOG_FILE_NAME));
+    if (!file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    if (file.read(sizeof(NFC_CATALOG_MAGIC) - 1) != NFC_CATALOG_MAGIC) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_7);
+    qint64 validSize = file.pos();
+    bool sorted = true;
+    while (!stream.atEnd()) {
+        NfcCatalogEntry entry;
+        stream >> entry;
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+        if (!m_entries.isEmpty() && entry.timestamp < m_entries.last().timestamp) {
+            sorted = false;
+        }
+        m_entries.append(entry);
+        validSize = file.pos();
+    }
+    if (validSize < file.size()) {
+        // Remove the incomplete entry, so that new entries can be appended
+        qDebug() << "Tag catalog truncated, recovered " << m_entries.size() << " entries";
+        file.resize(validSize);
+    }
+    file.close();
+    if (!sorted) {
+        qStableSort(m_entries.begin(), m_entries.end(), entryLessThan);
+    }
+    buildKeyIndex();
+    return true;
+}
+
+/*!
+  \brief Rewrite the index file with all entries and keep it open
+  for appending further entries.
+  */
+bool NfcTagCatalog::writeIndex()
+{
+    m_indexFile.close();
+    m_indexFile.setFileName(QDir(m_directory).filePath(NFC_CATALOG_FILE_NAME));
+    if (!m_indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Unable to write tag catalog: " << m_indexFile.fileName();
+        return false;
+    }
+    m_indexFile.write(NFC_CATALOG_MAGIC);
+    QDataStream stream(&m_indexFile);
+    stream.setVersion(QDataStream::Qt_4_7);
+    for (int i = 0; i < m_entries.size(); i++) {
+        stream << m_entries[i];
+    }
+    m_indexFile.close();
+    return m_indexFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered);
+}
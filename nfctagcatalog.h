@@ -0,0 +1,127 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NFCTAGCATALOG_H
+#define NFCTAGCATALOG_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QVariant>
+#include <QFile>
+#include <QFutureWatcher>
+#include "ndefmessagedecoder.h"
+#include "ndefsegmentlog.h"
+
+/*! Name of the index file, stored in the directory of the collected messages. */
+#define NFC_CATALOG_FILE_NAME "nfccatalog.idx"
+#define NFC_CATALOG_MAGIC "NFCCAT01"
+/*! Maximum number of URI / text tokens indexed per message. */
+#define NFC_CATALOG_MAX_TOKENS 64
+#define NFC_CATALOG_MIN_TOKEN_LENGTH 2
+#define NFC_CATALOG_MAX_TOKEN_LENGTH 32
+
+/*!
+  \brief Catalog entry for a single logged NDEF message.
+  */
+struct NfcCatalogEntry
+{
+    NfcCatalogEntry();
+
+    qint64 timestamp;
+    /*! File name or frame reference of the segment log. */
+    QString fileName;
+    QString tagType;
+    QByteArray uid;
+    int messageSize;
+    /*! Index keys: "uid:<hex>", "type:<record type>" and the tokens
+      of the tag type, URIs and texts. */
+    QStringList keys;
+};
+
+/*!
+  \brief Persistent, searchable index of the logged tags.
+
+  The catalog is stored in an append-only index file next to the
+  collected messages. New messages are added incrementally when
+  they are logged; rebuild() recreates the index from all files in
+  the directory, e.g., for existing logs.
+
+  In memory, the catalog keeps an inverted index from every key to
+  the (chronologically sorted) entries that contain it. Queries
+  intersect these lists, so they don't need to access the logged
+  files at all.
+  */
+class NfcTagCatalog : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NfcTagCatalog(QObject *parent = 0);
+    ~NfcTagCatalog();
+
+    bool open(const QString &directory);
+    void close();
+    QString directory() const;
+
+    bool addMessage(const QString &fileName, const QByteArray &rawMessage, const QString &tagType, const QByteArray &uid, const QDateTime &timestamp = QDateTime());
+
+    Q_INVOKABLE int size() const;
+    Q_INVOKABLE bool isRebuilding() const;
+    Q_INVOKABLE bool rebuild();
+    Q_INVOKABLE QVariantList query(const QString &queryText, const int maxResults = 100) const;
+    Q_INVOKABLE QVariantList queryTimeRange(const QString &queryText, const QDateTime &from, const QDateTime &to, const int maxResults = 100) const;
+    Q_INVOKABLE QStringList findByUid(const QString &uidHex) const;
+    Q_INVOKABLE QStringList findByRecordType(const QString &recordType) const;
+
+signals:
+    /*! Rebuilding the catalog has finished. */
+    void rebuilt(int entryCount);
+
+private slots:
+    void rebuildFinished();
+
+public:
+    static QList<NfcCatalogEntry> catalogFile(const QString &fileName);
+    static void mergeEntries(QList<NfcCatalogEntry> &result, const QList<NfcCatalogEntry> &fileEntries);
+    static NfcCatalogEntry createEntry(const QString &fileName, const QByteArray &rawMessage, const QString &tagType, const QByteArray &uid, const qint64 timestamp);
+
+private:
+    static void addTokens(const QString &text, QSet<QString> &keys);
+    QVector<int> findEntries(const QStringList &terms, const int first, const int last) const;
+    QVariantList toVariantList(const QVector<int> &entries, const int maxResults) const;
+    void buildKeyIndex();
+    bool appendToIndex(const NfcCatalogEntry &entry);
+    bool loadIndex();
+    bool writeIndex();
+
+private:
+    QString m_directory;
+    /*! Entries, sorted by their timestamp. */
+    QVector<NfcCatalogEntry> m_entries;
+    /*! For each key, the ascending indices of the entries in m_entries. */
+    QHash<QString, QVector<int> > m_keyIndex;
+    QFile m_indexFile;
+    QFutureWatcher<QList<NfcCatalogEntry> > *m_rebuildWatcher;
+    /*! Entries added while rebuilding, merged after rebuilding has finished. */
+    QList<NfcCatalogEntry> m_pendingEntries;
+};
+
+#endif // NFCTAGCATALOG_H
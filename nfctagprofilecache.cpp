@@ -0,0 +1,326 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "nfctagprofilecache.h"
+#include <QFile>
+#include <QDataStream>
+#include <QDebug>
+
+static QDataStream &operator<<(QDataStream &stream, const NfcTagProfile &profile)
+{
+    const NearFieldTargetInfo &info = profile.tagInfo;
+    stream << info.tagTypeName << info.tagUid
+           << (qint32)info.tagMajorVersion << (qint32)info.tagMinorVersion
+           << (qint32)info.tagMemorySize << (qint32)info.tagWritableSize << (qint32)info.tagNdefCapacity
+           << (qint32)info.tagReadAccessCC << (qint32)info.tagWriteAccessCC
+           << (qint32)info.tagReadAccessLockBits << (qint32)info.tagWriteAccessLockBits
+           << (qint32)info.tagMemoryType << profile.nfcInfo;
+    return stream;
+}
+
+static QDataStream &operator>>(QDataStream &stream, NfcTagProfile &profile)
+{
+    NearFieldTargetInfo &info = profile.tagInfo;
+    qint32 majorVersion, minorVersion, memorySize, writableSize, ndefCapacity;
+    qint32 readAccessCC, writeAccessCC, readAccessLockBits, writeAccessLockBits, memoryType;
+    stream >> info.tagTypeName >> info.tagUid
+           >> majorVersion >> minorVersion
+           >> memorySize >> writableSize >> ndefCapacity
+           >> readAccessCC >> writeAccessCC
+           >> readAccessLockBits >> writeAccessLockBits
+           >> memoryType >> profile.nfcInfo;
+    info.tagMajorVersion = majorVersion;
+    info.tagMinorVersion = minorVersion;
+    info.tagMemorySize = memorySize;
+    info.tagWritableSize = writableSize;
+    info.tagNdefCapacity = ndefCapacity;
+    info.tagReadAccessCC = (NearFieldTargetInfo::NfcTagAccessStatus)readAccessCC;
+    info.tagWriteAccessCC = (NearFieldTargetInfo::NfcTagAccessStatus)writeAccessCC;
+    info.tagReadAccessLockBits = (NearFieldTargetInfo::NfcTagAccessStatus)readAccessLockBits;
+    info.tagWriteAccessLockBits = (NearFieldTargetInfo::NfcTagAccessStatus)writeAccessLockBits;
+    info.tagMemoryType = (NearFieldTargetInfo::NfcTagMemoryType)memoryType;
+    return stream;
+}
+
+NfcTagProfileCache::NfcTagProfileCache(QObject *parent) :
+    QObject(parent),
+    m_capacity(NFC_PROFILE_CACHE_DEFAULT_CAPACITY),
+    m_hitCount(0),
+    m_missCount(0),
+    m_dirty(false)
+{
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(NFC_PROFILE_CACHE_SAVE_DELAY_MSECS);
+    connect(&m_saveTimer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+NfcTagProfileCache::~NfcTagProfileCache()
+{
+    flush();
+}
+
+/*!
+  \brief Maximum number of tags to keep in the cache. If more tags
+  are added, the least recently used ones are removed.
+  */
+void NfcTagProfileCache::setCapacity(const int capacity)
+{
+    m_capacity = qMax(1, capacity);
+    if (m_profiles.size() > m_capacity) {
+        trim();
+        markDirty();
+    }
+}
+
+int NfcTagProfileCache::capacity() const
+{
+    return m_capacity;
+}
+
+int NfcTagProfileCache::count() const
+{
+    return m_profiles.size();
+}
+
+/*!
+  \brief Find the stored profile of the tag with the \a uid.
+
+  The profile is only returned if it has been created for the same
+  type of tag, so that a UID that is re-used by a different tag type
+  (e.g., random UIDs of emulated cards) doesn't return wrong results.
+
+  \return true if the profile has been found and copied to \a profile.
+  */
+bool NfcTagProfileCache::lookup(const QByteArray &uid, const QString &tagTypeName, NfcTagProfile &profile)
+{
+    QHash<QByteArray, NfcTagProfile>::const_iterator it = m_profiles.constFind(uid);
+    if (uid.isEmpty() || it == m_profiles.constEnd() || it.value().tagInfo.tagTypeName != tagTypeName) {
+        m_missCount++;
+        return false;
+    }
+    profile = it.value();
+    m_hitCount++;
+    // Mark as most recently used. The order is only persisted
+    // when the cache changes the next time.
+    if (m_lru.last() != uid) {
+        m_lru.removeOne(uid);
+        m_lru.append(uid);
+    }
+    return true;
+}
+
+/*!
+  \brief Store the analysis results of the tag with the \a uid,
+  replacing a previous profile of the same tag.
+  */
+void NfcTagProfileCache::insert(const QByteArray &uid, const NfcTagProfile &profile)
+{
+    if (uid.isEmpty()) {
+        return;
+    }
+    if (m_profiles.contains(uid)) {
+        m_lru.removeOne(uid);
+    }
+    m_profiles.insert(uid, profile);
+    m_lru.append(uid);
+    trim();
+    markDirty();
+}
+
+/*!
+  \brief Remove the profile of the tag with the \a uid, so that it
+  will be analyzed again when touched the next time.
+  */
+void NfcTagProfileCache::invalidate(const QByteArray &uid)
+{
+    if (m_profiles.remove(uid) > 0) {
+        m_lru.removeOne(uid);
+        markDirty();
+    }
+}
+
+void NfcTagProfileCache::clear()
+{
+    m_profiles.clear();
+    m_lru.clear();
+    m_hitCount = 0;
+    m_missCount = 0;
+    markDirty();
+    // Don't keep the removed profiles in the file until the next change
+    flush();
+}
+
+/*!
+  \brief Persist the cache to \a fileName. Profiles already stored
+  in the file are added to the cache. Pass an empty file name to only
+  keep the cache in memory.
+
+  \return false if the file exists but couldn't be read.
+  */
+bool NfcTagProfileCache::setPersistentFile(const QString &fileName)
+{
+    if (fileName == m_fileName) {
+        return true;
+    }
+    // Pending changes belong to the previous file
+    flush();
+    m_fileName = fileName;
+    if (m_fileName.isEmpty()) {
+        return true;
+    }
+    const bool success = load();
+    // Write the merged profiles of memory and file
+    save();
+    return success;
+}
+
+QString NfcTagProfileCache::persistentFile() const
+{
+    return m_fileName;
+}
+
+/*!
+  \brief Number of lookups that found the profile of the tag.
+  */
+int NfcTagProfileCache::hitCount() const
+{
+    return m_hitCount;
+}
+
+/*!
+  \brief Number of lookups of tags that weren't in the cache.
+  */
+int NfcTagProfileCache::missCount() const
+{
+    return m_missCount;
+}
+
+/*!
+  \brief Write pending changes to the persistent file right away,
+  e.g., before the app is closed.
+  \return false if saving failed.
+  */
+bool NfcTagProfileCache::flush()
+{
+    m_saveTimer.stop();
+    if (!m_dirty) {
+        return true;
+    }
+    m_dirty = false;
+    return save();
+}
+
+/*!
+  \brief Add the profiles of the persistent file to the cache.
+  Profiles that are already cached in memory are more recent and
+  therefore take precedence.
+  */
+bool NfcTagProfileCache::load()
+{
+    QFile file(m_fileName);
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Unable to read tag profile cache: " << m_fileName;
+        return false;
+    }
+    const QByteArray magic = file.read(sizeof(NFC_PROFILE_CACHE_MAGIC) - 1);
+    if (magic != NFC_PROFILE_CACHE_MAGIC) {
+        qDebug() << "Unknown format of tag profile cache: " << m_fileName;
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_7);
+    // Stored from least to most recently used
+    QList<QByteArray> loadedUids;
+    QHash<QByteArray, NfcTagProfile> loadedProfiles;
+    while (!stream.atEnd()) {
+        QByteArray uid;
+        NfcTagProfile profile;
+        stream >> uid >> profile;
+        if (stream.status() != QDataStream::Ok) {
+            // Truncated file - keep the complete profiles
+            qDebug() << "Tag profile cache truncated after " << loadedUids.size() << " profiles";
+            break;
+        }
+        if (!loadedProfiles.contains(uid)) {
+            loadedUids.append(uid);
+        }
+        loadedProfiles.insert(uid, profile);
+    }
+    for (int i = loadedUids.size() - 1; i >= 0; i--) {
+        const QByteArray &uid = loadedUids.at(i);
+        if (!m_profiles.contains(uid)) {
+            m_profiles.insert(uid, loadedProfiles.value(uid));
+            m_lru.prepend(uid);
+        }
+    }
+    trim();
+    return true;
+}
+
+/*!
+  \brief Write all profiles to the persistent file. The file is
+  written to a temporary file first, so that a crash while saving
+  doesn't lose the previous profiles.
+  */
+bool NfcTagProfileCache::save()
+{
+    if (m_fileName.isEmpty()) {
+        return true;
+    }
+    QFile newFile(m_fileName + ".new");
+    if (!newFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Unable to write tag profile cache: " << newFile.fileName();
+        return false;
+    }
+    newFile.write(NFC_PROFILE_CACHE_MAGIC);
+    QDataStream stream(&newFile);
+    stream.setVersion(QDataStream::Qt_4_7);
+    for (int i = 0; i < m_lru.size(); i++) {
+        stream << m_lru.at(i) << m_profiles.value(m_lru.at(i));
+    }
+    newFile.close();
+    if (stream.status() != QDataStream::Ok) {
+        newFile.remove();
+        return false;
+    }
+    QFile::remove(m_fileName);
+    return newFile.rename(m_fileName);
+}
+
+/*!
+  \brief Save the changed cache once no further change has happened
+  for NFC_PROFILE_CACHE_SAVE_DELAY_MSECS.
+  */
+void NfcTagProfileCache::markDirty()
+{
+    if (m_fileName.isEmpty()) {
+        return;
+    }
+    m_dirty = true;
+    m_saveTimer.start();
+}
+
+/*!
+  \brief Remove the least recently used profiles that exceed the capacity.
+  */
+void NfcTagProfileCache::trim()
+{
+    while (m_lru.size() > m_capacity) {
+        m_profiles.remove(m_lru.takeFirst());
+    }
+}
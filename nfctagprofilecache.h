@@ -0,0 +1,106 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NFCTAGPROFILECACHE_H
+#define NFCTAGPROFILECACHE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include "nearfieldtargetinfo.h"
+
+#define NFC_PROFILE_CACHE_FILE_NAME "nfcprofiles.dat"
+#define NFC_PROFILE_CACHE_MAGIC "NFCPRF02"
+#define NFC_PROFILE_CACHE_DEFAULT_CAPACITY 128
+// Changes are collected for this time before the file is rewritten
+#define NFC_PROFILE_CACHE_SAVE_DELAY_MSECS 5000
+
+/*!
+  \brief Results of the tag-type specific analysis of a single tag.
+  */
+struct NfcTagProfile
+{
+    NearFieldTargetInfo tagInfo;
+    /*! Textual description of the tag-type specific analysis. */
+    QString nfcInfo;
+};
+
+/*!
+  \brief Least recently used cache of the analysis results of tags,
+  identified by their UID.
+
+  The NfcTargetAnalyzer stores the results of every complete analysis,
+  so that touching the same tag again doesn't need to send any
+  tag-type specific requests. Writing to a tag can change its lock
+  bits and capability container; invalidate() its profile in that case.
+
+  Optionally, the cache is persisted to a file, so that known tags
+  don't have to be analyzed again after restarting the app. Changes
+  only mark the cache as dirty; the file is rewritten once no further
+  change has happened for a few seconds, and when the cache is
+  destroyed. This way, quickly touching many tags (e.g., when
+  provisioning) doesn't rewrite the file for every tag. The profiles
+  are stored in the order of their last use.
+  */
+class NfcTagProfileCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NfcTagProfileCache(QObject *parent = 0);
+    ~NfcTagProfileCache();
+
+    void setCapacity(const int capacity);
+    int capacity() const;
+    int count() const;
+
+    bool lookup(const QByteArray &uid, const QString &tagTypeName, NfcTagProfile &profile);
+    void insert(const QByteArray &uid, const NfcTagProfile &profile);
+    void invalidate(const QByteArray &uid);
+    void clear();
+
+    bool setPersistentFile(const QString &fileName);
+    QString persistentFile() const;
+
+    int hitCount() const;
+    int missCount() const;
+
+public slots:
+    bool flush();
+
+private:
+    bool load();
+    bool save();
+    void markDirty();
+    void trim();
+
+private:
+    QHash<QByteArray, NfcTagProfile> m_profiles;
+    /*! UIDs of the cached profiles, the most recently used one last. */
+    QList<QByteArray> m_lru;
+    int m_capacity;
+    /*! File the cache is persisted to, or empty if only kept in memory. */
+    QString m_fileName;
+    int m_hitCount;
+    int m_missCount;
+    /*! The cache has changed since it has been saved. */
+    bool m_dirty;
+    /*! Delays saving after a change. */
+    QTimer m_saveTimer;
+};
+
+#endif // NFCTAGPROFILECACHE_H
@@ -19,7 +19,8 @@
   \brief Create a new Nfc Target Analyzer instance.
   */
 NfcTargetAnalyzer::NfcTargetAnalyzer(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    m_requestFailed(false)
 {
 }
 
@@ -27,11 +28,19 @@ NfcTargetAnalyzer::NfcTargetAnalyzer(QObject *parent) :
   \brief Create a string containing a textual description of the generic
   tag properties.
 
+  If the target allows tag-type specific access, all requests needed
+  to analyze it in more detail are sent directly afterwards. This method
+  doesn't wait for their results; they are emitted through the
+  targetAnalyzed() signal instead.
+
   \param target the NFC target to analyze. Works for all supported targets,
   not only for NDEF targets.
   */
 QString NfcTargetAnalyzer::analyzeTarget(QNearFieldTarget* target)
 {
+    // Results of a previous target are not relevant anymore
+    abortAnalysis();
+
     QString nfcInfo;
     m_tagInfo.resetInfo();
 
@@ -39,7 +48,8 @@ QString NfcTargetAnalyzer::analyzeTarget(QNearFieldTarget* target)
     m_tagInfo.tagTypeName = convertTagTypeToString(target->type());
     nfcInfo.append("Target type: " + m_tagInfo.tagTypeName + "\n");
     // Tag UID
-    QString uidString = QVariant(target->uid().toHex()).toString();
+    m_tagInfo.tagUid = target->uid();
+    QString uidString = QVariant(m_tagInfo.tagUid.toHex()).toString();
     nfcInfo.append("UID: " + uidString + "\n");
     // Tag URL (not to be confused with the URL of an NDEF record)
     if (!target->url().isEmpty()) { nfcInfo.append("Url: " + target->url().toString()) + "\n"; }
@@ -75,63 +85,251 @@ QString NfcTargetAnalyzer::analyzeTarget(QNearFieldTarget* target)
 #endif
     if (alwaysAnalyzeTagSpecific || accessMethods.testFlag(QNearFieldTarget::TagTypeSpecificAccess)) {
 
+        // Repeated touch of a known tag: use the previous results
+        NfcTagProfile profile;
+        if (m_profileCache.lookup(m_tagInfo.tagUid, m_tagInfo.tagTypeName, profile)) {
+            m_tagInfo = profile.tagInfo;
+            nfcInfo.append(profile.nfcInfo);
+            return nfcInfo.trimmed();
+        }
+
         if (target->type() == QNearFieldTarget::NfcTagType1)
         {
             // NFC Forum Tag Type 1
             QNearFieldTagType1* targetSpecific = qobject_cast<QNearFieldTagType1 *>(target);
-            nfcInfo.append(analyzeType1Target(targetSpecific));
+            if (targetSpecific) {
+                startType1Analysis(targetSpecific);
+            }
         }
         else if (target->type() == QNearFieldTarget::NfcTagType2)
         {
             // NFC Forum Tag Type 2
             QNearFieldTagType2* targetSpecific = qobject_cast<QNearFieldTagType2 *>(target);
-            nfcInfo.append(analyzeType2Target(targetSpecific));
+            if (targetSpecific) {
+                startType2Analysis(targetSpecific);
+            }
         }
     }
 
     return nfcInfo.trimmed();
 }
 
+/*!
+  \brief Returns true while the target hasn't answered all requests
+  of the tag-type specific analysis yet.
+  */
+bool NfcTargetAnalyzer::isAnalyzing() const
+{
+    return !m_target.isNull() && !m_pendingRequests.isEmpty();
+}
+
+/*!
+  \brief Returns true if the request \a id has been sent to the current
+  target by the analyzer.
+
+  Errors of these requests are already handled by the analyzer,
+  which will report the parts of the target it couldn't analyze.
+  */
+bool NfcTargetAnalyzer::isAnalyzerRequest(const QNearFieldTarget::RequestId &id) const
+{
+    return m_analysisRequests.contains(id);
+}
+
+/*!
+  \brief Cache of the analysis results of known tags, e.g., to
+  invalidate the profile of a tag after writing to it.
+  */
+NfcTagProfileCache *NfcTargetAnalyzer::profileCache()
+{
+    return &m_profileCache;
+}
+
+/*!
+  \brief Stop waiting for the responses of the previous target.
+  */
+void NfcTargetAnalyzer::abortAnalysis()
+{
+    if (m_target) {
+        disconnect(m_target, 0, this, 0);
+    }
+    m_target = NULL;
+    m_pendingRequests.clear();
+    m_analysisRequests.clear();
+    m_responses.clear();
+    m_requestFailed = false;
+}
+
+/*!
+  \brief Send the request needed to analyze a target based on the
+  NFC Forum Type 1 platform (such as the Innovision Topaz).
+
+  A single READALL command returns the header ROM, the capability
+  container, the lock bytes and the start of the data area, so the
+  target only needs to be accessed once.
+  */
+void NfcTargetAnalyzer::startType1Analysis(QNearFieldTagType1* target)
+{
+    m_target = target;
+    connect(target, SIGNAL(requestCompleted(const QNearFieldTarget::RequestId)),
+            this, SLOT(requestCompleted(QNearFieldTarget::RequestId)));
+    connect(target, SIGNAL(error(QNearFieldTarget::Error,QNearFieldTarget::RequestId)),
+            this, SLOT(targetError(QNearFieldTarget::Error,QNearFieldTarget::RequestId)));
+
+    // HR0, HR1 and the bytes of blocks 0h - Eh.
+    // For dynamic memory tags, this is the first segment.
+    addRequest(target->readAll(), Type1ReadAll);
+}
+
+/*!
+  \brief Send the request needed to analyze a target based on the
+  NFC Forum Type 2 platform.
+
+  The READ command always returns 16 bytes. Reading block 2 therefore
+  also returns the capability container in block 3 and the start of the
+  data area in blocks 4 and 5. Both reads are sent at once, the second
+  one returns blocks 6 - 9 with the rest of the control TLVs.
+  */
+void NfcTargetAnalyzer::startType2Analysis(QNearFieldTagType2* target)
+{
+    m_target = target;
+    connect(target, SIGNAL(requestCompleted(const QNearFieldTarget::RequestId)),
+            this, SLOT(requestCompleted(QNearFieldTarget::RequestId)));
+    connect(target, SIGNAL(error(QNearFieldTarget::Error,QNearFieldTarget::RequestId)),
+            this, SLOT(targetError(QNearFieldTarget::Error,QNearFieldTarget::RequestId)));
+
+    // Note: selecting sector 0 doesn't work really, but not important
+    // as the tag starts in sector 0 anyway. The variable in the
+    // tag-specific class where it stores the current sector unfortunately
+    // isn't public, to switch the sector only on demand.
+
+    // Blocks 2 - 5: static lock bytes, capability container (with
+    // the version number and memory size, as returned by the blocking
+    // target->version() and target->memorySize()) and the first TLVs.
+    addRequest(target->readBlock(2), Type2ReadBlocks);
+    // Blocks 6 - 9: Lock Control, Memory Control and NDEF message TLVs
+    // usually start within the first 24 bytes of the data area.
+    addRequest(target->readBlock(6), Type2ReadDataBlocks);
+}
+
+void NfcTargetAnalyzer::addRequest(const QNearFieldTarget::RequestId &id, const AnalyzerRequest request)
+{
+    if (!id.isValid()) {
+        // Request couldn't be sent at all
+        return;
+    }
+    m_pendingRequests.append(qMakePair(id, request));
+    m_analysisRequests.append(id);
+}
+
+void NfcTargetAnalyzer::requestCompleted(const QNearFieldTarget::RequestId &id)
+{
+    finishRequest(id, true);
+}
+
+void NfcTargetAnalyzer::targetError(QNearFieldTarget::Error error, const QNearFieldTarget::RequestId &id)
+{
+    Q_UNUSED(error);
+    finishRequest(id, false);
+}
+
+/*!
+  \brief Store the response of the request \a id. Once all requests
+  have been answered, merge the results into m_tagInfo and emit the
+  targetAnalyzed() signal.
+  */
+void NfcTargetAnalyzer::finishRequest(const QNearFieldTarget::RequestId &id, const bool success)
+{
+    if (!m_target || sender() != m_target.data()) {
+        return;
+    }
+    for (int i = 0; i < m_pendingRequests.size(); i++) {
+        if (m_pendingRequests.at(i).first == id) {
+            const AnalyzerRequest request = m_pendingRequests.at(i).second;
+            if (success) {
+                m_responses.insert(request, m_target->requestResponse(id));
+            } else {
+                qDebug() << "Analyzer request" << request << "failed";
+                m_requestFailed = true;
+            }
+            m_pendingRequests.removeAt(i);
+            break;
+        }
+    }
+    if (!m_pendingRequests.isEmpty()) {
+        return;
+    }
+
+    QString nfcInfo;
+    if (m_target->type() == QNearFieldTarget::NfcTagType1) {
+        nfcInfo = analyzeType1Results();
+    } else if (m_target->type() == QNearFieldTarget::NfcTagType2) {
+        nfcInfo = analyzeType2Results();
+    }
+    disconnect(m_target, 0, this, 0);
+    m_responses.clear();
+    nfcInfo = nfcInfo.trimmed();
+    if (!m_requestFailed) {
+        // Complete analysis - no need to repeat it for the same tag
+        NfcTagProfile profile;
+        profile.tagInfo = m_tagInfo;
+        profile.nfcInfo = nfcInfo;
+        m_profileCache.insert(m_tagInfo.tagUid, profile);
+    }
+    emit targetAnalyzed(nfcInfo);
+}
+
 /*!
   \brief Show more detailed information if the target is based on the NFC Forum Type 1 platform
   (such as the Innovision Topaz).
   */
-QString NfcTargetAnalyzer::analyzeType1Target(QNearFieldTagType1* target)
+QString NfcTargetAnalyzer::analyzeType1Results()
 {
     QString nfcInfo;
 
+    // READALL response: HR0, HR1, followed by the bytes of blocks 0h - Eh
+    QByteArray readAll;
+    const QVariant response = m_responses.value(Type1ReadAll);
+    if (response.isValid() && response.type() == QVariant::ByteArray) {
+        readAll = response.toByteArray();
+    }
+    if (readAll.size() < TYPE1_READALL_SIZE) {
+        qDebug() << "Error reading all bytes of the NFC Forum tag type one target.";
+        return nfcInfo;
+    }
+    // Memory of the tag, without the header ROM
+    const QByteArray memory = QByteArray::fromRawData(readAll.constData() + TYPE1_READALL_HEADER_SIZE,
+                                                      readAll.size() - TYPE1_READALL_HEADER_SIZE);
+
     // Static or dynamic memory?
-    QNearFieldTarget::RequestId id = target->readIdentification();
-    if (!target->waitForRequestCompleted(id)) {
-        qDebug() << "Error reading identification bytes of the NFC Forum tag type one target.";
+    // Byte 0: HR0
+    // HR0 Upper nibble = 0001b SHALL determine that it as a Type 1, NDEF capable tag.
+    const quint8 hr0 = readAll.at(0);
+    const quint8 tagCheck = hr0 >> 4;      // Most significant nibble
+    if (tagCheck != 0x1) {
+        qDebug() << "No Type 1, NDEF capable tag";
+    }
+    // HR0 Lower nibble = 0001b SHALL determine static memory map,
+    // != 0001b SHALL determine the dynamic memory map.
+    const quint8 tagStaticMemory = hr0 & 0x0F;    // Least significant nibble
+    if (tagStaticMemory == 0x01) {
+        m_tagInfo.tagMemoryType = NearFieldTargetInfo::NfcMemoryStatic;
     } else {
-        QVariant response = target->requestResponse(id);
-        if (response.type() == QVariant::ByteArray) {
-            QByteArray tagIdentification = response.toByteArray();
-            if (tagIdentification.size() > 2) {
-                // Response contains at least HR0 and HR1
-                // Byte 0: HR0
-                // HR0 Upper nibble = 0001b SHALL determine that it as a Type 1, NDEF capable tag.
-                const quint8 tagCheck = tagIdentification[0] >> 4;      // Most significant nibble
-                if (tagCheck != 0x1) {
-                    qDebug() << "No Type 1, NDEF capable tag";
-                }
-                // HR0 Lower nibble = 0001b SHALL determine static memory map,
-                // != 0001b SHALL determine the dynamic memory map.
-                const quint8 tagStaticMemory = tagIdentification[0] & 0x0F;    // Least significant nibble
-                if (tagStaticMemory == 0x01) {
-                    m_tagInfo.tagMemoryType = NearFieldTargetInfo::NfcMemoryStatic;
-                } else {
-                    m_tagInfo.tagMemoryType = NearFieldTargetInfo::NfcMemoryDynamic;
-                }
-                // Byte 1: HR1 = xxh is undefined and SHALL be ignored.
-            }
-        }
+        m_tagInfo.tagMemoryType = NearFieldTargetInfo::NfcMemoryDynamic;
     }
+    // Byte 1: HR1 = xxh is undefined and SHALL be ignored.
+
+    // Check if the Capability Container (CC) is present on the tag.
+    // SHALL be the case when an NDEF message is present on the tag.
+    // The CC SHALL be assigned to be in the first four bytes of memory block 1.
+    // Byte 0 CC memory area starts with NDEF magic number (E1h)
+    // Byte 1 SHALL carry the Version Number (VNo) of this document as supported by the Type 1 Tag.
+    // Byte 2 SHALL indicate the physical tag memory size (TMS) of the Type 1 Tag as multipliers of (8 bytes) * (n+1).
+    // Byte 3 SHALL indicate the read and write access (RWA) capability of the CC and data area of the Type 1 Tag.
+    const bool hasCapabilityContainer = ((quint8)memory.at(TYPE1_CC_ADDRESS) == NDEF_MAGIC_NUMBER);
 
     // Read capability container information
     // Tag version number (VNo)
-    const quint8 tagVersion = target->version();
+    const quint8 tagVersion = hasCapabilityContainer ? (quint8)memory.at(TYPE1_CC_ADDRESS + 1) : 0;
     const int tagMajorVersion = tagVersion >> 4;      // Most significant nibble
     const int tagMinorVersion = tagVersion & 0x0F;    // Least significant nibble
     if (tagVersion > 0) {
@@ -140,23 +338,17 @@ QString NfcTargetAnalyzer::analyzeType1Target(QNearFieldTagType1* target)
     m_tagInfo.tagMajorVersion = tagMajorVersion;
     m_tagInfo.tagMinorVersion = tagMinorVersion;
 
-    // Read physical tag memory size (TMS)
+    // Physical tag memory size (TMS)
     // This reads the tag size from the Capability Container (CC)
     // Therefore, only works when the tag is NDEF-formatted.
     // Also, the returned value can be the total tag size, and doesn't
     // usually mean the actual writable & usable tag memory size.
-    int tagMemorySize = target->memorySize();
-    if (tagMemorySize > 0) {
+    // TMS = size of the tag as multipliers of (8 bytes) * (n+1)
+    int tagMemorySize = -1;
+    if (hasCapabilityContainer) {
+        tagMemorySize = 8 * ((quint8)memory.at(TYPE1_CC_ADDRESS + 2) + 1);
         nfcInfo.append("Memory size: " + QString::number(tagMemorySize) + " bytes");
     }
-#ifdef MEEGO_EDITION_HARMATTAN
-    if (tagMemorySize == 0) {
-        // MeeGo returns 0 for the tag size because it can't determine it,
-        // not because that's the real tag size.
-        // -> set it to unknown
-        tagMemorySize = -1;
-    }
-#endif
     if (m_tagInfo.tagMemoryType != NearFieldTargetInfo::NfcMemoryUnknown) {
         if (tagMemorySize > 0) {
             // Memory size is available - add type to the same line
@@ -193,50 +385,36 @@ QString NfcTargetAnalyzer::analyzeType1Target(QNearFieldTagType1* target)
 
     // Lock status of static memory tag
     if (m_tagInfo.tagMemoryType == NearFieldTargetInfo::NfcMemoryStatic) {
-        // Read bytes 0, 1 of block 0xE
+        // Bytes 0, 1 of block 0xE
         // All twelve of the memory blocks 1h to Ch are separately lockable.
-        // When a blocks lock-bit is set to a 1, that block becomes irreversibly frozen as read-only.
+        // When a blocks lock-bit is set to a 1, that block becomes irreversibly frozen as read-only.
         // The lock-bits are stored in the Bytes 0 & 1 of BLOCK-Eh.
-
-        // readBlock() is a dynamic memory only method for type 1 tags
-        // Use readByte() instead.
-        id = target->readByte(0x0E*8);
-        if (!target->waitForRequestCompleted(id)) {
-            qDebug() << "Error reading block E, byte 0 of the NFC Forum tag type 1 target.";
-        } else {
-            quint8 lock0 = target->requestResponse(id).toUInt();
-
-            id = target->readByte(0x0E*8 + 1);
-            if (!target->waitForRequestCompleted(id)) {
-                qDebug() << "Error reading block E, byte 1 of the NFC Forum tag type 1 target.";
-            } else {
-                quint8 lock1 = target->requestResponse(id).toUInt();
-                qDebug() << "Lock bits: 0x" << QString::number(lock0, 16) << " 0x" << QString::number(lock1, 16);
-                // Clear probably set bits that are not relevant for
-                // the number of free data blocks
-                // b0 of lock0 = UID block -> always locked
-                lock0 &= 0xFE;
-                // b5 / b6 of lock1 = lock area (block D/E) - irrelevant for data area
-                // b7 of lock1 = not used
-                lock1 &= 0x1F;
-                // Count number of lock bits set
-                unsigned int bitCount = 0;
-                for (; lock0; bitCount++) {
-                  lock0 &= lock0 - 1;   // Clear the least significant bit set
-                }
-                for (; lock1; bitCount++) {
-                  lock1 &= lock1 - 1;   // Clear the least significant bit set
-                }
-                // Out of the 12 blocks of the static memory area,
-                // count how many are still unlocked and then convert the blocks
-                // to the number of bytes (8 bytes per block).
-                const int unlockedBytes = (12 - bitCount) * 8;
-                nfcInfo.append("Unlocked bytes in data area: " + QString::number(unlockedBytes) + "\n");
-                // Check if this reduces the writable tag size
-                if (unlockedBytes < m_tagInfo.tagWritableSize) {
-                    m_tagInfo.tagWritableSize = unlockedBytes;
-                }
-            }
+        quint8 lock0 = memory.at(TYPE1_LOCK_ADDRESS);
+        quint8 lock1 = memory.at(TYPE1_LOCK_ADDRESS + 1);
+        qDebug() << "Lock bits: 0x" << QString::number(lock0, 16) << " 0x" << QString::number(lock1, 16);
+        // Clear probably set bits that are not relevant for
+        // the number of free data blocks
+        // b0 of lock0 = UID block -> always locked
+        lock0 &= 0xFE;
+        // b5 / b6 of lock1 = lock area (block D/E) - irrelevant for data area
+        // b7 of lock1 = not used
+        lock1 &= 0x1F;
+        // Count number of lock bits set
+        unsigned int bitCount = 0;
+        for (; lock0; bitCount++) {
+          lock0 &= lock0 - 1;   // Clear the least significant bit set
+        }
+        for (; lock1; bitCount++) {
+          lock1 &= lock1 - 1;   // Clear the least significant bit set
+        }
+        // Out of the 12 blocks of the static memory area,
+        // count how many are still unlocked and then convert the blocks
+        // to the number of bytes (8 bytes per block).
+        const int unlockedBytes = (12 - bitCount) * 8;
+        nfcInfo.append("Unlocked bytes in data area: " + QString::number(unlockedBytes) + "\n");
+        // Check if this reduces the writable tag size
+        if (unlockedBytes < m_tagInfo.tagWritableSize) {
+            m_tagInfo.tagWritableSize = unlockedBytes;
         }
     }
     if (m_tagInfo.tagWritableSize == 0) {
@@ -245,61 +423,44 @@ QString NfcTargetAnalyzer::analyzeType1Target(QNearFieldTagType1* target)
         m_tagInfo.tagWriteAccessLockBits = NearFieldTargetInfo::NfcAccessAllowed;
     }
 
-    // Check if the Capability Container (CC) is present on the tag.
-    // SHALL be the case when an NDEF message is present on the tag.
-    // The CC SHALL be assigned to be in the first four bytes of memory block 1.
-    // Byte 0 CC memory area starts with NDEF magic number (E1h)
-    // Byte 1 SHALL carry the Version Number (VNo) of this document as supported by the Type 1 Tag.
-    // Byte 2 SHALL indicate the physical tag memory size (TMS) of the Type 1 Tag as multipliers of (8 bytes) * (n+1).
-    // Byte 3 SHALL indicate the read and write access (RWA) capability of the CC and data area of the Type 1 Tag.
-    // --> Byte 0 of the CC block equals to target->readByte(8) -> block 1, byte 0 = 1 * 8 + 0
-    id = target->readByte(8);   // Check the NDEF magic number
-    if (!target->waitForRequestCompleted(id)) {
-        qDebug() << "Error reading NDEF magic number of the NFC Forum Tag Type 1 target.";
-    } else {
-        const quint8 ndefMagicNumber = target->requestResponse(id).toUInt();
-        if (ndefMagicNumber == NDEF_MAGIC_NUMBER) {
-            qDebug() << "Ndef magic number correct";
-            // Found the CC - now check read write access in byte 3 of block 1 -> byte 11 in total
-            id = target->readByte(11);  // 11 = memory block 1, byte-3 (CC3)
-            if (!target->waitForRequestCompleted(id)) {
-                qDebug() << "Error reading RWA capability of the NFC Forum Tag Type 1 target.";
-            } else {
-                const quint8 rwa = target->requestResponse(id).toUInt();
-                const int tagReadAccessCondition = rwa >> 4;      // Most significant nibble
-                const int tagWriteAccessCondition = rwa & 0x0F;    // Least significant nibble
-                // Read access 0 = read access without security
-                const QString tagReadAccess = (tagReadAccessCondition == 0 ? "yes" : "unknown");
-                if (tagReadAccessCondition == 0) {
-                    m_tagInfo.tagReadAccessCC = NearFieldTargetInfo::NfcAccessAllowed;
-                }
-                QString tagWriteAccess;
-                switch (tagWriteAccessCondition)
-                {
-                case 0x00:   // Write access without security
-                    tagWriteAccess = "yes";
-                    m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessAllowed;
-                    break;
-                case 0x0F:   // No write access
-                    tagWriteAccess = "no";
-                    m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessForbidden;
-                    break;
-                default:
-                    tagWriteAccess = "unknown";
-                    m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
-                }
-                nfcInfo.append("Access (CC): Read - " + tagReadAccess + ", Write - " + tagWriteAccess);
-            }
-        } else {
-            qDebug() << "Wrong NDEF magic number";
+    // Access conditions and TLVs (only if the CC is present)
+    if (hasCapabilityContainer) {
+        qDebug() << "Ndef magic number correct";
+        // Found the CC - now check read write access in byte 3 of block 1 -> byte 11 in total
+        const quint8 rwa = memory.at(TYPE1_CC_ADDRESS + 3);
+        const int tagReadAccessCondition = rwa >> 4;      // Most significant nibble
+        const int tagWriteAccessCondition = rwa & 0x0F;    // Least significant nibble
+        // Read access 0 = read access without security
+        const QString tagReadAccess = (tagReadAccessCondition == 0 ? "yes" : "unknown");
+        if (tagReadAccessCondition == 0) {
+            m_tagInfo.tagReadAccessCC = NearFieldTargetInfo::NfcAccessAllowed;
         }
+        QString tagWriteAccess;
+        switch (tagWriteAccessCondition)
+        {
+        case 0x00:   // Write access without security
+            tagWriteAccess = "yes";
+            m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessAllowed;
+            break;
+        case 0x0F:   // No write access
+            tagWriteAccess = "no";
+            m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessForbidden;
+            break;
+        default:
+            tagWriteAccess = "unknown";
+            m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
+        }
+        nfcInfo.append("Access (CC): Read - " + tagReadAccess + ", Write - " + tagWriteAccess + "\n");
+        // TLVs in front of the NDEF message. READALL only returns the
+        // first 120 bytes, which always contain the control TLVs.
+        NdefTlvParser parser;
+        parser.setDataArea(TYPE1_DATA_ADDRESS, tagMemorySize);
+        parser.addReservedArea(TYPE1_RESERVED_ADDRESS, TYPE1_RESERVED_SIZE);
+        nfcInfo.append(analyzeTlvs(parser, memory, 0));
+    } else {
+        qDebug() << "Wrong NDEF magic number";
     }
 
-    // Read all
-//        if (!pendingWriteNdef)
-//        {
-//            cachedRequestId = targetSpecific->readAll();
-//        }
     return nfcInfo;
 }
 
@@ -307,12 +468,21 @@ QString NfcTargetAnalyzer::analyzeType1Target(QNearFieldTagType1* target)
 /*!
   \brief Show more detailed information if the target is based on the NFC Forum Type 2 platform.
   */
-QString NfcTargetAnalyzer::analyzeType2Target(QNearFieldTagType2* target)
+QString NfcTargetAnalyzer::analyzeType2Results()
 {
     QString nfcInfo;
+    // Blocks 2 - 5 (16 bytes)
+    QByteArray blocks;
+    const QVariant response = m_responses.value(Type2ReadBlocks);
+    if (response.isValid() && response.type() == QVariant::ByteArray) {
+        blocks = response.toByteArray();
+    }
+    // Capability container (block 3)
+    const QByteArray cc = (blocks.size() >= TYPE2_READ_SIZE) ? blocks.mid(TYPE2_READ_CC_OFFSET, 4) : QByteArray();
+
     // Read capability container information
     // Tag version number (VNo)
-    const quint8 tagVersion = target->version();
+    const quint8 tagVersion = (cc.size() >= 4) ? (quint8)cc.at(1) : 0;
     const int tagMajorVersion = tagVersion >> 4;      // Most significant nibble
     const int tagMinorVersion = tagVersion & 0x0F;    // Least significant nibble
     if (tagVersion > 0) {
@@ -321,23 +491,20 @@ QString NfcTargetAnalyzer::analyzeType2Target(QNearFieldTagType2* target)
     m_tagInfo.tagMajorVersion = tagMajorVersion;
     m_tagInfo.tagMinorVersion = tagMinorVersion;
 
-    // Read physical tag memory size (TMS)
+    // Physical tag memory size (TMS): size of the data area / 8
     // TODO: check if the returned number is correct
-    int tagMemorySize = target->memorySize();
-    if (tagMemorySize > 0) {
-        nfcInfo.append("Memory size: " + QString::number(tagMemorySize) + " bytes - ");
-    }
-#ifdef MEEGO_EDITION_HARMATTAN
+    int tagMemorySize = (cc.size() >= 4) ? 8 * (quint8)cc.at(2) : -1;
     if (tagMemorySize == 0) {
-        // MeeGo returns 0 for the tag size because it can't determine it,
-        // not because that's the real tag size.
-        // -> set it to unknown
+        // Not NDEF-formatted - the size is unknown,
+        // not really 0 bytes.
         tagMemorySize = -1;
     }
-#endif
+    if (tagMemorySize > 0) {
+        nfcInfo.append("Memory size: " + QString::number(tagMemorySize) + " bytes - ");
+    }
 
     m_tagInfo.tagMemorySize = tagMemorySize;
-    // TODO: search for TLV areas in dynamic memory tags
+    // Refined by the TLVs in the data area, if the CC is present
     m_tagInfo.tagWritableSize = m_tagInfo.tagMemorySize;
 
 
@@ -352,107 +519,97 @@ QString NfcTargetAnalyzer::analyzeType2Target(QNearFieldTagType2* target)
         }
     }
 
-    // Read static lock bytes of the tag
+    // Static lock bytes of the tag
     // Each block on a NFC Forum Type 2 tag is 4 bytes (0 - 4).
     // The bits of byte 2 and 3 of block 2 represent the field-programmable read-only locking
     // mechanism called static lock bytes. Depending on the value of the bits of the static lock bytes two
     // configurations are possible:
     // * All bits are set to 0b, the CC area and the data area of the tag can be read and written.
     // * All bits are set to 1b, the CC area and the data area of the tag can be only read.
-
-    // Note: selecting sector 0 doesn't work really, but not important
-    // as previous calls to get the memory size through Qt Mobility already
-    // selected the sector. The variable in the tag-specific class where it stores
-    // the current sector unfortunately isn't public, to switch the sector
-    // only on demand.
-
-    // Static memory lock
-    QNearFieldTarget::RequestId id = target->readBlock(2);
-    if (!target->waitForRequestCompleted(id)) {
+    if (!response.isValid()) {
         qDebug() << "Error reading static lock bytes of the NFC Forum tag type two target.";
-    } else {
-        QVariant response = target->requestResponse(id);
-        if (response.isValid() && response.type() == QVariant::ByteArray) {
-            QByteArray p = response.toByteArray();
-            // Response: 16 bytes + 2 bytes checksum
-            if (p.size() > 4) {
-                if (p.at(2) == char(0x00) && p.at(3) == char(0x00)) {
-                    nfcInfo.append("Static lock: Read - yes, Write - yes\n");
-                    m_tagInfo.tagReadAccessLockBits = NearFieldTargetInfo::NfcAccessAllowed;
-                    m_tagInfo.tagWriteAccessLockBits = NearFieldTargetInfo::NfcAccessAllowed;
-                } else if (p.at(2) == char(0xFF) && p.at(3) == char(0xFF)) {
-                    nfcInfo.append("Static lock: Read - yes, Write - no\n");
-                    m_tagInfo.tagReadAccessLockBits = NearFieldTargetInfo::NfcAccessAllowed;
-                    m_tagInfo.tagWriteAccessLockBits = NearFieldTargetInfo::NfcAccessForbidden;
-                } else {
-                    nfcInfo.append("Static lock: not set according to specifications\n");
-                    m_tagInfo.tagReadAccessLockBits = NearFieldTargetInfo::NfcAccessUnknown;
-                    m_tagInfo.tagWriteAccessLockBits = NearFieldTargetInfo::NfcAccessUnknown;
-                }
-            } else if (p.at(0) == char(0x05) || p.at(0) == char(0x01)){
-                // Received NACK
-                nfcInfo.append("Static lock: not successful (NACK response from tag)\n");
-            } else {
-                nfcInfo.append("Static lock: unexpected response (size: " + QString::number(p.size()) + ")\n");
-            }
+    } else if (blocks.size() >= TYPE2_READ_SIZE) {
+        // Response: 16 bytes + 2 bytes checksum
+        if (blocks.at(TYPE2_READ_LOCK_OFFSET) == char(0x00) && blocks.at(TYPE2_READ_LOCK_OFFSET + 1) == char(0x00)) {
+            nfcInfo.append("Static lock: Read - yes, Write - yes\n");
+            m_tagInfo.tagReadAccessLockBits = NearFieldTargetInfo::NfcAccessAllowed;
+            m_tagInfo.tagWriteAccessLockBits = NearFieldTargetInfo::NfcAccessAllowed;
+        } else if (blocks.at(TYPE2_READ_LOCK_OFFSET) == char(0xFF) && blocks.at(TYPE2_READ_LOCK_OFFSET + 1) == char(0xFF)) {
+            nfcInfo.append("Static lock: Read - yes, Write - no\n");
+            m_tagInfo.tagReadAccessLockBits = NearFieldTargetInfo::NfcAccessAllowed;
+            m_tagInfo.tagWriteAccessLockBits = NearFieldTargetInfo::NfcAccessForbidden;
+        } else {
+            nfcInfo.append("Static lock: not set according to specifications\n");
+            m_tagInfo.tagReadAccessLockBits = NearFieldTargetInfo::NfcAccessUnknown;
+            m_tagInfo.tagWriteAccessLockBits = NearFieldTargetInfo::NfcAccessUnknown;
         }
+    } else if (blocks.size() > 0 && (blocks.at(0) == char(0x05) || blocks.at(0) == char(0x01))) {
+        // Received NACK
+        nfcInfo.append("Static lock: not successful (NACK response from tag)\n");
+    } else {
+        nfcInfo.append("Static lock: unexpected response (size: " + QString::number(blocks.size()) + ")\n");
     }
 
     // CC lock
     // The CC is stored in the block 3 of the static or dynamic memory structure
     // Byte 0 is equal to E1h (magic number) to indicate that NFC Forum defined data is stored in the data area
     // Byte 3 indicates the read and write access capability of the data area and CC area of the Type 2 Tag Platform
-    id = target->readBlock(3);   // Check the NDEF magic number
-    if (!target->waitForRequestCompleted(id)) {
+    if (cc.isEmpty()) {
         qDebug() << "Error reading NDEF magic number of the NFC Forum Tag Type 2 target.";
     } else {
-        QVariant response = target->requestResponse(id);
-        if (response.isValid() && response.type() == QVariant::ByteArray) {
-            QByteArray p = response.toByteArray();
-            const quint8 ndefMagicNumber = p.at(0);
-            if (ndefMagicNumber == NDEF_MAGIC_NUMBER) {
-                // Found the CC - now check read write access in byte 3
-                // The most significant nibble (the 4 most significant bits) indicates the read access condition:
-                // - The value 0h indicates read access granted without any security.
-                // - The values from 1h to 7h and Fh are reserved for future use.
-                // - The values from 8h to Eh are proprietary.
-                // The least significant nibble (the 4 least significant bits) indicates the write access condition:
-                // - The value 0h indicates write access granted without any security.
-                // - The values from 1h to 7h are reserved for future use.
-                // - The values from 8h to Eh are proprietary.
-                // - The value Fh indicates no write access granted at all.
-                const quint8 rwa = p.at(3); // RWA = byte 3 of CC
-                const int tagReadAccessCondition = rwa >> 4;      // Most significant nibble
-                const int tagWriteAccessCondition = rwa & 0x0F;    // Least significant nibble
-
-                QString tagReadAccess;
-                if (tagReadAccessCondition == 0x0) {
-                    tagReadAccess = "yes";
-                    m_tagInfo.tagReadAccessCC = NearFieldTargetInfo::NfcAccessAllowed;
-                } else if (tagReadAccessCondition >= 0x8) {
-                    tagReadAccess = "proprietary";
-                    m_tagInfo.tagReadAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
-                } else {
-                    tagReadAccess = "unknown";
-                    m_tagInfo.tagReadAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
-                }
-
-                QString tagWriteAccess;
-                if (tagWriteAccessCondition == 0x0) {
-                    tagWriteAccess = "yes";
-                    m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessAllowed;
-                } else if (tagReadAccessCondition >= 0x8) {
-                    tagWriteAccess = "proprietary";
-                    m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
-                } else {
-                    tagWriteAccess = "unknown";
-                    m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
-                }
-                nfcInfo.append("Access (CC): Read - " + tagReadAccess + ", Write - " + tagWriteAccess);
+        const quint8 ndefMagicNumber = cc.at(0);
+        if (ndefMagicNumber == NDEF_MAGIC_NUMBER && cc.size() >= 4) {
+            // Found the CC - now check read write access in byte 3
+            // The most significant nibble (the 4 most significant bits) indicates the read access condition:
+            // - The value 0h indicates read access granted without any security.
+            // - The values from 1h to 7h and Fh are reserved for future use.
+            // - The values from 8h to Eh are proprietary.
+            // The least significant nibble (the 4 least significant bits) indicates the write access condition:
+            // - The value 0h indicates write access granted without any security.
+            // - The values from 1h to 7h are reserved for future use.
+            // - The values from 8h to Eh are proprietary.
+            // - The value Fh indicates no write access granted at all.
+            const quint8 rwa = cc.at(3); // RWA = byte 3 of CC
+            const int tagReadAccessCondition = rwa >> 4;      // Most significant nibble
+            const int tagWriteAccessCondition = rwa & 0x0F;    // Least significant nibble
+
+            QString tagReadAccess;
+            if (tagReadAccessCondition == 0x0) {
+                tagReadAccess = "yes";
+                m_tagInfo.tagReadAccessCC = NearFieldTargetInfo::NfcAccessAllowed;
+            } else if (tagReadAccessCondition >= 0x8) {
+                tagReadAccess = "proprietary";
+                m_tagInfo.tagReadAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
+            } else {
+                tagReadAccess = "unknown";
+                m_tagInfo.tagReadAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
+            }
 
+            QString tagWriteAccess;
+            if (tagWriteAccessCondition == 0x0) {
+                tagWriteAccess = "yes";
+                m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessAllowed;
+            } else if (tagReadAccessCondition >= 0x8) {
+                tagWriteAccess = "proprietary";
+                m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
             } else {
-                qDebug() << "Wrong NDEF magic number";
+                tagWriteAccess = "unknown";
+                m_tagInfo.tagWriteAccessCC = NearFieldTargetInfo::NfcAccessUnknown;
             }
+            nfcInfo.append("Access (CC): Read - " + tagReadAccess + ", Write - " + tagWriteAccess + "\n");
+            // First TLVs of the data area, in blocks 4 - 9
+            if (tagMemorySize > 0) {
+                NdefTlvParser parser;
+                parser.setDataArea(TYPE2_DATA_ADDRESS, TYPE2_DATA_ADDRESS + tagMemorySize);
+                QByteArray memory = blocks.left(TYPE2_READ_SIZE);
+                const QVariant dataResponse = m_responses.value(Type2ReadDataBlocks);
+                if (dataResponse.isValid() && dataResponse.type() == QVariant::ByteArray) {
+                    memory.append(dataResponse.toByteArray().left(TYPE2_READ_SIZE));
+                }
+                nfcInfo.append(analyzeTlvs(parser, memory, TYPE2_READ_ADDRESS));
+            }
+        } else {
+            qDebug() << "Wrong NDEF magic number";
         }
     }
 
@@ -460,6 +617,38 @@ QString NfcTargetAnalyzer::analyzeType2Target(QNearFieldTagType2* target)
 }
 
 
+/*!
+  \brief Walk the TLVs of the data area with the \a parser and store
+  the exact NDEF capacity in m_tagInfo.
+
+  \param memory tag memory read so far, starting at the byte address
+  \a memoryAddress. Only the TLVs in front of the NDEF message need
+  to be contained.
+  \return textual description of the TLVs and of the capacity.
+  */
+QString NfcTargetAnalyzer::analyzeTlvs(NdefTlvParser &parser, const QByteArray &memory, const int memoryAddress)
+{
+    QString nfcInfo;
+    if (!parser.parse(memory, memoryAddress)) {
+        qDebug() << "TLVs extend beyond the read tag memory";
+    }
+    const QString tlvs = parser.toString();
+    if (!tlvs.isEmpty()) {
+        nfcInfo.append(tlvs + "\n");
+    }
+    const int ndefCapacity = parser.maxNdefMessageSize();
+    if (ndefCapacity >= 0) {
+        m_tagInfo.tagNdefCapacity = ndefCapacity;
+        // Lock bits of static Type 1 tags might reduce it even further
+        if (m_tagInfo.tagWritableSize < 0 || ndefCapacity < m_tagInfo.tagWritableSize) {
+            m_tagInfo.tagWritableSize = ndefCapacity;
+        }
+        nfcInfo.append("Max. NDEF message size: " + QString::number(ndefCapacity) + " bytes\n");
+    }
+    return nfcInfo;
+}
+
+
 /*!
   \brief Return a textual description of the NFC target \a type.
   */
@@ -19,17 +19,43 @@
 #include <QObject>
 #include <QByteArray>
 #include <QVariant>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QPointer>
+#include <QStringList>
 #include <QDebug>
 #include <QUrl>
 #include <QNearFieldTarget>
 #include <QNearFieldTagType1>
 #include <QNearFieldTagType2>
 #include "nearfieldtargetinfo.h"
+#include "nfctagprofilecache.h"
+#include "ndeftlvparser.h"
 
 #define TYPE1_STATIC_WRITABLE_SIZE 96
 #define TYPE2_STATIC_MEMORY_SIZE 48
 #define NDEF_MAGIC_NUMBER 0xE1
 
+// Type 1 READALL response: HR0, HR1 and the 120 bytes of blocks 0h - Eh
+#define TYPE1_READALL_HEADER_SIZE 2
+#define TYPE1_READALL_SIZE (TYPE1_READALL_HEADER_SIZE + 120)
+// Type 1 byte addresses of the CC, the data area and the static lock bytes
+#define TYPE1_CC_ADDRESS 8
+#define TYPE1_DATA_ADDRESS 12
+#define TYPE1_LOCK_ADDRESS (0x0E * 8)
+// Blocks Dh - Fh are reserved / lock bytes, also on dynamic memory tags
+#define TYPE1_RESERVED_ADDRESS (0x0D * 8)
+#define TYPE1_RESERVED_SIZE (3 * 8)
+// Type 2 READ response: 16 bytes, i.e., the blocks 2 - 5 when reading block 2.
+// Contains the static lock bytes, the CC and the start of the data area.
+#define TYPE2_READ_SIZE 16
+#define TYPE2_READ_LOCK_OFFSET 2
+#define TYPE2_READ_CC_OFFSET 4
+// Type 2 byte addresses of the first read block (2) and the data area (block 4)
+#define TYPE2_READ_ADDRESS (2 * 4)
+#define TYPE2_DATA_ADDRESS (4 * 4)
+
 // Typical writable tag size
 #define GUESS_TAG_WRITABLE_SIZE_TYPICAL_TLV_SIZE 6
 
@@ -63,6 +89,26 @@ QTM_USE_NAMESPACE
   For Type 1 & 2 targets, deeper analysis is performed using low-level
   commands. Note that tag-type specific access is currently only
   implemented for Symbian, and does not work on the N9.
+  The widest read command of the tag type (READALL for Type 1, the
+  16 byte READ for Type 2) returns the lock bits, the capability
+  container and the first TLVs at once. For Type 2 tags, a second
+  READ of the following 16 bytes is sent together with the first one,
+  so that the Lock Control and Memory Control TLVs in front of the
+  NDEF message are available as well. The NdefTlvParser then
+  calculates the exact number of bytes available for the NDEF
+  message (NearFieldTargetInfo::tagNdefCapacity).
+
+  The analysis doesn't block: analyzeTarget() directly returns the
+  generic information and sends all tag-type specific requests to the
+  target at once. Once the target has answered all of them, the
+  results are merged into m_tagInfo and the targetAnalyzed() signal
+  delivers the additional information. Therefore, the app can
+  already read or write the NDEF message while the analysis is
+  still running.
+
+  The results of complete analyses are stored in the profile cache.
+  When the same tag is touched again, analyzeTarget() directly
+  returns the cached results and doesn't send any requests.
 
   The NfcNdefParser has a similar task, but returns the tag contents
   in textual form.
@@ -73,13 +119,57 @@ class NfcTargetAnalyzer : public QObject
 public:
     explicit NfcTargetAnalyzer(QObject *parent = 0);
     QString analyzeTarget(QNearFieldTarget *target);
-    QString analyzeType1Target(QNearFieldTagType1 *target);
-    QString analyzeType2Target(QNearFieldTagType2 *target);
+    bool isAnalyzing() const;
+    bool isAnalyzerRequest(const QNearFieldTarget::RequestId &id) const;
+    NfcTagProfileCache *profileCache();
 
     QString convertTagTypeToString(const QNearFieldTarget::Type type);
-    
+
+signals:
+    /*! \brief Tag-type specific analysis of the target has finished.
+      \a nfcInfo contains the textual description of the results,
+      in addition to the generic info returned by analyzeTarget(),
+      and might be empty. m_tagInfo is complete at this point. */
+    void targetAnalyzed(const QString& nfcInfo);
+
+private slots:
+    void requestCompleted(const QNearFieldTarget::RequestId &id);
+    void targetError(QNearFieldTarget::Error error, const QNearFieldTarget::RequestId &id);
+
 private:
-    
+    /*! Tag-type specific requests sent to the target during the analysis. */
+    enum AnalyzerRequest {
+        Type1ReadAll,
+        Type2ReadBlocks,
+        Type2ReadDataBlocks
+    };
+
+    void abortAnalysis();
+    void startType1Analysis(QNearFieldTagType1 *target);
+    void startType2Analysis(QNearFieldTagType2 *target);
+    void addRequest(const QNearFieldTarget::RequestId &id, const AnalyzerRequest request);
+    void finishRequest(const QNearFieldTarget::RequestId &id, const bool success);
+    QString analyzeType1Results();
+    QString analyzeType2Results();
+    QString analyzeTlvs(NdefTlvParser &parser, const QByteArray &memory, const int memoryAddress);
+
+private:
+    /*! Target that is currently being analyzed. Owned by NfcInfo,
+      which might delete it before the analysis is complete. */
+    QPointer<QNearFieldTarget> m_target;
+    /*! Requests that the target hasn't answered yet. */
+    QList<QPair<QNearFieldTarget::RequestId, AnalyzerRequest> > m_pendingRequests;
+    /*! All requests sent for the current target, to filter their
+      signals in other classes. */
+    QList<QNearFieldTarget::RequestId> m_analysisRequests;
+    /*! Responses of the successfully completed requests. */
+    QMap<AnalyzerRequest, QVariant> m_responses;
+    /*! At least one request of the current analysis failed;
+      the results are then not stored in the profile cache. */
+    bool m_requestFailed;
+    /*! Analysis results of known tags. */
+    NfcTagProfileCache m_profileCache;
+
 public:
     NearFieldTargetInfo m_tagInfo;
 };
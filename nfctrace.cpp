@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "nfctrace.h"
+
+static const char HexDigits[] = "0123456789abcdef";
+static bool TraceEnabled = !qgetenv("NFC_TRACE").isEmpty();
+static int TraceMaxBytes = NFC_TRACE_DEFAULT_MAX_BYTES;
+
+void NfcTrace::setEnabled(const bool enabled)
+{
+    TraceEnabled = enabled;
+}
+
+bool NfcTrace::isEnabled()
+{
+    return TraceEnabled;
+}
+
+/*!
+  \brief Limit each trace to the first \a maxBytes bytes of the data.
+  */
+void NfcTrace::setMaxBytes(const int maxBytes)
+{
+    TraceMaxBytes = qMax(0, maxBytes);
+}
+
+/*!
+  \brief Format the first \a maxBytes of the \a size bytes at \a data
+  as hex digits separated by spaces, e.g., "d1 01 0c 55".
+
+  Longer data is cut off, followed by the total number of bytes.
+  */
+QByteArray NfcTrace::toHex(const char *data, const int size, const int maxBytes)
+{
+    const int count = qMin(size, maxBytes);
+    if (count <= 0) {
+        return QByteArray();
+    }
+    QByteArray hex;
+    hex.resize(count * 3 - 1);
+    char *out = hex.data();
+    for (int i = 0; i < count; i++) {
+        const quint8 value = data[i];
+        if (i > 0) {
+            *out++ = ' ';
+        }
+        *out++ = HexDigits[value >> 4];
+        *out++ = HexDigits[value & 0x0F];
+    }
+    if (count < size) {
+        hex.append(" ... (" + QByteArray::number(size) + " bytes)");
+    }
+    return hex;
+}
+
+/*!
+  \brief Write the hex dump of \a data to the debug output.
+  */
+void NfcTrace::traceBytes(const char *label, const QByteArray &data)
+{
+    const QByteArray hex = toHex(data.constData(), data.size(), TraceMaxBytes);
+    qDebug("%s (%d bytes): %s", label, data.size(), hex.constData());
+}
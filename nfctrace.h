@@ -0,0 +1,57 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NFCTRACE_H
+#define NFCTRACE_H
+
+#include <QByteArray>
+#include <QDebug>
+
+// Protocol traces (hex dumps of the raw data sent and received through
+// LLCP / SNEP and of tag responses) are only compiled in if NFC_TRACE
+// is defined, see nfcinteractor.pro. They additionally have to be
+// activated at runtime through NfcTrace::setEnabled() or the NFC_TRACE
+// environment variable. Otherwise, the macro doesn't evaluate its
+// arguments.
+#ifdef NFC_TRACE
+#define NFC_TRACE_BYTES(label, data) \
+    do { if (NfcTrace::isEnabled()) { NfcTrace::traceBytes(label, data); } } while (0)
+#else
+#define NFC_TRACE_BYTES(label, data) do { } while (0)
+#endif
+
+// Default number of bytes of each trace, longer data is cut off.
+#define NFC_TRACE_DEFAULT_MAX_BYTES 512
+
+/*!
+  \brief Formats raw protocol data for debug traces.
+
+  The hex dump is written directly into a buffer that is allocated
+  once with its final size, using a lookup table for the digits.
+  Use the NFC_TRACE_BYTES() macro instead of calling traceBytes()
+  directly, so that the trace is removed in builds without NFC_TRACE.
+  */
+class NfcTrace
+{
+public:
+    static void setEnabled(const bool enabled);
+    static bool isEnabled();
+    static void setMaxBytes(const int maxBytes);
+
+    static QByteArray toHex(const char *data, const int size, const int maxBytes);
+    static void traceBytes(const char *label, const QByteArray &data);
+};
+
+#endif // NFCTRACE_H
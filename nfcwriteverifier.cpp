@@ -0,0 +1,291 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#include "nfcwriteverifier.h"
+
+NfcWriteVerifier::NfcWriteVerifier(QObject *parent) :
+    QObject(parent),
+    m_memoryAddress(0),
+    m_readAddress(0),
+    m_dataEnd(0),
+    m_verifying(false),
+    m_ndefFallback(false),
+    m_lastVerifyMsecs(-1),
+    m_failedCount(0)
+{
+}
+
+/*!
+  \brief Start reading back the \a rawMessage that has just been
+  written to the \a target.
+
+  Returns immediately; the verified() signal is emitted once the
+  message has been read and compared.
+
+  \param tagInfo results of the analysis of the target. The memory
+  size limits the reads to the data area of the tag.
+  \return false if no read request could be sent to the target.
+  */
+bool NfcWriteVerifier::verify(QNearFieldTarget *target, const QByteArray &rawMessage, const NearFieldTargetInfo &tagInfo)
+{
+    abort();
+    if (!target) {
+        return false;
+    }
+    m_target = target;
+    m_expectedMessage = rawMessage;
+    m_parser = NdefTlvParser();
+    m_verifying = true;
+    m_verifyTimer.start();
+    connect(target, SIGNAL(requestCompleted(const QNearFieldTarget::RequestId)),
+            this, SLOT(requestCompleted(QNearFieldTarget::RequestId)));
+    connect(target, SIGNAL(error(QNearFieldTarget::Error,QNearFieldTarget::RequestId)),
+            this, SLOT(targetError(QNearFieldTarget::Error,QNearFieldTarget::RequestId)));
+
+    // The NDEF message TLV usually directly follows the control TLVs
+    const int expectedTlvSize = VERIFY_CONTROL_TLV_SIZE + 4 + rawMessage.size();
+    bool sent = false;
+    if (target->type() == QNearFieldTarget::NfcTagType1 && qobject_cast<QNearFieldTagType1 *>(target)) {
+        m_memoryAddress = 0;
+        m_readAddress = 0;
+        m_dataEnd = (tagInfo.tagMemorySize > 0) ? tagInfo.tagMemorySize : TYPE1_READALL_SIZE - TYPE1_READALL_HEADER_SIZE;
+        m_parser.setDataArea(TYPE1_DATA_ADDRESS, m_dataEnd);
+        m_parser.addReservedArea(TYPE1_RESERVED_ADDRESS, TYPE1_RESERVED_SIZE);
+        sent = readUpTo(TYPE1_DATA_ADDRESS + expectedTlvSize);
+    } else if (target->type() == QNearFieldTarget::NfcTagType2 && qobject_cast<QNearFieldTagType2 *>(target)) {
+        m_memoryAddress = TYPE2_DATA_ADDRESS;
+        m_readAddress = TYPE2_DATA_ADDRESS;
+        m_dataEnd = TYPE2_DATA_ADDRESS + ((tagInfo.tagMemorySize > 0) ? tagInfo.tagMemorySize : TYPE2_STATIC_MEMORY_SIZE);
+        m_parser.setDataArea(TYPE2_DATA_ADDRESS, m_dataEnd);
+        sent = readUpTo(TYPE2_DATA_ADDRESS + expectedTlvSize);
+    }
+
+    if (!sent) {
+        // No tag-type specific access - read the message through the
+        // generic NDEF access instead
+        m_pendingRequests.clear();
+        m_ndefFallback = true;
+        connect(target, SIGNAL(ndefMessageRead(QNdefMessage)),
+                this, SLOT(ndefMessageRead(QNdefMessage)));
+        const QNearFieldTarget::RequestId id = target->readNdefMessages();
+        if (!id.isValid()) {
+            abort();
+            return false;
+        }
+        m_verifyRequests.append(id);
+    }
+    return true;
+}
+
+/*!
+  \brief Stop waiting for the responses of the current target,
+  e.g., when it has been lost. Doesn't emit verified().
+  */
+void NfcWriteVerifier::abort()
+{
+    if (m_target) {
+        disconnect(m_target, 0, this, 0);
+    }
+    m_target = NULL;
+    m_pendingRequests.clear();
+    m_verifyRequests.clear();
+    m_responses.clear();
+    m_verifying = false;
+    m_ndefFallback = false;
+}
+
+bool NfcWriteVerifier::isVerifying() const
+{
+    return m_verifying && !m_target.isNull();
+}
+
+/*!
+  \brief Returns true if the request \a id has been sent by the
+  verifier. Errors of these requests are reported through verified().
+  */
+bool NfcWriteVerifier::isVerifierRequest(const QNearFieldTarget::RequestId &id) const
+{
+    return m_verifyRequests.contains(id);
+}
+
+/*!
+  \brief Time in milliseconds the last verification needed, from
+  sending the first read request until the comparison, or -1.
+  */
+qint64 NfcWriteVerifier::lastVerifyMsecs() const
+{
+    return m_lastVerifyMsecs;
+}
+
+QString NfcWriteVerifier::statisticsToString() const
+{
+    return "Verified writes: " + QString::number(m_verifyLatency.count) + " ("
+            + QString::number(m_failedCount) + " failed)\nVerification time: " + m_verifyLatency.toString();
+}
+
+/*!
+  \brief Send read requests for the data area until \a endAddress
+  (exclusive), starting at the first byte that hasn't been requested yet.
+
+  \return false if a request couldn't be sent.
+  */
+bool NfcWriteVerifier::readUpTo(const int endAddress)
+{
+    const int readEnd = qMin(endAddress, m_dataEnd);
+    while (m_readAddress < readEnd) {
+        QNearFieldTarget::RequestId id;
+        const int address = m_readAddress;
+        if (m_target->type() == QNearFieldTarget::NfcTagType1) {
+            QNearFieldTagType1 *target = qobject_cast<QNearFieldTagType1 *>(m_target.data());
+            if (address < TYPE1_SEGMENT_SIZE) {
+                // READALL: blocks 0h - Eh of the first segment. The rest
+                // of the segment is reserved anyway.
+                id = target->readAll();
+                m_readAddress = TYPE1_SEGMENT_SIZE;
+            } else {
+                const int segment = address / TYPE1_SEGMENT_SIZE;
+                id = target->readSegment(segment);
+                m_readAddress = (segment + 1) * TYPE1_SEGMENT_SIZE;
+            }
+        } else {
+            QNearFieldTagType2 *target = qobject_cast<QNearFieldTagType2 *>(m_target.data());
+            if (address / 4 > 0xFF) {
+                // Would need to switch the sector
+                return false;
+            }
+            id = target->readBlock(address / 4);
+            m_readAddress += TYPE2_READ_SIZE;
+        }
+        if (!id.isValid()) {
+            // Request couldn't be sent at all
+            return false;
+        }
+        m_pendingRequests.append(qMakePair(id, address));
+        m_verifyRequests.append(id);
+    }
+    return true;
+}
+
+void NfcWriteVerifier::requestCompleted(const QNearFieldTarget::RequestId &id)
+{
+    if (!m_verifying || m_ndefFallback || !m_target || sender() != m_target.data()) {
+        // The generic read is handled by ndefMessageRead()
+        return;
+    }
+    for (int i = 0; i < m_pendingRequests.size(); i++) {
+        if (m_pendingRequests.at(i).first == id) {
+            const int address = m_pendingRequests.at(i).second;
+            QByteArray response = m_target->requestResponse(id).toByteArray();
+            if (m_target->type() == QNearFieldTarget::NfcTagType1 && address == 0) {
+                // Remove HR0 and HR1 of the READALL response
+                response = response.mid(TYPE1_READALL_HEADER_SIZE);
+            }
+            m_responses.insert(address, response);
+            m_pendingRequests.removeAt(i);
+            if (m_pendingRequests.isEmpty()) {
+                checkMemory();
+            }
+            return;
+        }
+    }
+}
+
+void NfcWriteVerifier::targetError(QNearFieldTarget::Error error, const QNearFieldTarget::RequestId &id)
+{
+    if (!m_verifying || !m_target || sender() != m_target.data() || !m_verifyRequests.contains(id)) {
+        return;
+    }
+    finishVerification(false, "Unable to read back the message (error " + QString::number(error) + ")");
+}
+
+void NfcWriteVerifier::ndefMessageRead(const QNdefMessage &message)
+{
+    if (!m_verifying || !m_ndefFallback) {
+        // Only the first message of the tag is relevant
+        return;
+    }
+    compareMessage(message.toByteArray());
+}
+
+/*!
+  \brief Parse the TLVs of the memory read so far. Compares the
+  message if it has been read completely, otherwise sends the
+  reads for the rest of it.
+  */
+void NfcWriteVerifier::checkMemory()
+{
+    QByteArray memory(m_readAddress - m_memoryAddress, '\0');
+    QMap<int, QByteArray>::const_iterator it;
+    for (it = m_responses.constBegin(); it != m_responses.constEnd(); ++it) {
+        const int offset = it.key() - m_memoryAddress;
+        const int size = qMin(it.value().size(), memory.size() - offset);
+        if (offset >= 0 && size > 0) {
+            memory.replace(offset, size, it.value().constData(), size);
+        }
+    }
+
+    int nextEnd;
+    if (!m_parser.parse(memory, m_memoryAddress)) {
+        // The TLVs in front of the message take more space than expected
+        nextEnd = m_readAddress + 1;
+    } else if (!m_parser.hasNdefMessage()) {
+        finishVerification(false, "No NDEF message found on the tag");
+        return;
+    } else if (m_parser.ndefMessageLength() != m_expectedMessage.size()) {
+        finishVerification(false, "Message on the tag has " + QString::number(m_parser.ndefMessageLength())
+                           + " bytes instead of " + QString::number(m_expectedMessage.size()));
+        return;
+    } else {
+        nextEnd = m_parser.ndefMessageEndAddress();
+        if (nextEnd <= m_readAddress) {
+            compareMessage(m_parser.ndefMessage());
+            return;
+        }
+    }
+    if (m_readAddress >= m_dataEnd || !readUpTo(nextEnd) || m_pendingRequests.isEmpty()) {
+        finishVerification(false, "Unable to read the complete message");
+    }
+}
+
+void NfcWriteVerifier::compareMessage(const QByteArray &readMessage)
+{
+    if (readMessage == m_expectedMessage) {
+        finishVerification(true, QString());
+        return;
+    }
+    int position = 0;
+    while (position < readMessage.size() && position < m_expectedMessage.size()
+           && readMessage.at(position) == m_expectedMessage.at(position)) {
+        position++;
+    }
+    finishVerification(false, "Read-back differs from the written message at byte " + QString::number(position));
+}
+
+void NfcWriteVerifier::finishVerification(const bool success, const QString &detail)
+{
+#if QT_VERSION >= 0x040800
+    const qint64 nsecs = m_verifyTimer.nsecsElapsed();
+#else
+    const qint64 nsecs = m_verifyTimer.elapsed() * 1000000;
+#endif
+    m_lastVerifyMsecs = nsecs / 1000000;
+    m_verifyLatency.add(nsecs);
+    if (!success) {
+        m_failedCount++;
+    }
+    qDebug() << "Write verification" << (success ? "succeeded" : "failed") << "after" << m_lastVerifyMsecs << "ms" << detail;
+    abort();
+    emit verified(success, detail);
+}
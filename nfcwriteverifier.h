@@ -0,0 +1,119 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+#ifndef NFCWRITEVERIFIER_H
+#define NFCWRITEVERIFIER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QNearFieldTarget>
+#include <QNearFieldTagType1>
+#include <QNearFieldTagType2>
+#include <QNdefMessage>
+#include "nearfieldtargetinfo.h"
+#include "nfctargetanalyzer.h"
+#include "ndeftlvparser.h"
+#include "nfclogwriter.h"
+
+// Type 1 READSEG response: the 128 bytes of one segment
+#define TYPE1_SEGMENT_SIZE 128
+// Space for the Lock Control and Memory Control TLVs in front of the
+// NDEF message, read together with the message by the first request.
+#define VERIFY_CONTROL_TLV_SIZE 16
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Reads a message back from the tag right after it has been
+  written and compares it to the written message.
+
+  For Type 1 and Type 2 tags, only the part of the data area up to
+  the end of the NDEF message TLV is read with tag-type specific
+  commands: the READALL / READSEG commands of Type 1 tags and as many
+  16 byte READ commands as needed on Type 2 tags. All reads are sent
+  at once; only if the TLVs in front of the message take more space
+  than expected, a second round of reads follows. The NdefTlvParser
+  then extracts the stored message, skipping reserved areas.
+
+  For all other tag types, or if the tag-type specific access isn't
+  available, the message is read through the generic NDEF access.
+
+  The time needed for each verification is measured, see
+  lastVerifyMsecs() and statisticsToString().
+  */
+class NfcWriteVerifier : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NfcWriteVerifier(QObject *parent = 0);
+
+    bool verify(QNearFieldTarget *target, const QByteArray &rawMessage, const NearFieldTargetInfo &tagInfo);
+    void abort();
+    bool isVerifying() const;
+    bool isVerifierRequest(const QNearFieldTarget::RequestId &id) const;
+
+    qint64 lastVerifyMsecs() const;
+    QString statisticsToString() const;
+
+signals:
+    /*! \brief The written message has been read back. \a success is
+      false if it doesn't match the written message or if reading
+      failed, \a detail describes the reason in that case. */
+    void verified(bool success, const QString &detail);
+
+private slots:
+    void requestCompleted(const QNearFieldTarget::RequestId &id);
+    void targetError(QNearFieldTarget::Error error, const QNearFieldTarget::RequestId &id);
+    void ndefMessageRead(const QNdefMessage &message);
+
+private:
+    bool readUpTo(const int endAddress);
+    void checkMemory();
+    void compareMessage(const QByteArray &readMessage);
+    void finishVerification(const bool success, const QString &detail);
+
+private:
+    /*! Target that the message has been written to. Owned by NfcInfo. */
+    QPointer<QNearFieldTarget> m_target;
+    QByteArray m_expectedMessage;
+    NdefTlvParser m_parser;
+    /*! Address of the first byte of the data area that is read. */
+    int m_memoryAddress;
+    /*! Address behind the last byte that has been requested so far. */
+    int m_readAddress;
+    int m_dataEnd;
+    /*! Requests that the target hasn't answered yet, with the byte
+      address of the first byte they return. */
+    QList<QPair<QNearFieldTarget::RequestId, int> > m_pendingRequests;
+    /*! All requests sent for the current verification. */
+    QList<QNearFieldTarget::RequestId> m_verifyRequests;
+    /*! Responses of the read requests, by their start address. */
+    QMap<int, QByteArray> m_responses;
+    bool m_verifying;
+    bool m_ndefFallback;
+
+    QElapsedTimer m_verifyTimer;
+    qint64 m_lastVerifyMsecs;
+    NfcLatencyCounter m_verifyLatency;
+    int m_failedCount;
+};
+
+#endif // NFCWRITEVERIFIER_H
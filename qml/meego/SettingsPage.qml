@@ -33,7 +33,15 @@ Page {
     // Settings
     property alias logNdefToFile: logNdefToFileEdit.checked
     property alias logNdefDir: logNdefDirEdit.text
+    property alias logNdefSegmented: logNdefSegmentedEdit.checked
+    property alias logNdefDedup: logNdefDedupEdit.checked
+    property alias logNdefDedupRetentionDays: logNdefDedupRetentionEdit.text
+    property alias logNdefAsync: logNdefAsyncEdit.checked
     property alias deleteTagBeforeWriting: deleteTagBeforeWritingEdit.checked
+    property alias persistTagProfiles: persistTagProfilesEdit.checked
+    property alias shrinkMessagesToFit: shrinkMessagesToFitEdit.checked
+    property alias verifyWrites: verifyWritesEdit.checked
+    property alias diffWrites: diffWritesEdit.checked
     property alias useSnep: useSnepEdit.checked
 
     // - Raw peer to peer settings
@@ -54,7 +62,15 @@ Page {
     function applySettingsToPage() {
         logNdefToFile = settings.logNdefToFile;
         logNdefDir = settings.logNdefDir;
+        logNdefSegmented = settings.logNdefSegmented;
+        logNdefDedup = settings.logNdefDedup;
+        logNdefDedupRetentionDays = settings.logNdefDedupRetentionDays;
+        logNdefAsync = settings.logNdefAsync;
         deleteTagBeforeWriting = settings.deleteTagBeforeWriting;
+        persistTagProfiles = settings.persistTagProfiles;
+        shrinkMessagesToFit = settings.shrinkMessagesToFit;
+        verifyWrites = settings.verifyWrites;
+        diffWrites = settings.diffWrites;
         useSnep = settings.useSnep;
         useConnectionLess = settings.useConnectionLess;
         nfcPort = settings.nfcPort;
@@ -69,7 +85,15 @@ Page {
         // Apply the new settings to the nfcPeerToPeer object
         settings.setLogNdefToFile(logNdefToFile);
         settings.setLogNdefDir(logNdefDir);
+        settings.setLogNdefSegmented(logNdefSegmented);
+        settings.setLogNdefDedup(logNdefDedup);
+        settings.setLogNdefDedupRetentionDays(logNdefDedupRetentionDays);
+        settings.setLogNdefAsync(logNdefAsync);
         settings.setDeleteTagBeforeWriting(deleteTagBeforeWriting);
+        settings.setPersistTagProfiles(persistTagProfiles);
+        settings.setShrinkMessagesToFit(shrinkMessagesToFit);
+        settings.setVerifyWrites(verifyWrites);
+        settings.setDiffWrites(diffWrites);
 
         settings.setUseSnep(useSnep);
         settings.setUseConnectionLess(useConnectionLess);
@@ -150,6 +174,10 @@ Page {
                 onClicked: {
                     logNdefDirEdit.enabled = logNdefToFileEdit.checked
                     logNdefDirTitle.color = (logNdefDirEdit.enabled) ? customPlatformStyle.colorNormalLight : customPlatformStyle.colorNormalMid;
+                    logNdefSegmentedEdit.enabled = logNdefToFileEdit.checked
+                    logNdefDedupEdit.enabled = logNdefToFileEdit.checked
+                    logNdefDedupRetentionEdit.enabled = logNdefToFileEdit.checked
+                    logNdefAsyncEdit.enabled = logNdefToFileEdit.checked
                 }
             }
             Item {// 2-line text for checkbox not properly formated
@@ -180,6 +208,63 @@ Page {
                 }
             }
 
+            // --------------------------------------------------------------------------------
+            // - Log collected messages to segment files
+            Item {// 2-line text for checkbox not properly formated
+                width: 1
+                height: customPlatformStyle.paddingSmall;
+            }
+            CheckBox {
+                id: logNdefSegmentedEdit
+                checked: false
+                text: "Collect read messages in log segments\n(faster for many tags)"
+            }
+
+            // --------------------------------------------------------------------------------
+            // - Store repeated messages only once
+            Item {// 2-line text for checkbox not properly formated
+                width: 1
+                height: customPlatformStyle.paddingSmall;
+            }
+            CheckBox {
+                id: logNdefDedupEdit
+                checked: false
+                text: "Store identical messages only once\n(saves space for repeated tags)"
+            }
+            Text {
+                id: logNdefDedupRetentionTitle
+                text: qsTr("Keep reads of identical messages for days\n(0 = keep all)")
+                visible: logNdefDedupEdit.checked
+                font.family: customPlatformStyle.fontFamilyRegular;
+                color: customPlatformStyle.colorNormalLight
+                font.pixelSize: customPlatformStyle.fontSizeMedium
+            }
+            TextField {
+                id: logNdefDedupRetentionEdit
+                width: parent.width
+                text: "90"
+                visible: logNdefDedupEdit.checked
+                validator: IntValidator{bottom: 0; top: 36500}
+                onActiveFocusChanged: {
+                    if (activeFocus) {
+                        focusedItem = logNdefDedupRetentionEdit;
+                        moveToFocusedItem();
+                    }
+                }
+            }
+
+            // --------------------------------------------------------------------------------
+            // - Write log files in the background
+            Item {// 2-line text for checkbox not properly formated
+                width: 1
+                height: customPlatformStyle.paddingSmall;
+            }
+            CheckBox {
+                id: logNdefAsyncEdit
+                checked: true
+                text: "Save files in the background\n(faster reading of many tags)"
+            }
+
             // --------------------------------------------------------------------------------
             // - Delete tag before writing
             Item {// 2-line text for checkbox not properly formated
@@ -191,6 +276,45 @@ Page {
                 checked: true
                 text: "Delete/format tag before writing\n(use for factory empty tags)"
             }
+
+            // --------------------------------------------------------------------------------
+            // - Remember analyzed tags
+            Item {// 2-line text for checkbox not properly formated
+                width: 1
+                height: customPlatformStyle.paddingSmall;
+            }
+            CheckBox {
+                id: persistTagProfilesEdit
+                checked: false
+                text: "Remember analyzed tags after restart\n(faster repeated touches)"
+            }
+            Item {// 2-line text for checkbox not properly formated
+                width: 1
+                height: customPlatformStyle.paddingSmall;
+            }
+            CheckBox {
+                id: shrinkMessagesToFitEdit
+                checked: false
+                text: "Shrink messages that are too large\n(e.g., Smart Poster to URI)"
+            }
+            Item {// 2-line text for checkbox not properly formated
+                width: 1
+                height: customPlatformStyle.paddingSmall;
+            }
+            CheckBox {
+                id: verifyWritesEdit
+                checked: false
+                text: "Verify written messages\n(read back while the tag is present)"
+            }
+            Item {// 2-line text for checkbox not properly formated
+                width: 1
+                height: customPlatformStyle.paddingSmall;
+            }
+            CheckBox {
+                id: diffWritesEdit
+                checked: false
+                text: "Only write changed blocks\n(Type 2 tags)"
+            }
             Item {// 2-line text for checkbox not properly formated
                 width: 1
                 height: customPlatformStyle.paddingSmall;
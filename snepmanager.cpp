@@ -15,9 +15,44 @@
 
 #include "snepmanager.h"
 
+SnepSession::SnepSession() :
+    receiveSize(0),
+    continueSent(false),
+    requestCommand(SNEP_NO_REQUEST)
+{
+}
+
 SnepManager::SnepManager(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    m_fragmentSize(SNEP_DEFAULT_FRAGMENT_SIZE),
+    m_maxMessageSize(SNEP_MAX_MESSAGE_SIZE)
+{
+}
+
+/*!
+  \brief Maximum size of the first fragment of a request, usually the
+  MIU of the LLCP connection. Qt Mobility doesn't report the MIU
+  negotiated with the remote device, so the default MIU of LLCP
+  is used unless set otherwise.
+  */
+void SnepManager::setFragmentSize(const int fragmentSize)
+{
+    m_fragmentSize = qMax(SNEP_HEADER_SIZE, fragmentSize);
+}
+
+int SnepManager::fragmentSize() const
+{
+    return m_fragmentSize;
+}
+
+/*!
+  \brief Messages with more than \a maxMessageSize bytes of information
+  are answered with the Excess Data response.
+  */
+void SnepManager::setMaxMessageSize(const quint32 maxMessageSize)
 {
+    // The buffer size has to fit into an int, including the header
+    m_maxMessageSize = qMin(maxMessageSize, (quint32)(0x7FFFFFFF - SNEP_HEADER_SIZE));
 }
 
 QByteArray SnepManager::wrapNdefInSnepPut(const QNdefMessage* ndefMessage)
@@ -40,32 +75,211 @@ QByteArray SnepManager::wrapNdefInSnepPut(const QNdefMessage* ndefMessage)
     // Information (x bytes)
     snepMsg.append(rawMessage);
 
-    qDebug() << "SNEP message: " << snepMsg;
     qDebug() << "SNEP total size: " << snepMsg.size();
+    NFC_TRACE_BYTES("SNEP Put", snepMsg);
 
-    QString arrayContents = "";
-    for (int i = 0; i < snepMsg.size(); ++i) {
-        arrayContents.append(QString("0x") + QString::number(snepMsg.at(i), 16) + " ");
-    }
-    qDebug() << "SNEP Raw contents:\n" << arrayContents;
+    return snepMsg;
+}
+
+/*!
+  \brief Create a SNEP Get request for the NDEF message identified by
+  the first record of \a requestMessage.
 
+  \param acceptableLength maximum number of bytes the remote server
+  may return.
+  */
+QByteArray SnepManager::wrapNdefInSnepGet(const QNdefMessage *requestMessage, const quint32 acceptableLength)
+{
+    const QByteArray rawRequest = requestMessage->toByteArray();
+    QByteArray snepMsg = createSnepHeader(SNEP_REQ_GET, SNEP_ACCEPTABLE_LENGTH_SIZE + rawRequest.size());
+    snepMsg.reserve(SNEP_HEADER_SIZE + SNEP_ACCEPTABLE_LENGTH_SIZE + rawRequest.size());
+    // Acceptable Length (32-bit unsigned integer), followed by the request
+    snepMsg.append((char)(acceptableLength >> 24));
+    snepMsg.append((char)(acceptableLength >> 16));
+    snepMsg.append((char)(acceptableLength >> 8));
+    snepMsg.append((char)acceptableLength);
+    snepMsg.append(rawRequest);
     return snepMsg;
 }
 
-QNdefMessage SnepManager::analyzeSnepMessage(QByteArray& rawMessage, QString& results)
+/*!
+  \brief Store the NDEF message that the server returns for Get
+  requests whose first record has the type name format \a tnf and the
+  \a type.
+
+  The message is wrapped in the Success response right away, so
+  answering a request doesn't need to convert or copy the message.
+  A message stored for the same type before is replaced.
+  */
+void SnepManager::setGetResponse(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, const QByteArray &rawNdefMessage)
+{
+    QByteArray response = createSnepHeader(SNEP_RES_SUCCESS, rawNdefMessage.size());
+    response.append(rawNdefMessage);
+    m_getResponses.insert(getResponseKey(tnf, type), response);
+}
+
+void SnepManager::setGetResponse(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, const QNdefMessage &message)
+{
+    setGetResponse(tnf, type, message.toByteArray());
+}
+
+void SnepManager::removeGetResponse(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type)
 {
-    // TODO: Debug
-    QString arrayContents = "";
-    for (int i = 0; i < rawMessage.size(); ++i) {
-        arrayContents.append(QString("0x") + QString::number(rawMessage.at(i), 16) + " ");
+    m_getResponses.remove(getResponseKey(tnf, type));
+}
+
+void SnepManager::clearGetResponses()
+{
+    m_getResponses.clear();
+}
+
+int SnepManager::getResponseCount() const
+{
+    return m_getResponses.size();
+}
+
+/*!
+  \brief Prepare sending the complete SNEP request \a snepRequest
+  through \a transport.
+
+  Only call this once the first fragment can actually be written;
+  the session then waits for the response to this request.
+
+  \return the first fragment, to be written to the transport. If the
+  request is larger than the fragment size, the remaining data is sent
+  once analyzeSnepMessage() receives the Continue response.
+  */
+QByteArray SnepManager::startRequest(NfcLlcpTransport *transport, const QByteArray &snepRequest)
+{
+    SnepSession &session = m_sessions[transport];
+    // Remember the request type to know how to handle the Success response
+    session.requestCommand = (snepRequest.size() >= SNEP_HEADER_SIZE) ? (quint8)snepRequest.at(1) : SNEP_NO_REQUEST;
+    if (snepRequest.size() <= m_fragmentSize) {
+        session.pendingRequestData.clear();
+        return snepRequest;
+    }
+    session.pendingRequestData = snepRequest.mid(m_fragmentSize);
+    qDebug() << "SNEP request fragmented:" << m_fragmentSize << "bytes, waiting to send" << session.pendingRequestData.size() << "bytes";
+    return snepRequest.left(m_fragmentSize);
+}
+
+/*!
+  \brief The first fragment returned by startRequest() couldn't be
+  sent through \a transport - don't wait for the response.
+  */
+void SnepManager::cancelRequest(NfcLlcpTransport *transport)
+{
+    if (!m_sessions.contains(transport)) {
+        return;
+    }
+    SnepSession &session = m_sessions[transport];
+    session.requestCommand = SNEP_NO_REQUEST;
+    session.pendingRequestData.clear();
+}
+
+/*!
+  \brief Process data received from the remote device through
+  \a transport.
+
+  The data can be a complete SNEP message, a fragment of it or
+  multiple messages. Fragments are collected until the message is
+  complete; data following the end of a message starts the next one.
+
+  \param results textual description of the received messages.
+  \param reply set to the data that has to be written back to the
+  same transport: the Continue / Success / error response of a received
+  request (for Get, the stored message), or the remaining fragments of
+  a sent request or response once the remote device has answered with
+  Continue. Replies to multiple messages are concatenated. Empty if no
+  reply is needed.
+  \return the NDEF messages of complete Put requests and of the Success
+  response to a Get request.
+  */
+QList<QNdefMessage> SnepManager::analyzeSnepMessage(NfcLlcpTransport *transport, const QByteArray &rawMessage, QString &results, QByteArray &reply)
+{
+    reply.clear();
+    NFC_TRACE_BYTES("SNEP received", rawMessage);
+
+    SnepSession &session = m_sessions[transport];
+    QList<QNdefMessage> messages;
+    const char *data = rawMessage.constData();
+    int remaining = rawMessage.size();
+    while (remaining > 0) {
+        const int consumed = consumeData(session, data, remaining, results, reply, messages);
+        data += consumed;
+        remaining -= consumed;
     }
-    qDebug() << "Raw contents of SNEP message:\n" << arrayContents;
 
-    // Version
-    QDataStream snepStream(&rawMessage, QIODevice::ReadOnly);
+    if (session.receiveSize > 0 && session.receiveBuffer.size() < session.receiveSize) {
+        results.append("SNEP: received " + QString::number(session.receiveBuffer.size() - SNEP_HEADER_SIZE) + " / "
+                       + QString::number(session.receiveSize - SNEP_HEADER_SIZE) + " Bytes\n");
+        if (!session.continueSent) {
+            // First fragment - the remote device waits for Continue
+            // before sending the rest of the message.
+            const bool isRequest = ((quint8)session.receiveBuffer.at(1) < SNEP_RES_CONTINUE);
+            reply.append(isRequest ? createSnepResponse(SNEP_RES_CONTINUE) : createSnepRequest(SNEP_REQ_CONTINUE));
+            session.continueSent = true;
+        }
+    }
+    return messages;
+}
+
+/*!
+  \brief Add the first bytes of \a data to the message that is being
+  received in \a session. Completed messages are processed right away.
 
-    quint8 version;
-    snepStream >> version;
+  \return the number of bytes that have been used, at most up to the
+  end of the current message.
+  */
+int SnepManager::consumeData(SnepSession &session, const char *data, const int size, QString &results, QByteArray &reply, QList<QNdefMessage> &messages)
+{
+    if (session.receiveSize > 0) {
+        // Subsequent fragment of the current message
+        const int informationBytes = qMin(size, session.receiveSize - session.receiveBuffer.size());
+        session.receiveBuffer.append(data, informationBytes);
+        if (session.receiveBuffer.size() == session.receiveSize) {
+            processCompleteMessage(session, results, reply, messages);
+        }
+        return informationBytes;
+    }
+
+    // Start of a new message - the header itself might be split
+    const int headerBytes = qMin(size, SNEP_HEADER_SIZE - session.receiveBuffer.size());
+    session.receiveBuffer.append(data, headerBytes);
+    if (session.receiveBuffer.size() < SNEP_HEADER_SIZE) {
+        return headerBytes;
+    }
+    if (!startMessage(session, results, reply)) {
+        // The message has been rejected. Its sender doesn't continue
+        // after the first fragment, so the rest of this read belongs
+        // to the rejected message.
+        return size;
+    }
+    if (session.receiveSize > 0 && session.receiveBuffer.size() == session.receiveSize) {
+        // Message without information
+        processCompleteMessage(session, results, reply, messages);
+    }
+    return headerBytes;
+}
+
+/*!
+  \brief Handle the SNEP header in the receive buffer of \a session.
+
+  Continue and Reject are handled completely. For all other messages,
+  the receive size is set to prepare receiving the information.
+
+  \return false if the message has been rejected.
+  */
+bool SnepManager::startMessage(SnepSession &session, QString &results, QByteArray &reply)
+{
+    const quint8 version = session.receiveBuffer.at(0);
+    const quint8 command = session.receiveBuffer.at(1);
+    const quint32 length = ((quint32)(quint8)session.receiveBuffer.at(2) << 24) |
+            ((quint32)(quint8)session.receiveBuffer.at(3) << 16) |
+            ((quint32)(quint8)session.receiveBuffer.at(4) << 8) |
+            (quint32)(quint8)session.receiveBuffer.at(5);
+    const bool isRequest = (command < SNEP_RES_CONTINUE);
+    results.append("SNEP: " + convertSnepCommandToText(command) + "\n");
 
     if (version != SNEP_VERSION)
     {
@@ -73,68 +287,265 @@ QNdefMessage SnepManager::analyzeSnepMessage(QByteArray& rawMessage, QString& re
         const int minorVersion = version & 0x0F;    // Least significant nibble
         results.append("Warning: Unsupported SNEP version (" + QString::number(majorVersion) + "." +
                        QString::number(minorVersion) + ")\n");
+        if (isRequest && majorVersion != (SNEP_VERSION >> 4)) {
+            // Different major versions are not compatible
+            reply.append(createSnepResponse(SNEP_RES_UNSUPPORTEDVERSION));
+            session.receiveBuffer.clear();
+            return false;
+        }
+    }
 
-        // TODO: We could return the SNEP_RES_UNSUPPORTEDVERSION response here.
+    switch (command) {
+    case SNEP_RES_CONTINUE:
+        // The remote server accepts the rest of our request
+        reply.append(session.pendingRequestData);
+        session.pendingRequestData.clear();
+        session.receiveBuffer.clear();
+        return true;
+    case SNEP_REQ_CONTINUE:
+        // The remote client accepts the rest of our Get response
+        reply.append(session.pendingResponseData);
+        session.pendingResponseData.clear();
+        session.receiveBuffer.clear();
+        return true;
+    case SNEP_REQ_REJECT:
+        session.pendingResponseData.clear();
+        session.receiveBuffer.clear();
+        return true;
+    case SNEP_RES_SUCCESS:
+        session.pendingRequestData.clear();
+        break;
+    default:
+        if (!isRequest) {
+            // Error response - don't send the remaining fragments
+            session.pendingRequestData.clear();
+        }
+        break;
     }
 
-    const int protocolHeaderSize = 6;   // version (1b) + command (1b) + length (4b) = 6 bytes
+    if (length > m_maxMessageSize) {
+        results.append("Message too large: " + QString::number(length) + " Bytes\n");
+        reply.append(isRequest ? createSnepResponse(SNEP_RES_EXCESSDATA) : createSnepRequest(SNEP_REQ_REJECT));
+        session.receiveBuffer.clear();
+        if (!isRequest) {
+            finishRequest(session, false);
+        }
+        return false;
+    }
+    if (length > 0) {
+        results.append("Length: " + QString::number(length) + " Bytes\n");
+    }
+    session.receiveSize = SNEP_HEADER_SIZE + (int)length;
+    session.continueSent = false;
+    // Receive the rest into a buffer of the final size
+    session.receiveBuffer.reserve(session.receiveSize);
+    return true;
+}
 
-    // Command
-    quint8 command;
-    snepStream >> command;
-    results.append("SNEP: " + convertSnepCommandToText(command) + "\n");
+/*!
+  \brief Handle the message in the receive buffer of \a session, which
+  has been received completely, and prepare receiving the next one.
+  */
+void SnepManager::processCompleteMessage(SnepSession &session, QString &results, QByteArray &reply, QList<QNdefMessage> &messages)
+{
+    const quint8 command = session.receiveBuffer.at(1);
+    const int length = session.receiveSize - SNEP_HEADER_SIZE;
+    if (command == SNEP_REQ_PUT) {
+        // Read NDEF message and send back to to
+        // NfcInfo::ndefMessageRead
+        // Decode in-place, limited to the length announced in the header.
+        NdefStreamDecoder decoder;
+        if (decoder.feed(session.receiveBuffer.constData() + SNEP_HEADER_SIZE, length) &&
+                decoder.messageCount() > 0) {
+            messages.append(decoder.lastMessage());
+            reply.append(createSnepResponse(SNEP_RES_SUCCESS));
+        } else {
+            results.append(decoder.errorString() + "\n");
+            reply.append(createSnepResponse(SNEP_RES_BADREQUEST));
+        }
+    } else if (command == SNEP_REQ_GET) {
+        reply.append(answerGetRequest(session, results));
+    } else if (command == SNEP_RES_SUCCESS && session.requestCommand == SNEP_REQ_GET) {
+        // Response to our Get request
+        NdefStreamDecoder decoder;
+        if (decoder.feed(session.receiveBuffer.constData() + SNEP_HEADER_SIZE, length) &&
+                decoder.messageCount() > 0) {
+            messages.append(decoder.lastMessage());
+        } else {
+            results.append(decoder.errorString() + "\n");
+        }
+    } else if (length > 0) {
+        // Read raw data
+        results.append("Contents: ");
+        results.append(session.receiveBuffer.mid(SNEP_HEADER_SIZE) + "\n");
+    }
 
-    // Length
-    quint32 length;
-    snepStream >> length;
-    if (length > 0)
+    // If success (writing), inform UI
+    if (command == SNEP_RES_SUCCESS && session.requestCommand != SNEP_REQ_GET)
     {
-        results.append("Length: " + QString::number(length) + " Bytes");
+        emit nfcSnepSuccess();
+    }
+    session.receiveBuffer.clear();
+    session.receiveSize = 0;
+    session.continueSent = false;
+    if (command >= SNEP_RES_CONTINUE) {
+        // Final response to our request - the next one can be sent
+        finishRequest(session, command == SNEP_RES_SUCCESS);
+    }
+}
 
-        QByteArray snepContents;
-        snepStream >> snepContents;
+/*!
+  \brief The final response to the request of \a session has been
+  received or the response has been rejected.
+  */
+void SnepManager::finishRequest(SnepSession &session, const bool success)
+{
+    if (session.requestCommand == SNEP_NO_REQUEST) {
+        return;
+    }
+    session.requestCommand = SNEP_NO_REQUEST;
+    emit requestFinished(success);
+}
 
-        // Read contents
-        if (command == SNEP_REQ_PUT) {
-            // Read NDEF message and send back to to
-            // NfcInfo::ndefMessageRead
-            QNdefMessage containedNdef = QNdefMessage::fromByteArray(rawMessage.mid(protocolHeaderSize));
+/*!
+  \brief Find the stored response for the Get request in the receive
+  buffer of \a session.
 
-            return containedNdef;
-        }
-        else
-        {
-            // Read raw data
-            results.append("Contents: ");
-            results.append(rawMessage.mid(protocolHeaderSize) + "\n");
-        }
+  \return the first fragment of the Success response, or the Not Found,
+  Excess Data or Bad Request response.
+  */
+QByteArray SnepManager::answerGetRequest(SnepSession &session, QString &results)
+{
+    const char *information = session.receiveBuffer.constData() + SNEP_HEADER_SIZE;
+    const int length = session.receiveSize - SNEP_HEADER_SIZE;
+    if (length <= SNEP_ACCEPTABLE_LENGTH_SIZE) {
+        return createSnepResponse(SNEP_RES_BADREQUEST);
+    }
+    const quint32 acceptableLength = ((quint32)(quint8)information[0] << 24) |
+            ((quint32)(quint8)information[1] << 16) |
+            ((quint32)(quint8)information[2] << 8) |
+            (quint32)(quint8)information[3];
 
+    // Only the type of the first record is needed - don't decode the
+    // complete request message.
+    NdefRecordView requestRecord;
+    if (NdefRecordView::parse(information + SNEP_ACCEPTABLE_LENGTH_SIZE, length - SNEP_ACCEPTABLE_LENGTH_SIZE, requestRecord) != NdefRecordView::ParseOk) {
+        return createSnepResponse(SNEP_RES_BADREQUEST);
     }
+    results.append("Requested type: " + QString::fromLatin1(requestRecord.typeData(), requestRecord.typeLength()) + "\n");
 
-    // If success (writing), inform UI
-    if (command == SNEP_RES_SUCCESS)
-    {
-        emit nfcSnepSuccess();
+    QHash<QByteArray, QByteArray>::const_iterator it =
+            m_getResponses.constFind(getResponseKey(requestRecord.typeNameFormat(), requestRecord.type()));
+    if (it == m_getResponses.constEnd()) {
+        return createSnepResponse(SNEP_RES_NOTFOUND);
+    }
+    const QByteArray &response = it.value();
+    if ((quint32)(response.size() - SNEP_HEADER_SIZE) > acceptableLength) {
+        return createSnepResponse(SNEP_RES_EXCESSDATA);
+    }
+    // Large responses are fragmented like requests; the rest is sent
+    // when the client requests it with Continue.
+    if (response.size() <= m_fragmentSize) {
+        session.pendingResponseData.clear();
+        return response;
     }
+    session.pendingResponseData = response.mid(m_fragmentSize);
+    return response.left(m_fragmentSize);
+}
+
+/*!
+  \brief Key of the response store for the type name format
+  \a tnf and the \a type.
+  */
+QByteArray SnepManager::getResponseKey(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type)
+{
+    QByteArray key;
+    key.reserve(1 + type.size());
+    key.append((char)tnf);
+    key.append(type);
+    return key;
+}
+
+/*!
+  \brief Create the header of a SNEP message with \a length bytes
+  of information.
+  */
+QByteArray SnepManager::createSnepHeader(const quint8 command, const quint32 length) const
+{
+    QByteArray header(SNEP_HEADER_SIZE, char(0));
+    header[0] = SNEP_VERSION;
+    header[1] = command;
+    // Length (32-bit unsigned integer, big endian)
+    header[2] = (char)(length >> 24);
+    header[3] = (char)(length >> 16);
+    header[4] = (char)(length >> 8);
+    header[5] = (char)length;
+    return header;
+}
 
-    return QNdefMessage();
+/*!
+  \brief Create a SNEP response without information.
+  */
+QByteArray SnepManager::createSnepResponse(const quint8 response) const
+{
+    return createSnepHeader(response, 0);
+}
+
+/*!
+  \brief Create a SNEP request without information, i.e., Continue
+  or Reject for fragmented responses.
+  */
+QByteArray SnepManager::createSnepRequest(const quint8 request) const
+{
+    return createSnepResponse(request);
 }
 
-QByteArray SnepManager::createSnepSuccessResponse()
+/*!
+  \brief Returns true while the fragments of a message are being
+  received through \a transport.
+  */
+bool SnepManager::isReceiving(NfcLlcpTransport *transport) const
 {
-    QByteArray response(6, char(0));
-    response[0] = SNEP_VERSION;
-    response[1] = SNEP_RES_SUCCESS;
-    // 2 - 5 (4b): 0x0 (length = 0, so no data afterwards)
+    return m_sessions.value(transport).receiveSize > 0;
+}
+
+/*!
+  \brief Returns true while waiting for the final response to the
+  request sent through startRequest() on \a transport.
+  */
+bool SnepManager::isRequestPending(NfcLlcpTransport *transport) const
+{
+    return m_sessions.value(transport).requestCommand != SNEP_NO_REQUEST;
+}
 
-    // TODO: Debug
-    QString arrayContents = "";
-    for (int i = 0; i < response.size(); ++i) {
-        arrayContents.append(QString("0x") + QString::number(response.at(i), 16) + " ");
+/*!
+  \brief Discard partially received messages and fragments that haven't
+  been sent yet through \a transport, e.g., when the connection is lost.
+  */
+void SnepManager::reset(NfcLlcpTransport *transport)
+{
+    if (m_sessions.contains(transport)) {
+        m_sessions[transport] = SnepSession();
     }
-    qDebug() << "Raw contents of SNEP response:\n" << arrayContents;
+}
 
-    return response;
+/*!
+  \brief Reset the sessions of all transports.
+  */
+void SnepManager::reset()
+{
+    for (QHash<NfcLlcpTransport *, SnepSession>::iterator it = m_sessions.begin(); it != m_sessions.end(); ++it) {
+        it.value() = SnepSession();
+    }
+}
+
+/*!
+  \brief Forget the session of \a transport, which is not going to
+  be used anymore.
+  */
+void SnepManager::removeSession(NfcLlcpTransport *transport)
+{
+    m_sessions.remove(transport);
 }
 
 QString SnepManager::convertSnepCommandToText(quint8 command)
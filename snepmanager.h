@@ -19,6 +19,11 @@
 #include <QObject>
 #include <QDebug>
 #include <QNdefMessage>
+#include <QHash>
+#include <QList>
+#include "ndefstreamdecoder.h"
+#include "ndefrecordview.h"
+#include "nfctrace.h"
 
 // The Version field is a single octet representing a
 // structure of two 4-bit unsigned integers. The most significant 4 bits SHALL denote the major
@@ -39,25 +44,136 @@
 #define SNEP_RES_UNSUPPORTEDVERSION (quint8)0xE1
 #define SNEP_RES_REJECT     (quint8)0xFF
 
+// Version (1b) + request / response (1b) + length of the information (4b)
+#define SNEP_HEADER_SIZE    6
+// Default MIU of an LLCP data link connection (128 bytes), used as the
+// size of the first fragment of requests.
+#define SNEP_DEFAULT_FRAGMENT_SIZE  128
+// Largest message accepted from the remote device. The receive buffer is
+// preallocated with the size announced in the header, up to this limit.
+#define SNEP_MAX_MESSAGE_SIZE   (1024 * 1024)
+// Size of the Acceptable Length field in front of the NDEF message
+// of a Get request
+#define SNEP_ACCEPTABLE_LENGTH_SIZE 4
+// No request has been sent or the final response has been received.
+// Not a valid SNEP request code.
+#define SNEP_NO_REQUEST     (quint8)0x7E
+
 QTM_USE_NAMESPACE
 
+class NfcLlcpTransport;
+
+/*!
+  \brief Reassembly and request state of the SNEP conversation on
+  a single transport.
+  */
+struct SnepSession
+{
+    SnepSession();
+
+    /*! Fragments of the message that is currently being received,
+      including the SNEP header. */
+    QByteArray receiveBuffer;
+    /*! Total size of the message that is being received (header +
+      information), or 0 if the header hasn't been received yet. */
+    int receiveSize;
+    /*! Continue has been sent for the message that is being received. */
+    bool continueSent;
+    /*! Remaining fragments of the request that has been sent,
+      waiting for the Continue response of the remote server. */
+    QByteArray pendingRequestData;
+    /*! Remaining fragments of the Get response that has been sent,
+      waiting for the Continue request of the remote client. */
+    QByteArray pendingResponseData;
+    /*! Request that has been sent and is waiting for the final response. */
+    quint8 requestCommand;
+};
+
+/*!
+  \brief Implements the Simple NDEF Exchange Protocol (SNEP) on top of
+  the data received from and sent to a connection-oriented LLCP socket.
+
+  Sending: requests that don't fit into a single fragment are split
+  by startRequest(). Only the first fragment (including the SNEP
+  header) is sent right away; the rest follows once the remote server
+  has answered with Continue. A Reject or error response discards it.
+
+  Receiving: analyzeSnepMessage() reassembles the fragments of a
+  message into a buffer that is preallocated from the length in the
+  SNEP header. After the first fragment of a larger request, it
+  returns the Continue response (or Excess Data if the message is
+  larger than the maximum message size) for the caller to send back
+  on the same socket; the reply to a complete Put request is Success.
+  A single read may contain several messages, which are all processed.
+
+  The client and the server socket exchange messages independently, so
+  the receive and request state is kept in a separate SnepSession for
+  every transport. Replies always have to be written to the transport
+  that the data was received from.
+
+  Get requests are answered from a store of NDEF messages, keyed by
+  the type of the first record of the request message. The messages
+  are serialized when they are added to the store (see
+  setGetResponse()), so serving a request only needs a hash lookup.
+  */
 class SnepManager : public QObject
 {
     Q_OBJECT
 public:
     explicit SnepManager(QObject *parent = 0);
-    
+
+    void setFragmentSize(const int fragmentSize);
+    int fragmentSize() const;
+    void setMaxMessageSize(const quint32 maxMessageSize);
+
     QByteArray wrapNdefInSnepPut(const QNdefMessage* ndefMessage);
-    QNdefMessage analyzeSnepMessage(QByteArray &rawMessage, QString &results);
-    QByteArray createSnepSuccessResponse();
+    QByteArray wrapNdefInSnepGet(const QNdefMessage* requestMessage, const quint32 acceptableLength);
+    QByteArray startRequest(NfcLlcpTransport *transport, const QByteArray &snepRequest);
+    void cancelRequest(NfcLlcpTransport *transport);
+    QList<QNdefMessage> analyzeSnepMessage(NfcLlcpTransport *transport, const QByteArray &rawMessage, QString &results, QByteArray &reply);
+    QByteArray createSnepResponse(const quint8 response) const;
+    QByteArray createSnepRequest(const quint8 request) const;
+    bool isReceiving(NfcLlcpTransport *transport) const;
+    bool isRequestPending(NfcLlcpTransport *transport) const;
+    void reset(NfcLlcpTransport *transport);
+    void reset();
+    void removeSession(NfcLlcpTransport *transport);
+
+    void setGetResponse(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, const QByteArray &rawNdefMessage);
+    void setGetResponse(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type, const QNdefMessage &message);
+    void removeGetResponse(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type);
+    void clearGetResponses();
+    int getResponseCount() const;
 
 signals:
     void nfcSnepSuccess();
+    /*! The final response to the request sent through startRequest()
+      has been received. Emitted while the received data is processed:
+      connect with a queued connection if the slot starts a new request
+      or removes a session. */
+    void requestFinished(const bool success);
     
 public slots:
 private:
+    int consumeData(SnepSession &session, const char *data, const int size, QString &results, QByteArray &reply, QList<QNdefMessage> &messages);
+    bool startMessage(SnepSession &session, QString &results, QByteArray &reply);
+    void processCompleteMessage(SnepSession &session, QString &results, QByteArray &reply, QList<QNdefMessage> &messages);
+    QByteArray answerGetRequest(SnepSession &session, QString &results);
+    void finishRequest(SnepSession &session, const bool success);
+    static QByteArray getResponseKey(const QNdefRecord::TypeNameFormat tnf, const QByteArray &type);
+    QByteArray createSnepHeader(const quint8 command, const quint32 length) const;
     QString convertSnepCommandToText(quint8 command);
 
+private:
+    /*! Size of the first fragment of a request, i.e., the MIU of the
+      LLCP connection. */
+    int m_fragmentSize;
+    quint32 m_maxMessageSize;
+    /*! State of the SNEP conversation on each transport. */
+    QHash<NfcLlcpTransport *, SnepSession> m_sessions;
+    /*! Complete Success responses (header + NDEF message) for Get
+      requests, see getResponseKey(). */
+    QHash<QByteArray, QByteArray> m_getResponses;
 };
 
 #endif // SNEPMANAGER_H
@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QFile>
+#include "ndefloganalyzer.h"
+
+static void printUsage(QTextStream &err)
+{
+    err << "Usage: ndefloganalyzer [--csv|--json] [--threads n] [--all] [--output file] <directory>\n"
+        << "  --csv          write the statistics as CSV (default)\n"
+        << "  --json         write the statistics as JSON\n"
+        << "  --threads n    number of worker threads (default: one per core)\n"
+        << "  --all          analyze all files, not only *.txt and *.nlog\n"
+        << "  --output file  write the statistics to the file instead of stdout\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    bool json = false;
+    int threadCount = 0;
+    bool allFiles = false;
+    QString outputFileName;
+    QString directory;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); i++) {
+        const QString arg = args.at(i);
+        if (arg == "--csv") {
+            json = false;
+        } else if (arg == "--json") {
+            json = true;
+        } else if (arg == "--all") {
+            allFiles = true;
+        } else if (arg == "--threads" && i + 1 < args.size()) {
+            threadCount = args.at(++i).toInt();
+        } else if (arg == "--output" && i + 1 < args.size()) {
+            outputFileName = args.at(++i);
+        } else if (!arg.startsWith("--") && directory.isEmpty()) {
+            directory = arg;
+        } else {
+            printUsage(err);
+            return 1;
+        }
+    }
+    if (directory.isEmpty()) {
+        printUsage(err);
+        return 1;
+    }
+
+    NdefLogAnalyzer analyzer;
+    analyzer.setThreadCount(threadCount);
+    if (allFiles) {
+        analyzer.setNameFilters(QStringList() << "*");
+    }
+    if (!analyzer.analyze(directory)) {
+        err << "Unable to read directory: " << directory << "\n";
+        return 2;
+    }
+
+    const QString result = json ? analyzer.toJson() : analyzer.toCsv();
+    if (outputFileName.isEmpty()) {
+        QTextStream out(stdout);
+        out << result;
+    } else {
+        QFile outputFile(outputFileName);
+        if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            err << "Unable to write output file: " << outputFileName << "\n";
+            return 3;
+        }
+        QTextStream out(&outputFile);
+        out << result;
+    }
+
+    // Throughput summary for interactive use, not part of the output
+    err << analyzer.statistics().fileCount << " files in " << analyzer.elapsedMsecs() << " ms ("
+        << QString::number(analyzer.filesPerSecond(), 'f', 1) << " files/s, "
+        << QString::number(analyzer.megabytesPerSecond(), 'f', 2) << " MB/s)\n";
+    return 0;
+}
@@ -0,0 +1,418 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "ndefloganalyzer.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+#include <QDebug>
+
+// Upper limits of the message size histogram buckets, in bytes
+static const int SizeBucketLimits[NDEF_LOG_SIZE_BUCKET_COUNT - 1] = {
+    64, 128, 256, 512, 1024, 4096
+};
+
+// Longest scheme that is reported for URIs without an abbreviation
+#define NDEF_LOG_MAX_SCHEME_LENGTH 16
+
+NdefLogStatistics::NdefLogStatistics() :
+    fileCount(0),
+    unreadableCount(0),
+    emptyCount(0),
+    malformedCount(0),
+    messageCount(0),
+    recordCount(0),
+    totalBytes(0),
+    messageBytes(0),
+    minMessageSize(-1),
+    maxMessageSize(0)
+{
+    for (int i = 0; i < NDEF_LOG_SIZE_BUCKET_COUNT; i++) {
+        sizeBuckets[i] = 0;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+NdefLogAnalyzer::NdefLogAnalyzer() :
+    m_elapsedMsecs(0)
+{
+    // NfcInfo::storeNdefToFile() always uses the .txt extension,
+    // the segmented log stores many messages per file
+    m_nameFilters << "*.txt" << QString("*") + NDEF_SEGMENT_SUFFIX;
+}
+
+/*!
+  \brief File name patterns of the files to analyze.
+  Default: "*.txt" and "*.nlog".
+  */
+void NdefLogAnalyzer::setNameFilters(const QStringList &nameFilters)
+{
+    m_nameFilters = nameFilters;
+}
+
+/*!
+  \brief Maximum number of worker threads. By default, one thread
+  per core is used.
+  */
+void NdefLogAnalyzer::setThreadCount(const int threadCount)
+{
+    if (threadCount > 0) {
+        QThreadPool::globalInstance()->setMaxThreadCount(threadCount);
+    }
+}
+
+/*!
+  \brief Analyze all matching files in the \a directory and its
+  sub-directories. Blocks until all files have been processed.
+
+  \return false if the directory doesn't exist.
+  */
+bool NdefLogAnalyzer::analyze(const QString &directory)
+{
+    m_statistics = NdefLogStatistics();
+    m_elapsedMsecs = 0;
+    if (!QDir(directory).exists()) {
+        qDebug() << "Directory doesn't exist: " << directory;
+        return false;
+    }
+
+    // Scanning the directory tree is part of the measured throughput
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList fileNames;
+    QDirIterator it(directory, m_nameFilters, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        fileNames.append(it.next());
+    }
+
+    if (!fileNames.isEmpty()) {
+        // The order of the files doesn't matter for the statistics
+        m_statistics = QtConcurrent::blockingMappedReduced(fileNames,
+                                                           &NdefLogAnalyzer::analyzeFile,
+                                                           &NdefLogAnalyzer::mergeStatistics,
+                                                           QtConcurrent::UnorderedReduce);
+    }
+    m_elapsedMsecs = timer.elapsed();
+    return true;
+}
+
+const NdefLogStatistics &NdefLogAnalyzer::statistics() const
+{
+    return m_statistics;
+}
+
+/*!
+  \brief Time needed for the most recent call to analyze(), including
+  scanning the directory tree.
+  */
+qint64 NdefLogAnalyzer::elapsedMsecs() const
+{
+    return m_elapsedMsecs;
+}
+
+double NdefLogAnalyzer::filesPerSecond() const
+{
+    // Avoid dividing by zero for very small directories
+    const qint64 msecs = qMax(m_elapsedMsecs, (qint64)1);
+    return m_statistics.fileCount * 1000.0 / msecs;
+}
+
+double NdefLogAnalyzer::megabytesPerSecond() const
+{
+    const qint64 msecs = qMax(m_elapsedMsecs, (qint64)1);
+    return m_statistics.totalBytes / (1024.0 * 1024.0) * 1000.0 / msecs;
+}
+
+/*!
+  \brief Decode a single logged NDEF message, or all messages of a
+  segment of the log, and create the statistics for the file.
+  Called from the worker threads.
+  */
+NdefLogStatistics NdefLogAnalyzer::analyzeFile(const QString &fileName)
+{
+    NdefLogStatistics stats;
+    stats.fileCount = 1;
+
+    if (fileName.endsWith(NDEF_SEGMENT_SUFFIX)) {
+        NdefSegmentReader reader;
+        if (!reader.open(fileName)) {
+            stats.unreadableCount = 1;
+            return stats;
+        }
+        stats.totalBytes = QFileInfo(fileName).size();
+        NdefLogFrame frame;
+        for (int i = 0; i < reader.frameCount(); i++) {
+            if (reader.readFrame(i, frame)) {
+                analyzeMessage(frame.rawMessage, stats);
+            } else {
+                stats.malformedCount++;
+            }
+        }
+        return stats;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        stats.unreadableCount = 1;
+        return stats;
+    }
+    const QByteArray rawMessage = file.readAll();
+    file.close();
+    stats.totalBytes = rawMessage.size();
+    analyzeMessage(rawMessage, stats);
+    return stats;
+}
+
+/*!
+  \brief Decode the raw NDEF message and add it to the \a stats.
+  */
+void NdefLogAnalyzer::analyzeMessage(const QByteArray &rawMessage, NdefLogStatistics &stats)
+{
+    if (rawMessage.isEmpty()) {
+        stats.emptyCount++;
+        return;
+    }
+
+    ParsedNdefMessage message;
+    if (!NdefMessageDecoder::decode(rawMessage, message)) {
+        stats.malformedCount++;
+        return;
+    }
+
+    const int messageSize = rawMessage.size();
+    stats.messageCount++;
+    stats.messageBytes += messageSize;
+    if (stats.minMessageSize < 0 || messageSize < stats.minMessageSize) {
+        stats.minMessageSize = messageSize;
+    }
+    stats.maxMessageSize = qMax(stats.maxMessageSize, messageSize);
+    int bucket = 0;
+    while (bucket < NDEF_LOG_SIZE_BUCKET_COUNT - 1 && messageSize >= SizeBucketLimits[bucket]) {
+        bucket++;
+    }
+    stats.sizeBuckets[bucket]++;
+
+    stats.recordCount += message.recordCount();
+    for (int i = 0; i < message.recordCount(); i++) {
+        const ParsedNdefRecord &record = message.record(i);
+        stats.recordTypes[recordTypeName(message, record)]++;
+        if (!record.uri.isNull()) {
+            stats.uriPrefixes[uriPrefixName(message, record)]++;
+        }
+    }
+}
+
+/*!
+  \brief Add the statistics of a single file to the \a result.
+  */
+void NdefLogAnalyzer::mergeStatistics(NdefLogStatistics &result, const NdefLogStatistics &fileStats)
+{
+    if (fileStats.minMessageSize >= 0 &&
+            (result.minMessageSize < 0 || fileStats.minMessageSize < result.minMessageSize)) {
+        result.minMessageSize = fileStats.minMessageSize;
+    }
+    result.maxMessageSize = qMax(result.maxMessageSize, fileStats.maxMessageSize);
+    result.fileCount += fileStats.fileCount;
+    result.unreadableCount += fileStats.unreadableCount;
+    result.emptyCount += fileStats.emptyCount;
+    result.malformedCount += fileStats.malformedCount;
+    result.messageCount += fileStats.messageCount;
+    result.recordCount += fileStats.recordCount;
+    result.totalBytes += fileStats.totalBytes;
+    result.messageBytes += fileStats.messageBytes;
+    for (int i = 0; i < NDEF_LOG_SIZE_BUCKET_COUNT; i++) {
+        result.sizeBuckets[i] += fileStats.sizeBuckets[i];
+    }
+    for (QMap<QString, int>::const_iterator it = fileStats.recordTypes.constBegin();
+         it != fileStats.recordTypes.constEnd(); ++it) {
+        result.recordTypes[it.key()] += it.value();
+    }
+    for (QMap<QString, int>::const_iterator it = fileStats.uriPrefixes.constBegin();
+         it != fileStats.uriPrefixes.constEnd(); ++it) {
+        result.uriPrefixes[it.key()] += it.value();
+    }
+}
+
+/*!
+  \brief Name of the type of the \a record for the histogram,
+  consisting of the type name format and the type.
+  */
+QString NdefLogAnalyzer::recordTypeName(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
+{
+    QString tnfName;
+    switch (record.typeNameFormat) {
+    case QNdefRecord::Empty:
+        return "Empty";
+    case QNdefRecord::NfcRtd:
+        tnfName = "NfcRtd";
+        break;
+    case QNdefRecord::Mime:
+        tnfName = "Mime";
+        break;
+    case QNdefRecord::Uri:
+        tnfName = "Uri";
+        break;
+    case QNdefRecord::ExternalRtd:
+        tnfName = "ExternalRtd";
+        break;
+    case QNdefRecord::Unknown:
+        return "Unknown";
+    default:
+        return "Reserved (" + QString::number((int)record.typeNameFormat) + ")";
+    }
+    return tnfName + ":" + message.toAscii(record.type);
+}
+
+/*!
+  \brief Prefix of the URI stored in the Uri or Smart Poster \a record.
+
+  If the URI isn't abbreviated, the scheme of the URI is used instead
+  (e.g., "tel:").
+  */
+QString NdefLogAnalyzer::uriPrefixName(const ParsedNdefMessage &message, const ParsedNdefRecord &record)
+{
+    if (record.uriPrefix > 0) {
+        const QString prefix = NdefMessageDecoder::uriPrefix(record.uriPrefix);
+        return prefix.isEmpty() ? "Reserved (" + QString::number(record.uriPrefix) + ")" : prefix;
+    }
+    const char *uri = message.data(record.uri);
+    const int maxLength = qMin(record.uri.length, NDEF_LOG_MAX_SCHEME_LENGTH + 1);
+    for (int i = 0; i < maxLength; i++) {
+        if (uri[i] == ':') {
+            return QString::fromLatin1(uri, i + 1);
+        }
+    }
+    return "(none)";
+}
+
+QString NdefLogAnalyzer::sizeBucketName(const int bucket)
+{
+    if (bucket == 0) {
+        return "<" + QString::number(SizeBucketLimits[0]);
+    }
+    if (bucket == NDEF_LOG_SIZE_BUCKET_COUNT - 1) {
+        return ">=" + QString::number(SizeBucketLimits[bucket - 1]);
+    }
+    return QString::number(SizeBucketLimits[bucket - 1]) + "-" + QString::number(SizeBucketLimits[bucket] - 1);
+}
+
+/*!
+  \brief Statistics of the most recent analysis as CSV, with one
+  "section,key,value" line per value.
+  */
+QString NdefLogAnalyzer::toCsv() const
+{
+    const NdefLogStatistics &s = m_statistics;
+    QString csv("section,key,value\n");
+    csv.append("summary,files," + QString::number(s.fileCount) + "\n");
+    csv.append("summary,messages," + QString::number(s.messageCount) + "\n");
+    csv.append("summary,records," + QString::number(s.recordCount) + "\n");
+    csv.append("summary,malformed," + QString::number(s.malformedCount) + "\n");
+    csv.append("summary,empty," + QString::number(s.emptyCount) + "\n");
+    csv.append("summary,unreadable," + QString::number(s.unreadableCount) + "\n");
+    csv.append("summary,bytes," + QString::number(s.totalBytes) + "\n");
+    csv.append("size,min," + QString::number(qMax(s.minMessageSize, 0)) + "\n");
+    csv.append("size,max," + QString::number(s.maxMessageSize) + "\n");
+    csv.append("size,avg," + QString::number(s.messageCount > 0 ? (double)s.messageBytes / s.messageCount : 0.0, 'f', 1) + "\n");
+    for (int i = 0; i < NDEF_LOG_SIZE_BUCKET_COUNT; i++) {
+        csv.append("sizehistogram," + escapeCsv(sizeBucketName(i)) + "," + QString::number(s.sizeBuckets[i]) + "\n");
+    }
+    for (QMap<QString, int>::const_iterator it = s.recordTypes.constBegin(); it != s.recordTypes.constEnd(); ++it) {
+        csv.append("recordtype," + escapeCsv(it.key()) + "," + QString::number(it.value()) + "\n");
+    }
+    for (QMap<QString, int>::const_iterator it = s.uriPrefixes.constBegin(); it != s.uriPrefixes.constEnd(); ++it) {
+        csv.append("uriprefix," + escapeCsv(it.key()) + "," + QString::number(it.value()) + "\n");
+    }
+    csv.append("throughput,msecs," + QString::number(m_elapsedMsecs) + "\n");
+    csv.append("throughput,files/s," + QString::number(filesPerSecond(), 'f', 1) + "\n");
+    csv.append("throughput,MB/s," + QString::number(megabytesPerSecond(), 'f', 2) + "\n");
+    return csv;
+}
+
+/*!
+  \brief Statistics of the most recent analysis as a JSON object.
+  */
+QString NdefLogAnalyzer::toJson() const
+{
+    const NdefLogStatistics &s = m_statistics;
+    QString json("{\n");
+    json.append("  \"files\": " + QString::number(s.fileCount) + ",\n");
+    json.append("  \"messages\": " + QString::number(s.messageCount) + ",\n");
+    json.append("  \"records\": " + QString::number(s.recordCount) + ",\n");
+    json.append("  \"malformed\": " + QString::number(s.malformedCount) + ",\n");
+    json.append("  \"empty\": " + QString::number(s.emptyCount) + ",\n");
+    json.append("  \"unreadable\": " + QString::number(s.unreadableCount) + ",\n");
+    json.append("  \"bytes\": " + QString::number(s.totalBytes) + ",\n");
+    json.append("  \"messageSize\": {\n");
+    json.append("    \"min\": " + QString::number(qMax(s.minMessageSize, 0)) + ",\n");
+    json.append("    \"max\": " + QString::number(s.maxMessageSize) + ",\n");
+    json.append("    \"avg\": " + QString::number(s.messageCount > 0 ? (double)s.messageBytes / s.messageCount : 0.0, 'f', 1) + ",\n");
+    json.append("    \"histogram\": {");
+    for (int i = 0; i < NDEF_LOG_SIZE_BUCKET_COUNT; i++) {
+        json.append(QString(i > 0 ? ", " : " ") + "\"" + escapeJson(sizeBucketName(i)) + "\": " + QString::number(s.sizeBuckets[i]));
+    }
+    json.append(" }\n  },\n");
+
+    json.append("  \"recordTypes\": {");
+    for (QMap<QString, int>::const_iterator it = s.recordTypes.constBegin(); it != s.recordTypes.constEnd(); ++it) {
+        json.append(QString(it != s.recordTypes.constBegin() ? "," : "") + "\n    \"" + escapeJson(it.key()) + "\": " + QString::number(it.value()));
+    }
+    json.append("\n  },\n");
+    json.append("  \"uriPrefixes\": {");
+    for (QMap<QString, int>::const_iterator it = s.uriPrefixes.constBegin(); it != s.uriPrefixes.constEnd(); ++it) {
+        json.append(QString(it != s.uriPrefixes.constBegin() ? "," : "") + "\n    \"" + escapeJson(it.key()) + "\": " + QString::number(it.value()));
+    }
+    json.append("\n  },\n");
+
+    json.append("  \"throughput\": {\n");
+    json.append("    \"msecs\": " + QString::number(m_elapsedMsecs) + ",\n");
+    json.append("    \"filesPerSecond\": " + QString::number(filesPerSecond(), 'f', 1) + ",\n");
+    json.append("    \"megabytesPerSecond\": " + QString::number(megabytesPerSecond(), 'f', 2) + "\n");
+    json.append("  }\n}\n");
+    return json;
+}
+
+QString NdefLogAnalyzer::escapeCsv(const QString &value)
+{
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n')) {
+        return value;
+    }
+    QString escaped(value);
+    escaped.replace("\"", "\"\"");
+    return "\"" + escaped + "\"";
+}
+
+QString NdefLogAnalyzer::escapeJson(const QString &value)
+{
+    QString escaped;
+    escaped.reserve(value.size());
+    for (int i = 0; i < value.size(); i++) {
+        const QChar c = value.at(i);
+        if (c == '"' || c == '\\') {
+            escaped.append('\\').append(c);
+        } else if (c.unicode() < 0x20) {
+            escaped.append(QString("\\u%1").arg((int)c.unicode(), 4, 16, QChar('0')));
+        } else {
+            escaped.append(c);
+        }
+    }
+    return escaped;
+}
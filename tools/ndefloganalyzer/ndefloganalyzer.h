@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NDEFLOGANALYZER_H
+#define NDEFLOGANALYZER_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QElapsedTimer>
+#include "ndefmessagedecoder.h"
+#include "ndefsegmentlog.h"
+
+// Upper limits (exclusive) of the message size histogram buckets.
+// The last bucket contains all larger messages.
+#define NDEF_LOG_SIZE_BUCKET_COUNT 7
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Aggregated statistics about a set of logged NDEF messages.
+
+  Plain data, so that it can be created for each file in a worker
+  thread and merged afterwards.
+  */
+struct NdefLogStatistics
+{
+    NdefLogStatistics();
+
+    /*! Number of files that have been analyzed. */
+    int fileCount;
+    /*! Files that couldn't be opened. */
+    int unreadableCount;
+    /*! Messages without any data. */
+    int emptyCount;
+    /*! Messages that aren't completely valid. */
+    int malformedCount;
+    /*! Valid NDEF messages. Log segments contain multiple messages per file. */
+    int messageCount;
+    qint64 recordCount;
+    /*! Size of all files, including the malformed ones. */
+    qint64 totalBytes;
+    /*! Size of the valid messages. */
+    qint64 messageBytes;
+    int minMessageSize;
+    int maxMessageSize;
+    int sizeBuckets[NDEF_LOG_SIZE_BUCKET_COUNT];
+    /*! Number of records per type, e.g., "NfcRtd:U" or "Mime:image/png". */
+    QMap<QString, int> recordTypes;
+    /*! Number of URIs per prefix (abbreviated or literal scheme). */
+    QMap<QString, int> uriPrefixes;
+};
+
+/*!
+  \brief Scans a directory tree of logged NDEF messages in parallel
+  and aggregates statistics about their contents.
+
+  Each file is decoded with the NdefMessageDecoder on one of the
+  threads of the global thread pool. The decoder doesn't create
+  any strings or images, which keeps analyzing hundreds of thousands
+  of files I/O bound.
+  */
+class NdefLogAnalyzer
+{
+public:
+    NdefLogAnalyzer();
+
+    void setNameFilters(const QStringList &nameFilters);
+    void setThreadCount(const int threadCount);
+
+    bool analyze(const QString &directory);
+
+    const NdefLogStatistics &statistics() const;
+    qint64 elapsedMsecs() const;
+    double filesPerSecond() const;
+    double megabytesPerSecond() const;
+
+    QString toCsv() const;
+    QString toJson() const;
+
+    static NdefLogStatistics analyzeFile(const QString &fileName);
+    static void mergeStatistics(NdefLogStatistics &result, const NdefLogStatistics &fileStats);
+
+private:
+    static void analyzeMessage(const QByteArray &rawMessage, NdefLogStatistics &stats);
+    static QString recordTypeName(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
+    static QString uriPrefixName(const ParsedNdefMessage &message, const ParsedNdefRecord &record);
+    static QString sizeBucketName(const int bucket);
+    static QString escapeCsv(const QString &value);
+    static QString escapeJson(const QString &value);
+
+private:
+    QStringList m_nameFilters;
+    NdefLogStatistics m_statistics;
+    qint64 m_elapsedMsecs;
+};
+
+#endif // NDEFLOGANALYZER_H
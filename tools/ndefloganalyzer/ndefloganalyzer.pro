@@ -0,0 +1,22 @@
+# Headless command line tool that analyzes the NDEF messages
+# logged by Nfc Interactor (see NfcInfo::storeNdefToFile()), either
+# as individual files or in segments of the log (*.nlog).
+#
+# Usage: ndefloganalyzer [--csv|--json] [--threads n] [--all] <directory>
+
+TEMPLATE = app
+TARGET = ndefloganalyzer
+QT += core
+QT -= gui
+CONFIG += console mobility
+CONFIG -= app_bundle
+MOBILITY += connectivity
+
+SOURCES += main.cpp \
+    ndefloganalyzer.cpp
+
+HEADERS += \
+    ndefloganalyzer.h
+
+# Pure NDEF decoding, shared with the app
+include(../../ndefdecoding.pri)
@@ -0,0 +1,62 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include "ndeflogconverter.h"
+
+static void printUsage(QTextStream &err)
+{
+    err << "Usage: ndeflogconvert --import <legacy directory> <log directory> [--segment-size bytes]\n"
+        << "       ndeflogconvert --export <segment file or log directory> <target directory>\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    const QStringList args = app.arguments();
+    if (args.size() < 4) {
+        printUsage(err);
+        return 1;
+    }
+    const QString mode = args.at(1);
+    NdefLogConverter converter;
+    if (args.size() >= 6 && args.at(4) == "--segment-size") {
+        converter.setMaxSegmentSize(args.at(5).toLongLong());
+    }
+
+    int messageCount;
+    if (mode == "--import") {
+        messageCount = converter.importFiles(args.at(2), args.at(3));
+    } else if (mode == "--export") {
+        messageCount = converter.exportSegments(args.at(2), args.at(3));
+    } else {
+        printUsage(err);
+        return 1;
+    }
+
+    if (!converter.errorString().isEmpty()) {
+        err << converter.errorString() << "\n";
+    }
+    if (messageCount < 0) {
+        return 2;
+    }
+    err << "Converted " << messageCount << " messages\n";
+    return 0;
+}
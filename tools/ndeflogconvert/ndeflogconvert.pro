@@ -0,0 +1,23 @@
+# Command line tool to convert between the legacy layout of logged
+# NDEF messages (one .txt file per message) and the segmented log
+# (*.nlog, see NdefSegmentLog).
+#
+# Usage: ndeflogconvert --import <legacy directory> <log directory>
+#        ndeflogconvert --export <segment file or log directory> <target directory>
+
+TEMPLATE = app
+TARGET = ndeflogconvert
+QT += core
+QT -= gui
+CONFIG += console mobility
+CONFIG -= app_bundle
+MOBILITY += connectivity
+
+SOURCES += main.cpp \
+    ndeflogconverter.cpp
+
+HEADERS += \
+    ndeflogconverter.h
+
+# Segment log format, shared with the app
+include(../../ndefdecoding.pri)
@@ -0,0 +1,156 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "ndeflogconverter.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+NdefLogConverter::NdefLogConverter() :
+    m_maxSegmentSize(NDEF_SEGMENT_DEFAULT_MAX_SIZE)
+{
+}
+
+void NdefLogConverter::setMaxSegmentSize(const qint64 maxSegmentSize)
+{
+    m_maxSegmentSize = maxSegmentSize;
+}
+
+/*!
+  \brief Append all legacy log files in the \a sourceDir and its
+  sub-directories to new segments in the \a logDir.
+
+  The files are imported in the order of their names, which is the
+  chronological order for files created by the app.
+
+  \return number of imported messages, or -1 if the log couldn't be
+  created.
+  */
+int NdefLogConverter::importFiles(const QString &sourceDir, const QString &logDir)
+{
+    m_errorString.clear();
+    QStringList fileNames;
+    QDirIterator it(sourceDir, QStringList() << QString("*") + LEGACY_LOG_SUFFIX, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        fileNames.append(it.next());
+    }
+    fileNames.sort();
+
+    NdefSegmentLog log;
+    log.setMaxSegmentSize(m_maxSegmentSize);
+    if (!log.open(logDir)) {
+        m_errorString = log.errorString();
+        return -1;
+    }
+
+    int importedCount = 0;
+    foreach (const QString &fileName, fileNames) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qDebug() << "Unable to open file: " << fileName;
+            continue;
+        }
+        const QByteArray rawMessage = file.readAll();
+        file.close();
+
+        const QFileInfo fileInfo(fileName);
+        QDateTime timestamp;
+        QString tagType;
+        if (!NdefSegmentLog::parseLegacyFileName(fileInfo.completeBaseName(), timestamp, tagType)) {
+            // Manually named file - use the modification time instead
+            timestamp = fileInfo.lastModified();
+        }
+        if (log.append(rawMessage, tagType, timestamp) < 0) {
+            m_errorString = log.errorString();
+            break;
+        }
+        importedCount++;
+    }
+    log.close();
+    return importedCount;
+}
+
+/*!
+  \brief Write every frame of the segment file, or of all segments in
+  the directory, to a legacy log file of its own in the \a targetDir.
+
+  \return number of exported messages, or -1 if the target directory
+  couldn't be created.
+  */
+int NdefLogConverter::exportSegments(const QString &source, const QString &targetDir)
+{
+    m_errorString.clear();
+    const QStringList segmentFileNames = QFileInfo(source).isDir() ? NdefSegmentLog::segmentFiles(source)
+                                                                   : QStringList(source);
+    if (!QDir().mkpath(targetDir)) {
+        m_errorString = "Unable to create directory: " + targetDir;
+        return -1;
+    }
+
+    int exportedCount = 0;
+    foreach (const QString &segmentFileName, segmentFileNames) {
+        NdefSegmentReader reader;
+        if (!reader.open(segmentFileName)) {
+            qDebug() << reader.errorString();
+            continue;
+        }
+        if (!reader.hasIndex()) {
+            qDebug() << "Segment has no index, recovering frames: " << segmentFileName;
+        }
+        NdefLogFrame frame;
+        for (int i = 0; i < reader.frameCount(); i++) {
+            if (!reader.readFrame(i, frame)) {
+                qDebug() << reader.errorString();
+                continue;
+            }
+            QFile file(legacyFileName(targetDir, frame));
+            if (!file.open(QIODevice::WriteOnly) || file.write(frame.rawMessage) != frame.rawMessage.size()) {
+                m_errorString = "Unable to write file: " + file.fileName();
+                qDebug() << m_errorString;
+                continue;
+            }
+            file.close();
+            exportedCount++;
+        }
+    }
+    return exportedCount;
+}
+
+QString NdefLogConverter::errorString() const
+{
+    return m_errorString;
+}
+
+/*!
+  \brief File name for the exported \a frame, using the same pattern as
+  NfcInfo::storeNdefToFile(). Messages read within the same second get
+  a counter appended instead of overwriting each other.
+  */
+QString NdefLogConverter::legacyFileName(const QString &targetDir, const NdefLogFrame &frame)
+{
+    const QDir dir(targetDir);
+    QString baseName = frame.timestamp.toString(LEGACY_LOG_DATE_FORMAT);
+    if (!frame.tagType.isEmpty()) {
+        baseName.append(" - " + frame.tagType);
+    }
+    QString fileName = dir.filePath(baseName + LEGACY_LOG_SUFFIX);
+    for (int i = 2; QFile::exists(fileName); i++) {
+        fileName = dir.filePath(baseName + " (" + QString::number(i) + ")" + LEGACY_LOG_SUFFIX);
+    }
+    return fileName;
+}
@@ -0,0 +1,52 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NDEFLOGCONVERTER_H
+#define NDEFLOGCONVERTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include "ndefsegmentlog.h"
+
+/*!
+  \brief Converts logged NDEF messages between the legacy layout with
+  one file per message and the segmented log.
+
+  The timestamp and the tag type are taken from the legacy file names
+  when importing, and used to create the file names when exporting.
+  */
+class NdefLogConverter
+{
+public:
+    NdefLogConverter();
+
+    void setMaxSegmentSize(const qint64 maxSegmentSize);
+
+    int importFiles(const QString &sourceDir, const QString &logDir);
+    int exportSegments(const QString &source, const QString &targetDir);
+
+    QString errorString() const;
+
+private:
+    static QString legacyFileName(const QString &targetDir, const NdefLogFrame &frame);
+
+private:
+    qint64 m_maxSegmentSize;
+    QString m_errorString;
+};
+
+#endif // NDEFLOGCONVERTER_H
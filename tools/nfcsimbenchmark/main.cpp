@@ -0,0 +1,151 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include <QApplication>
+#include <QDir>
+#include <QStringList>
+#include <QTextStream>
+#include "nfcsimbenchmark.h"
+
+static bool verbose = false;
+
+/*!
+  \brief Hide the debug output of NfcInfo and the target analyzer,
+  which would otherwise flood the console.
+  */
+static void messageHandler(QtMsgType type, const char *msg)
+{
+    if (type == QtDebugMsg && !verbose) {
+        return;
+    }
+    QTextStream(stderr) << msg << "\n";
+}
+
+static void printUsage(QTextStream &err)
+{
+    err << "Usage: nfcsimbenchmark [options]\n"
+        << "  --type t             tag type: 1, 2, 4 or all (default)\n"
+        << "  --iterations n       touches per scenario (default: 100)\n"
+        << "  --size bytes         size of the written message (default: 40)\n"
+        << "  --tag-size bytes     Type 2 data area / Type 4 NDEF file size\n"
+        << "  --latency us         duration of every request (default: 5000)\n"
+        << "  --byte-latency us    additional duration per byte (default: 100)\n"
+        << "  --jitter us          maximum random delay per request (default: 0)\n"
+        << "  --failure-rate p     probability of a failed request, 0 - 1 (default: 0)\n"
+        << "  --remove-after n     tag goes out of range after n requests\n"
+        << "  --seed n             seed for the random numbers (default: 1)\n"
+        << "  --log-dir dir        directory for the logged messages (default: temp)\n"
+        << "  --no-log             don't save read messages to files\n"
+        << "  --sync-log           save files while reading, not in the background\n"
+        << "  --segmented          save read messages to the segment log\n"
+        << "  --dedup              save read messages to the dedup store\n"
+        << "  --shrink             shrink messages that don't fit the tag\n"
+        << "  --diff               only write the changed blocks\n"
+        << "  --verify             read back written messages\n"
+        << "  --verbose            show the debug output\n";
+}
+
+int main(int argc, char *argv[])
+{
+    // NfcInfo needs QApplication, but no GUI
+    QApplication app(argc, argv, false);
+    QTextStream err(stderr);
+    NfcSimBenchmark benchmark;
+    AppSettings *settings = benchmark.settings();
+
+    NfcSimulatorConfig config;
+    QList<NfcSimulatedManager::SimulatedTagType> tagTypes;
+    int iterations = 100;
+    int messageSize = 40;
+    int tagSize = 0;
+    quint32 seed = 1;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); i++) {
+        const QString arg = args.at(i);
+        const bool hasValue = (i + 1 < args.size());
+        if (arg == "--type" && hasValue) {
+            const QString type = args.at(++i);
+            if (type == "1") {
+                tagTypes << NfcSimulatedManager::SimulatedType1;
+            } else if (type == "2") {
+                tagTypes << NfcSimulatedManager::SimulatedType2;
+            } else if (type == "4") {
+                tagTypes << NfcSimulatedManager::SimulatedType4;
+            } else if (type != "all") {
+                printUsage(err);
+                return 1;
+            }
+        } else if (arg == "--iterations" && hasValue) {
+            iterations = args.at(++i).toInt();
+        } else if (arg == "--size" && hasValue) {
+            messageSize = args.at(++i).toInt();
+        } else if (arg == "--tag-size" && hasValue) {
+            tagSize = args.at(++i).toInt();
+        } else if (arg == "--latency" && hasValue) {
+            config.requestLatencyUsecs = args.at(++i).toInt();
+        } else if (arg == "--byte-latency" && hasValue) {
+            config.byteLatencyUsecs = args.at(++i).toInt();
+        } else if (arg == "--jitter" && hasValue) {
+            config.jitterUsecs = args.at(++i).toInt();
+        } else if (arg == "--failure-rate" && hasValue) {
+            config.failureRate = args.at(++i).toDouble();
+        } else if (arg == "--remove-after" && hasValue) {
+            config.removeAfterRequests = args.at(++i).toInt();
+        } else if (arg == "--seed" && hasValue) {
+            seed = args.at(++i).toUInt();
+        } else if (arg == "--log-dir" && hasValue) {
+            settings->setLogNdefDir(QDir::cleanPath(args.at(++i)) + "/");
+        } else if (arg == "--no-log") {
+            settings->setLogNdefToFile(false);
+        } else if (arg == "--sync-log") {
+            settings->setLogNdefAsync(false);
+        } else if (arg == "--segmented") {
+            settings->setLogNdefSegmented(true);
+        } else if (arg == "--dedup") {
+            settings->setLogNdefDedup(true);
+        } else if (arg == "--shrink") {
+            settings->setShrinkMessagesToFit(true);
+        } else if (arg == "--diff") {
+            settings->setDiffWrites(true);
+        } else if (arg == "--verify") {
+            settings->setVerifyWrites(true);
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else {
+            printUsage(err);
+            return 1;
+        }
+    }
+    if (tagTypes.isEmpty()) {
+        tagTypes << NfcSimulatedManager::SimulatedType1 << NfcSimulatedManager::SimulatedType2
+                 << NfcSimulatedManager::SimulatedType4;
+    }
+    qInstallMsgHandler(messageHandler);
+
+    benchmark.setConfig(config);
+    benchmark.setSeed(seed);
+    benchmark.setIterations(iterations);
+    benchmark.setMessageSize(messageSize);
+    benchmark.setTagSize(tagSize);
+    foreach (const NfcSimulatedManager::SimulatedTagType tagType, tagTypes) {
+        benchmark.run(tagType);
+    }
+
+    QTextStream out(stdout);
+    out << benchmark.toText();
+    return 0;
+}
@@ -0,0 +1,301 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "nfcsimbenchmark.h"
+#include <QDir>
+#include <QFile>
+#include <QNdefNfcTextRecord>
+
+NfcSimBenchmarkResult::NfcSimBenchmarkResult() :
+    failureCount(0),
+    bytesWritten(0)
+{
+}
+
+/*!
+  \brief Latency that \a percentile percent of the successful
+  iterations didn't exceed.
+  */
+qint64 NfcSimBenchmarkResult::percentileNsecs(const int percentile) const
+{
+    if (latenciesNsecs.isEmpty()) {
+        return 0;
+    }
+    QVector<qint64> sorted = latenciesNsecs;
+    qSort(sorted);
+    const int index = qBound(0, (sorted.size() * percentile + 99) / 100 - 1, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+// ----------------------------------------------------------------------------
+
+NfcSimBenchmark::NfcSimBenchmark(QObject *parent) :
+    QObject(parent),
+    m_iterations(100),
+    m_messageSize(40),
+    m_tagSize(0),
+    m_currentResult(-1),
+    m_writing(false),
+    m_remainingIterations(0),
+    m_iterationActive(false),
+    m_iterationSucceeded(false)
+{
+    m_simulator = new NfcSimulatedManager(this);
+
+    // Start from the defaults instead of the settings stored by the app
+    m_settings = new AppSettings(this);
+    m_settings->setLogNdefToFile(true);
+    m_settings->setLogNdefDir(QDir::tempPath() + "/nfcsimbenchmark/");
+    m_settings->setLogNdefSegmented(false);
+    m_settings->setLogNdefDedup(false);
+    m_settings->setLogNdefAsync(true);
+    m_settings->setDeleteTagBeforeWriting(false);
+    m_settings->setPersistTagProfiles(false);
+    m_settings->setShrinkMessagesToFit(false);
+    m_settings->setVerifyWrites(false);
+    m_settings->setDiffWrites(false);
+
+    // Same setup as in main() of the app, just without the UI
+    m_nfcInfo = new NfcInfo(this);
+    m_nfcInfo->setSimulator(m_simulator);
+    connect(m_nfcInfo, SIGNAL(nfcTagContents(QString,QString)), this, SLOT(tagContents()));
+    connect(m_nfcInfo, SIGNAL(nfcTagWritten()), this, SLOT(tagWritten()));
+    connect(m_nfcInfo, SIGNAL(nfcStoppedTagInteraction()), this, SLOT(stoppedTagInteraction()));
+    // NfcInfo deletes the lost targets
+    connect(m_simulator, SIGNAL(targetLost(QNearFieldTarget*)), this, SLOT(targetLost()));
+
+    m_iterationTimer.setSingleShot(true);
+    connect(&m_iterationTimer, SIGNAL(timeout()), this, SLOT(iterationTimeout()));
+}
+
+/*!
+  \brief Settings for NfcInfo, which select the features that are
+  measured. Applied when the first run() starts.
+  */
+AppSettings * NfcSimBenchmark::settings() const
+{
+    return m_settings;
+}
+
+void NfcSimBenchmark::setConfig(const NfcSimulatorConfig &config)
+{
+    m_simulator->setConfig(config);
+}
+
+void NfcSimBenchmark::setSeed(const quint32 seed)
+{
+    m_simulator->setSeed(seed);
+}
+
+void NfcSimBenchmark::setIterations(const int iterations)
+{
+    m_iterations = iterations;
+}
+
+/*!
+  \brief Size of the written message in bytes. Reduced to the
+  capacity of the tag if necessary.
+  */
+void NfcSimBenchmark::setMessageSize(const int messageSize)
+{
+    m_messageSize = messageSize;
+}
+
+/*!
+  \brief Data area size of Type 2 tags or NDEF file size of Type 4
+  tags, 0 for the default size.
+  */
+void NfcSimBenchmark::setTagSize(const int tagSize)
+{
+    m_tagSize = tagSize;
+}
+
+/*!
+  \brief Run both scenarios for a new tag of the \a tagType: first
+  write the message with every touch, then read it with every touch.
+  */
+bool NfcSimBenchmark::run(const NfcSimulatedManager::SimulatedTagType tagType)
+{
+    if (m_settings->parent() != m_nfcInfo) {
+        // Takes ownership of the settings
+        m_nfcInfo->setAppSettings(m_settings);
+    }
+    m_tag = m_simulator->createTag(tagType, m_tagSize);
+    if (!m_tag) {
+        return false;
+    }
+    NfcTargetAnalyzer analyzer;
+    const QString tagName = analyzer.convertTagTypeToString(m_tag->type());
+
+    for (int scenario = 0; scenario < 2; scenario++) {
+        m_writing = (scenario == 0);
+        if (m_writing) {
+            if (!startWriting()) {
+                return false;
+            }
+        } else {
+            m_nfcInfo->nfcStopWritingTags();
+        }
+        NfcSimBenchmarkResult result;
+        result.scenario = tagName + (m_writing ? ": detect to written" : ": detect to read");
+        m_results.append(result);
+        m_currentResult = m_results.size() - 1;
+        m_tag->resetBytesWritten();
+        m_remainingIterations = m_iterations;
+        QTimer::singleShot(0, this, SLOT(nextIteration()));
+        m_loop.exec();
+        if (m_writing) {
+            m_results[m_currentResult].bytesWritten = m_tag->bytesWritten();
+        }
+    }
+    return true;
+}
+
+QList<NfcSimBenchmarkResult> NfcSimBenchmark::results() const
+{
+    return m_results;
+}
+
+/*!
+  \brief Table of the latency percentiles of all scenarios.
+  */
+QString NfcSimBenchmark::toText() const
+{
+    QString text = QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+            .arg("Scenario", -36).arg("Runs", 6).arg("Fail", 6)
+            .arg("p50 ms", 9).arg("p90 ms", 9).arg("p99 ms", 9).arg("max ms", 9).arg("B/write", 9);
+    foreach (const NfcSimBenchmarkResult &result, m_results) {
+        const int runs = result.latenciesNsecs.size() + result.failureCount;
+        text.append(QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                    .arg(result.scenario, -36)
+                    .arg(runs, 6)
+                    .arg(result.failureCount, 6)
+                    .arg(result.percentileNsecs(50) / 1000000.0, 9, 'f', 2)
+                    .arg(result.percentileNsecs(90) / 1000000.0, 9, 'f', 2)
+                    .arg(result.percentileNsecs(99) / 1000000.0, 9, 'f', 2)
+                    .arg(result.percentileNsecs(100) / 1000000.0, 9, 'f', 2)
+                    .arg(runs > 0 && result.bytesWritten > 0 ? QString::number(result.bytesWritten / runs) : QString("-"), 9));
+    }
+    return text;
+}
+
+/*!
+  \brief Touch the tag for the next iteration of the current scenario.
+  */
+void NfcSimBenchmark::nextIteration()
+{
+    if (m_remainingIterations <= 0) {
+        m_loop.quit();
+        return;
+    }
+    m_remainingIterations--;
+    m_iterationActive = true;
+    m_iterationSucceeded = false;
+    m_iterationTimer.start(NFCSIMBENCHMARK_ITERATION_TIMEOUT_MSECS);
+    m_touchTimer.start();
+    m_simulator->touch(m_tag);
+}
+
+void NfcSimBenchmark::tagContents()
+{
+    if (!m_writing) {
+        m_iterationSucceeded = true;
+    }
+}
+
+void NfcSimBenchmark::tagWritten()
+{
+    if (m_writing) {
+        m_iterationSucceeded = true;
+    }
+}
+
+/*!
+  \brief NfcInfo has finished reading or writing the tag, including
+  logging the message or verifying it.
+  */
+void NfcSimBenchmark::stoppedTagInteraction()
+{
+    finishIteration(m_iterationSucceeded);
+}
+
+void NfcSimBenchmark::targetLost()
+{
+    finishIteration(false);
+}
+
+void NfcSimBenchmark::iterationTimeout()
+{
+    qDebug() << "Iteration not finished after" << NFCSIMBENCHMARK_ITERATION_TIMEOUT_MSECS << "ms";
+    finishIteration(false);
+}
+
+/*!
+  \brief Save the message to a file and let NfcInfo write it to
+  every touched tag, like writing a saved message in the app.
+  */
+bool NfcSimBenchmark::startWriting()
+{
+    const QString dirName = m_settings->logNdefDir(false);
+    QFile messageFile(QDir(dirName).filePath(NFCSIMBENCHMARK_MESSAGE_FILE_NAME));
+    if (!QDir().mkpath(dirName) || !messageFile.open(QIODevice::WriteOnly) ||
+            messageFile.write(createMessage().toByteArray()) < 0) {
+        qWarning() << "Unable to write the message file" << messageFile.fileName();
+        return false;
+    }
+    messageFile.close();
+    // Note the inverted flag: true keeps writing to further tags
+    return m_nfcInfo->nfcWriteTag(messageFile.fileName(), true);
+}
+
+/*!
+  \brief Text message of the configured size.
+  */
+QNdefMessage NfcSimBenchmark::createMessage() const
+{
+    // Text record: 4 bytes header + type, 3 bytes status and locale
+    const int maxSize = qMin(m_messageSize, m_tag->ndefCapacity());
+    QNdefNfcTextRecord textRecord;
+    textRecord.setLocale("en");
+    textRecord.setText(QString(qMax(1, maxSize - 7), QChar('x')));
+    return QNdefMessage(textRecord);
+}
+
+/*!
+  \brief Record the latency of the current iteration and take the
+  target out of range.
+  */
+void NfcSimBenchmark::finishIteration(const bool success)
+{
+    if (!m_iterationActive) {
+        return;
+    }
+    m_iterationActive = false;
+    m_iterationTimer.stop();
+#if QT_VERSION >= 0x040800
+    const qint64 elapsedNsecs = m_touchTimer.nsecsElapsed();
+#else
+    const qint64 elapsedNsecs = m_touchTimer.elapsed() * 1000000;
+#endif
+    NfcSimBenchmarkResult &result = m_results[m_currentResult];
+    if (success) {
+        result.latenciesNsecs.append(elapsedNsecs);
+    } else {
+        result.failureCount++;
+    }
+    m_simulator->removeTarget();
+    QTimer::singleShot(0, this, SLOT(nextIteration()));
+}
@@ -0,0 +1,126 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef NFCSIMBENCHMARK_H
+#define NFCSIMBENCHMARK_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QList>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QSharedPointer>
+#include <QNdefMessage>
+#include "nfcsimulatedmanager.h"
+#include "nfcinfo.h"
+#include "appsettings.h"
+
+/*! Iterations that NfcInfo hasn't finished after this time fail. */
+#define NFCSIMBENCHMARK_ITERATION_TIMEOUT_MSECS 10000
+/*! File name of the message written by the benchmark, in the
+  directory of the saved messages. */
+#define NFCSIMBENCHMARK_MESSAGE_FILE_NAME "nfcsimbenchmark.txt"
+
+QTM_USE_NAMESPACE
+
+/*!
+  \brief Latencies measured for one scenario of the benchmark.
+  */
+struct NfcSimBenchmarkResult
+{
+    NfcSimBenchmarkResult();
+    qint64 percentileNsecs(const int percentile) const;
+
+    QString scenario;
+    int failureCount;
+    /*! Bytes written to the tag memory, for the write scenario. */
+    qint64 bytesWritten;
+    QVector<qint64> latenciesNsecs;
+};
+
+/*!
+  \brief Benchmark of the tag interaction of the app, based on
+  simulated targets.
+
+  The simulated targets are handled by a real NfcInfo instance
+  (through NfcInfo::setSimulator()), just without the QML UI. Every
+  touch therefore takes the same path as in the app: the analysis of
+  the tag, reading and parsing, logging, cataloging and deduplicating
+  the collected message, or writing with shrinking, diff writing and
+  verification - depending on the AppSettings passed to NfcInfo.
+
+  The latency is measured from the touch until NfcInfo has finished
+  the interaction with the tag ("detect to read" / "detect to
+  written"). The iteration is successful if NfcInfo has shown the
+  contents or reported the message as written.
+  */
+class NfcSimBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NfcSimBenchmark(QObject *parent = 0);
+
+    AppSettings *settings() const;
+    void setConfig(const NfcSimulatorConfig &config);
+    void setSeed(const quint32 seed);
+    void setIterations(const int iterations);
+    void setMessageSize(const int messageSize);
+    void setTagSize(const int tagSize);
+
+    bool run(const NfcSimulatedManager::SimulatedTagType tagType);
+    QList<NfcSimBenchmarkResult> results() const;
+    QString toText() const;
+
+private slots:
+    void tagContents();
+    void tagWritten();
+    void stoppedTagInteraction();
+    void targetLost();
+    void iterationTimeout();
+    void nextIteration();
+
+private:
+    QNdefMessage createMessage() const;
+    bool startWriting();
+    void finishIteration(const bool success);
+
+private:
+    NfcSimulatedManager *m_simulator;
+    /*! Owned by m_nfcInfo once the first run() has started. */
+    AppSettings *m_settings;
+    NfcInfo *m_nfcInfo;
+    int m_iterations;
+    int m_messageSize;
+    int m_tagSize;
+    QSharedPointer<NfcSimulatedTagMemory> m_tag;
+    QList<NfcSimBenchmarkResult> m_results;
+    /*! Index of the result for the current scenario. */
+    int m_currentResult;
+    bool m_writing;
+    int m_remainingIterations;
+    bool m_iterationActive;
+    /*! NfcInfo has shown the contents / written the message
+      in the current iteration. */
+    bool m_iterationSucceeded;
+    QElapsedTimer m_touchTimer;
+    /*! Fails iterations that NfcInfo never finishes. */
+    QTimer m_iterationTimer;
+    QEventLoop m_loop;
+};
+
+#endif // NFCSIMBENCHMARK_H
@@ -0,0 +1,27 @@
+# Headless benchmark of the tag interaction with simulated NFC
+# targets: measures the latency from touching a tag until NfcInfo
+# has read its message, and until it has written a message.
+# Uses the complete NfcInfo of the app, just without the QML UI.
+# Runs on any desktop, no NFC hardware needed.
+#
+# Usage: nfcsimbenchmark [--type 1|2|4] [--iterations n] [--size bytes] ...
+
+TEMPLATE = app
+TARGET = nfcsimbenchmark
+QT += core gui declarative
+CONFIG += console mobility
+CONFIG -= app_bundle
+MOBILITY += sensors connectivity systeminfo versit contacts location
+
+DEFINES += USE_NFC_SIMULATOR
+
+SOURCES += main.cpp \
+    nfcsimbenchmark.cpp
+
+HEADERS += \
+    nfcsimbenchmark.h
+
+# NfcInfo and its dependencies, shared with the app
+include(../../nfccore.pri)
+# Simulated targets
+include(../../nfcsimulator/nfcsimulator.pri)
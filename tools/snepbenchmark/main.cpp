@@ -0,0 +1,107 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include "snepbenchmark.h"
+#include "snepselftest.h"
+
+static bool verbose = false;
+
+/*!
+  \brief Hide the debug output of the SNEP manager, which would
+  otherwise flood the console.
+  */
+static void messageHandler(QtMsgType type, const char *msg)
+{
+    if (type == QtDebugMsg && !verbose) {
+        return;
+    }
+    QTextStream(stderr) << msg << "\n";
+}
+
+static void printUsage(QTextStream &err)
+{
+    err << "Usage: snepbenchmark [options]\n"
+        << "  --sizes b1,b2,...    NDEF message sizes in bytes (default: 64,1024,16384)\n"
+        << "  --iterations n       requests per scenario (default: 200)\n"
+        << "  --segment bytes      bytes delivered at once by the link, which\n"
+        << "                       is also the SNEP fragment size (default: 128),\n"
+        << "                       0 to send all data at once\n"
+        << "  --verbose            show the debug output\n"
+        << "  --self-test          check the SNEP reassembly instead of measuring,\n"
+        << "                       exits with 1 if a check fails\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    QList<int> messageSizes;
+    int iterations = 200;
+    int segmentSize = SNEP_DEFAULT_FRAGMENT_SIZE;
+    bool selfTest = false;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); i++) {
+        const QString arg = args.at(i);
+        const bool hasValue = (i + 1 < args.size());
+        if (arg == "--sizes" && hasValue) {
+            foreach (const QString &size, args.at(++i).split(',', QString::SkipEmptyParts)) {
+                bool ok;
+                const int messageSize = size.toInt(&ok);
+                if (!ok || messageSize <= 0) {
+                    printUsage(err);
+                    return 1;
+                }
+                messageSizes << messageSize;
+            }
+        } else if (arg == "--iterations" && hasValue) {
+            iterations = args.at(++i).toInt();
+        } else if (arg == "--segment" && hasValue) {
+            segmentSize = args.at(++i).toInt();
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else if (arg == "--self-test") {
+            selfTest = true;
+        } else {
+            printUsage(err);
+            return 1;
+        }
+    }
+    if (messageSizes.isEmpty()) {
+        messageSizes << 64 << 1024 << 16384;
+    }
+    qInstallMsgHandler(messageHandler);
+
+    QTextStream out(stdout);
+    if (selfTest) {
+        SnepSelfTest test;
+        return test.run(out) ? 0 : 1;
+    }
+
+    SnepBenchmark benchmark;
+    benchmark.setIterations(iterations);
+    benchmark.setSegmentSize(segmentSize);
+    foreach (const int messageSize, messageSizes) {
+        benchmark.run(messageSize);
+    }
+
+    out << benchmark.toText();
+    return 0;
+}
@@ -0,0 +1,285 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#include "snepbenchmark.h"
+#include <QNdefRecord>
+
+// Type of the records exchanged by the benchmark
+#define SNEP_BENCHMARK_TYPE "application/x-snepbenchmark"
+
+SnepBenchmarkResult::SnepBenchmarkResult() :
+    messageSize(0),
+    failureCount(0),
+    totalNsecs(0)
+{
+}
+
+/*!
+  \brief Round trip latency that \a percentile percent of the
+  successful requests didn't exceed.
+  */
+qint64 SnepBenchmarkResult::percentileNsecs(const int percentile) const
+{
+    if (latenciesNsecs.isEmpty()) {
+        return 0;
+    }
+    QVector<qint64> sorted = latenciesNsecs;
+    qSort(sorted);
+    const int index = qBound(0, (sorted.size() * percentile + 99) / 100 - 1, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+double SnepBenchmarkResult::messagesPerSecond() const
+{
+    if (totalNsecs <= 0) {
+        return 0;
+    }
+    return latenciesNsecs.size() * 1000000000.0 / totalNsecs;
+}
+
+/*!
+  \brief NDEF message bytes transferred per second, not counting the
+  SNEP headers and responses.
+  */
+double SnepBenchmarkResult::bytesPerSecond() const
+{
+    return messagesPerSecond() * messageSize;
+}
+
+// ----------------------------------------------------------------------------
+
+SnepBenchmark::SnepBenchmark(QObject *parent) :
+    QObject(parent),
+    m_iterations(200),
+    m_scenario(PutScenario),
+    m_window(1),
+    m_remainingIterations(0)
+{
+    NfcLoopbackTransport::createPair(m_clientTransport, m_serverTransport, this);
+    // Only changed in memory, the settings are never saved
+    m_appSettings = new AppSettings(this);
+    m_appSettings->setUseSnep(true);
+    m_appSettings->setUseConnectionLess(false);
+    m_appSettings->setSendThroughServerSocket(false);
+
+    m_client = new NfcPeerToPeer(this);
+    m_client->setAppSettings(m_appSettings);
+    m_client->setTransports(m_clientTransport, NULL);
+    m_server = new NfcPeerToPeer(this);
+    m_server->setAppSettings(m_appSettings);
+    m_server->setTransports(NULL, m_serverTransport);
+    connect(m_client, SIGNAL(frameCompleted(int,bool)), this, SLOT(frameCompleted(int,bool)));
+
+    m_timeoutTimer.setSingleShot(true);
+    m_timeoutTimer.setInterval(SNEP_BENCHMARK_TIMEOUT_MSECS);
+    connect(&m_timeoutTimer, SIGNAL(timeout()), this, SLOT(scenarioTimeout()));
+    setSegmentSize(SNEP_DEFAULT_FRAGMENT_SIZE);
+}
+
+void SnepBenchmark::setIterations(const int iterations)
+{
+    m_iterations = iterations;
+}
+
+/*!
+  \brief Maximum number of bytes delivered at once by the loopback
+  link, which is also used as the fragment size of the SNEP requests
+  and responses. 0 to deliver all written data at once.
+  */
+void SnepBenchmark::setSegmentSize(const int segmentSize)
+{
+    m_clientTransport->setSegmentSize(segmentSize);
+    m_serverTransport->setSegmentSize(segmentSize);
+    const int fragmentSize = (segmentSize > 0) ? segmentSize : SNEP_MAX_MESSAGE_SIZE + SNEP_HEADER_SIZE;
+    m_client->setSnepFragmentSize(fragmentSize);
+    m_server->setSnepFragmentSize(fragmentSize);
+}
+
+/*!
+  \brief Run all scenarios with a message of \a messageSize bytes:
+  Put from the client to the server, Get of the same message from the
+  server, then Put with a filled send queue.
+  */
+void SnepBenchmark::run(const int messageSize)
+{
+    runScenario(PutScenario, messageSize);
+    runScenario(GetScenario, messageSize);
+    runScenario(QueueScenario, messageSize);
+}
+
+void SnepBenchmark::runScenario(const Scenario scenario, const int messageSize)
+{
+    m_scenario = scenario;
+    m_message = createMessage(messageSize);
+    const int rawMessageSize = m_message.toByteArray().size();
+    QString name;
+    switch (scenario) {
+    case PutScenario:
+        name = "Put";
+        break;
+    case GetScenario:
+        name = "Get";
+        m_server->setSnepGetResponse(QNdefRecord::Mime, SNEP_BENCHMARK_TYPE, m_message);
+        break;
+    case QueueScenario:
+        name = "Queue";
+        break;
+    }
+    SnepBenchmarkResult result;
+    result.scenario = name + " " + QString::number(rawMessageSize) + " B";
+    result.messageSize = rawMessageSize;
+    m_results.append(result);
+    // SNEP only sends the next request after the response to the
+    // previous one, the others wait in the send queue.
+    m_window = (scenario == QueueScenario) ? MAX_SEND_QUEUE_LENGTH : 1;
+    m_remainingIterations = m_iterations;
+    m_requestStartNsecs.clear();
+
+    m_scenarioTimer.start();
+    QTimer::singleShot(0, this, SLOT(sendRequests()));
+    m_loop.exec();
+    m_results.last().totalNsecs = elapsedNsecs();
+    m_timeoutTimer.stop();
+    m_server->clearSnepGetResponses();
+}
+
+QList<SnepBenchmarkResult> SnepBenchmark::results() const
+{
+    return m_results;
+}
+
+/*!
+  \brief Table with the throughput and the latency percentiles of
+  all scenarios.
+  */
+QString SnepBenchmark::toText() const
+{
+    QString text = QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+            .arg("Scenario", -16).arg("Runs", 6).arg("Fail", 6)
+            .arg("msg/s", 10).arg("KB/s", 10)
+            .arg("p50 ms", 9).arg("p99 ms", 9).arg("max ms", 9);
+    foreach (const SnepBenchmarkResult &result, m_results) {
+        text.append(QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                    .arg(result.scenario, -16)
+                    .arg(result.latenciesNsecs.size() + result.failureCount, 6)
+                    .arg(result.failureCount, 6)
+                    .arg(result.messagesPerSecond(), 10, 'f', 1)
+                    .arg(result.bytesPerSecond() / 1024.0, 10, 'f', 1)
+                    .arg(result.percentileNsecs(50) / 1000000.0, 9, 'f', 3)
+                    .arg(result.percentileNsecs(99) / 1000000.0, 9, 'f', 3)
+                    .arg(result.percentileNsecs(100) / 1000000.0, 9, 'f', 3));
+    }
+    return text;
+}
+
+/*!
+  \brief Queue requests of the current scenario until the window is
+  full. Quits the scenario once all requests have finished.
+  */
+void SnepBenchmark::sendRequests()
+{
+    while (m_remainingIterations > 0 && m_requestStartNsecs.size() < m_window) {
+        m_remainingIterations--;
+        const qint64 startNsecs = elapsedNsecs();
+        const int frameId = enqueueRequest();
+        if (frameId < 0) {
+            m_results.last().failureCount++;
+            continue;
+        }
+        m_requestStartNsecs.insert(frameId, startNsecs);
+    }
+    if (m_requestStartNsecs.isEmpty()) {
+        m_loop.quit();
+        return;
+    }
+    m_timeoutTimer.start();
+}
+
+/*!
+  \brief Add the request of the current scenario to the send queue
+  of the client.
+  \return the id of the frame, or -1 if it couldn't be queued.
+  */
+int SnepBenchmark::enqueueRequest()
+{
+    if (m_scenario == GetScenario) {
+        return m_client->requestNdef(QNdefRecord::Mime, SNEP_BENCHMARK_TYPE);
+    }
+    return m_client->enqueueNdefMessage(&m_message, NfcPeerToPeer::NormalSendPriority);
+}
+
+/*!
+  \brief Record the latency of the finished request and queue the next one.
+  */
+void SnepBenchmark::frameCompleted(const int frameId, const bool success)
+{
+    QHash<int, qint64>::iterator it = m_requestStartNsecs.find(frameId);
+    if (it == m_requestStartNsecs.end()) {
+        // Aborted by a timeout
+        return;
+    }
+    const qint64 latencyNsecs = elapsedNsecs() - it.value();
+    m_requestStartNsecs.erase(it);
+    SnepBenchmarkResult &result = m_results.last();
+    if (success) {
+        result.latenciesNsecs.append(latencyNsecs);
+    } else {
+        result.failureCount++;
+    }
+    sendRequests();
+}
+
+/*!
+  \brief A request got lost and would block the send queue - count the
+  remaining requests as failed and discard the SNEP state of both sides,
+  like when the remote device is lost.
+  */
+void SnepBenchmark::scenarioTimeout()
+{
+    m_results.last().failureCount += m_requestStartNsecs.size() + m_remainingIterations;
+    m_requestStartNsecs.clear();
+    m_remainingIterations = 0;
+    m_client->targetLost(NULL);
+    m_server->targetLost(NULL);
+    m_loop.quit();
+}
+
+/*!
+  \brief Message with a single Mime record, \a messageSize bytes in total.
+  */
+QNdefMessage SnepBenchmark::createMessage(const int messageSize) const
+{
+    const int typeLength = sizeof(SNEP_BENCHMARK_TYPE) - 1;
+    // Short records: 3 bytes header, otherwise 6 bytes
+    int payloadSize = messageSize - 3 - typeLength;
+    if (payloadSize > 255) {
+        payloadSize = messageSize - 6 - typeLength;
+    }
+    QNdefRecord record;
+    record.setTypeNameFormat(QNdefRecord::Mime);
+    record.setType(SNEP_BENCHMARK_TYPE);
+    record.setPayload(QByteArray(qMax(0, payloadSize), 'x'));
+    return QNdefMessage(record);
+}
+
+qint64 SnepBenchmark::elapsedNsecs() const
+{
+#if QT_VERSION >= 0x040800
+    return m_scenarioTimer.nsecsElapsed();
+#else
+    return m_scenarioTimer.elapsed() * 1000000;
+#endif
+}
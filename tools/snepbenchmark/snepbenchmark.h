@@ -0,0 +1,125 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+#ifndef SNEPBENCHMARK_H
+#define SNEPBENCHMARK_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QTimer>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QNdefMessage>
+#include "appsettings.h"
+#include "nfcpeertopeer.h"
+#include "nfcloopbacktransport.h"
+
+QTM_USE_NAMESPACE
+
+// A scenario is aborted if no request finishes within this time
+#define SNEP_BENCHMARK_TIMEOUT_MSECS 5000
+
+/*!
+  \brief Throughput and latencies measured for one scenario of the benchmark.
+  */
+struct SnepBenchmarkResult
+{
+    SnepBenchmarkResult();
+    qint64 percentileNsecs(const int percentile) const;
+    double messagesPerSecond() const;
+    double bytesPerSecond() const;
+
+    QString scenario;
+    /*! Size of the raw NDEF message that has been transferred. */
+    int messageSize;
+    int failureCount;
+    /*! Duration of all iterations of the scenario. */
+    qint64 totalNsecs;
+    QVector<qint64> latenciesNsecs;
+};
+
+/*!
+  \brief Benchmark of the SNEP client and server of two NfcPeerToPeer
+  instances, connected through a pair of loopback transports.
+
+  The client sends through its client transport, the server answers
+  through the transport of its accepted connection. Every request is
+  added to the send queue of the client and measured from queuing
+  until frameCompleted() reports the final response:
+  - Put: the client sends the message to the server, which replies
+  with Success once the message has been reassembled and decoded.
+  - Get: the server returns the message from its response store.
+  - Queue: like Put, but the send queue is kept filled, so the
+  latency includes waiting for the previous requests.
+
+  Messages larger than the segment size are fragmented and need the
+  Continue round trip.
+  */
+class SnepBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SnepBenchmark(QObject *parent = 0);
+
+    void setIterations(const int iterations);
+    void setSegmentSize(const int segmentSize);
+
+    void run(const int messageSize);
+    QList<SnepBenchmarkResult> results() const;
+    QString toText() const;
+
+private slots:
+    void frameCompleted(const int frameId, const bool success);
+    void scenarioTimeout();
+    void sendRequests();
+
+private:
+    enum Scenario {
+        PutScenario,
+        GetScenario,
+        QueueScenario
+    };
+    void runScenario(const Scenario scenario, const int messageSize);
+    int enqueueRequest();
+    QNdefMessage createMessage(const int messageSize) const;
+    qint64 elapsedNsecs() const;
+
+private:
+    NfcLoopbackTransport *m_clientTransport;
+    NfcLoopbackTransport *m_serverTransport;
+    AppSettings *m_appSettings;
+    NfcPeerToPeer *m_client;
+    NfcPeerToPeer *m_server;
+    int m_iterations;
+    QList<SnepBenchmarkResult> m_results;
+    Scenario m_scenario;
+    /*! Message of the current scenario. */
+    QNdefMessage m_message;
+    /*! Number of requests that are queued at the same time. */
+    int m_window;
+    int m_remainingIterations;
+    /*! Time when the requests that haven't finished yet were queued,
+      by frame id. */
+    QHash<int, qint64> m_requestStartNsecs;
+    QElapsedTimer m_scenarioTimer;
+    QTimer m_timeoutTimer;
+    QEventLoop m_loop;
+};
+
+#endif // SNEPBENCHMARK_H
@@ -0,0 +1,40 @@
+# Headless benchmark of the SNEP implementation: pushes NDEF messages
+# through the send queues of two NfcPeerToPeer instances connected by
+# a loopback LLCP transport, in both directions (Put and Get). Measures
+# messages/s, bytes/s and the round trip latency of every request.
+# Runs on any desktop, no NFC hardware needed.
+#
+# Usage: snepbenchmark [--sizes b1,b2,...] [--iterations n] [--segment bytes] ...
+#        snepbenchmark --self-test
+
+TEMPLATE = app
+TARGET = snepbenchmark
+QT += core
+QT -= gui
+CONFIG += console mobility
+CONFIG -= app_bundle
+MOBILITY += connectivity
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    snepbenchmark.cpp \
+    snepselftest.cpp \
+    ../../snepmanager.cpp \
+    ../../nfcllcptransport.cpp \
+    ../../nfcpeertopeer.cpp \
+    ../../appsettings.cpp
+
+HEADERS += \
+    snepbenchmark.h \
+    snepselftest.h \
+    ../../snepmanager.h \
+    ../../nfcllcptransport.h \
+    ../../nfcpeertopeer.h \
+    ../../appsettings.h \
+    ../../nfctypes.h
+
+# Pure NDEF decoding, shared with the app
+include(../../ndefdecoding.pri)
+# Loopback transport
+include(../../nfcsimulator/nfcsimulator.pri)
@@ -0,0 +1,192 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+
+#include "snepselftest.h"
+#include <QNdefRecord>
+#include "nfcloopbacktransport.h"
+
+// Type of the records exchanged by the self test
+#define SNEP_SELFTEST_TYPE "application/x-snepselftest"
+
+SnepSelfTest::SnepSelfTest(QObject *parent) :
+    QObject(parent),
+    m_finishedCount(0),
+    m_successCount(0)
+{
+    m_snepManager = new SnepManager(this);
+    // Only used as the keys of the SNEP sessions, no data is sent through them
+    NfcLoopbackTransport *first;
+    NfcLoopbackTransport *second;
+    NfcLoopbackTransport::createPair(first, second, this);
+    m_clientTransport = first;
+    m_serverTransport = second;
+    connect(m_snepManager, SIGNAL(requestFinished(bool)), this, SLOT(requestFinished(bool)));
+}
+
+/*!
+  \brief Run all checks and write the results to \a out.
+  \return true if all checks passed.
+  */
+bool SnepSelfTest::run(QTextStream &out)
+{
+    bool passed = true;
+    passed &= testTwoPutsInOneRead(out);
+    passed &= testResponseJoinedWithRequest(out);
+    passed &= testSplitHeader(out);
+    passed &= testSeparateTransports(out);
+    out << (passed ? "All checks passed\n" : "Checks failed\n");
+    return passed;
+}
+
+void SnepSelfTest::requestFinished(const bool success)
+{
+    m_finishedCount++;
+    if (success) {
+        m_successCount++;
+    }
+}
+
+/*!
+  \brief Two complete Put requests arrive in the same read.
+  */
+bool SnepSelfTest::testTwoPutsInOneRead(QTextStream &out)
+{
+    m_snepManager->reset();
+    QString results;
+    QByteArray reply;
+    const QList<QNdefMessage> messages = m_snepManager->analyzeSnepMessage(
+                m_serverTransport, createPut(10, 'a') + createPut(20, 'b'), results, reply);
+
+    bool passed = check(out, "Two Puts in one read: both messages decoded", messages.size() == 2);
+    if (messages.size() == 2) {
+        passed &= check(out, "Two Puts in one read: payloads in order",
+                        messages.at(0).at(0).payload() == QByteArray(10, 'a') &&
+                        messages.at(1).at(0).payload() == QByteArray(20, 'b'));
+    }
+    passed &= check(out, "Two Puts in one read: Success for each request",
+                    reply == m_snepManager->createSnepResponse(SNEP_RES_SUCCESS) + m_snepManager->createSnepResponse(SNEP_RES_SUCCESS));
+    return passed;
+}
+
+/*!
+  \brief The Success response to our request arrives in the same read
+  as the next request of the remote device.
+  */
+bool SnepSelfTest::testResponseJoinedWithRequest(QTextStream &out)
+{
+    m_snepManager->reset();
+    m_finishedCount = 0;
+    m_successCount = 0;
+    m_snepManager->startRequest(m_clientTransport, createPut(10, 'a'));
+
+    QString results;
+    QByteArray reply;
+    const QList<QNdefMessage> messages = m_snepManager->analyzeSnepMessage(
+                m_clientTransport, m_snepManager->createSnepResponse(SNEP_RES_SUCCESS) + createPut(5, 'c'), results, reply);
+
+    bool passed = check(out, "Success joined with Put: request finished",
+                        m_finishedCount == 1 && m_successCount == 1 && !m_snepManager->isRequestPending(m_clientTransport));
+    passed &= check(out, "Success joined with Put: Put decoded",
+                    messages.size() == 1 && messages.at(0).at(0).payload() == QByteArray(5, 'c'));
+    passed &= check(out, "Success joined with Put: Put answered",
+                    reply == m_snepManager->createSnepResponse(SNEP_RES_SUCCESS));
+    return passed;
+}
+
+/*!
+  \brief A fragmented Put whose header is split over two reads, and
+  whose last fragment arrives together with the start of the next Put.
+  */
+bool SnepSelfTest::testSplitHeader(QTextStream &out)
+{
+    m_snepManager->reset();
+    const QByteArray firstPut = createPut(300, 'a');
+    const QByteArray secondPut = createPut(20, 'b');
+    QString results;
+    QByteArray reply;
+
+    QList<QNdefMessage> messages = m_snepManager->analyzeSnepMessage(m_serverTransport, firstPut.left(3), results, reply);
+    bool passed = check(out, "Split header: no reply to an incomplete header", messages.isEmpty() && reply.isEmpty());
+
+    messages = m_snepManager->analyzeSnepMessage(m_serverTransport, firstPut.mid(3, 125), results, reply);
+    passed &= check(out, "Split header: Continue after the first fragment",
+                    messages.isEmpty() && reply == m_snepManager->createSnepResponse(SNEP_RES_CONTINUE));
+
+    messages = m_snepManager->analyzeSnepMessage(m_serverTransport, firstPut.mid(128, 100), results, reply);
+    passed &= check(out, "Split header: no second Continue", messages.isEmpty() && reply.isEmpty());
+
+    messages = m_snepManager->analyzeSnepMessage(m_serverTransport, firstPut.mid(228) + secondPut.left(4), results, reply);
+    passed &= check(out, "Split header: message complete",
+                    messages.size() == 1 && messages.at(0).at(0).payload() == QByteArray(300, 'a') &&
+                    reply == m_snepManager->createSnepResponse(SNEP_RES_SUCCESS));
+
+    messages = m_snepManager->analyzeSnepMessage(m_serverTransport, secondPut.mid(4), results, reply);
+    passed &= check(out, "Split header: following message kept",
+                    messages.size() == 1 && messages.at(0).at(0).payload() == QByteArray(20, 'b') &&
+                    reply == m_snepManager->createSnepResponse(SNEP_RES_SUCCESS));
+    return passed;
+}
+
+/*!
+  \brief The Success response to our request arrives on the client
+  transport while a fragmented Put is being received on the server
+  transport.
+  */
+bool SnepSelfTest::testSeparateTransports(QTextStream &out)
+{
+    m_snepManager->reset();
+    m_finishedCount = 0;
+    m_successCount = 0;
+    const QByteArray put = createPut(300, 'a');
+    QString results;
+    QByteArray reply;
+
+    m_snepManager->startRequest(m_clientTransport, createPut(10, 'b'));
+    m_snepManager->analyzeSnepMessage(m_serverTransport, put.left(128), results, reply);
+    QList<QNdefMessage> messages = m_snepManager->analyzeSnepMessage(
+                m_clientTransport, m_snepManager->createSnepResponse(SNEP_RES_SUCCESS), results, reply);
+    bool passed = check(out, "Separate transports: response received during the Put",
+                        m_finishedCount == 1 && m_successCount == 1 && messages.isEmpty() && reply.isEmpty());
+    passed &= check(out, "Separate transports: Put still being received",
+                    m_snepManager->isReceiving(m_serverTransport) && !m_snepManager->isReceiving(m_clientTransport));
+
+    messages = m_snepManager->analyzeSnepMessage(m_serverTransport, put.mid(128), results, reply);
+    passed &= check(out, "Separate transports: Put complete",
+                    messages.size() == 1 && messages.at(0).at(0).payload() == QByteArray(300, 'a') &&
+                    reply == m_snepManager->createSnepResponse(SNEP_RES_SUCCESS));
+    return passed;
+}
+
+/*!
+  \brief Put request of a message with a single Mime record, whose
+  payload consists of \a payloadSize times \a fill.
+  */
+QByteArray SnepSelfTest::createPut(const int payloadSize, const char fill)
+{
+    QNdefRecord record;
+    record.setTypeNameFormat(QNdefRecord::Mime);
+    record.setType(SNEP_SELFTEST_TYPE);
+    record.setPayload(QByteArray(payloadSize, fill));
+    const QNdefMessage message(record);
+    return m_snepManager->wrapNdefInSnepPut(&message);
+}
+
+bool SnepSelfTest::check(QTextStream &out, const QString &name, const bool condition)
+{
+    out << (condition ? "PASS " : "FAIL ") << name << "\n";
+    return condition;
+}
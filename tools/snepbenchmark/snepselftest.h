@@ -0,0 +1,64 @@
+/****************************************************************************
+**
+** Copyright (C) 2012-2013 Andreas Jakl.
+** All rights reserved.
+** Contact: Andreas Jakl (andreas.jakl@mopius.com)
+**
+** This file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+****************************************************************************/
+
+
+
+#ifndef SNEPSELFTEST_H
+#define SNEPSELFTEST_H
+
+#include <QObject>
+#include <QTextStream>
+#include "snepmanager.h"
+
+QTM_USE_NAMESPACE
+
+class NfcLlcpTransport;
+
+/*!
+  \brief Checks of the SNEP reassembly with reads that don't match
+  the message boundaries: multiple messages in a single read, split
+  headers and messages exchanged on two transports at the same time.
+
+  The data is passed to SnepManager::analyzeSnepMessage() directly,
+  so the checks run synchronously without an event loop.
+  */
+class SnepSelfTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SnepSelfTest(QObject *parent = 0);
+
+    bool run(QTextStream &out);
+
+private slots:
+    void requestFinished(const bool success);
+
+private:
+    bool testTwoPutsInOneRead(QTextStream &out);
+    bool testResponseJoinedWithRequest(QTextStream &out);
+    bool testSplitHeader(QTextStream &out);
+    bool testSeparateTransports(QTextStream &out);
+    QByteArray createPut(const int payloadSize, const char fill);
+    bool check(QTextStream &out, const QString &name, const bool condition);
+
+private:
+    SnepManager *m_snepManager;
+    NfcLlcpTransport *m_clientTransport;
+    NfcLlcpTransport *m_serverTransport;
+    int m_finishedCount;
+    int m_successCount;
+};
+
+#endif // SNEPSELFTEST_H